@@ -129,6 +129,8 @@ public:
     NDAttributeList *pAttributeList;  /**< Linked list of attributes */
     Codec_t codec;              /**< Definition of codec used to compress the data. */
     size_t compressedSize;      /**< Size of the compressed data. Should be equal to dataSize if pData is uncompressed. */
+    bool readOnly;              /**< pData is shared with another owner and must not be modified; plugins that would modify
+                                  * the array in place must copy it instead. */
 };
 
 // This class defines the object that is contained in the std::multilist for sorting NDArrays in the freeList_.
@@ -165,6 +165,9 @@ NDArray* NDArrayPool::alloc(int ndims, size_t *dims, NDDataType_t dataType, size
   /* Clear codec */
   pArray->codec.clear();
 
+  /* The data of a new array can be modified; pools that share it with another owner set this after alloc() */
+  pArray->readOnly = false;
+
   /* At this point pArray exists, but pArray->pData may be NULL */
   /* If the caller passed a valid buffer use that */
   if (pData) {
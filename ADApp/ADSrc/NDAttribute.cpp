@@ -37,7 +37,7 @@ const char *NDAttribute::attrSourceString(NDAttrSource_t type)
                            NDAttrSource_t sourceType, const char *pSource,
                            NDAttrDataType_t dataType, void *pValue)
 
-  : dataType_(NDAttrUndefined)
+  : dataType_(NDAttrUndefined), pValue_(&value_), schemaId_(-1)
 
 {
 
@@ -74,6 +74,7 @@ const char *NDAttribute::attrSourceString(NDAttrSource_t type)
   * \param[in] attribute The attribute to copy from
   */
 NDAttribute::NDAttribute(NDAttribute& attribute)
+  : pValue_(&value_), schemaId_(-1)
 {
   void *pValue;
   this->name_ = attribute.name_;
@@ -84,7 +85,7 @@ NDAttribute::NDAttribute(NDAttribute& attribute)
   this->string_ = "";
   this->dataType_ = attribute.dataType_;
   if (attribute.dataType_ == NDAttrString) pValue = (void *)attribute.string_.c_str();
-  else pValue = &attribute.value_;
+  else pValue = attribute.pValue_;
   this->setValue(pValue);
   this->listNode_.pNDAttribute = this;
 }
@@ -109,7 +110,7 @@ NDAttribute* NDAttribute::copy(NDAttribute *pOut)
     pOut = new NDAttribute(*this);
   else {
     if (this->dataType_ == NDAttrString) pValue = (void *)this->string_.c_str();
-    else pValue = &this->value_;
+    else pValue = this->pValue_;
     pOut->setValue(pValue);
   }
   return pOut;
@@ -122,6 +123,23 @@ const char *NDAttribute::getName()
   return name_.c_str();
 }
 
+/** Returns the ID of this attribute in the NDAttributeSchema of the list that holds it.
+  * \return The ID, or -1 if the attribute is not in a list with a schema.
+  */
+int NDAttribute::getSchemaId()
+{
+  return schemaId_;
+}
+
+/** Returns the number of times the value of this attribute had to be read again because it changed
+  * while it was being read by updateValue().  Only attributes whose value is published by another
+  * thread or by publishValue(), such as PVAttribute, retry; this base class returns 0.
+  */
+size_t NDAttribute::getSnapshotRetries()
+{
+  return 0;
+}
+
 /** Sets the data type of this attribute. This can only be called once.
   */
 int NDAttribute::setDataType(NDAttrDataType_t type)
@@ -191,34 +209,34 @@ int NDAttribute::setValue(const void *pValue)
   }
   switch (dataType_) {
     case NDAttrInt8:
-      this->value_.i8 = *(epicsInt8 *)pValue;
+      this->pValue_->i8 = *(epicsInt8 *)pValue;
       break;
     case NDAttrUInt8:
-      this->value_.ui8 = *(epicsUInt8 *)pValue;
+      this->pValue_->ui8 = *(epicsUInt8 *)pValue;
       break;
     case NDAttrInt16:
-      this->value_.i16 = *(epicsInt16 *)pValue;
+      this->pValue_->i16 = *(epicsInt16 *)pValue;
       break;
     case NDAttrUInt16:
-      this->value_.ui16 = *(epicsUInt16 *)pValue;
+      this->pValue_->ui16 = *(epicsUInt16 *)pValue;
       break;
     case NDAttrInt32:
-      this->value_.i32 = *(epicsInt32*)pValue;
+      this->pValue_->i32 = *(epicsInt32*)pValue;
       break;
     case NDAttrUInt32:
-      this->value_.ui32 = *(epicsUInt32 *)pValue;
+      this->pValue_->ui32 = *(epicsUInt32 *)pValue;
       break;
     case NDAttrInt64:
-      this->value_.i64 = *(epicsInt64*)pValue;
+      this->pValue_->i64 = *(epicsInt64*)pValue;
       break;
     case NDAttrUInt64:
-      this->value_.ui64 = *(epicsUInt64 *)pValue;
+      this->pValue_->ui64 = *(epicsUInt64 *)pValue;
       break;
     case NDAttrFloat32:
-      this->value_.f32 = *(epicsFloat32 *)pValue;
+      this->pValue_->f32 = *(epicsFloat32 *)pValue;
       break;
     case NDAttrFloat64:
-      this->value_.f64 = *(epicsFloat64 *)pValue;
+      this->pValue_->f64 = *(epicsFloat64 *)pValue;
       break;
     case NDAttrUndefined:
       break;
@@ -251,34 +269,34 @@ int NDAttribute::getValueInfo(NDAttrDataType_t *pDataType, size_t *pSize)
   *pDataType = this->dataType_;
   switch (this->dataType_) {
     case NDAttrInt8:
-      *pSize = sizeof(this->value_.i8);
+      *pSize = sizeof(this->pValue_->i8);
       break;
     case NDAttrUInt8:
-      *pSize = sizeof(this->value_.ui8);
+      *pSize = sizeof(this->pValue_->ui8);
       break;
     case NDAttrInt16:
-      *pSize = sizeof(this->value_.i16);
+      *pSize = sizeof(this->pValue_->i16);
       break;
     case NDAttrUInt16:
-      *pSize = sizeof(this->value_.ui16);
+      *pSize = sizeof(this->pValue_->ui16);
       break;
     case NDAttrInt32:
-      *pSize = sizeof(this->value_.i32);
+      *pSize = sizeof(this->pValue_->i32);
       break;
     case NDAttrUInt32:
-      *pSize = sizeof(this->value_.ui32);
+      *pSize = sizeof(this->pValue_->ui32);
       break;
     case NDAttrInt64:
-      *pSize = sizeof(this->value_.i64);
+      *pSize = sizeof(this->pValue_->i64);
       break;
     case NDAttrUInt64:
-      *pSize = sizeof(this->value_.ui64);
+      *pSize = sizeof(this->pValue_->ui64);
       break;
     case NDAttrFloat32:
-      *pSize = sizeof(this->value_.f32);
+      *pSize = sizeof(this->pValue_->f32);
       break;
     case NDAttrFloat64:
-      *pSize = sizeof(this->value_.f64);
+      *pSize = sizeof(this->pValue_->f64);
       break;
     case NDAttrString:
       *pSize = this->string_.size()+1;
@@ -300,34 +318,34 @@ int NDAttribute::getValueT(void *pValueIn, size_t dataSize)
 
   switch (this->dataType_) {
     case NDAttrInt8:
-      *pValue = (epicsType) this->value_.i8;
+      *pValue = (epicsType) this->pValue_->i8;
       break;
     case NDAttrUInt8:
-       *pValue = (epicsType) this->value_.ui8;
+       *pValue = (epicsType) this->pValue_->ui8;
       break;
     case NDAttrInt16:
-      *pValue = (epicsType) this->value_.i16;
+      *pValue = (epicsType) this->pValue_->i16;
       break;
     case NDAttrUInt16:
-      *pValue = (epicsType) this->value_.ui16;
+      *pValue = (epicsType) this->pValue_->ui16;
       break;
     case NDAttrInt32:
-      *pValue = (epicsType) this->value_.i32;
+      *pValue = (epicsType) this->pValue_->i32;
       break;
     case NDAttrUInt32:
-      *pValue = (epicsType) this->value_.ui32;
+      *pValue = (epicsType) this->pValue_->ui32;
       break;
     case NDAttrInt64:
-      *pValue = (epicsType) this->value_.i64;
+      *pValue = (epicsType) this->pValue_->i64;
       break;
     case NDAttrUInt64:
-      *pValue = (epicsType) this->value_.ui64;
+      *pValue = (epicsType) this->pValue_->ui64;
       break;
     case NDAttrFloat32:
-      *pValue = (epicsType) this->value_.f32;
+      *pValue = (epicsType) this->pValue_->f32;
       break;
     case NDAttrFloat64:
-      *pValue = (epicsType) this->value_.f64;
+      *pValue = (epicsType) this->pValue_->f64;
       break;
     default:
       return ND_ERROR;
@@ -399,6 +417,16 @@ int NDAttribute::getValue(std::string& value)
   }
 }
 
+/** Reads the source of this attribute and publishes its value for the next call to updateValue().
+  * NDAttributeList::updateValues() calls this without the list mutex held, so that slow sources do not
+  * block other threads using the list.  The base class does nothing, as do attributes whose value is
+  * published by another thread, such as PVAttribute.
+  */
+int NDAttribute::publishValue()
+{
+  return ND_SUCCESS;
+}
+
 /** Updates the current value of this attribute.
   * The base class does nothing, but derived classes may fetch the current value of the attribute,
   * for example from an EPICS PV or driver parameter library.
@@ -425,43 +453,43 @@ int NDAttribute::report(FILE *fp, int details)
   switch (this->dataType_) {
     case NDAttrInt8:
       fprintf(fp, "  dataType=NDAttrInt8\n");
-      fprintf(fp, "  value=%d\n", this->value_.i8);
+      fprintf(fp, "  value=%d\n", this->pValue_->i8);
       break;
     case NDAttrUInt8:
       fprintf(fp, "  dataType=NDAttrUInt8\n");
-      fprintf(fp, "  value=%u\n", this->value_.ui8);
+      fprintf(fp, "  value=%u\n", this->pValue_->ui8);
       break;
     case NDAttrInt16:
       fprintf(fp, "  dataType=NDAttrInt16\n");
-      fprintf(fp, "  value=%d\n", this->value_.i16);
+      fprintf(fp, "  value=%d\n", this->pValue_->i16);
       break;
     case NDAttrUInt16:
       fprintf(fp, "  dataType=NDAttrUInt16\n");
-      fprintf(fp, "  value=%d\n", this->value_.ui16);
+      fprintf(fp, "  value=%d\n", this->pValue_->ui16);
       break;
     case NDAttrInt32:
       fprintf(fp, "  dataType=NDAttrInt32\n");
-      fprintf(fp, "  value=%d\n", this->value_.i32);
+      fprintf(fp, "  value=%d\n", this->pValue_->i32);
       break;
     case NDAttrUInt32:
       fprintf(fp, "  dataType=NDAttrUInt32\n");
-      fprintf(fp, "  value=%d\n", this->value_.ui32);
+      fprintf(fp, "  value=%d\n", this->pValue_->ui32);
       break;
     case NDAttrInt64:
       fprintf(fp, "  dataType=NDAttrInt64\n");
-      fprintf(fp, "  value=%lld\n", this->value_.i64);
+      fprintf(fp, "  value=%lld\n", this->pValue_->i64);
       break;
     case NDAttrUInt64:
       fprintf(fp, "  dataType=NDAttrUInt64\n");
-      fprintf(fp, "  value=%llu\n", this->value_.ui64);
+      fprintf(fp, "  value=%llu\n", this->pValue_->ui64);
       break;
     case NDAttrFloat32:
       fprintf(fp, "  dataType=NDAttrFloat32\n");
-      fprintf(fp, "  value=%f\n", this->value_.f32);
+      fprintf(fp, "  value=%f\n", this->pValue_->f32);
       break;
     case NDAttrFloat64:
       fprintf(fp, "  dataType=NDAttrFloat64\n");
-      fprintf(fp, "  value=%f\n", this->value_.f64);
+      fprintf(fp, "  value=%f\n", this->pValue_->f64);
       break;
     case NDAttrString:
       fprintf(fp, "  dataType=NDAttrString\n");
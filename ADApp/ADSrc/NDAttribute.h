@@ -112,8 +112,11 @@ public:
     virtual int setDataType(NDAttrDataType_t dataType);
     virtual int setValue(const void *pValue);
     virtual int setValue(const std::string&);
+    virtual int publishValue();
     virtual int updateValue();
     virtual int report(FILE *fp, int details);
+    int getSchemaId();
+    virtual size_t getSnapshotRetries();
     friend class NDArray;
     friend class NDAttributeList;
 
@@ -129,6 +132,9 @@ private:
     NDAttrSource_t sourceType_;     /**< Source type */
     std::string sourceTypeString_;  /**< Source type string */
     NDAttributeListNode listNode_;  /**< Used for NDAttributeList */
+    NDAttrValue *pValue_;           /**< Value of attribute except for strings; points to value_, or into the
+                                      *  value block of an NDAttributeList with a schema */
+    int schemaId_;                  /**< ID in the NDAttributeSchema of the list holding the attribute, -1 if none */
 };
 
 #endif
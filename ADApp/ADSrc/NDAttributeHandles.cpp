@@ -0,0 +1,296 @@
+/** NDAttributeHandles.cpp
+ *
+ * Attribute names resolved once to schema IDs, so that plugins can
+ * read the attributes of each frame without comparing names.
+ *
+ */
+
+#include "NDAttributeHandles.h"
+
+/** NDAttributeHandles constructor
+  */
+NDAttributeHandles::NDAttributeHandles()
+  : pSchema_(NULL), schemaCount_(0), numUnresolved_(0)
+{
+}
+
+/** NDAttributeHandles destructor; releases the schema the names were resolved with.
+  */
+NDAttributeHandles::~NDAttributeHandles()
+{
+  this->setSchema(NULL);
+}
+
+/** Changes the schema the names are resolved with, holding a reference to it so that its IDs stay valid.
+  * \param[in] pSchema The new schema, or NULL.
+  */
+void NDAttributeHandles::setSchema(NDAttributeSchema *pSchema)
+{
+  if (pSchema == this->pSchema_) return;
+  if (pSchema) pSchema->reserve();
+  if (this->pSchema_) this->pSchema_->release();
+  this->pSchema_ = pSchema;
+  this->schemaCount_ = 0;
+  this->numUnresolved_ = (int)this->names_.size();
+  for (size_t i=0; i<this->ids_.size(); i++) this->ids_[i] = -1;
+}
+
+/** Adds an attribute name to the set.
+  * \param[in] pName The name of the attribute; may be empty and set later with setName().
+  * \return The handle of the attribute.
+  */
+int NDAttributeHandles::add(const char *pName)
+{
+  this->names_.push_back(pName ? pName : "");
+  this->ids_.push_back(-1);
+  this->numUnresolved_++;
+  this->schemaCount_ = 0;
+  return (int)this->names_.size() - 1;
+}
+
+/** Changes the attribute name of a handle; the name is resolved again when it is next read.
+  * \param[in] handle The handle.
+  * \param[in] pName The new name of the attribute.
+  */
+int NDAttributeHandles::setName(int handle, const char *pName)
+{
+  if ((handle < 0) || (handle >= (int)this->names_.size())) return ND_ERROR;
+  if (!pName) pName = "";
+  if (this->names_[handle] == pName) return ND_SUCCESS;
+  this->names_[handle] = pName;
+  if (this->ids_[handle] >= 0) {
+    this->ids_[handle] = -1;
+    this->numUnresolved_++;
+  }
+  /* Force the unresolved names to be looked up on the next read */
+  this->schemaCount_ = 0;
+  return ND_SUCCESS;
+}
+
+/** Returns the attribute name of a handle, or NULL if the handle is not valid.
+  * \param[in] handle The handle.
+  */
+const char* NDAttributeHandles::getName(int handle)
+{
+  if ((handle < 0) || (handle >= (int)this->names_.size())) return NULL;
+  return this->names_[handle].c_str();
+}
+
+/** Returns the number of handles.
+  */
+int NDAttributeHandles::count()
+{
+  return (int)this->names_.size();
+}
+
+/** Resolves the names to the schema IDs of an attribute list if they are not already resolved.
+  * This is called by get(), getValue() and getValues(); it only looks up names when the list has another schema
+  * than the last list, or when some names were not in the schema and names have been added to it since.
+  * \param[in] pList The attribute list.
+  * \return The number of handles whose name is in the schema, or 0 if the list has no schema.
+  */
+int NDAttributeHandles::resolve(NDAttributeList *pList)
+{
+  int numIds;
+
+  this->setSchema(pList->getSchema());
+  if (!this->pSchema_) return 0;
+  if (this->numUnresolved_ > 0) {
+    numIds = this->pSchema_->count();
+    if (numIds != this->schemaCount_) {
+      this->schemaCount_ = numIds;
+      for (size_t i=0; i<this->names_.size(); i++) {
+        if (this->ids_[i] >= 0) continue;
+        this->ids_[i] = this->pSchema_->findId(this->names_[i].c_str());
+        if (this->ids_[i] >= 0) this->numUnresolved_--;
+      }
+    }
+  }
+  return (int)this->names_.size() - this->numUnresolved_;
+}
+
+/** Returns the attribute of a handle in an attribute list.
+  * \param[in] pList The attribute list.
+  * \param[in] handle The handle.
+  * \return The attribute, or NULL if the handle is not valid or the list does not hold the attribute.
+  */
+NDAttribute* NDAttributeHandles::get(NDAttributeList *pList, int handle)
+{
+  NDAttribute *pAttribute;
+
+  if ((handle < 0) || (handle >= (int)this->names_.size())) return NULL;
+  this->resolve(pList);
+  epicsMutexLock(pList->lock_);
+  pAttribute = this->find(pList, (size_t)handle);
+  epicsMutexUnlock(pList->lock_);
+  return pAttribute;
+}
+
+/** Finds the attribute of a valid handle in an attribute list, once the names have been resolved for the list.
+  * Called with the lock of the list held.
+  * \param[in] pList The attribute list.
+  * \param[in] handle The handle.
+  */
+NDAttribute* NDAttributeHandles::find(NDAttributeList *pList, size_t handle)
+{
+  int id;
+
+  if (!this->pSchema_) return pList->findUnbound(this->names_[handle].c_str());
+  id = this->ids_[handle];
+  if ((id >= 0) && (id < (int)pList->slots_.size()) && pList->slots_[id].present) return pList->slots_[id].pAttribute;
+  /* Attributes copied from a list with another schema may only be held by name */
+  if (pList->numUnbound_ > 0) return pList->findUnbound(this->names_[handle].c_str());
+  return NULL;
+}
+
+/** Returns the value of the attribute of a handle in an attribute list; see NDAttribute::getValue().
+  * \param[in] pList The attribute list.
+  * \param[in] handle The handle.
+  * \param[in] dataType The data type to convert the value to.
+  * \param[out] pValue A pointer to the value.
+  * \param[in] dataSize The size of the buffer for string values.
+  * \return Returns ND_ERROR if the list does not hold the attribute.
+  */
+int NDAttributeHandles::getValue(NDAttributeList *pList, int handle, NDAttrDataType_t dataType, void *pValue, size_t dataSize)
+{
+  NDAttribute *pAttribute;
+  int status = ND_ERROR;
+
+  if ((handle < 0) || (handle >= (int)this->names_.size())) return ND_ERROR;
+  this->resolve(pList);
+  epicsMutexLock(pList->lock_);
+  pAttribute = this->find(pList, (size_t)handle);
+  if (pAttribute) status = pAttribute->getValue(dataType, pValue, dataSize);
+  epicsMutexUnlock(pList->lock_);
+  return status;
+}
+
+/** Returns the value of the NDAttrString attribute of a handle in an attribute list.
+  * \param[in] pList The attribute list.
+  * \param[in] handle The handle.
+  * \param[out] value The value.
+  * \return Returns ND_ERROR if the list does not hold the attribute or it is not a string.
+  */
+int NDAttributeHandles::getValue(NDAttributeList *pList, int handle, std::string& value)
+{
+  NDAttribute *pAttribute;
+  int status = ND_ERROR;
+
+  if ((handle < 0) || (handle >= (int)this->names_.size())) return ND_ERROR;
+  this->resolve(pList);
+  epicsMutexLock(pList->lock_);
+  pAttribute = this->find(pList, (size_t)handle);
+  if (pAttribute) status = pAttribute->getValue(value);
+  epicsMutexUnlock(pList->lock_);
+  return status;
+}
+
+/** Converts a value from the value block of a list; returns false for strings and undefined values */
+template <typename epicsType>
+static bool convertValue(NDAttrDataType_t dataType, const NDAttrValue& value, epicsType *pValue)
+{
+  switch (dataType) {
+    case NDAttrInt8:    *pValue = (epicsType)value.i8;   break;
+    case NDAttrUInt8:   *pValue = (epicsType)value.ui8;  break;
+    case NDAttrInt16:   *pValue = (epicsType)value.i16;  break;
+    case NDAttrUInt16:  *pValue = (epicsType)value.ui16; break;
+    case NDAttrInt32:   *pValue = (epicsType)value.i32;  break;
+    case NDAttrUInt32:  *pValue = (epicsType)value.ui32; break;
+    case NDAttrInt64:   *pValue = (epicsType)value.i64;  break;
+    case NDAttrUInt64:  *pValue = (epicsType)value.ui64; break;
+    case NDAttrFloat32: *pValue = (epicsType)value.f32;  break;
+    case NDAttrFloat64: *pValue = (epicsType)value.f64;  break;
+    default: return false;
+  }
+  return true;
+}
+
+/** Reads the values of all handles into a dense array indexed by handle, with one lock of the list.
+  * Attributes held by schema ID are read from the value block of the list; others with NDAttribute::getValue().
+  * \param[in] pList The attribute list.
+  * \param[in] dataType The data type of the values, NDAttrFloat64 or NDAttrInt64.
+  * \param[out] pValues The values; must have room for count() elements.
+  * \param[in] missingValue The value stored for attributes that are not in the list or cannot be converted.
+  * \return The number of values read from attributes.
+  */
+template <typename epicsType>
+int NDAttributeHandles::getValuesT(NDAttributeList *pList, NDAttrDataType_t dataType,
+                                   epicsType *pValues, epicsType missingValue)
+{
+  NDAttribute *pAttribute;
+  int id;
+  bool found;
+  int numRead = 0;
+
+  this->resolve(pList);
+  epicsMutexLock(pList->lock_);
+  for (size_t i=0; i<this->names_.size(); i++) {
+    pAttribute = this->find(pList, i);
+    found = false;
+    if (pAttribute) {
+      id = pAttribute->getSchemaId();
+      if (id >= 0) {
+        found = convertValue(pAttribute->getDataType(), pList->values_[id], &pValues[i]);
+      } else {
+        found = (pAttribute->getValue(dataType, &pValues[i]) == ND_SUCCESS);
+      }
+    }
+    if (found) numRead++;
+    else pValues[i] = missingValue;
+  }
+  epicsMutexUnlock(pList->lock_);
+  return numRead;
+}
+
+/** Reads the values of all handles as doubles into a dense array indexed by handle.
+  * The list mutex is taken once for all handles.
+  * \param[in] pList The attribute list.
+  * \param[out] pValues The values; must have room for count() elements.
+  * \param[in] missingValue The value stored for attributes that are not in the list or cannot be converted.
+  * \return The number of values read from attributes.
+  */
+int NDAttributeHandles::getValues(NDAttributeList *pList, epicsFloat64 *pValues, epicsFloat64 missingValue)
+{
+  return this->getValuesT(pList, NDAttrFloat64, pValues, missingValue);
+}
+
+/** Reads the values of all handles as 64-bit integers into a dense array indexed by handle.
+  * Integer attributes are read without a round trip through double, so values above 2^53 are exact;
+  * floating point values are truncated.  The list mutex is taken once for all handles.
+  * \param[in] pList The attribute list.
+  * \param[out] pValues The values; must have room for count() elements.
+  * \param[in] missingValue The value stored for attributes that are not in the list or cannot be converted.
+  * \return The number of values read from attributes.
+  */
+int NDAttributeHandles::getValues(NDAttributeList *pList, epicsInt64 *pValues, epicsInt64 missingValue)
+{
+  return this->getValuesT(pList, NDAttrInt64, pValues, missingValue);
+}
+
+/** Reads the values of all NDAttrString handles into a vector indexed by handle.
+  * The vector is resized to count() elements; the strings already in it are reused, so once they are long
+  * enough reading the values does not allocate memory.  The list mutex is taken once for all handles.
+  * \param[in] pList The attribute list.
+  * \param[out] values The values.
+  * \param[in] missingValue The value stored for attributes that are not in the list or are not strings.
+  * \return The number of values read from attributes.
+  */
+int NDAttributeHandles::getValues(NDAttributeList *pList, std::vector<std::string>& values, const std::string& missingValue)
+{
+  NDAttribute *pAttribute;
+  int numRead = 0;
+
+  this->resolve(pList);
+  values.resize(this->names_.size());
+  epicsMutexLock(pList->lock_);
+  for (size_t i=0; i<this->names_.size(); i++) {
+    pAttribute = this->find(pList, i);
+    if (pAttribute && (pAttribute->getValue(values[i]) == ND_SUCCESS)) {
+      numRead++;
+    } else {
+      values[i] = missingValue;
+    }
+  }
+  epicsMutexUnlock(pList->lock_);
+  return numRead;
+}
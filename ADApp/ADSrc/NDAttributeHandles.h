@@ -0,0 +1,54 @@
+/** NDAttributeHandles.h
+ *
+ * Attribute names resolved once to schema IDs, so that plugins can
+ * read the attributes of each frame without comparing names.
+ *
+ */
+
+#ifndef NDAttributeHandles_H
+#define NDAttributeHandles_H
+
+#include <string>
+#include <vector>
+
+#include "NDAttributeList.h"
+
+/** NDAttributeHandles class; a set of attribute names that a plugin reads from every NDArray.
+  * Each name is given a handle, an index into the set, when it is added.  The names are resolved to
+  * schema IDs the first time the attributes of an NDAttributeList with a schema are read, and again
+  * only when the list has another schema or names that were not yet in the schema may have been added,
+  * so reading an attribute by handle is an indexed lookup in the list without any string operations.
+  * getValue() and getValues() take the mutex of the list once per call, and read the values of attributes
+  * held by schema ID directly from the value block of the list.  Lists without a schema, and attributes
+  * whose names are not in the schema, are searched by name.  An NDAttributeHandles object is not thread safe;
+  * it is normally used by one plugin with its lock held.
+  */
+class ADCORE_API NDAttributeHandles {
+public:
+    NDAttributeHandles();
+    ~NDAttributeHandles();
+    int          add(const char *pName);
+    int          setName(int handle, const char *pName);
+    const char*  getName(int handle);
+    int          count();
+    int          resolve(NDAttributeList *pList);
+    NDAttribute* get(NDAttributeList *pList, int handle);
+    int          getValue(NDAttributeList *pList, int handle, NDAttrDataType_t dataType, void *pValue, size_t dataSize=0);
+    int          getValue(NDAttributeList *pList, int handle, std::string& value);
+    int          getValues(NDAttributeList *pList, epicsFloat64 *pValues, epicsFloat64 missingValue);
+    int          getValues(NDAttributeList *pList, epicsInt64 *pValues, epicsInt64 missingValue);
+    int          getValues(NDAttributeList *pList, std::vector<std::string>& values, const std::string& missingValue);
+
+private:
+    void         setSchema(NDAttributeSchema *pSchema);
+    NDAttribute* find(NDAttributeList *pList, size_t handle);
+    template <typename epicsType> int getValuesT(NDAttributeList *pList, NDAttrDataType_t dataType,
+                                                 epicsType *pValues, epicsType missingValue);
+    std::vector<std::string> names_;  /**< Attribute names indexed by handle */
+    std::vector<int> ids_;            /**< Schema IDs indexed by handle, -1 if not resolved */
+    NDAttributeSchema *pSchema_;      /**< Schema the IDs were resolved with, NULL if none */
+    int schemaCount_;                 /**< Number of names in the schema when the IDs were resolved */
+    int numUnresolved_;               /**< Number of handles whose name was not in the schema */
+};
+
+#endif
@@ -7,15 +7,18 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "NDAttributeList.h"
 
 /** NDAttributeList constructor
   */
 NDAttributeList::NDAttributeList()
+  : pSchema_(NULL), snapshotRetries_(0), numUnbound_(0)
 {
   ellInit(&this->list_);
   this->lock_ = epicsMutexCreate();
+  this->updateLock_ = epicsMutexCreate();
 }
 
 /** NDAttributeList destructor
@@ -23,8 +26,11 @@ NDAttributeList::NDAttributeList()
 NDAttributeList::~NDAttributeList()
 {
   this->clear();
+  this->purge();
+  if (this->pSchema_) this->pSchema_->release();
   ellFree(&this->list_);
   epicsMutexDestroy(this->lock_);
+  epicsMutexDestroy(this->updateLock_);
 }
 
 /** Adds an attribute to the list.
@@ -36,11 +42,13 @@ int NDAttributeList::add(NDAttribute *pAttribute)
 {
   //const char *functionName = "NDAttributeList::add";
 
+  epicsMutexLock(this->updateLock_);
   epicsMutexLock(this->lock_);
   /* Remove any existing attribute with this name */
   this->remove(pAttribute->name_.c_str());
-  ellAdd(&this->list_, &pAttribute->listNode_.node);
+  this->insert(pAttribute, false, true);
   epicsMutexUnlock(this->lock_);
+  epicsMutexUnlock(this->updateLock_);
   return(ND_SUCCESS);
 }
 
@@ -65,15 +73,27 @@ NDAttribute* NDAttributeList::add(const char *pName, const char *pDescription, N
   //const char *functionName = "NDAttributeList::add";
   NDAttribute *pAttribute;
 
+  epicsMutexLock(this->updateLock_);
   epicsMutexLock(this->lock_);
   pAttribute = this->find(pName);
   if (pAttribute) {
     pAttribute->setValue(pValue);
   } else {
-    pAttribute = new NDAttribute(pName, pDescription, NDAttrSourceDriver, "Driver", dataType, pValue);
-    ellAdd(&this->list_, &pAttribute->listNode_.node);
+    /* Reuse an attribute of this name and data type that was removed by clear() */
+    int id = this->pSchema_ ? this->pSchema_->findId(pName) : -1;
+    if ((id >= 0) && (id < (int)this->slots_.size()) && this->slots_[id].pAttribute &&
+        (this->slots_[id].pAttribute->dataType_ == dataType)) {
+      pAttribute = this->slots_[id].pAttribute;
+      pAttribute->setValue(pValue);
+      ellAdd(&this->list_, &pAttribute->listNode_.node);
+      this->slots_[id].present = true;
+    } else {
+      pAttribute = new NDAttribute(pName, pDescription, NDAttrSourceDriver, "Driver", dataType, pValue);
+      this->insert(pAttribute, true, true);
+    }
   }
   epicsMutexUnlock(this->lock_);
+  epicsMutexUnlock(this->updateLock_);
   return(pAttribute);
 }
 
@@ -85,20 +105,52 @@ NDAttribute* NDAttributeList::add(const char *pName, const char *pDescription, N
   */
 NDAttribute* NDAttributeList::find(const char *pName)
 {
-  NDAttribute *pAttribute;
-  NDAttributeListNode *pListNode;
+  NDAttribute *pAttribute = NULL;
   //const char *functionName = "NDAttributeList::find";
 
   epicsMutexLock(this->lock_);
+  if (this->pSchema_) {
+    /* With a schema the name is looked up in its hash table, and only the attributes whose names
+     * are not in the schema are compared by name */
+    pAttribute = this->find(this->pSchema_->findId(pName));
+    if (!pAttribute && (this->numUnbound_ > 0)) pAttribute = this->findUnbound(pName);
+  } else {
+    pAttribute = this->findUnbound(pName);
+  }
+  epicsMutexUnlock(this->lock_);
+  return(pAttribute);
+}
+
+/** Finds an attribute that is not held by schema ID by comparing names; called with the lock held.
+  * Without a schema this searches all the attributes.
+  * \param[in] pName The name of the attribute to be found.
+  */
+NDAttribute* NDAttributeList::findUnbound(const char *pName)
+{
+  NDAttribute *pAttribute;
+  NDAttributeListNode *pListNode;
+
   pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
   while (pListNode) {
     pAttribute = pListNode->pNDAttribute;
-    if (pAttribute->name_ == pName) goto done;
+    if ((pAttribute->schemaId_ < 0) && (pAttribute->name_ == pName)) return pAttribute;
     pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
   }
-  pAttribute = NULL;
+  return NULL;
+}
 
-  done:
+/** Finds an attribute by its ID in the schema of the list.
+  * \param[in] id The ID of the attribute, from NDAttributeSchema::findId or NDAttribute::getSchemaId.
+  * \return Returns a pointer to the attribute if found, NULL if not found or if the list has no schema.
+  */
+NDAttribute* NDAttributeList::find(int id)
+{
+  NDAttribute *pAttribute = NULL;
+
+  epicsMutexLock(this->lock_);
+  if ((id >= 0) && (id < (int)this->slots_.size()) && this->slots_[id].present) {
+    pAttribute = this->slots_[id].pAttribute;
+  }
   epicsMutexUnlock(this->lock_);
   return(pAttribute);
 }
@@ -145,34 +197,56 @@ int NDAttributeList::remove(const char *pName)
   int status = ND_ERROR;
   //const char *functionName = "NDAttributeList::remove";
 
+  epicsMutexLock(this->updateLock_);
   epicsMutexLock(this->lock_);
   pAttribute = this->find(pName);
   if (!pAttribute) goto done;
   ellDelete(&this->list_, &pAttribute->listNode_.node);
+  if (pAttribute->schemaId_ >= 0) {
+    this->slots_[pAttribute->schemaId_].pAttribute = NULL;
+    this->slots_[pAttribute->schemaId_].present = false;
+  } else if (this->pSchema_) {
+    this->numUnbound_--;
+  }
   delete pAttribute;
   status = ND_SUCCESS;
 
   done:
   epicsMutexUnlock(this->lock_);
+  epicsMutexUnlock(this->updateLock_);
   return(status);
 }
 
-/** Deletes all attributes from the list. */
+/** Deletes all attributes from the list.
+  * With a schema the attributes created by the list are not deleted, but kept for reuse by add() and copy().
+  */
 int NDAttributeList::clear()
 {
   NDAttribute *pAttribute;
   NDAttributeListNode *pListNode;
   //const char *functionName = "NDAttributeList::clear";
 
+  epicsMutexLock(this->updateLock_);
   epicsMutexLock(this->lock_);
   pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
   while (pListNode) {
     pAttribute = pListNode->pNDAttribute;
     ellDelete(&this->list_, &pListNode->node);
-    delete pAttribute;
+    if (pAttribute->schemaId_ >= 0) {
+      Slot& slot = this->slots_[pAttribute->schemaId_];
+      slot.present = false;
+      if (!slot.owned) {
+        slot.pAttribute = NULL;
+        delete pAttribute;
+      }
+    } else {
+      delete pAttribute;
+    }
     pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
   }
+  this->numUnbound_ = 0;
   epicsMutexUnlock(this->lock_);
+  epicsMutexUnlock(this->updateLock_);
   return(ND_SUCCESS);
 }
 
@@ -180,6 +254,9 @@ int NDAttributeList::clear()
   * It is efficient so that if the attribute already exists in the output
   * list it just copies the properties, and memory allocation is minimized.
   * The attributes are added to any existing attributes already present in the output list.
+  * An output list without a schema, or an empty one with another schema, adopts the schema of this list.
+  * Otherwise the names are only looked up in the schema of the output list, never added to it, so
+  * copying the attributes of one driver into the arrays of another does not grow its schema.
   * \param[out] pListOut A pointer to the output attribute list to copy to.
   */
 int NDAttributeList::copy(NDAttributeList *pListOut)
@@ -188,7 +265,20 @@ int NDAttributeList::copy(NDAttributeList *pListOut)
   NDAttributeListNode *pListNode;
   //const char *functionName = "NDAttributeList::copy";
 
+  epicsMutexLock(pListOut->updateLock_);
   epicsMutexLock(this->lock_);
+  if (this->pSchema_ && (pListOut->pSchema_ != this->pSchema_) &&
+      (!pListOut->pSchema_ || (pListOut->count() == 0))) {
+    epicsMutexLock(pListOut->lock_);
+    pListOut->useSchema(this->pSchema_, false);
+    epicsMutexUnlock(pListOut->lock_);
+  }
+  if (this->pSchema_ && (pListOut->pSchema_ == this->pSchema_)) {
+    this->copySchema(pListOut);
+    epicsMutexUnlock(this->lock_);
+    epicsMutexUnlock(pListOut->updateLock_);
+    return(ND_SUCCESS);
+  }
   pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
   while (pListNode) {
     pAttrIn = pListNode->pNDAttribute;
@@ -197,14 +287,228 @@ int NDAttributeList::copy(NDAttributeList *pListOut)
     /* The copy function will copy the properties, and will create the attribute if pFound is NULL */
     pAttrOut = pAttrIn->copy(pFound);
     /* If pFound is NULL, then a copy created a new attribute, need to add it to the list */
-    if (!pFound) pListOut->add(pAttrOut);
+    if (!pFound) {
+      epicsMutexLock(pListOut->lock_);
+      pListOut->insert(pAttrOut, false, false);
+      epicsMutexUnlock(pListOut->lock_);
+    }
+    pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
+  }
+  epicsMutexUnlock(this->lock_);
+  epicsMutexUnlock(pListOut->updateLock_);
+  return(ND_SUCCESS);
+}
+
+/** Copies all attributes to a list with the same schema; called by copy() with the lock held.
+  * Attributes are matched by schema ID.  If the output list is empty, as it is when NDArrayPool
+  * recycles an NDArray, the value block is copied with a single memcpy.  Attributes that are
+  * already in the output list or were removed from it by clear() are reused, so new attributes are
+  * only created the first time an attribute is copied to the list, or if its data type has changed.
+  * Attributes whose names are not in the schema are matched by name.
+  * \param[out] pListOut A pointer to the output attribute list to copy to.
+  */
+int NDAttributeList::copySchema(NDAttributeList *pListOut)
+{
+  NDAttribute *pAttrIn, *pAttrOut, *pFound;
+  NDAttributeListNode *pListNode;
+  bool empty;
+  int id;
+
+  epicsMutexLock(pListOut->lock_);
+  pListOut->growValues(this->values_.size());
+  empty = (ellCount(&pListOut->list_) == 0);
+  if (empty && !this->values_.empty()) {
+    memcpy(&pListOut->values_[0], &this->values_[0], this->values_.size() * sizeof(NDAttrValue));
+  }
+  pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
+  while (pListNode) {
+    pAttrIn = pListNode->pNDAttribute;
+    id = pAttrIn->schemaId_;
     pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
+    if (id < 0) {
+      pFound = pListOut->find(pAttrIn->name_.c_str());
+      pAttrOut = pAttrIn->copy(pFound);
+      if (!pFound) pListOut->insert(pAttrOut, false, false);
+      continue;
+    }
+    Slot& slot = pListOut->slots_[id];
+    pAttrOut = slot.pAttribute;
+    /* A reused attribute must have the same data type */
+    if (pAttrOut && (pAttrOut->dataType_ != pAttrIn->dataType_)) {
+      if (slot.present) ellDelete(&pListOut->list_, &pAttrOut->listNode_.node);
+      delete pAttrOut;
+      slot.pAttribute = NULL;
+      slot.present = false;
+      pAttrOut = NULL;
+    }
+    if (!pAttrOut) {
+      /* The output list may hold the attribute by name if its name was added to the schema later */
+      if ((pListOut->numUnbound_ > 0) && (pFound = pListOut->findUnbound(pAttrIn->name_.c_str()))) {
+        ellDelete(&pListOut->list_, &pFound->listNode_.node);
+        delete pFound;
+        pListOut->numUnbound_--;
+      }
+      pAttrOut = pAttrIn->copy(NULL);
+      pListOut->insert(pAttrOut, true, false);
+    } else {
+      if (!empty) pListOut->values_[id] = this->values_[id];
+      if (pAttrIn->dataType_ == NDAttrString) pAttrOut->string_ = pAttrIn->string_;
+      if (!slot.present) {
+        ellAdd(&pListOut->list_, &pAttrOut->listNode_.node);
+        slot.present = true;
+      }
+    }
   }
+  epicsMutexUnlock(pListOut->lock_);
+  return(ND_SUCCESS);
+}
+
+/** Sets the schema used by the list.
+  * The names of the attributes already in the list are added to the new schema, and any attributes kept for
+  * reuse are deleted.
+  * \param[in] pSchema The schema, or NULL to use a plain linked list.
+  */
+int NDAttributeList::setSchema(NDAttributeSchema *pSchema)
+{
+  epicsMutexLock(this->lock_);
+  this->useSchema(pSchema, true);
   epicsMutexUnlock(this->lock_);
   return(ND_SUCCESS);
 }
 
-/** Updates all attribute values in the list; calls NDAttribute::updateValue() for each attribute in the list.
+/** Changes the schema used by the list; called with the lock held.
+  * The attributes already in the list are moved to the new schema, and any attributes kept for
+  * reuse are deleted.
+  * \param[in] pSchema The schema, or NULL to use a plain linked list.
+  * \param[in] intern Whether names of the attributes that are not in the schema are added to it.
+  */
+void NDAttributeList::useSchema(NDAttributeSchema *pSchema, bool intern)
+{
+  NDAttribute *pAttribute;
+  NDAttributeListNode *pListNode;
+
+  if (pSchema == this->pSchema_) return;
+  this->purge();
+  /* Move the values back into the attributes */
+  pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
+  while (pListNode) {
+    pAttribute = pListNode->pNDAttribute;
+    pAttribute->value_ = *pAttribute->pValue_;
+    pAttribute->pValue_ = &pAttribute->value_;
+    pAttribute->schemaId_ = -1;
+    pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
+  }
+  this->slots_.clear();
+  this->values_.clear();
+  this->numUnbound_ = 0;
+  if (this->pSchema_) this->pSchema_->release();
+  this->pSchema_ = pSchema;
+  if (!pSchema) return;
+  pSchema->reserve();
+  pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
+  while (pListNode) {
+    pAttribute = pListNode->pNDAttribute;
+    this->bind(pAttribute, false, intern);
+    pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
+  }
+}
+
+/** Returns the schema used by the list, NULL if there is none.
+  */
+NDAttributeSchema* NDAttributeList::getSchema()
+{
+  return this->pSchema_;
+}
+
+/** Adds an attribute to the end of list_, and to its slot if the list has a schema; called with the lock held.
+  * \param[in] pAttribute The attribute, which must not already be in the list.
+  * \param[in] owned Whether the attribute was created by this list and may be kept for reuse.
+  * \param[in] intern Whether the name is added to the schema if it is not already there.
+  */
+void NDAttributeList::insert(NDAttribute *pAttribute, bool owned, bool intern)
+{
+  ellAdd(&this->list_, &pAttribute->listNode_.node);
+  if (this->pSchema_) this->bind(pAttribute, owned, intern);
+}
+
+/** Puts an attribute that is in list_ into the slot for its schema ID, and moves its value into the value block.
+  * Any attribute of the same name kept for reuse is deleted.  If the name is not in the schema and intern is
+  * false the attribute is only held in list_.  Called with the lock held.
+  * \param[in] pAttribute The attribute.
+  * \param[in] owned Whether the attribute was created by this list and may be kept for reuse.
+  * \param[in] intern Whether the name is added to the schema if it is not already there.
+  */
+void NDAttributeList::bind(NDAttribute *pAttribute, bool owned, bool intern)
+{
+  int id;
+
+  if (intern) {
+    id = this->pSchema_->intern(pAttribute->name_.c_str(), pAttribute->description_.c_str(),
+                                pAttribute->sourceType_, pAttribute->source_.c_str());
+  } else {
+    id = this->pSchema_->findId(pAttribute->name_.c_str());
+  }
+  if (id < 0) {
+    pAttribute->schemaId_ = -1;
+    this->numUnbound_++;
+    return;
+  }
+  if (id >= (int)this->slots_.size()) {
+    Slot empty = {NULL, false, false};
+    this->slots_.resize(id+1, empty);
+  }
+  this->growValues(id+1);
+  Slot& slot = this->slots_[id];
+  if (slot.pAttribute && (slot.pAttribute != pAttribute)) {
+    if (slot.present) ellDelete(&this->list_, &slot.pAttribute->listNode_.node);
+    delete slot.pAttribute;
+  }
+  this->values_[id] = *pAttribute->pValue_;
+  pAttribute->pValue_ = &this->values_[id];
+  pAttribute->schemaId_ = id;
+  slot.pAttribute = pAttribute;
+  slot.present = true;
+  slot.owned = owned;
+}
+
+/** Makes the value block hold at least size values; called with the lock held.
+  * The block is sized for all IDs in the schema, so it rarely needs to grow, and the attributes
+  * are pointed at their new values when it does.
+  * \param[in] size The number of values needed.
+  */
+void NDAttributeList::growValues(size_t size)
+{
+  if (size <= this->values_.size()) return;
+  size_t schemaSize = (size_t)this->pSchema_->count();
+  if (schemaSize > size) size = schemaSize;
+  if (size > this->slots_.size()) {
+    Slot empty = {NULL, false, false};
+    this->slots_.resize(size, empty);
+  }
+  this->values_.resize(size);
+  for (size_t id=0; id<this->slots_.size(); id++) {
+    if (this->slots_[id].pAttribute) this->slots_[id].pAttribute->pValue_ = &this->values_[id];
+  }
+}
+
+/** Deletes the attributes that clear() kept for reuse; called with the lock held.
+  */
+void NDAttributeList::purge()
+{
+  for (size_t id=0; id<this->slots_.size(); id++) {
+    Slot& slot = this->slots_[id];
+    if (slot.pAttribute && !slot.present) {
+      delete slot.pAttribute;
+      slot.pAttribute = NULL;
+    }
+  }
+}
+
+/** Updates all attribute values in the list.
+  * First calls NDAttribute::publishValue() for each attribute without the list mutex held, so reading
+  * parameters or calling functions does not block threads copying or searching this list.  Then calls
+  * NDAttribute::updateValue() for each attribute with the mutex held, which only copies the published values.
+  * Adding or removing attributes waits until this returns.
   */
 int NDAttributeList::updateValues()
 {
@@ -212,17 +516,39 @@ int NDAttributeList::updateValues()
   NDAttributeListNode *pListNode;
   //const char *functionName = "NDAttributeList::updateValues";
 
+  size_t retries = 0;
+
+  /* Read the sources without the list mutex, so that copy() and find() are not blocked by slow sources.
+   * updateLock_ keeps attributes from being added or deleted meanwhile. */
+  epicsMutexLock(this->updateLock_);
+  pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
+  while (pListNode) {
+    pListNode->pNDAttribute->publishValue();
+    pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
+  }
+  /* Take a snapshot of the published values */
   epicsMutexLock(this->lock_);
   pListNode = (NDAttributeListNode *)ellFirst(&this->list_);
   while (pListNode) {
     pAttribute = pListNode->pNDAttribute;
     pAttribute->updateValue();
+    retries += pAttribute->getSnapshotRetries();
     pListNode = (NDAttributeListNode *)ellNext(&pListNode->node);
   }
+  this->snapshotRetries_ = retries;
   epicsMutexUnlock(this->lock_);
+  epicsMutexUnlock(this->updateLock_);
   return(ND_SUCCESS);
 }
 
+/** Returns the number of times the attributes in the list had to read their value again because it
+  * changed while it was being read, summed over the attributes at the last call to updateValues().
+  */
+size_t NDAttributeList::getSnapshotRetries()
+{
+  return this->snapshotRetries_;
+}
+
 /** Reports on the properties of the attribute list.
   * \param[in] fp File pointer for the report output.
   * \param[in] details Level of report details desired; if >10 calls NDAttribute::report() for each attribute.
@@ -236,6 +562,7 @@ int NDAttributeList::report(FILE *fp, int details)
   fprintf(fp, "\n");
   fprintf(fp, "NDAttributeList: address=%p:\n", this);
   fprintf(fp, "  number of attributes=%d\n", this->count());
+  if (this->pSchema_) fprintf(fp, "  schema=%p\n", this->pSchema_);
   if (details > 10) {
     pListNode = (NDAttributeListNode *) ellFirst(&this->list_);
     while (pListNode) {
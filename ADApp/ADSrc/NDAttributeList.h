@@ -10,13 +10,23 @@
 #define NDAttributeList_H
 
 #include <stdio.h>
+#include <vector>
 #include <ellLib.h>
 #include <epicsMutex.h>
 
 #include "NDAttribute.h"
+#include "NDAttributeSchema.h"
 
 
 /** NDAttributeList class; this is a linked list of attributes.
+  * A list can be given an NDAttributeSchema.  Its attributes are then also held in slots indexed by
+  * their schema ID, with their values in one contiguous block, so that find() does not compare names
+  * and copy() to a list with the same schema reuses the attributes already created in the output list.
+  * Attributes created by the list itself are kept in their slots when they are removed by clear(),
+  * so copying the attributes of each frame into a recycled NDArray does not allocate memory.
+  * Only add() and setSchema() add names to the schema.  copy() to a list with another schema only looks the
+  * names up in it; attributes whose names are not in it are held in the linked list alone and found by name,
+  * so copying between drivers does not grow the schema of either.
   */
 class ADCORE_API NDAttributeList {
 public:
@@ -26,17 +36,41 @@ public:
     NDAttribute* add(const char *pName, const char *pDescription="",
                      NDAttrDataType_t dataType=NDAttrUndefined, void *pValue=NULL);
     NDAttribute* find(const char *pName);
+    NDAttribute* find(int id);
     NDAttribute* next(NDAttribute *pAttribute);
     int          count();
     int          remove(const char *pName);
     int          clear();
     int          copy(NDAttributeList *pOut);
     int          updateValues();
+    size_t       getSnapshotRetries();
     int          report(FILE *fp, int details);
+    int          setSchema(NDAttributeSchema *pSchema);
+    NDAttributeSchema* getSchema();
+    friend class NDAttributeHandles;
 
 private:
+    /** An attribute held by schema ID */
+    struct Slot {
+        NDAttribute *pAttribute;  /**< The attribute with this ID, or NULL */
+        bool present;             /**< The attribute is in list_; if not it is kept for reuse */
+        bool owned;               /**< The attribute was created by this list */
+    };
+    void         bind(NDAttribute *pAttribute, bool owned, bool intern);
+    void         insert(NDAttribute *pAttribute, bool owned, bool intern);
+    NDAttribute* findUnbound(const char *pName);
+    void         growValues(size_t size);
+    void         purge();
+    void         useSchema(NDAttributeSchema *pSchema, bool intern);
+    int          copySchema(NDAttributeList *pListOut);
     ELLLIST      list_;   /**< The EPICS ELLLIST  */
     epicsMutexId lock_;  /**< Mutex to protect the ELLLIST */
+    epicsMutexId updateLock_;         /**< Held by updateValues() and by methods adding or removing attributes */
+    NDAttributeSchema *pSchema_;      /**< Schema of the attribute names, NULL if none */
+    std::vector<Slot> slots_;         /**< Attributes indexed by schema ID */
+    std::vector<NDAttrValue> values_; /**< Values of the attributes indexed by schema ID */
+    size_t snapshotRetries_;          /**< Retries summed over the attributes by updateValues() */
+    int numUnbound_;                  /**< Number of attributes in list_ whose name is not in the schema */
 };
 
 #endif
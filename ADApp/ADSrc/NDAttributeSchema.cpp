@@ -0,0 +1,210 @@
+/** NDAttributeSchema.cpp
+ *
+ * Interned attribute names shared by the attribute lists of a driver
+ * and of the NDArrays it produces.
+ *
+ */
+
+#include <stdlib.h>
+
+#include <epicsString.h>
+
+#include "NDAttributeSchema.h"
+
+/** Initial number of hash buckets; the table is doubled when it holds more names than buckets */
+#define SCHEMA_INITIAL_BUCKETS 64
+
+/** NDAttributeSchema constructor; the creator holds the first reference.
+  */
+NDAttributeSchema::NDAttributeSchema()
+  : referenceCount_(1)
+{
+  this->lock_ = epicsMutexCreate();
+  this->buckets_.resize(SCHEMA_INITIAL_BUCKETS);
+}
+
+/** NDAttributeSchema destructor; called by release() when the last reference is released.
+  */
+NDAttributeSchema::~NDAttributeSchema()
+{
+  for (size_t i=0; i<this->entries_.size(); i++) delete this->entries_[i];
+  epicsMutexDestroy(this->lock_);
+}
+
+/** Rebuilds the hash table with a new number of buckets; called with the lock held.
+  * \param[in] numBuckets The new number of buckets, must be a power of 2.
+  */
+void NDAttributeSchema::rehash(size_t numBuckets)
+{
+  this->buckets_.clear();
+  this->buckets_.resize(numBuckets);
+  for (size_t id=0; id<this->entries_.size(); id++) {
+    unsigned int hash = epicsStrHash(this->entries_[id]->name.c_str(), 0);
+    this->buckets_[hash & (numBuckets-1)].push_back((int)id);
+  }
+}
+
+/** Returns the ID of an attribute name, adding the attribute to the schema if it is not already there.
+  * The description and source are only recorded the first time a name is interned.
+  * \param[in] pName The name of the attribute.
+  * \param[in] pDescription The description of the attribute.
+  * \param[in] sourceType The source type of the attribute.
+  * \param[in] pSource The source string of the attribute.
+  * \return The ID of the attribute, or -1 if pName is NULL.
+  */
+int NDAttributeSchema::intern(const char *pName, const char *pDescription,
+                              NDAttrSource_t sourceType, const char *pSource)
+{
+  int id;
+
+  if (!pName) return -1;
+  epicsMutexLock(this->lock_);
+  id = this->findId(pName);
+  if (id < 0) {
+    Entry *pEntry = new Entry;
+    pEntry->name = pName;
+    pEntry->description = pDescription ? pDescription : "";
+    pEntry->source = pSource ? pSource : "";
+    pEntry->sourceType = sourceType;
+    id = (int)this->entries_.size();
+    this->entries_.push_back(pEntry);
+    if (this->entries_.size() > this->buckets_.size()) {
+      this->rehash(this->buckets_.size() * 2);
+    } else {
+      unsigned int hash = epicsStrHash(pName, 0);
+      this->buckets_[hash & (this->buckets_.size()-1)].push_back(id);
+    }
+  }
+  epicsMutexUnlock(this->lock_);
+  return id;
+}
+
+/** Finds the ID of an attribute name; the search is case sensitive, like NDAttributeList::find.
+  * \param[in] pName The name of the attribute.
+  * \return The ID of the attribute, or -1 if the name has not been interned.
+  */
+int NDAttributeSchema::findId(const char *pName)
+{
+  int id = -1;
+
+  if (!pName) return -1;
+  epicsMutexLock(this->lock_);
+  unsigned int hash = epicsStrHash(pName, 0);
+  std::vector<int>& bucket = this->buckets_[hash & (this->buckets_.size()-1)];
+  for (size_t i=0; i<bucket.size(); i++) {
+    if (this->entries_[bucket[i]]->name == pName) {
+      id = bucket[i];
+      break;
+    }
+  }
+  epicsMutexUnlock(this->lock_);
+  return id;
+}
+
+/** Returns the number of interned attributes; IDs range from 0 to count()-1.
+  */
+int NDAttributeSchema::count()
+{
+  int n;
+
+  epicsMutexLock(this->lock_);
+  n = (int)this->entries_.size();
+  epicsMutexUnlock(this->lock_);
+  return n;
+}
+
+/** Returns the interned name of an attribute, or NULL if the ID is not valid.
+  * The string remains valid for the life of the schema.
+  * \param[in] id The ID of the attribute.
+  */
+const char* NDAttributeSchema::getName(int id)
+{
+  const char *pName = NULL;
+
+  epicsMutexLock(this->lock_);
+  if ((id >= 0) && (id < (int)this->entries_.size())) pName = this->entries_[id]->name.c_str();
+  epicsMutexUnlock(this->lock_);
+  return pName;
+}
+
+/** Returns the interned description of an attribute, or NULL if the ID is not valid.
+  * \param[in] id The ID of the attribute.
+  */
+const char* NDAttributeSchema::getDescription(int id)
+{
+  const char *pDescription = NULL;
+
+  epicsMutexLock(this->lock_);
+  if ((id >= 0) && (id < (int)this->entries_.size())) pDescription = this->entries_[id]->description.c_str();
+  epicsMutexUnlock(this->lock_);
+  return pDescription;
+}
+
+/** Returns the interned source string of an attribute, or NULL if the ID is not valid.
+  * \param[in] id The ID of the attribute.
+  */
+const char* NDAttributeSchema::getSource(int id)
+{
+  const char *pSource = NULL;
+
+  epicsMutexLock(this->lock_);
+  if ((id >= 0) && (id < (int)this->entries_.size())) pSource = this->entries_[id]->source.c_str();
+  epicsMutexUnlock(this->lock_);
+  return pSource;
+}
+
+/** Returns the source type of an attribute, or NDAttrSourceUndefined if the ID is not valid.
+  * \param[in] id The ID of the attribute.
+  */
+NDAttrSource_t NDAttributeSchema::getSourceType(int id)
+{
+  NDAttrSource_t sourceType = NDAttrSourceUndefined;
+
+  epicsMutexLock(this->lock_);
+  if ((id >= 0) && (id < (int)this->entries_.size())) sourceType = this->entries_[id]->sourceType;
+  epicsMutexUnlock(this->lock_);
+  return sourceType;
+}
+
+/** Increases the reference count of the schema; called by each NDAttributeList that uses it.
+  */
+int NDAttributeSchema::reserve()
+{
+  epicsMutexLock(this->lock_);
+  this->referenceCount_++;
+  epicsMutexUnlock(this->lock_);
+  return ND_SUCCESS;
+}
+
+/** Decreases the reference count of the schema, and deletes it when the count reaches 0.
+  */
+int NDAttributeSchema::release()
+{
+  int count;
+
+  epicsMutexLock(this->lock_);
+  count = --this->referenceCount_;
+  epicsMutexUnlock(this->lock_);
+  if (count == 0) delete this;
+  return ND_SUCCESS;
+}
+
+/** Reports on the properties of the schema.
+  * \param[in] fp File pointer for the report output.
+  * \param[in] details Level of report details desired; if >10 lists the interned names.
+  */
+int NDAttributeSchema::report(FILE *fp, int details)
+{
+  epicsMutexLock(this->lock_);
+  fprintf(fp, "\n");
+  fprintf(fp, "NDAttributeSchema: address=%p:\n", this);
+  fprintf(fp, "  number of attributes=%d\n", (int)this->entries_.size());
+  fprintf(fp, "  reference count=%d\n", this->referenceCount_);
+  if (details > 10) {
+    for (size_t id=0; id<this->entries_.size(); id++) {
+      fprintf(fp, "  %d: %s\n", (int)id, this->entries_[id]->name.c_str());
+    }
+  }
+  epicsMutexUnlock(this->lock_);
+  return ND_SUCCESS;
+}
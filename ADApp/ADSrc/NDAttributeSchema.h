@@ -0,0 +1,56 @@
+/** NDAttributeSchema.h
+ *
+ * Interned attribute names shared by the attribute lists of a driver
+ * and of the NDArrays it produces.
+ *
+ */
+
+#ifndef NDAttributeSchema_H
+#define NDAttributeSchema_H
+
+#include <string>
+#include <vector>
+
+#include <epicsMutex.h>
+
+#include "NDAttribute.h"
+
+/** NDAttributeSchema class; interns the name, description and source of each attribute once
+  * and gives it a stable integer ID.  IDs are never reused or removed, so they stay valid for the
+  * life of the schema.  NDAttributeList objects that share a schema keep their attributes in slots
+  * indexed by these IDs, which gives O(1) lookups and lets attribute values be copied between them
+  * without comparing names or allocating memory.
+  * A schema is reference counted; it is deleted when the last list using it releases it.
+  */
+class ADCORE_API NDAttributeSchema {
+public:
+    NDAttributeSchema();
+    int          intern(const char *pName, const char *pDescription="",
+                        NDAttrSource_t sourceType=NDAttrSourceDriver, const char *pSource="");
+    int          findId(const char *pName);
+    int          count();
+    const char*  getName(int id);
+    const char*  getDescription(int id);
+    const char*  getSource(int id);
+    NDAttrSource_t getSourceType(int id);
+    int          reserve();
+    int          release();
+    int          report(FILE *fp, int details);
+
+private:
+    ~NDAttributeSchema();
+    /** Definition of one interned attribute */
+    struct Entry {
+        std::string name;           /**< Name string, also the key in the hash table */
+        std::string description;    /**< Description string */
+        std::string source;         /**< Source string */
+        NDAttrSource_t sourceType;  /**< Source type */
+    };
+    void rehash(size_t numBuckets);
+    std::vector<Entry *> entries_;  /**< Interned attributes indexed by ID */
+    std::vector<std::vector<int> > buckets_;  /**< Hash table from names to IDs */
+    int referenceCount_;            /**< Number of lists using this schema */
+    epicsMutexId lock_;             /**< Mutex to protect entries_ and referenceCount_ */
+};
+
+#endif
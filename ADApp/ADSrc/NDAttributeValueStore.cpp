@@ -0,0 +1,182 @@
+/** NDAttributeValueStore.cpp
+ *
+ * Attribute value published by one thread and read by another
+ * without either of them blocking.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsAtomic.h>
+
+#include "NDAttributeValueStore.h"
+
+/** Copies a string buffer that may be overwritten during the copy, so may not be terminated */
+static void copyString(const char *pBuffer, size_t maxSize, std::string& string)
+{
+  const char *pEnd = (const char *)memchr(pBuffer, 0, maxSize);
+  string.assign(pBuffer, pEnd ? (size_t)(pEnd - pBuffer) : maxSize);
+}
+
+/** NDAttributeValueStore constructor
+  * \param[in] dataType The data type of the values that will be published.
+  * \param[in] maxStringSize The size of the largest string value, including the terminating 0; longer strings are truncated.
+  */
+NDAttributeValueStore::NDAttributeValueStore(NDAttrDataType_t dataType, size_t maxStringSize)
+  : dataType_(dataType), sequence_(0), maxStringSize_(maxStringSize), retries_(0)
+{
+  memset(this->values_, 0, sizeof(this->values_));
+  this->strings_[0] = this->strings_[1] = NULL;
+  if (dataType == NDAttrString) {
+    if (this->maxStringSize_ < 1) this->maxStringSize_ = 1;
+    this->strings_[0] = (char *)calloc(this->maxStringSize_, 1);
+    this->strings_[1] = (char *)calloc(this->maxStringSize_, 1);
+  }
+  this->writeLock_ = epicsMutexCreate();
+}
+
+/** NDAttributeValueStore destructor
+  */
+NDAttributeValueStore::~NDAttributeValueStore()
+{
+  free(this->strings_[0]);
+  free(this->strings_[1]);
+  epicsMutexDestroy(this->writeLock_);
+}
+
+/** Publishes a new value; never waits for readers.
+  * \param[in] pValue Pointer to the value, of the data type of the store; a char array for strings.
+  */
+void NDAttributeValueStore::publish(const void *pValue)
+{
+  size_t sequence;
+  int buffer;
+
+  if (!pValue) return;
+  epicsMutexLock(this->writeLock_);
+  sequence = epicsAtomicGetSizeT(&this->sequence_);
+  /* Write the buffer that readers are not directed to */
+  buffer = (int)(((sequence >> 1) + 1) & 1);
+  switch (this->dataType_) {
+    case NDAttrInt8:
+      this->values_[buffer].i8 = *(epicsInt8 *)pValue;
+      break;
+    case NDAttrUInt8:
+      this->values_[buffer].ui8 = *(epicsUInt8 *)pValue;
+      break;
+    case NDAttrInt16:
+      this->values_[buffer].i16 = *(epicsInt16 *)pValue;
+      break;
+    case NDAttrUInt16:
+      this->values_[buffer].ui16 = *(epicsUInt16 *)pValue;
+      break;
+    case NDAttrInt32:
+      this->values_[buffer].i32 = *(epicsInt32 *)pValue;
+      break;
+    case NDAttrUInt32:
+      this->values_[buffer].ui32 = *(epicsUInt32 *)pValue;
+      break;
+    case NDAttrInt64:
+      this->values_[buffer].i64 = *(epicsInt64 *)pValue;
+      break;
+    case NDAttrUInt64:
+      this->values_[buffer].ui64 = *(epicsUInt64 *)pValue;
+      break;
+    case NDAttrFloat32:
+      this->values_[buffer].f32 = *(epicsFloat32 *)pValue;
+      break;
+    case NDAttrFloat64:
+      this->values_[buffer].f64 = *(epicsFloat64 *)pValue;
+      break;
+    case NDAttrString:
+      strncpy(this->strings_[buffer], (const char *)pValue, this->maxStringSize_ - 1);
+      this->strings_[buffer][this->maxStringSize_ - 1] = 0;
+      break;
+    default:
+      epicsMutexUnlock(this->writeLock_);
+      return;
+  }
+  epicsAtomicWriteMemoryBarrier();
+  epicsAtomicSetSizeT(&this->sequence_, sequence + 2);
+  epicsMutexUnlock(this->writeLock_);
+}
+
+/** Reads the latest published value of a store for a data type other than strings.
+  * \param[out] pValue The value.
+  * \return Returns false if no value has been published yet or the store holds strings, true otherwise.
+  */
+bool NDAttributeValueStore::read(NDAttrValue *pValue)
+{
+  if (this->dataType_ == NDAttrString) return false;
+  return this->readLatest(pValue, NULL);
+}
+
+/** Reads the latest published value of a store for strings.
+  * \param[out] string The value.
+  * \return Returns false if no value has been published yet or the store does not hold strings, true otherwise.
+  */
+bool NDAttributeValueStore::read(std::string& string)
+{
+  if (this->dataType_ != NDAttrString) return false;
+  return this->readLatest(NULL, &string);
+}
+
+/** Copies the latest published value, retrying while new values are published during the copy.
+  * \param[out] pValue The value, for data types other than strings.
+  * \param[out] pString The value, for strings.
+  * \return Returns false if no value has been published yet, true otherwise.
+  */
+bool NDAttributeValueStore::readLatest(NDAttrValue *pValue, std::string *pString)
+{
+  size_t sequence, check;
+  size_t retries = 0;
+
+  while (true) {
+    sequence = epicsAtomicGetSizeT(&this->sequence_);
+    if (sequence == 0) return false;
+    epicsAtomicReadMemoryBarrier();
+    this->copy((int)((sequence >> 1) & 1), pValue, pString);
+    epicsAtomicReadMemoryBarrier();
+    check = epicsAtomicGetSizeT(&this->sequence_);
+    if (check == sequence) break;
+    retries++;
+    if (retries >= ND_ATTR_STORE_MAX_RETRIES) {
+      /* The value is changing faster than it can be copied, wait for the publisher */
+      epicsMutexLock(this->writeLock_);
+      this->copy((int)((epicsAtomicGetSizeT(&this->sequence_) >> 1) & 1), pValue, pString);
+      epicsMutexUnlock(this->writeLock_);
+      break;
+    }
+  }
+  if (retries) epicsAtomicAddSizeT(&this->retries_, retries);
+  return true;
+}
+
+/** Copies the value in one of the buffers.
+  * \param[in] buffer The buffer, 0 or 1.
+  * \param[out] pValue The value, for data types other than strings.
+  * \param[out] pString The value, for strings.
+  */
+void NDAttributeValueStore::copy(int buffer, NDAttrValue *pValue, std::string *pString)
+{
+  if (this->dataType_ == NDAttrString) {
+    copyString(this->strings_[buffer], this->maxStringSize_, *pString);
+  } else {
+    *pValue = this->values_[buffer];
+  }
+}
+
+/** Returns the data type of the values in the store.
+  */
+NDAttrDataType_t NDAttributeValueStore::getDataType()
+{
+  return this->dataType_;
+}
+
+/** Returns the total number of times read() had to copy a value again because it was published during the copy.
+  */
+size_t NDAttributeValueStore::getRetries()
+{
+  return epicsAtomicGetSizeT(&this->retries_);
+}
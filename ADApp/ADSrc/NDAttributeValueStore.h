@@ -0,0 +1,53 @@
+/** NDAttributeValueStore.h
+ *
+ * Attribute value published by one thread and read by another
+ * without either of them blocking.
+ *
+ */
+
+#ifndef NDAttributeValueStore_H
+#define NDAttributeValueStore_H
+
+#include <string>
+
+#include <epicsMutex.h>
+
+#include "NDAttribute.h"
+
+/** Maximum number of times read() retries before it waits for the publisher */
+#define ND_ATTR_STORE_MAX_RETRIES 100
+
+/** Size of the string buffers, including the terminating 0, for sources with no known maximum string length */
+#define ND_ATTR_STORE_STRING_SIZE 256
+
+/** NDAttributeValueStore class; holds the latest value published for an attribute in one of two buffers.
+  * The sequence number is incremented by 2 after each value is published, and bit 1 of it selects the buffer
+  * holding the latest value, so a publisher always writes the buffer that readers are not directed to.
+  * A reader copies the latest value and checks that the sequence number has not changed while it did so;
+  * if it has, a publisher may have started to overwrite the buffer and the copy is retried.
+  * Publishers never wait for readers, and readers only wait for a publisher after ND_ATTR_STORE_MAX_RETRIES
+  * retries.  String values are held in fixed size buffers so that a reader never sees freed memory.
+  */
+class ADCORE_API NDAttributeValueStore {
+public:
+    NDAttributeValueStore(NDAttrDataType_t dataType, size_t maxStringSize);
+    ~NDAttributeValueStore();
+    void publish(const void *pValue);
+    bool read(NDAttrValue *pValue);
+    bool read(std::string& string);
+    NDAttrDataType_t getDataType();
+    size_t getRetries();
+
+private:
+    bool readLatest(NDAttrValue *pValue, std::string *pString);
+    void copy(int buffer, NDAttrValue *pValue, std::string *pString);
+    NDAttrDataType_t dataType_;  /**< Data type of the values */
+    size_t sequence_;            /**< 0 until the first value is published, then 2 more for each value */
+    NDAttrValue values_[2];      /**< Buffers for values except strings */
+    char *strings_[2];           /**< Buffers for string values */
+    size_t maxStringSize_;       /**< Size of each string buffer, including the terminating 0 */
+    size_t retries_;             /**< Number of times read() had to copy the value again */
+    epicsMutexId writeLock_;     /**< Serializes publishers, and readers that ran out of retries */
+};
+
+#endif
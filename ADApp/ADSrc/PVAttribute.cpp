@@ -12,7 +12,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <dbDefs.h>
 #include <epicsString.h>
+#include <epicsAtomic.h>
 
 #include "PVAttribute.h"
 
@@ -37,7 +39,7 @@ static asynUser *pasynUserSelf = NULL;
 PVAttribute::PVAttribute(const char *pName, const char *pDescription,
                          const char *pSource, chtype dbrType)
     : NDAttribute(pName, pDescription, NDAttrSourceEPICSPV, pSource, NDAttrUndefined, 0),
-    dbrType(dbrType), callbackString(0), connectedOnce(false)
+    dbrType(dbrType), pStore(0), connectedOnce(false)
 {
     static const char *functionName = "PVAttribute";
 
@@ -78,6 +80,8 @@ PVAttribute::PVAttribute(PVAttribute& attribute)
     eventId = 0;
     chanId = 0;
     lock = 0;
+    pStore = 0;
+    connectedOnce = false;
 }
 
 
@@ -85,6 +89,7 @@ PVAttribute::~PVAttribute()
 {
     if (this->chanId) SEVCHK(ca_clear_channel(this->chanId),"ca_clear_channel");
     if (this->lock) epicsMutexDestroy(this->lock);
+    delete this->pStore;
 }
 
 
@@ -109,16 +114,15 @@ static void monitorCallbackC(struct event_handler_args cha)
 }
 
 /** Monitor callback called whenever an EPICS PV changes value.
-  * Calls NDAttribute::setValue to store the new value.
+  * Publishes the new value in the value store, without waiting for updateValue() to read it.
   * \param[in] eha Event handler argument structure passed by channel access.
   */
 void PVAttribute::monitorCallback(struct event_handler_args eha)
 {
     //chid  chanId = eha.chid;
-    NDAttrDataType_t dataType = this->getDataType();
+    NDAttributeValueStore *pStore = (NDAttributeValueStore *)epicsAtomicGetPtrT((void **)&this->pStore);
     const char *functionName = "monitorCallback";
 
-    epicsMutexLock(this->lock);
     asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
         "%s:%s: PV=%s\n",
         driverName, functionName, this->getSource());
@@ -127,65 +131,43 @@ void PVAttribute::monitorCallback(struct event_handler_args eha)
         asynPrint(pasynUserSelf,  ASYN_TRACE_ERROR,
         "%s:%s: CA returns eha.status=%d\n",
         driverName, functionName, eha.status);
-        goto done;
-    }
-    /* Treat strings specially */
-    if (dataType == NDAttrString) {
-      if (this->callbackString) free(this->callbackString);
-      this->callbackString = epicsStrDup((char *)eha.dbr);
-      goto done;
-    }
-    switch (dataType) {
-      case NDAttrInt8:
-        callbackValue.i8 = *(epicsInt8 *)eha.dbr;
-        break;
-      case NDAttrUInt8:
-        callbackValue.ui8 = *(epicsUInt8 *)eha.dbr;
-        break;
-      case NDAttrInt16:
-        callbackValue.i16 = *(epicsInt16 *)eha.dbr;
-        break;
-      case NDAttrUInt16:
-        callbackValue.ui16 = *(epicsUInt16 *)eha.dbr;
-        break;
-      case NDAttrInt32:
-        callbackValue.i32 = *(epicsInt32*)eha.dbr;
-        break;
-      case NDAttrUInt32:
-        callbackValue.ui32 = *(epicsUInt32 *)eha.dbr;
-        break;
-      case NDAttrFloat32:
-        callbackValue.f32 = *(epicsFloat32 *)eha.dbr;
-        break;
-      case NDAttrFloat64:
-        callbackValue.f64 = *(epicsFloat64 *)eha.dbr;
-        break;
-      case NDAttrUndefined:
-        break;
-      default:
-        break;
+        return;
     }
-    done:
-    epicsMutexUnlock(this->lock);
+    if (pStore) pStore->publish(eha.dbr);
 }
 
+/** Updates the value of this attribute with the latest value published by monitorCallback.
+  * This never blocks channel access callbacks, and is only blocked by them if the PV changes
+  * so fast that the value cannot be read ND_ATTR_STORE_MAX_RETRIES times in a row.
+  * Numeric values are copied directly; string values are read into a buffer that is kept
+  * between calls.
+  */
 int PVAttribute::updateValue()
 {
     //static const char *functionName = "updateValue"
 
-    void *pValue;
-    NDAttrDataType_t dataType = this->getDataType();
+    NDAttributeValueStore *pStore = (NDAttributeValueStore *)epicsAtomicGetPtrT((void **)&this->pStore);
+    NDAttrValue value;
 
-    epicsMutexLock(this->lock);
-    if (dataType == NDAttrString)
-        pValue = callbackString;
-    else
-        pValue = &callbackValue;
-    this->setValue(pValue);
-    epicsMutexUnlock(this->lock);
+    if (!pStore) return asynSuccess;
+    if (pStore->getDataType() == NDAttrString) {
+        if (pStore->read(this->stringValue)) this->setValue(this->stringValue);
+    } else {
+        if (pStore->read(&value)) this->setValue(&value);
+    }
     return asynSuccess;
 }
 
+/** Returns the number of times updateValue() had to read the value again because monitorCallback
+  * published a new one while it was being read.
+  */
+size_t PVAttribute::getSnapshotRetries()
+{
+    NDAttributeValueStore *pStore = (NDAttributeValueStore *)epicsAtomicGetPtrT((void **)&this->pStore);
+
+    return pStore ? pStore->getRetries() : 0;
+}
+
 
 
 static void connectCallbackC(struct connection_handler_args cha)
@@ -208,6 +190,7 @@ void PVAttribute::connectCallback(struct connection_handler_args cha)
     int nRequest=1;
     int elementCount;
     NDAttrDataType_t dataType;
+    NDAttributeValueStore *pNewStore;
 
     epicsMutexLock(this->lock);
     if (chanId && (ca_state(chanId) == cs_conn)) {
@@ -290,6 +273,12 @@ void PVAttribute::connectCallback(struct connection_handler_args cha)
             driverName, functionName, this->getSource(), chanId, dataType);
         this->setDataType(dataType);
 
+        /* Create the store the monitor callbacks publish into.  Strings read as char arrays can
+         * be as long as the array, other strings are limited by channel access. */
+        pNewStore = new NDAttributeValueStore(dataType, (nRequest > 1) ? nRequest + 1 : MAX_STRING_SIZE);
+        epicsAtomicWriteMemoryBarrier();
+        epicsAtomicSetPtrT((void **)&this->pStore, pNewStore);
+
         /* Set value change callback on this PV */
         SEVCHK(ca_add_masked_array_event(
             dbrType,
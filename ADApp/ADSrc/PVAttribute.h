@@ -16,6 +16,7 @@
 #include <epicsEvent.h>
 
 #include "NDAttribute.h"
+#include "NDAttributeValueStore.h"
 
 /** Use native type for channel access */
 #define DBR_NATIVE -1
@@ -29,6 +30,7 @@ public:
     ~PVAttribute();
     PVAttribute* copy(NDAttribute *pAttribute);
     virtual int updateValue();
+    virtual size_t getSnapshotRetries();
     /* These callbacks must be public because they are called from C */
     void connectCallback(struct connection_handler_args cha);
     void monitorCallback(struct event_handler_args cha);
@@ -38,10 +40,10 @@ private:
     chid        chanId;
     evid        eventId;
     chtype      dbrType;
-    NDAttrValue callbackValue;
-    char        *callbackString;
+    NDAttributeValueStore *pStore;  /**< Values published by monitorCallback, created on the first connection */
+    std::string stringValue;        /**< Buffer for string values read by updateValue */
     bool        connectedOnce;
-    epicsMutexId lock;
+    epicsMutexId lock;              /**< Protects the connection state */
 };
 
 #endif /*INCPVAttributeH*/
@@ -16,6 +16,9 @@
 #include <sys/stat.h>
 #include <sstream>
 #include <fstream>
+#include <map>
+#include <list>
+#include <vector>
 
 #include <libxml/parser.h>
 
@@ -23,6 +26,7 @@
 #include <epicsThread.h>
 #include <macLib.h>
 #include <cantProceed.h>
+#include <epicsExport.h>
 
 #include "PVAttribute.h"
 #include "paramAttribute.h"
@@ -49,6 +53,15 @@
 
 static const char *driverName = "asynNDArrayDriver";
 
+/** useNDAttributeSchema is a global flag that controls whether each driver interns its attribute
+  * names in an NDAttributeSchema, which the attribute lists of its NDArrays adopt when the attributes
+  * are copied to them.  The default value is 1, which gives lookups by hash or ID instead of by comparing
+  * names, and copies of attribute lists that reuse the attributes already in the output list.
+  * Set this flag to 0 before drivers are created to use plain linked lists of attributes.
+  */
+volatile int useNDAttributeSchema=1;
+extern "C" {epicsExportAddress(int, useNDAttributeSchema);}
+
 /** Checks whether the directory specified exists.
   *
   * This is a convenience function that determines the directory specified exists.
@@ -260,9 +273,232 @@ asynStatus asynNDArrayDriver::createFileName(int maxChars, char *filePath, char
     return (asynStatus) status;
 }
 
+/** Maximum number of parsed attributes files that a driver keeps */
+#define MAX_CACHED_ATTRIBUTES_FILES 16
+
+/** Definition of one attribute in an attributes file; the values of its XML attributes */
+struct NDAttributeDefinition {
+    std::string name;
+    std::string type;
+    std::string source;
+    std::string description;
+    std::string dbrtype;
+    std::string datatype;
+    std::string addr;
+    std::string param;
+    std::string update;
+    std::string period;
+
+    bool operator==(const NDAttributeDefinition& other) const {
+        return (name == other.name) && (type == other.type) && (source == other.source) &&
+               (description == other.description) && (dbrtype == other.dbrtype) &&
+               (datatype == other.datatype) && (addr == other.addr) && (param == other.param) &&
+               (update == other.update) && (period == other.period);
+    }
+};
+
+/** Parsed attributes files, and the definitions of the attributes in the attribute list that were
+  * created from the current file.  A reload compares the new definitions with these, and only
+  * creates and deletes the attributes that changed.  When the cache is full the least recently
+  * used file is evicted.
+  */
+class NDAttributesFileCache {
+public:
+    /** An attributes file after macro substitution, and the definitions parsed from it */
+    struct File {
+        std::string text;
+        std::vector<NDAttributeDefinition> definitions;
+        std::list<std::string>::iterator lru;               /**< Position of the file name in lru */
+    };
+
+    /** Returns a parsed file, or NULL if it is not in the cache, and marks it as the most recently used */
+    File *find(const std::string& name) {
+        std::map<std::string, File>::iterator it = files.find(name);
+        if (it == files.end()) return NULL;
+        lru.splice(lru.begin(), lru, it->second.lru);
+        return &it->second;
+    }
+
+    /** Returns the entry for a file, adding it as the most recently used if it is not in the cache */
+    File& insert(const std::string& name) {
+        File *pFile = find(name);
+        if (pFile) return *pFile;
+        if (files.size() >= MAX_CACHED_ATTRIBUTES_FILES) {
+            files.erase(lru.back());
+            lru.pop_back();
+        }
+        lru.push_front(name);
+        File& file = files[name];
+        file.lru = lru.begin();
+        return file;
+    }
+
+    std::map<std::string, File> files;                      /**< Parsed files, by file name */
+    std::list<std::string> lru;                             /**< File names, most recently used first */
+    std::map<std::string, NDAttributeDefinition> current;   /**< Definitions of the attributes in the list, by name */
+};
+
+/** Returns the value of an XML attribute, or pDefault if the XML attribute is absent */
+static std::string getXMLProp(xmlNode *pNode, const char *pName, const char *pDefault)
+{
+    std::string value = pDefault;
+    xmlChar *pValue = xmlGetProp(pNode, (const xmlChar *)pName);
+    if (pValue) {
+        value = (const char *)pValue;
+        xmlFree(pValue);
+    }
+    return value;
+}
+
+/** Parses the text of an attributes file into attribute definitions, checking the values of the XML attributes.
+  * \param[in] pasynUser The asynUser used for error messages.
+  * \param[in] text The text of the file after macro substitution.
+  * \param[out] definitions The definitions, in the order of the file.
+  * \return Returns 0 on success, -1 if the text is not a valid attributes file.
+  */
+static int parseNDAttributes(asynUser *pasynUser, const std::string& text, std::vector<NDAttributeDefinition>& definitions)
+{
+    xmlDocPtr doc;
+    xmlNode *Attr, *Attrs;
+    int status = 0;
+    static const char *functionName = "parseNDAttributes";
+
+    definitions.clear();
+    doc = xmlReadMemory(text.c_str(), (int)text.length(), "noname.xml", NULL, 0);
+    if (doc == NULL) {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR,
+            "%s:%s: error creating doc\n", driverName, functionName);
+        return -1;
+    }
+    Attrs = xmlDocGetRootElement(doc);
+    if ((!Attrs) || (!xmlStrEqual(Attrs->name, (const xmlChar *)"Attributes"))) {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR,
+            "%s:%s: cannot find Attributes element\n", driverName, functionName);
+        xmlFreeDoc(doc);
+        return -1;
+    }
+    for (Attr = xmlFirstElementChild(Attrs); Attr; Attr = xmlNextElementSibling(Attr)) {
+        NDAttributeDefinition definition;
+        xmlChar *pName = xmlGetProp(Attr, (const xmlChar *)"name");
+        if (!pName) {
+            asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                "%s:%s: name attribute not found\n", driverName, functionName);
+            status = -1;
+            break;
+        }
+        definition.name = (const char *)pName;
+        xmlFree(pName);
+        xmlChar *pSource = xmlGetProp(Attr, (const xmlChar *)"source");
+        if (!pSource) {
+            asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                "%s:%s: source attribute not found for attribute %s\n", driverName, functionName, definition.name.c_str());
+            status = -1;
+            break;
+        }
+        definition.source = (const char *)pSource;
+        xmlFree(pSource);
+        definition.description = getXMLProp(Attr, "description", "");
+        definition.type        = getXMLProp(Attr, "type", NDAttribute::attrSourceString(NDAttrSourceEPICSPV));
+        definition.dbrtype     = getXMLProp(Attr, "dbrtype", "DBR_NATIVE");
+        definition.datatype    = getXMLProp(Attr, "datatype", "int");
+        definition.addr        = getXMLProp(Attr, "addr", "0");
+        definition.param       = getXMLProp(Attr, "param", "");
+        definition.update      = getXMLProp(Attr, "update", "FRAME");
+        definition.period      = getXMLProp(Attr, "period", "0");
+        if (definition.type == NDAttribute::attrSourceString(NDAttrSourceEPICSPV)) {
+            const char *dbrTypes[] = {"DBR_CHAR", "DBR_SHORT", "DBR_ENUM", "DBR_INT", "DBR_LONG",
+                                      "DBR_FLOAT", "DBR_DOUBLE", "DBR_STRING", "DBR_NATIVE"};
+            size_t i;
+            for (i=0; i<sizeof(dbrTypes)/sizeof(dbrTypes[0]); i++) {
+                if (definition.dbrtype == dbrTypes[i]) break;
+            }
+            if (i == sizeof(dbrTypes)/sizeof(dbrTypes[0])) {
+                asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                    "%s:%s: unknown dbrType = %s for attribute %s\n",
+                    driverName, functionName, definition.dbrtype.c_str(), definition.name.c_str());
+                status = -1;
+                break;
+            }
+        } else if (definition.type == NDAttribute::attrSourceString(NDAttrSourceParam)) {
+            /* The datatype and addr are checked when the paramAttribute is created */
+        } else if (definition.type == NDAttribute::attrSourceString(NDAttrSourceFunct)) {
+            if ((definition.update != "FRAME") && (definition.update != "CHANGE") && (definition.update != "PERIODIC")) {
+                asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                    "%s:%s: unknown update = %s for attribute %s\n",
+                    driverName, functionName, definition.update.c_str(), definition.name.c_str());
+                status = -1;
+                break;
+            }
+        } else {
+            asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                "%s:%s: unknown attribute type = %s for attribute %s\n",
+                driverName, functionName, definition.type.c_str(), definition.name.c_str());
+            status = -1;
+            break;
+        }
+        definitions.push_back(definition);
+    }
+    xmlFreeDoc(doc);
+    return status;
+}
+
+/** Creates an attribute from its definition in an attributes file.
+  * \param[in] definition The definition, which has been checked by parseNDAttributes().
+  * \return The new attribute, or NULL if this type of attribute is not supported by the build.
+  */
+NDAttribute* asynNDArrayDriver::createNDAttribute(const NDAttributeDefinition& definition)
+{
+    const char *pName = definition.name.c_str();
+    const char *pSource = definition.source.c_str();
+    const char *pDescription = definition.description.c_str();
+    static const char *functionName = "createNDAttribute";
+
+    if (definition.type == NDAttribute::attrSourceString(NDAttrSourceEPICSPV)) {
+        const char *pDBRType = definition.dbrtype.c_str();
+        int dbrType = DBR_NATIVE;
+        if      (!strcmp(pDBRType, "DBR_CHAR"))   dbrType = DBR_CHAR;
+        else if (!strcmp(pDBRType, "DBR_SHORT"))  dbrType = DBR_SHORT;
+        else if (!strcmp(pDBRType, "DBR_ENUM"))   dbrType = DBR_ENUM;
+        else if (!strcmp(pDBRType, "DBR_INT"))    dbrType = DBR_INT;
+        else if (!strcmp(pDBRType, "DBR_LONG"))   dbrType = DBR_LONG;
+        else if (!strcmp(pDBRType, "DBR_FLOAT"))  dbrType = DBR_FLOAT;
+        else if (!strcmp(pDBRType, "DBR_DOUBLE")) dbrType = DBR_DOUBLE;
+        else if (!strcmp(pDBRType, "DBR_STRING")) dbrType = DBR_STRING;
+        asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
+            "%s:%s: Name=%s, PVName=%s, pDBRType=%s, dbrType=%d, pDescription=%s\n",
+            driverName, functionName, pName, pSource, pDBRType, dbrType, pDescription);
+#ifndef EPICS_LIBCOM_ONLY
+        return new PVAttribute(pName, pDescription, pSource, dbrType);
+#endif
+    } else if (definition.type == NDAttribute::attrSourceString(NDAttrSourceParam)) {
+        const char *pDataType = definition.datatype.c_str();
+        int addr = strtol(definition.addr.c_str(), NULL, 0);
+        asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
+            "%s:%s: Name=%s, drvInfo=%s, dataType=%s,pDescription=%s\n",
+            driverName, functionName, pName, pSource, pDataType, pDescription);
+        return new paramAttribute(pName, pDescription, pSource, addr, this, pDataType);
+    } else if (definition.type == NDAttribute::attrSourceString(NDAttrSourceFunct)) {
+        const char *pParam = definition.param.c_str();
+        functUpdatePolicy_t updatePolicy = functUpdateFrame;
+        if      (definition.update == "CHANGE")   updatePolicy = functUpdateChange;
+        else if (definition.update == "PERIODIC") updatePolicy = functUpdatePeriodic;
+        double updatePeriod = strtod(definition.period.c_str(), NULL) / 1000.;
+        asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
+            "%s:%s: Name=%s, function=%s, pParam=%s, update=%s, period=%f, pDescription=%s\n",
+            driverName, functionName, pName, pSource, pParam, definition.update.c_str(), updatePeriod, pDescription);
+#ifndef EPICS_LIBCOM_ONLY
+        return new functAttribute(pName, pDescription, pSource, pParam, updatePolicy, updatePeriod);
+#endif
+    }
+    return NULL;
+}
+
 /** Create this driver's NDAttributeList (pAttributeList) by reading an XML file
-  * This clears any existing attributes from this drivers' NDAttributeList and then creates a new list
-  * based on the XML file.  These attributes can then be associated with an NDArray by calling asynNDArrayDriver::getAttributes()
+  * This makes this drivers' NDAttributeList match the XML file.  Attributes whose definition in the file
+  * is unchanged since the last time it was read are kept, so their EPICS PV channels are not recreated; attributes
+  * that are new or changed are created, and all other attributes are deleted.  The parsed file is cached, so reading
+  * a file whose text (after macro substitution) has not changed does not parse the XML again.  If the file cannot
+  * be parsed the existing attributes are left unchanged.  These attributes can then be associated with an NDArray by calling asynNDArrayDriver::getAttributes()
   * passing it pNDArray->pAttributeList.
   *
   * The following simple example XML file illustrates the way that both PVAttribute and paramAttribute attributes are defined.
@@ -298,15 +534,19 @@ asynStatus asynNDArrayDriver::createFileName(int maxChars, char *filePath, char
   * parameter library, and must be "INT", "DOUBLE", or "STRING".  The default is "INT" if this XML attribute is absent.   Always use uppercase.
   *
   * <b>addr</b> determines the asyn addr (address) for type="PARAM".  The default is 0 if the XML attribute is absent.
+  * The PARAM attributes are read together, with the driver locked once for each addr.
+  *
+  * <b>update</b> determines when the function of a type="FUNCTION" attribute is called.  "FRAME" calls it for every array,
+  * "CHANGE" calls it for the first array and then only after functAttribute::requestUpdate() has been called,
+  * and "PERIODIC" calls it when <b>period</b> has elapsed since the last call.  The default is FRAME if this XML attribute is absent.
+  *
+  * <b>period</b> determines the minimum time in milliseconds between calls for update="PERIODIC".  The default is 0.
   *
   * <b>description</b> determines the description for this attribute.  It is not required, and the default is a NULL string.
   *
   */
 asynStatus asynNDArrayDriver::readNDAttributesFile()
 {
-    const char *pName, *pSource, *pAttrType, *pDescription;
-    xmlDocPtr doc;
-    xmlNode *Attr, *Attrs;
     std::ostringstream buff;
     std::string buffer;
     std::ifstream infile;
@@ -317,15 +557,27 @@ asynStatus asynNDArrayDriver::readNDAttributesFile()
     int bufferSize;
     char *tmpBuffer = 0;
     int status;
+    NDAttributesFileCache *pCache = this->pAttributesFileCache_;
+    std::vector<NDAttributeDefinition> parsed;
+    std::vector<NDAttributeDefinition> *pDefinitions;
+    std::map<std::string, NDAttributeDefinition> definitions;
+    std::map<std::string, NDAttributeDefinition>::iterator it;
+    std::vector<std::string> names;
+    NDAttribute *pAttr;
+    int numKept=0, numAdded=0, numRemoved=0;
+    bool newPVs = false;
     static const char *functionName = "readNDAttributesFile";
 
     getStringParam(NDAttributesFile, fileName);
     getStringParam(NDAttributesMacros, attributesMacros);
 
-    /* Clear any existing attributes */
-    this->pAttributeList->clear();
-    if (fileName.length() == 0) return asynSuccess;
-
+    if (fileName.length() == 0) {
+        /* Clear any existing attributes */
+        this->pParamAttributeBatch_->clear();
+        this->pAttributeList->clear();
+        pCache->current.clear();
+        return asynSuccess;
+    }
     infile.open(fileName.c_str());
     if (infile.fail()) {
         asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
@@ -379,101 +631,83 @@ done_macros:
             return asynError;
         }
     }
-    // Assume failure
-    setIntegerParam(NDAttributesStatus, NDAttributesXMLSyntaxError);
-    doc = xmlReadMemory(buffer.c_str(), (int)buffer.length(), "noname.xml", NULL, 0);
-    if (doc == NULL) {
-        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-            "%s:%s: error creating doc\n", driverName, functionName);
-        return asynError;
-    }
-    Attrs = xmlDocGetRootElement(doc);
-    if ((!xmlStrEqual(Attrs->name, (const xmlChar *)"Attributes"))) {
-        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-            "%s:%s: cannot find Attributes element\n", driverName, functionName);
-        return asynError;
-    }
-    for (Attr = xmlFirstElementChild(Attrs); Attr; Attr = xmlNextElementSibling(Attr)) {
-        pName = (const char *)xmlGetProp(Attr, (const xmlChar *)"name");
-        if (!pName) {
-            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-                "%s:%s: name attribute not found\n", driverName, functionName);
-            return asynError;
-        }
-        pDescription = (const char *)xmlGetProp(Attr, (const xmlChar *)"description");
-        if (!pDescription) pDescription = "";
-        pSource = (const char *)xmlGetProp(Attr, (const xmlChar *)"source");
-        if (!pSource) {
-            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-                "%s:%s: source attribute not found for attribute %s\n", driverName, functionName, pName);
+
+    // Use the definitions parsed the last time this file was read if its text has not changed
+    NDAttributesFileCache::File *pFile = pCache->find(fileName);
+    if (pFile && (pFile->text == buffer)) {
+        pDefinitions = &pFile->definitions;
+    } else {
+        if (parseNDAttributes(pasynUserSelf, buffer, parsed)) {
+            // The current attributes are left unchanged
+            setIntegerParam(NDAttributesStatus, NDAttributesXMLSyntaxError);
             return asynError;
         }
-        pAttrType = (const char *)xmlGetProp(Attr, (const xmlChar *)"type");
-        if (!pAttrType) pAttrType = NDAttribute::attrSourceString(NDAttrSourceEPICSPV);
-        if (strcmp(pAttrType, NDAttribute::attrSourceString(NDAttrSourceEPICSPV)) == 0) {
-            const char *pDBRType = (const char *)xmlGetProp(Attr, (const xmlChar *)"dbrtype");
-            int dbrType = DBR_NATIVE;
-            if (pDBRType) {
-                if      (!strcmp(pDBRType, "DBR_CHAR"))   dbrType = DBR_CHAR;
-                else if (!strcmp(pDBRType, "DBR_SHORT"))  dbrType = DBR_SHORT;
-                else if (!strcmp(pDBRType, "DBR_ENUM"))   dbrType = DBR_ENUM;
-                else if (!strcmp(pDBRType, "DBR_INT"))    dbrType = DBR_INT;
-                else if (!strcmp(pDBRType, "DBR_LONG"))   dbrType = DBR_LONG;
-                else if (!strcmp(pDBRType, "DBR_FLOAT"))  dbrType = DBR_FLOAT;
-                else if (!strcmp(pDBRType, "DBR_DOUBLE")) dbrType = DBR_DOUBLE;
-                else if (!strcmp(pDBRType, "DBR_STRING")) dbrType = DBR_STRING;
-                else if (!strcmp(pDBRType, "DBR_NATIVE")) dbrType = DBR_NATIVE;
-                else {
-                    asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-                        "%s:%s: unknown dbrType = %s for attribute %s\n", driverName, functionName, pDBRType, pName);
-                   return asynError;
-                }
-            }
-            asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
-                "%s:%s: Name=%s, PVName=%s, pDBRType=%s, dbrType=%d, pDescription=%s\n",
-                driverName, functionName, pName, pSource, pDBRType, dbrType, pDescription);
-#ifndef EPICS_LIBCOM_ONLY
-            PVAttribute *pPVAttribute = new PVAttribute(pName, pDescription, pSource, dbrType);
-            this->pAttributeList->add(pPVAttribute);
-#endif
-        } else if (strcmp(pAttrType, NDAttribute::attrSourceString(NDAttrSourceParam)) == 0) {
-            const char *pDataType = (const char *)xmlGetProp(Attr, (const xmlChar *)"datatype");
-            if (!pDataType) pDataType = "int";
-            const char *pAddr = (const char *)xmlGetProp(Attr, (const xmlChar *)"addr");
-            int addr=0;
-            if (pAddr) addr = strtol(pAddr, NULL, 0);
-            asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
-                "%s:%s: Name=%s, drvInfo=%s, dataType=%s,pDescription=%s\n",
-                driverName, functionName, pName, pSource, pDataType, pDescription);
-            paramAttribute *pParamAttribute = new paramAttribute(pName, pDescription, pSource, addr, this, pDataType);
-            this->pAttributeList->add(pParamAttribute);
-        } else if (strcmp(pAttrType, NDAttribute::attrSourceString(NDAttrSourceFunct)) == 0) {
-            const char *pParam = (const char *)xmlGetProp(Attr, (const xmlChar *)"param");
-            if (!pParam) pParam = epicsStrDup("");
-            asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
-                "%s:%s: Name=%s, function=%s, pParam=%s, pDescription=%s\n",
-                driverName, functionName, pName, pSource, pParam, pDescription);
-#ifndef EPICS_LIBCOM_ONLY
-            functAttribute *pFunctAttribute = new functAttribute(pName, pDescription, pSource, pParam);
-            this->pAttributeList->add(pFunctAttribute);
-#endif
+        NDAttributesFileCache::File& entry = pCache->insert(fileName);
+        entry.text = buffer;
+        entry.definitions.swap(parsed);
+        pDefinitions = &entry.definitions;
+    }
+    // A later definition replaces an earlier one with the same name
+    for (size_t i=0; i<pDefinitions->size(); i++) {
+        definitions[(*pDefinitions)[i].name] = (*pDefinitions)[i];
+    }
+
+    // Delete the attributes that are not defined in the same way by the new file,
+    // including any that were added to the list other than from the file
+    for (pAttr = this->pAttributeList->next(NULL); pAttr; pAttr = this->pAttributeList->next(pAttr)) {
+        it = pCache->current.find(pAttr->getName());
+        if ((it != pCache->current.end()) && (definitions.count(it->first) > 0) &&
+            (definitions[it->first] == it->second)) {
+            numKept++;
         } else {
-            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-                "%s:%s: unknown attribute type = %s for attribute %s\n", driverName, functionName, pAttrType, pName);
-            return asynError;
+            names.push_back(pAttr->getName());
         }
     }
+    for (size_t i=0; i<names.size(); i++) {
+        this->pAttributeList->remove(names[i].c_str());
+        pCache->current.erase(names[i]);
+        numRemoved++;
+    }
+    for (it = pCache->current.begin(); it != pCache->current.end(); ) {
+        if (this->pAttributeList->find(it->first.c_str())) ++it;
+        else pCache->current.erase(it++);
+    }
+
+    // Create the attributes that are new or changed, in the order of the file
+    for (size_t i=0; i<pDefinitions->size(); i++) {
+        const NDAttributeDefinition& definition = (*pDefinitions)[i];
+        if (!(definitions[definition.name] == definition)) continue;
+        if (pCache->current.count(definition.name) > 0) continue;
+        pAttr = this->createNDAttribute(definition);
+        if (!pAttr) continue;
+        this->pAttributeList->add(pAttr);
+        pCache->current[definition.name] = definition;
+        if (definition.type == NDAttribute::attrSourceString(NDAttrSourceEPICSPV)) newPVs = true;
+        numAdded++;
+    }
+    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+        "%s::%s file %s, kept %d attributes, removed %d, added %d\n",
+        driverName, functionName, fileName.c_str(), numKept, numRemoved, numAdded);
     setIntegerParam(NDAttributesStatus, NDAttributesOK);
-    // Wait a short while for channel access callbacks on EPICS PVs
-    epicsThreadSleep(0.5);
+
+    // Group the PARAM attributes by addr, so they are read with one lock of the driver for each
+    this->pParamAttributeBatch_->clear();
+    for (pAttr = this->pAttributeList->next(NULL); pAttr; pAttr = this->pAttributeList->next(pAttr)) {
+        paramAttribute *pParamAttribute = dynamic_cast<paramAttribute *>(pAttr);
+        if (pParamAttribute) this->pParamAttributeBatch_->add(pParamAttribute);
+    }
+    // Wait a short while for channel access callbacks on new EPICS PVs
+    if (newPVs) epicsThreadSleep(0.5);
     // Get the initial values
+    this->pParamAttributeBatch_->update();
     this->pAttributeList->updateValues();
     return asynSuccess;
 }
 
 
 /** Get the current values of attributes from this driver and appends them to an output attribute list.
-  * Calls NDAttributeList::updateValues for this driver's attribute list,
+  * Reads the PARAM attributes with one lock of this driver for each addr,
+  * calls NDAttributeList::updateValues for this driver's attribute list,
   * and then NDAttributeList::copy, to copy this driver's attribute
   * list to pList, appending the values to that output attribute list.
   * \param[out] pList  The NDAttributeList to copy the attributes to.
@@ -487,7 +721,9 @@ asynStatus asynNDArrayDriver::getAttributes(NDAttributeList *pList)
     //const char *functionName = "getAttributes";
     int status = asynSuccess;
 
-    status = this->pAttributeList->updateValues();
+    status = this->pParamAttributeBatch_->update();
+    status |= this->pAttributeList->updateValues();
+    setIntegerParam(NDAttributesSnapshotRetries, (int)this->pAttributeList->getSnapshotRetries());
     status = this->pAttributeList->copy(pList);
     return (asynStatus) status;
 }
@@ -869,6 +1105,13 @@ asynNDArrayDriver::asynNDArrayDriver(const char *portName, int maxAddr, int maxB
     /* Allocate pArray pointer array */
     this->pArrays = (NDArray **)calloc(maxAddr, sizeof(NDArray *));
     this->pAttributeList = new NDAttributeList();
+    this->pAttributesFileCache_ = new NDAttributesFileCache();
+    this->pParamAttributeBatch_ = new paramAttributeBatch();
+    if (useNDAttributeSchema) {
+        NDAttributeSchema *pSchema = new NDAttributeSchema();
+        this->pAttributeList->setSchema(pSchema);
+        pSchema->release();
+    }
 
     createParam(NDPortNameSelfString,         asynParamOctet,           &NDPortNameSelf);
     createParam(NDADCoreVersionString,        asynParamOctet,           &NDADCoreVersion);
@@ -919,9 +1162,15 @@ asynNDArrayDriver::asynNDArrayDriver(const char *portName, int maxAddr, int maxB
     createParam(NDFileLazyOpenString,         asynParamInt32,           &NDFileLazyOpen);
     createParam(NDFileCreateDirString,        asynParamInt32,           &NDFileCreateDir);
     createParam(NDFileTempSuffixString,       asynParamOctet,           &NDFileTempSuffix);
+    createParam(NDFileCaptureMaxMemoryString, asynParamInt32,           &NDFileCaptureMaxMemory);
+    createParam(NDFileCaptureMemoryString,    asynParamFloat64,         &NDFileCaptureMemory);
+    createParam(NDFileSpillPathString,        asynParamOctet,           &NDFileSpillPath);
+    createParam(NDFileSpillMaxSizeString,     asynParamInt32,           &NDFileSpillMaxSize);
+    createParam(NDFileSpillUsedString,        asynParamFloat64,         &NDFileSpillUsed);
     createParam(NDAttributesFileString,       asynParamOctet,           &NDAttributesFile);
     createParam(NDAttributesStatusString,     asynParamInt32,           &NDAttributesStatus);
     createParam(NDAttributesMacrosString,     asynParamOctet,           &NDAttributesMacros);
+    createParam(NDAttributesSnapshotRetriesString, asynParamInt32,      &NDAttributesSnapshotRetries);
     createParam(NDArrayDataString,            asynParamGenericPointer,  &NDArrayData);
     createParam(NDArrayCallbacksString,       asynParamInt32,           &NDArrayCallbacks);
     createParam(NDPoolMaxBuffersString,       asynParamInt32,           &NDPoolMaxBuffers);
@@ -974,9 +1223,15 @@ asynNDArrayDriver::asynNDArrayDriver(const char *portName, int maxAddr, int maxB
     setIntegerParam(NDFileFreeCapture, 0);
     setIntegerParam(NDFileCreateDir, 0);
     setStringParam (NDFileTempSuffix, "");
+    setIntegerParam(NDFileCaptureMaxMemory, 0);
+    setDoubleParam (NDFileCaptureMemory, 0.);
+    setStringParam (NDFileSpillPath, "");
+    setIntegerParam(NDFileSpillMaxSize, 0);
+    setDoubleParam (NDFileSpillUsed, 0.);
     setStringParam (NDAttributesFile, "");
     setIntegerParam(NDAttributesStatus, NDAttributesFileNotFound);
     setStringParam (NDAttributesMacros, "");
+    setIntegerParam(NDAttributesSnapshotRetries, 0);
 
     setIntegerParam(NDPoolAllocBuffers, this->pNDArrayPool->getNumBuffers());
     setIntegerParam(NDPoolFreeBuffers, this->pNDArrayPool->getNumFree());
@@ -1012,6 +1267,8 @@ asynNDArrayDriver::~asynNDArrayDriver()
 
     delete this->pNDArrayPoolPvt_;
     free(this->pArrays);
+    delete this->pParamAttributeBatch_;
+    delete this->pAttributesFileCache_;
     delete this->pAttributeList;
     delete this->queuedArrayCountMutex_;
 }
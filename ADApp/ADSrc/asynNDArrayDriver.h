@@ -105,10 +105,16 @@ typedef enum {
 #define NDFileLazyOpenString    "FILE_LAZY_OPEN"    /**< (asynInt32,    r/w) Don't open file until first frame arrives in Stream mode */
 #define NDFileCreateDirString   "CREATE_DIR"        /**< (asynInt32,    r/w) Create the target directory up to this depth */
 #define NDFileTempSuffixString  "FILE_TEMP_SUFFIX"  /**< (asynOctet,    r/w) Temporary filename suffix while writing data to file. The file will be renamed (suffix removed) upon closing the file. */
+#define NDFileCaptureMaxMemoryString "CAPTURE_MAX_MEMORY" /**< (asynInt32, r/w) Memory for the capture buffer (MB) before arrays are spilled to disk, 0=no limit */
+#define NDFileCaptureMemoryString    "CAPTURE_MEMORY"     /**< (asynFloat64, r/o) Memory used by the capture buffer (MB) */
+#define NDFileSpillPathString        "FILE_SPILL_PATH"    /**< (asynOctet,   r/w) Directory for captured arrays beyond CAPTURE_MAX_MEMORY */
+#define NDFileSpillMaxSizeString     "FILE_SPILL_MAX_SIZE" /**< (asynInt32,  r/w) Maximum disk space for captured arrays (MB) */
+#define NDFileSpillUsedString        "FILE_SPILL_USED"    /**< (asynFloat64, r/o) Disk space used by captured arrays (MB) */
 
 #define NDAttributesFileString    "ND_ATTRIBUTES_FILE"   /**< (asynOctet,    r/w) Attributes file name */
 #define NDAttributesStatusString  "ND_ATTRIBUTES_STATUS" /**< (asynInt32,    r/o) Attributes status */
 #define NDAttributesMacrosString  "ND_ATTRIBUTES_MACROS" /**< (asynOctet,    r/w) Attributes macros string */
+#define NDAttributesSnapshotRetriesString "ND_ATTRIBUTES_SNAPSHOT_RETRIES" /**< (asynInt32, r/o) Attribute values read again because they changed during the read */
 
 /* The detector array data */
 #define NDArrayDataString       "ARRAY_DATA"        /**< (asynGenericPointer,   r/w) NDArray data */
@@ -216,9 +222,15 @@ protected:
     int NDFileLazyOpen;
     int NDFileCreateDir;
     int NDFileTempSuffix;
+    int NDFileCaptureMaxMemory;
+    int NDFileCaptureMemory;
+    int NDFileSpillPath;
+    int NDFileSpillMaxSize;
+    int NDFileSpillUsed;
     int NDAttributesFile;
     int NDAttributesStatus;
     int NDAttributesMacros;
+    int NDAttributesSnapshotRetries;
     int NDArrayData;
     int NDArrayCallbacks;
     int NDPoolMaxBuffers;
@@ -236,6 +248,9 @@ protected:
 
 private:
     NDArrayPool *pNDArrayPoolPvt_;
+    class NDAttributesFileCache *pAttributesFileCache_; /**< Parsed attributes files and the current definitions */
+    class paramAttributeBatch *pParamAttributeBatch_;   /**< Reads the PARAM attributes of pAttributeList in one pass */
+    NDAttribute *createNDAttribute(const struct NDAttributeDefinition& definition);
     epicsMutex *queuedArrayCountMutex_;
     epicsEventId queuedArrayEvent_;
     int queuedArrayCount_;
@@ -11,6 +11,7 @@
 #include <stdlib.h>
 
 #include <epicsString.h>
+#include <epicsAtomic.h>
 
 #include <registryFunction.h>
 
@@ -29,11 +30,15 @@ static asynUser *pasynUserSelf = NULL;
   * \param[in] pDescription The description of the attribute.
   * \param[in] pSource The symbol name for the function to be called to get the value of the parameter.
   * \param[in] pParam A string that will be passed to the function, typically to specify what/how to get the value.
+  * \param[in] policy When the function is called; functUpdateFrame calls it on every publishValue().
+  * \param[in] period The minimum time in seconds between calls for functUpdatePeriodic.
   */
-functAttribute::functAttribute(const char *pName, const char *pDescription, const char *pSource, const char *pParam)
+functAttribute::functAttribute(const char *pName, const char *pDescription, const char *pSource, const char *pParam,
+                               functUpdatePolicy_t policy, double period)
 
     : NDAttribute(pName, pDescription, NDAttrSourceFunct, pSource, NDAttrUndefined, 0),
-      pFunction(0), functionPvt(0)
+      pFunction(0), functionPvt(0), updatePolicy(policy), updatePeriod(period),
+      updateRequested(0), evaluated(false), publishing(false), pStore(0)
 {
     static const char *functionName = "functAttribute";
 
@@ -71,6 +76,13 @@ functAttribute::functAttribute(functAttribute& attribute)
     functParam = epicsStrDup(attribute.functParam);
     pFunction = attribute.pFunction;
     functionPvt = attribute.functionPvt;
+    updatePolicy = attribute.updatePolicy;
+    updatePeriod = attribute.updatePeriod;
+    updateRequested = 0;
+    evaluated = attribute.evaluated;
+    lastUpdate = attribute.lastUpdate;
+    publishing = false;
+    pStore = 0;
 }
 
 /** Destructor for driver/plugin attribute
@@ -78,6 +90,7 @@ functAttribute::functAttribute(functAttribute& attribute)
 functAttribute::~functAttribute()
 {
     free(functParam);
+    delete this->pStore;
 }
 
 functAttribute* functAttribute::copy(NDAttribute *pAttr)
@@ -94,19 +107,108 @@ functAttribute* functAttribute::copy(NDAttribute *pAttr)
 }
 
 
-/** Updates the current value of this attribute; sets the attribute value to the return value of the
-  * specified function.
+/** Sets the value of the attribute; while publishValue() is calling the function the value is
+  * published into the value store instead, and set by the next updateValue().
+  * \param[in] pValue Pointer to the value, of the data type of the attribute; a char array for strings.
   */
-int functAttribute::updateValue()
+int functAttribute::setValue(const void *pValue)
+{
+    static const char *functionName = "setValue";
+
+    if (!this->publishing) return NDAttribute::setValue(pValue);
+    if (!pValue) return ND_ERROR;
+    if (!this->pStore) {
+        if (this->getDataType() == NDAttrUndefined) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: ERROR, function %s did not set the data type of attribute %s\n",
+                driverName, functionName, this->getSource(), this->getName());
+            return ND_ERROR;
+        }
+        this->pStore = new NDAttributeValueStore(this->getDataType(), ND_ATTR_STORE_STRING_SIZE);
+    }
+    this->pStore->publish(pValue);
+    return ND_SUCCESS;
+}
+
+/** Sets the string value of the attribute; see setValue(const void *).
+  * \param[in] value The string value.
+  */
+int functAttribute::setValue(const std::string& value)
+{
+    if (!this->publishing) return NDAttribute::setValue(value);
+    return this->setValue((const void *)value.c_str());
+}
+
+/** Calls the function if the update policy says it is due to be called, and publishes the value it sets.
+  */
+int functAttribute::publishValue()
 {
-    //static const char *functionName = "updateValue";
+    //static const char *functionName = "publishValue";
+    epicsTimeStamp now;
 
     if (!this->pFunction) return asynError;
 
+    switch (this->updatePolicy) {
+      case functUpdateChange:
+        /* Clear the request before calling, so a change during the call is not lost */
+        if (!epicsAtomicCmpAndSwapIntT(&this->updateRequested, 1, 0) && this->evaluated) return asynSuccess;
+        break;
+      case functUpdatePeriodic:
+        epicsTimeGetCurrent(&now);
+        if (this->evaluated && (epicsTimeDiffInSeconds(&now, &this->lastUpdate) < this->updatePeriod))
+            return asynSuccess;
+        this->lastUpdate = now;
+        break;
+      default:
+        break;
+    }
+    this->publishing = true;
     this->pFunction(this->functParam, &functionPvt, this);
+    this->publishing = false;
+    this->evaluated = true;
+    return asynSuccess;
+}
+
+/** Updates the current value of this attribute; sets the attribute value to the value the function
+  * set in the last call from publishValue().
+  */
+int functAttribute::updateValue()
+{
+    NDAttrValue value;
+
+    if (!this->pFunction) return asynError;
+    if (!this->pStore) return asynSuccess;
+    if (this->getDataType() == NDAttrString) {
+        if (this->pStore->read(this->stringValue)) NDAttribute::setValue(this->stringValue);
+    } else {
+        if (this->pStore->read(&value)) NDAttribute::setValue(&value);
+    }
     return asynSuccess;
 }
 
+/** Returns the number of times updateValue() had to read the value again because publishValue()
+  * published a new one while it was being read.
+  */
+size_t functAttribute::getSnapshotRetries()
+{
+    return this->pStore ? this->pStore->getRetries() : 0;
+}
+
+/** Requests that the function be called on the next publishValue(); used with functUpdateChange.
+  * Can be called from any thread, typically from the callback that sees the source of the value change.
+  */
+void functAttribute::requestUpdate()
+{
+    epicsAtomicSetIntT(&this->updateRequested, 1);
+}
+
+/** Returns the update policy of the attribute.
+  */
+functUpdatePolicy_t functAttribute::getUpdatePolicy()
+{
+    return this->updatePolicy;
+}
+
 
 /** Reports on the properties of the functAttribute object;
   * calls base class NDAttribute::report() to report on the parameter value.
@@ -120,6 +222,11 @@ int functAttribute::report(FILE *fp, int details)
     fprintf(fp, "    functParam=%s\n", this->functParam);
     fprintf(fp, "    pFunction=%p\n", this->pFunction);
     fprintf(fp, "    functionPvt=%p\n", this->functionPvt);
+    fprintf(fp, "    updatePolicy=%s\n",
+        (this->updatePolicy == functUpdateChange) ? "CHANGE" :
+        (this->updatePolicy == functUpdatePeriodic) ? "PERIODIC" : "FRAME");
+    if (this->updatePolicy == functUpdatePeriodic)
+        fprintf(fp, "    updatePeriod=%f\n", this->updatePeriod);
     return(ND_SUCCESS);
 }
 
@@ -13,26 +13,55 @@
 
 #include <stdio.h>
 
+#include <epicsTime.h>
+
 #include "NDAttribute.h"
+#include "NDAttributeValueStore.h"
+
+/** When a functAttribute calls its function */
+typedef enum {
+    functUpdateFrame,    /**< Calls the function on every publishValue(), the default */
+    functUpdateChange,   /**< Calls the function the first time, then only after requestUpdate() */
+    functUpdatePeriodic  /**< Calls the function when the update period has elapsed since the last call */
+} functUpdatePolicy_t;
 
 typedef int (*NDAttributeFunction)(const char *functParam, void **functionPvt, class functAttribute *pAttribute);
 
 /** Attribute that gets its value from a user-defined function
-  * The updateValue() method for this class retrieves the current value from the function.
+  * The publishValue() method for this class calls the function, and the values the function sets are published
+  * into a value store.  The updateValue() method copies the latest value from the store into the attribute.
+  * Functions that are expensive to call can be called less often with an update policy; the attribute
+  * then keeps its last value between calls.  With functUpdateChange the function, or whatever monitors
+  * its source, calls requestUpdate() on the attribute when the value changes.
   */
 class ADCORE_API functAttribute : public NDAttribute {
 public:
-    functAttribute(const char *pName, const char *pDescription, const char *pSource, const char *pParam);
+    functAttribute(const char *pName, const char *pDescription, const char *pSource, const char *pParam,
+                   functUpdatePolicy_t policy=functUpdateFrame, double period=0.);
     functAttribute(functAttribute& attribute);
     ~functAttribute();
     functAttribute* copy(NDAttribute *pAttribute);
+    virtual int setValue(const void *pValue);
+    virtual int setValue(const std::string& value);
+    virtual int publishValue();
     virtual int updateValue();
+    virtual size_t getSnapshotRetries();
+    void requestUpdate();
+    functUpdatePolicy_t getUpdatePolicy();
     int report(FILE *fp, int details);
 
 private:
     char *functParam;
     NDAttributeFunction pFunction;
     void *functionPvt;
+    functUpdatePolicy_t updatePolicy;  /**< When the function is called */
+    double updatePeriod;               /**< Seconds between calls for functUpdatePeriodic */
+    int updateRequested;               /**< Set by requestUpdate(), cleared when the function is called */
+    bool evaluated;                    /**< The function has been called at least once */
+    epicsTimeStamp lastUpdate;         /**< Time of the last call for functUpdatePeriodic */
+    bool publishing;                   /**< publishValue() is calling the function, so setValue() publishes */
+    NDAttributeValueStore *pStore;     /**< Values set by the function, created on the first one; NULL in copies */
+    std::string stringValue;           /**< String value read from the store, kept to avoid reallocation */
 };
 
 #endif /*INCfunctAttributeH*/
@@ -12,6 +12,7 @@
 #include <string>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 
 #include <epicsMutex.h>
 #include <epicsTime.h>
@@ -40,7 +41,7 @@ static asynUser *pasynUserSelf = NULL;
 paramAttribute::paramAttribute(const char *pName, const char *pDescription, const char *pSource, int addr,
                                class asynNDArrayDriver *pDriver, const char *dataType)
     : NDAttribute(pName, pDescription, NDAttrSourceParam, pSource, NDAttrUndefined, 0),
-    paramAddr(addr), paramType(paramAttrTypeUnknown), pDriver(pDriver)
+    paramAddr(addr), paramType(paramAttrTypeUnknown), pDriver(pDriver), pStore(0), pStringBuffer(0), pBatch(0)
 {
     static const char *functionName = "paramAttribute";
     asynUser *pasynUser=NULL;
@@ -92,7 +93,10 @@ paramAttribute::paramAttribute(const char *pName, const char *pDescription, cons
     else if (!strcmp(dataType, "STRING")) {
         this->paramType=paramAttrTypeString;
         this->setDataType(NDAttrString);
+        this->pStringBuffer = (char *)calloc(ND_ATTR_STORE_STRING_SIZE, 1);
     }
+    if (this->paramType != paramAttrTypeUnknown)
+        this->pStore = new NDAttributeValueStore(this->getDataType(), ND_ATTR_STORE_STRING_SIZE);
 
 error:
     if (pasynUser) pasynManager->freeAsynUser(pasynUser);
@@ -108,46 +112,62 @@ paramAttribute::paramAttribute(paramAttribute& attribute)
     paramAddr = attribute.paramAddr;
     pDriver = attribute.pDriver;
     paramId = attribute.paramId;
+    pStore = 0;
+    pStringBuffer = 0;
+    pBatch = 0;
 }
 
 /** Destructor for driver/plugin attribute
   */
 paramAttribute::~paramAttribute()
 {
+    if (this->pBatch) this->pBatch->remove(this);
+    delete this->pStore;
+    free(this->pStringBuffer);
 }
 
-/** Updates the current value of this attribute; sets the attribute value to the current value of the
-  * driver/plugin parameter in the parameter library.
+/** Publishes the current value of the driver/plugin parameter for the next updateValue().
+  * Does nothing if the attribute is read by a paramAttributeBatch.
   */
-int paramAttribute::updateValue()
+int paramAttribute::publishValue()
+{
+    if (this->pBatch) return asynSuccess;
+    return this->readParam();
+}
+
+/** Reads the current value of the driver/plugin parameter in the parameter library and publishes it
+  * for the next updateValue().
+  */
+int paramAttribute::readParam()
 {
     int status = asynSuccess;
-    std::string stringValue = "";
     epicsInt32 i32Value=0;
     epicsInt64 i64Value=0;
     epicsFloat64 f64Value=0.;
-    static const char *functionName = "updateValue";
+    static const char *functionName = "readParam";
 
+    if (!this->pStore) return asynSuccess;
     switch (this->paramType) {
         case paramAttrTypeInt:
             status = this->pDriver->getIntegerParam(this->paramAddr, this->paramId,
                                                  &i32Value);
-            this->setValue(&i32Value);
+            this->pStore->publish(&i32Value);
             break;
         case paramAttrTypeInt64:
             status = this->pDriver->getInteger64Param(this->paramAddr, this->paramId,
                                                  &i64Value);
-            this->setValue(&i64Value);
+            this->pStore->publish(&i64Value);
             break;
         case paramAttrTypeDouble:
             status = this->pDriver->getDoubleParam(this->paramAddr, this->paramId,
                                                 &f64Value);
-            this->setValue(&f64Value);
+            this->pStore->publish(&f64Value);
             break;
         case paramAttrTypeString:
+            this->pStringBuffer[0] = 0;
             status = this->pDriver->getStringParam(this->paramAddr, this->paramId,
-                                                stringValue);
-            this->setValue(stringValue);
+                                                ND_ATTR_STORE_STRING_SIZE, this->pStringBuffer);
+            this->pStore->publish(this->pStringBuffer);
             break;
         default:
             break;
@@ -160,6 +180,30 @@ int paramAttribute::updateValue()
     return(status);
 }
 
+/** Updates the current value of this attribute; sets the attribute value to the value of the
+  * driver/plugin parameter last read by publishValue().
+  */
+int paramAttribute::updateValue()
+{
+    NDAttrValue value;
+
+    if (!this->pStore) return asynSuccess;
+    if (this->paramType == paramAttrTypeString) {
+        if (this->pStore->read(this->stringValue)) this->setValue(this->stringValue);
+    } else {
+        if (this->pStore->read(&value)) this->setValue(&value);
+    }
+    return asynSuccess;
+}
+
+/** Returns the number of times updateValue() had to read the value again because publishValue()
+  * published a new one while it was being read.
+  */
+size_t paramAttribute::getSnapshotRetries()
+{
+    return this->pStore ? this->pStore->getRetries() : 0;
+}
+
 paramAttribute* paramAttribute::copy(NDAttribute *pAttr)
 {
   paramAttribute *pOut = (paramAttribute *)pAttr;
@@ -187,3 +231,121 @@ int paramAttribute::report(FILE *fp, int details)
     return(ND_SUCCESS);
 }
 
+/** Constructor for a batch of parameter attributes
+  */
+paramAttributeBatch::paramAttributeBatch()
+{
+}
+
+/** Destructor for a batch of parameter attributes; the attributes are not deleted.
+  */
+paramAttributeBatch::~paramAttributeBatch()
+{
+    this->clear();
+}
+
+/** Orders attributes by parameter index */
+bool paramAttributeBatch::less(const paramAttribute *pA, const paramAttribute *pB)
+{
+    return pA->paramId < pB->paramId;
+}
+
+/** Adds an attribute to the group for its driver and asyn address; its publishValue() no longer reads the parameter.
+  * \param[in] pAttribute The attribute.
+  */
+int paramAttributeBatch::add(paramAttribute *pAttribute)
+{
+    size_t i;
+
+    if (!pAttribute->pStore) return ND_ERROR;
+    if (pAttribute->pBatch) pAttribute->pBatch->remove(pAttribute);
+    for (i=0; i<this->groups.size(); i++) {
+        if ((this->groups[i].pDriver == pAttribute->pDriver) && (this->groups[i].addr == pAttribute->paramAddr)) break;
+    }
+    if (i == this->groups.size()) {
+        Group group;
+        group.pDriver = pAttribute->pDriver;
+        group.addr = pAttribute->paramAddr;
+        group.sorted = true;
+        this->groups.push_back(group);
+    }
+    this->groups[i].attributes.push_back(pAttribute);
+    this->groups[i].sorted = false;
+    pAttribute->pBatch = this;
+    return ND_SUCCESS;
+}
+
+/** Removes an attribute from the batch; it reads its parameter in publishValue() again.
+  * \param[in] pAttribute The attribute.
+  */
+int paramAttributeBatch::remove(paramAttribute *pAttribute)
+{
+    std::vector<paramAttribute *>::iterator it;
+
+    for (size_t i=0; i<this->groups.size(); i++) {
+        std::vector<paramAttribute *>& attributes = this->groups[i].attributes;
+        it = std::find(attributes.begin(), attributes.end(), pAttribute);
+        if (it == attributes.end()) continue;
+        attributes.erase(it);
+        if (attributes.empty()) this->groups.erase(this->groups.begin() + i);
+        pAttribute->pBatch = 0;
+        return ND_SUCCESS;
+    }
+    return ND_ERROR;
+}
+
+/** Removes all attributes from the batch; they read their parameters in publishValue() again.
+  */
+int paramAttributeBatch::clear()
+{
+    for (size_t i=0; i<this->groups.size(); i++) {
+        for (size_t j=0; j<this->groups[i].attributes.size(); j++) {
+            this->groups[i].attributes[j]->pBatch = 0;
+        }
+    }
+    this->groups.clear();
+    return ND_SUCCESS;
+}
+
+/** Returns the number of attributes in the batch.
+  */
+int paramAttributeBatch::count()
+{
+    size_t count = 0;
+
+    for (size_t i=0; i<this->groups.size(); i++) count += this->groups[i].attributes.size();
+    return (int)count;
+}
+
+/** Returns the number of groups in the batch, one for each driver and asyn address.
+  */
+int paramAttributeBatch::numGroups()
+{
+    return (int)this->groups.size();
+}
+
+/** Reads the parameters of all attributes in the batch and publishes them for their next updateValue().
+  * Each driver is locked once for each asyn address, so the values of one address are consistent.
+  * The driver lock is recursive, so this can be called with the lock already held.
+  * \return asynError if any parameter could not be read; parameters that have never been set are not errors.
+  */
+int paramAttributeBatch::update()
+{
+    int status = asynSuccess;
+    int paramStatus;
+
+    for (size_t i=0; i<this->groups.size(); i++) {
+        Group& group = this->groups[i];
+        if (!group.sorted) {
+            std::sort(group.attributes.begin(), group.attributes.end(), paramAttributeBatch::less);
+            group.sorted = true;
+        }
+        group.pDriver->lock();
+        for (size_t j=0; j<group.attributes.size(); j++) {
+            paramStatus = group.attributes[j]->readParam();
+            if (paramStatus && (paramStatus != asynParamUndefined)) status = asynError;
+        }
+        group.pDriver->unlock();
+    }
+    return status;
+}
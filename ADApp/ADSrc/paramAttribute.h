@@ -11,7 +11,11 @@
 #ifndef INCparamAttributeH
 #define INCparamAttributeH
 
+#include <string>
+#include <vector>
+
 #include "NDAttribute.h"
+#include "NDAttributeValueStore.h"
 #include "asynNDArrayDriver.h"
 
 /** Use native type for channel access */
@@ -26,7 +30,9 @@ typedef enum {
 } paramAttrType_t;
 
 /** Attribute that gets its value from an asynNDArrayDriver driver parameter.
-  * The updateValue() method for this class retrieves the current value of the driver parameter.
+  * The publishValue() method for this class reads the current value of the driver parameter into a value store,
+  * and the updateValue() method copies it from the store into the attribute.  The parameter index is resolved
+  * once, when the attribute is created.  An attribute in a paramAttributeBatch is read by the batch instead.
   */
 class ADCORE_API paramAttribute : public NDAttribute {
 public:
@@ -35,14 +41,50 @@ public:
     paramAttribute(paramAttribute& attribute);
     ~paramAttribute();
     paramAttribute* copy(NDAttribute *pAttribute);
+    int publishValue();
+    int readParam();
     int updateValue();
+    size_t getSnapshotRetries();
     int report(FILE *fp, int details);
+    friend class paramAttributeBatch;
 
 private:
     int         paramId;
     int         paramAddr;
     paramAttrType_t paramType;
     class asynNDArrayDriver *pDriver;
+    NDAttributeValueStore *pStore;  /**< Values published by publishValue(), NULL in copies */
+    char *pStringBuffer;            /**< Buffer for reading string parameters in publishValue() */
+    std::string stringValue;        /**< String value read from the store, kept to avoid reallocation */
+    class paramAttributeBatch *pBatch;  /**< Batch that reads the value, if any; publishValue() then does nothing */
+};
+
+/** Reads the parameters of a set of paramAttribute objects with one lock of the driver for each asyn address.
+  * The attributes are grouped by driver and asyn address when they are added, and sorted by parameter index
+  * within each group, so update() locks each driver once per address instead of each attribute reading its
+  * parameter on its own.  The batch does not own the attributes; an attribute that is deleted removes itself.
+  */
+class ADCORE_API paramAttributeBatch {
+public:
+    paramAttributeBatch();
+    ~paramAttributeBatch();
+    int add(paramAttribute *pAttribute);
+    int remove(paramAttribute *pAttribute);
+    int clear();
+    int count();
+    int numGroups();
+    int update();
+
+private:
+    /** The attributes reading the parameters of one asyn address of one driver */
+    struct Group {
+        class asynNDArrayDriver *pDriver;
+        int addr;
+        bool sorted;                            /**< attributes is sorted by parameter index */
+        std::vector<paramAttribute *> attributes;
+    };
+    static bool less(const paramAttribute *pA, const paramAttribute *pB);
+    std::vector<Group> groups;
 };
 
 #endif /*INCparamAttributeH*/
@@ -44,6 +44,57 @@ struct freeNDArray {
     void operator()(dataType *data) { array->release(); }
 };
 
+// NDArray that holds a reference to the NTNDArray value that its data points to
+class NTNDWrappedArray : public NDArray
+{
+public:
+    shared_vector<const void> value;
+};
+
+NTNDArrayPool::NTNDArrayPool (asynNDArrayDriver *pDriver, size_t maxMemory)
+    : NDArrayPool(pDriver, maxMemory) {}
+
+/** Allocates an NDArray whose data is an NTNDArray value, without copying it.
+  * \param[in] ndims The number of dimensions in the NDArray.
+  * \param[in] dims Array of dimensions, whose size must be at least ndims.
+  * \param[in] dataType Data type of the NDArray data.
+  * \param[in] data The value; the array keeps a reference to it until it is released.
+  * \return The array, or NULL if it could not be allocated.
+  */
+NDArray *NTNDArrayPool::wrap (int ndims, size_t *dims, NDDataType_t dataType,
+        shared_vector<const void> const & data)
+{
+    if (data.empty())
+        return NULL;
+
+    NDArray *pArray = alloc(ndims, dims, dataType, data.size(), const_cast<void*>(data.data()));
+    if (pArray) {
+        static_cast<NTNDWrappedArray*>(pArray)->value = data;
+        pArray->readOnly = true;
+        pArray->pAttributeList->clear();
+    }
+    return pArray;
+}
+
+NDArray *NTNDArrayPool::createArray (void)
+{
+    return new NTNDWrappedArray;
+}
+
+/* Called with the pool locked.  When the last reference is released the value is released, and pData is
+ * cleared so the pool does not free it; the next wrap() replaces it and corrects the memory size. */
+void NTNDArrayPool::onReleaseArray (NDArray *pArray)
+{
+    if (pArray->getReferenceCount() > 0)
+        return;
+
+    NTNDWrappedArray *pWrapped = static_cast<NTNDWrappedArray*>(pArray);
+    if (!pWrapped->value.empty()) {
+        pWrapped->value.clear();
+        pWrapped->pData = NULL;
+    }
+}
+
 NTNDArrayConverter::NTNDArrayConverter (NTNDArrayPtr array) : m_array(array) {}
 
 ScalarType NTNDArrayConverter::getValueType (void)
@@ -207,6 +258,27 @@ NTNDArrayInfo_t NTNDArrayConverter::getInfo (void)
 void NTNDArrayConverter::toArray (NDArray *dest)
 {
     toValue(dest);
+    toFields(dest);
+}
+
+/** Returns a new NDArray from an NTNDArrayPool that uses the value of the NTNDArray as its data,
+  * so the data are not copied.  The caller must release the array.
+  */
+NDArray *NTNDArrayConverter::toArray (NTNDArrayPool *pool)
+{
+    NDArray *dest = wrapValue(pool);
+
+    try {
+        toFields(dest);
+    } catch (...) {
+        dest->release();
+        throw;
+    }
+    return dest;
+}
+
+void NTNDArrayConverter::toFields (NDArray *dest)
+{
     toDimensions(dest);
     toTimeStamp(dest);
     toDataTimeStamp(dest);
@@ -273,6 +345,49 @@ void NTNDArrayConverter::toValue (NDArray *dest)
 
 }
 
+template <typename arrayType>
+NDArray *NTNDArrayConverter::wrapValue (NTNDArrayPool *pool)
+{
+    typedef typename arrayType::value_type arrayValType;
+    typedef typename arrayType::const_svector arrayVecType;
+
+    PVUnionPtr src(m_array->getValue());
+    arrayVecType srcVec(src->get<arrayType>()->view());
+
+    NTNDArrayInfo_t info = getInfo();
+    NDArray *dest = pool->wrap(info.ndims, info.dims, info.dataType,
+            static_shared_vector_cast<const void>(srcVec));
+    if (!dest)
+        throw std::runtime_error("unable to allocate NDArray");
+
+    dest->codec.name = info.codec;
+    if (!info.codec.empty())
+        dest->compressedSize = srcVec.size()*sizeof(arrayValType);
+
+    return dest;
+}
+
+NDArray *NTNDArrayConverter::wrapValue (NTNDArrayPool *pool)
+{
+    switch(getValueType())
+    {
+    case pvByte:    return wrapValue<PVByteArray>  (pool);
+    case pvUByte:   return wrapValue<PVUByteArray> (pool);
+    case pvShort:   return wrapValue<PVShortArray> (pool);
+    case pvUShort:  return wrapValue<PVUShortArray>(pool);
+    case pvInt:     return wrapValue<PVIntArray>   (pool);
+    case pvUInt:    return wrapValue<PVUIntArray>  (pool);
+    case pvLong:    return wrapValue<PVLongArray>  (pool);
+    case pvULong:   return wrapValue<PVULongArray> (pool);
+    case pvFloat:   return wrapValue<PVFloatArray> (pool);
+    case pvDouble:  return wrapValue<PVDoubleArray>(pool);
+    case pvBoolean:
+    case pvString:
+    default:
+        throw std::runtime_error("invalid value data type");
+    }
+}
+
 void NTNDArrayConverter::toDimensions (NDArray *dest)
 {
     PVStructureArrayPtr src(m_array->getDimension());
@@ -502,22 +617,39 @@ void NTNDArrayConverter::fromTimeStamp (NDArray *src)
     pvDest.set(ts);
 }
 
-template <typename pvAttrType, typename valueType>
-void NTNDArrayConverter::fromAttribute (PVStructurePtr dest, NDAttribute *src)
+// Puts a string field only if it has changed, because each put is posted to the monitors of the record
+static void putIfChanged (PVStringPtr const & dest, const char *value)
 {
-    valueType value;
-    src->getValue(src->getDataType(), (void*)&value);
+    if (dest->get() != value)
+        dest->put(value);
+}
+
+template <typename pvAttrType>
+typename pvAttrType::shared_pointer NTNDArrayConverter::attributeValueField (AttributeFields &dest)
+{
+    typedef typename pvAttrType::shared_pointer valuePtr;
+
+    if (dest.scalar && dest.scalar->getScalar()->getScalarType() == pvAttrType::typeCode)
+        return static_pointer_cast<pvAttrType>(dest.scalar);
 
-    PVUnionPtr destUnion(dest->getSubFieldT<PVUnion>("value"));
-    typename pvAttrType::shared_pointer valueFld(destUnion->get<pvAttrType>());
+    valuePtr valueFld(dest.value->get<pvAttrType>());
     if(!valueFld) {
         valueFld = PVDC->createPVScalar<pvAttrType>();
-        destUnion->set(valueFld);
+        dest.value->set(valueFld);
     }
-    valueFld->put(value);
+    dest.scalar = valueFld;
+    return valueFld;
 }
 
-void NTNDArrayConverter::fromStringAttribute (PVStructurePtr dest, NDAttribute *src)
+template <typename pvAttrType, typename valueType>
+void NTNDArrayConverter::fromAttribute (AttributeFields &dest, NDAttribute *src)
+{
+    valueType value;
+    src->getValue(src->getDataType(), (void*)&value);
+    attributeValueField<pvAttrType>(dest)->put(value);
+}
+
+void NTNDArrayConverter::fromStringAttribute (AttributeFields &dest, NDAttribute *src)
 {
     NDAttrDataType_t attrDataType;
     size_t attrDataSize;
@@ -525,20 +657,14 @@ void NTNDArrayConverter::fromStringAttribute (PVStructurePtr dest, NDAttribute *
     src->getValueInfo(&attrDataType, &attrDataSize);
     std::vector<char> value(attrDataSize);
     src->getValue(attrDataType, &value[0], attrDataSize);
-
-    PVUnionPtr destUnion(dest->getSubFieldT<PVUnion>("value"));
-    PVStringPtr valueFld(destUnion->get<PVString>());
-    if(!valueFld) {
-        valueFld = PVDC->createPVScalar<PVString>();
-        destUnion->set(valueFld);
-    }
-    valueFld->put(&value[0]);
+    attributeValueField<PVString>(dest)->put(&value[0]);
 }
 
-void NTNDArrayConverter::fromUndefinedAttribute (PVStructurePtr dest)
+void NTNDArrayConverter::fromUndefinedAttribute (AttributeFields &dest)
 {
     PVFieldPtr nullPtr;
-    dest->getSubField<PVUnion>("value")->set(nullPtr);
+    dest.value->set(nullPtr);
+    dest.scalar.reset();
 }
 
 void NTNDArrayConverter::fromAttributes (NDArray *src)
@@ -550,37 +676,51 @@ void NTNDArrayConverter::fromAttributes (NDArray *src)
     PVStructureArray::svector destVec(dest->reuse());
 
     destVec.resize(srcList->count());
+    m_attributes.resize(srcList->count());
 
     size_t i = 0;
     while((attr = srcList->next(attr)))
     {
-        if(!destVec[i].get() || !destVec[i].unique())
+        AttributeFields &fields = m_attributes[i];
+
+        // The structure of the last array can be updated in place if it is only referenced by destVec and
+        // the cache; otherwise a monitor still holds it and a new structure is needed.
+        if(!destVec[i].get() || destVec[i] != fields.structure || destVec[i].use_count() > 2)
+        {
             destVec[i] = PVDC->createPVStructure(structure);
 
-        PVStructurePtr pvAttr(destVec[i]);
+            fields.structure  = destVec[i];
+            fields.name       = destVec[i]->getSubFieldT<PVString>("name");
+            fields.descriptor = destVec[i]->getSubFieldT<PVString>("descriptor");
+            fields.source     = destVec[i]->getSubFieldT<PVString>("source");
+            fields.sourceType = destVec[i]->getSubFieldT<PVInt>("sourceType");
+            fields.value      = destVec[i]->getSubFieldT<PVUnion>("value");
+            fields.scalar.reset();
+        }
 
-        pvAttr->getSubField<PVString>("name")->put(attr->getName());
-        pvAttr->getSubField<PVString>("descriptor")->put(attr->getDescription());
-        pvAttr->getSubField<PVString>("source")->put(attr->getSource());
+        putIfChanged(fields.name, attr->getName());
+        putIfChanged(fields.descriptor, attr->getDescription());
+        putIfChanged(fields.source, attr->getSource());
 
         NDAttrSource_t sourceType;
         attr->getSourceInfo(&sourceType);
-        pvAttr->getSubField<PVInt>("sourceType")->put(sourceType);
+        if (fields.sourceType->get() != sourceType)
+            fields.sourceType->put(sourceType);
 
         switch(attr->getDataType())
         {
-        case NDAttrInt8:      fromAttribute <PVByte,   int8_t>  (pvAttr, attr); break;
-        case NDAttrUInt8:     fromAttribute <PVUByte,  uint8_t> (pvAttr, attr); break;
-        case NDAttrInt16:     fromAttribute <PVShort,  int16_t> (pvAttr, attr); break;
-        case NDAttrUInt16:    fromAttribute <PVUShort, uint16_t>(pvAttr, attr); break;
-        case NDAttrInt32:     fromAttribute <PVInt,    int32_t> (pvAttr, attr); break;
-        case NDAttrUInt32:    fromAttribute <PVUInt,   uint32_t>(pvAttr, attr); break;
-        case NDAttrInt64:     fromAttribute <PVLong,   int64_t> (pvAttr, attr); break;
-        case NDAttrUInt64:    fromAttribute <PVULong,  uint64_t>(pvAttr, attr); break;
-        case NDAttrFloat32:   fromAttribute <PVFloat,  float>   (pvAttr, attr); break;
-        case NDAttrFloat64:   fromAttribute <PVDouble, double>  (pvAttr, attr); break;
-        case NDAttrString:    fromStringAttribute(pvAttr, attr); break;
-        case NDAttrUndefined: fromUndefinedAttribute(pvAttr); break;
+        case NDAttrInt8:      fromAttribute <PVByte,   int8_t>  (fields, attr); break;
+        case NDAttrUInt8:     fromAttribute <PVUByte,  uint8_t> (fields, attr); break;
+        case NDAttrInt16:     fromAttribute <PVShort,  int16_t> (fields, attr); break;
+        case NDAttrUInt16:    fromAttribute <PVUShort, uint16_t>(fields, attr); break;
+        case NDAttrInt32:     fromAttribute <PVInt,    int32_t> (fields, attr); break;
+        case NDAttrUInt32:    fromAttribute <PVUInt,   uint32_t>(fields, attr); break;
+        case NDAttrInt64:     fromAttribute <PVLong,   int64_t> (fields, attr); break;
+        case NDAttrUInt64:    fromAttribute <PVULong,  uint64_t>(fields, attr); break;
+        case NDAttrFloat32:   fromAttribute <PVFloat,  float>   (fields, attr); break;
+        case NDAttrFloat64:   fromAttribute <PVDouble, double>  (fields, attr); break;
+        case NDAttrString:    fromStringAttribute(fields, attr); break;
+        case NDAttrUndefined: fromUndefinedAttribute(fields); break;
         default:              throw std::runtime_error("invalid attribute data type");
         }
 
@@ -589,7 +729,3 @@ void NTNDArrayConverter::fromAttributes (NDArray *src)
 
     dest->replace(freeze(destVec));
 }
-
-
-
-
@@ -1,4 +1,5 @@
 #include <math.h>
+#include <vector>
 
 #include <ntndArrayConverterAPI.h>
 #include <NDArray.h>
@@ -21,6 +22,25 @@ typedef struct NTNDArrayInfo
     }x, y, color;
 }NTNDArrayInfo_t;
 
+/** NDArrayPool whose arrays use the value of an NTNDArray as their data, so received arrays are not copied.
+  * The pool holds a reference to the value until the array is released, and then detaches it so that the
+  * data is never freed by the pool.  Arrays must only be allocated with wrap().
+  * The value is shared with pvAccess, so the arrays are marked NDArray::readOnly and plugins copy them
+  * rather than modify them in place.
+  */
+class NTNDARRAYCONVERTER_API NTNDArrayPool : public NDArrayPool
+{
+public:
+    NTNDArrayPool(class asynNDArrayDriver *pDriver, size_t maxMemory);
+
+    NDArray *wrap (int ndims, size_t *dims, NDDataType_t dataType,
+            epics::pvData::shared_vector<const void> const & data);
+
+protected:
+    NDArray *createArray (void);
+    void onReleaseArray (NDArray *pArray);
+};
+
 class NTNDARRAYCONVERTER_API NTNDArrayConverter
 {
 public:
@@ -28,10 +48,24 @@ public:
 
     NTNDArrayInfo_t getInfo (void);
     void toArray (NDArray *dest);
+    NDArray *toArray (NTNDArrayPool *pool);
     void fromArray (NDArray *src);
 
 private:
+    // Field handles of one element of the attribute array, so they are not looked up by name for every array
+    struct AttributeFields
+    {
+        epics::pvData::PVStructurePtr structure;
+        epics::pvData::PVStringPtr name;
+        epics::pvData::PVStringPtr descriptor;
+        epics::pvData::PVStringPtr source;
+        epics::pvData::PVIntPtr sourceType;
+        epics::pvData::PVUnionPtr value;
+        epics::pvData::PVScalarPtr scalar;   // The field selected in value, NULL if undefined
+    };
+
     epics::nt::NTNDArrayPtr m_array;
+    std::vector<AttributeFields> m_attributes;
 
     epics::pvData::ScalarType getValueType (void);
     NDColorMode_t getColorMode (void);
@@ -39,7 +73,11 @@ private:
     template <typename arrayType>
     void toValue (NDArray *dest);
     void toValue (NDArray *dest);
+    template <typename arrayType>
+    NDArray *wrapValue (NTNDArrayPool *pool);
+    NDArray *wrapValue (NTNDArrayPool *pool);
 
+    void toFields (NDArray *dest);
     void toDimensions (NDArray *dest);
     void toTimeStamp (NDArray *dest);
     void toDataTimeStamp (NDArray *dest);
@@ -58,10 +96,12 @@ private:
     void fromTimeStamp (NDArray *src);
     void fromDataTimeStamp (NDArray *src);
 
+    template <typename pvAttrType>
+    typename pvAttrType::shared_pointer attributeValueField (AttributeFields &dest);
     template <typename pvAttrType, typename valueType>
-    void fromAttribute (epics::pvData::PVStructurePtr dest, NDAttribute *src);
-    void fromStringAttribute (epics::pvData::PVStructurePtr dest, NDAttribute *src);
-    void fromUndefinedAttribute (epics::pvData::PVStructurePtr dest);
+    void fromAttribute (AttributeFields &dest, NDAttribute *src);
+    void fromStringAttribute (AttributeFields &dest, NDAttribute *src);
+    void fromUndefinedAttribute (AttributeFields &dest);
     void fromAttributes (NDArray *src);
 };
 
@@ -0,0 +1,152 @@
+/*
+ * NDArrayReorderBuffer.cpp
+ *
+ * Buffer that returns NDArrays in uniqueId order
+ *
+ */
+
+#include "NDArrayReorderBuffer.h"
+
+NDArrayReorderBuffer::NDArrayReorderBuffer()
+  : freeElement_(-1), count_(0), minId_(0), maxId_(0)
+{
+}
+
+NDArrayReorderBuffer::~NDArrayReorderBuffer()
+{
+  clear();
+}
+
+/** Releases the arrays in the buffer and allocates the slots and elements for a new size.
+  * \param[in] size The maximum number of arrays in the buffer, which is also the maximum span of their uniqueIds.
+  */
+void NDArrayReorderBuffer::setSize(int size)
+{
+  Slot empty = {-1, -1};
+
+  clear();
+  if (size < 0) size = 0;
+  slots_.assign(size, empty);
+  elements_.resize(size);
+  for (int i=0; i<size; i++) {
+    elements_[i].pArray = NULL;
+    elements_[i].next = (i < size-1) ? i+1 : -1;
+  }
+  freeElement_ = (size > 0) ? 0 : -1;
+}
+
+/** Returns the maximum number of arrays in the buffer.
+  */
+int NDArrayReorderBuffer::getSize()
+{
+  return (int)slots_.size();
+}
+
+/** Returns the number of arrays in the buffer.
+  */
+int NDArrayReorderBuffer::count()
+{
+  return count_;
+}
+
+/** Returns the slot for a uniqueId.
+  * \param[in] uniqueId The uniqueId.
+  */
+NDArrayReorderBuffer::Slot& NDArrayReorderBuffer::slot(int uniqueId)
+{
+  int size = (int)slots_.size();
+  return slots_[((uniqueId % size) + size) % size];
+}
+
+/** Returns true if an array with this uniqueId can be pushed without the uniqueIds in the buffer spanning
+  * more than its size.  If not, the caller pops arrays until it does.
+  * \param[in] uniqueId The uniqueId of the array.
+  */
+bool NDArrayReorderBuffer::fits(int uniqueId)
+{
+  int lowest, highest;
+
+  if (count_ == 0) return true;
+  lowest = (uniqueId < minId_) ? uniqueId : minId_;
+  highest = (uniqueId > maxId_) ? uniqueId : maxId_;
+  return (highest - lowest < (int)slots_.size());
+}
+
+/** Adds an array to the buffer and reserves it.  The caller must check fits() first.
+  * \param[in] pArray The array.
+  * \param[in] pTime The time the array was added, for expired().
+  * \return ND_SUCCESS, or ND_ERROR if the buffer is full.
+  */
+int NDArrayReorderBuffer::push(NDArray *pArray, const epicsTimeStamp *pTime)
+{
+  int uniqueId = pArray->uniqueId;
+  int index = freeElement_;
+
+  if ((index < 0) || !fits(uniqueId)) return ND_ERROR;
+  Element& element = elements_[index];
+  freeElement_ = element.next;
+  pArray->reserve();
+  element.pArray = pArray;
+  element.insertionTime = *pTime;
+  element.next = -1;
+  Slot& s = slot(uniqueId);
+  if (s.last >= 0) {
+    elements_[s.last].next = index;
+  } else {
+    s.first = index;
+  }
+  s.last = index;
+  if ((count_ == 0) || (uniqueId < minId_)) minId_ = uniqueId;
+  if ((count_ == 0) || (uniqueId > maxId_)) maxId_ = uniqueId;
+  count_++;
+  return ND_SUCCESS;
+}
+
+/** Removes the array with the lowest uniqueId from the buffer, if its uniqueId is not above a limit.
+  * The caller takes over the reference to the array and must release it.
+  * \param[in] maxUniqueId The highest uniqueId to return; normally one more than the last array output,
+  *            or INT_MAX to return the lowest array whatever its uniqueId.
+  * \return The array, or NULL if the buffer is empty or the lowest uniqueId is above maxUniqueId.
+  */
+NDArray *NDArrayReorderBuffer::pop(int maxUniqueId)
+{
+  NDArray *pArray;
+  int index;
+
+  if ((count_ == 0) || (minId_ > maxUniqueId)) return NULL;
+  Slot& s = slot(minId_);
+  index = s.first;
+  Element& element = elements_[index];
+  pArray = element.pArray;
+  s.first = element.next;
+  if (s.first < 0) s.last = -1;
+  element.pArray = NULL;
+  element.next = freeElement_;
+  freeElement_ = index;
+  count_--;
+  // The uniqueIds span less than the size, so the next array is found before the search wraps
+  if (count_ > 0) {
+    while (slot(minId_).first < 0) minId_++;
+  }
+  return pArray;
+}
+
+/** Returns true if the array with the lowest uniqueId has been in the buffer for longer than a timeout,
+  * so the arrays that should precede it are not waited for any longer.
+  * \param[in] pNow The current time.
+  * \param[in] timeout The timeout in seconds.
+  */
+bool NDArrayReorderBuffer::expired(const epicsTimeStamp *pNow, double timeout)
+{
+  if (count_ == 0) return false;
+  return (epicsTimeDiffInSeconds(pNow, &elements_[slot(minId_).first].insertionTime) > timeout);
+}
+
+/** Releases all the arrays in the buffer.
+  */
+void NDArrayReorderBuffer::clear()
+{
+  NDArray *pArray;
+
+  while ((pArray = pop(minId_)) != NULL) pArray->release();
+}
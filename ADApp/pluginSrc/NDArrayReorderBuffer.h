@@ -0,0 +1,60 @@
+/*
+ * NDArrayReorderBuffer.h
+ *
+ * Buffer that returns NDArrays in uniqueId order
+ *
+ */
+
+#ifndef NDARRAYREORDERBUFFER_H
+#define NDARRAYREORDERBUFFER_H
+
+#include <vector>
+
+#include <epicsTime.h>
+
+#include "NDPluginAPI.h"
+#include "NDArray.h"
+
+/** NDArrayReorderBuffer class; holds NDArrays that arrived out of order until they can be output in uniqueId order.
+  * The buffer is a ring of slots indexed by uniqueId modulo its size, so finding the array with a given uniqueId
+  * does not search.  The uniqueIds of the arrays in the buffer must therefore span less than the size of the buffer,
+  * which callers check with fits().  Each slot holds a chain of the arrays with the same uniqueId, taken from a
+  * pool of elements allocated by setSize(), so no memory is allocated for each array.
+  * The buffer holds a reference to each array from push() until pop().
+  * The buffer is not thread safe; plugins call it with their lock held.
+  */
+class NDPLUGIN_API NDArrayReorderBuffer
+{
+  public:
+    NDArrayReorderBuffer();
+    ~NDArrayReorderBuffer();
+    void setSize(int size);
+    int getSize();
+    int count();
+    bool fits(int uniqueId);
+    int push(NDArray *pArray, const epicsTimeStamp *pTime);
+    NDArray *pop(int maxUniqueId);
+    bool expired(const epicsTimeStamp *pNow, double timeout);
+    void clear();
+
+  private:
+    struct Element {
+      NDArray *pArray;               /**< The array */
+      epicsTimeStamp insertionTime;  /**< Time the array was pushed */
+      int next;                      /**< Next element in the slot or the free list, -1 at the end */
+    };
+    struct Slot {
+      int first;                     /**< First element, -1 if the slot is empty */
+      int last;                      /**< Last element, so that arrays with the same uniqueId keep their order */
+    };
+    Slot& slot(int uniqueId);
+
+    std::vector<Slot> slots_;        /**< Slots indexed by uniqueId modulo the size */
+    std::vector<Element> elements_;  /**< Pool of elements */
+    int freeElement_;                /**< First element of the free list, -1 if the buffer is full */
+    int count_;                      /**< Number of arrays in the buffer */
+    int minId_;                      /**< Lowest uniqueId in the buffer, valid when count_ > 0 */
+    int maxId_;                      /**< Highest uniqueId in the buffer, valid when count_ > 0 */
+};
+
+#endif
@@ -13,9 +13,9 @@ NDArrayRing::NDArrayRing(int noOfBuffers)
 {
   noOfBuffers_ = noOfBuffers;
   buffers_ = NULL;
-  writeIndex_ = -1;
   readIndex_ = -1;
-  wrapped_ = 0;
+  startIndex_ = 0;
+  count_ = 0;
 
   buffers_ = new NDArray *[noOfBuffers_];
   for (int index = 0; index < noOfBuffers_; index++){
@@ -31,10 +31,7 @@ NDArrayRing::~NDArrayRing()
 
 int NDArrayRing::size()
 {
-  if (wrapped_ == 1){
-    return noOfBuffers_;
-  }
-  return writeIndex_ + 1;
+  return count_;
 }
 
 NDArray *NDArrayRing::addToEnd(NDArray *pArray)
@@ -42,14 +39,14 @@ NDArray *NDArrayRing::addToEnd(NDArray *pArray)
   NDArray *retVal = NULL;
 
   if (noOfBuffers_ > 0) {
-      writeIndex_ = (writeIndex_ + 1) % noOfBuffers_;
-      if (wrapped_ == 1){
-          retVal = buffers_[writeIndex_];
-      }
-      buffers_[writeIndex_] = pArray;
-      if (writeIndex_+1 == noOfBuffers_){
-          // We have now wrapped
-          wrapped_ = 1;
+      if (count_ == noOfBuffers_){
+          // The ring is full, so overwrite the oldest frame
+          retVal = buffers_[startIndex_];
+          buffers_[startIndex_] = pArray;
+          startIndex_ = (startIndex_ + 1) % noOfBuffers_;
+      } else {
+          buffers_[(startIndex_ + count_) % noOfBuffers_] = pArray;
+          count_++;
       }
   } else {
       // Buffer is not being used, so return the passed array to be released immediately.
@@ -61,37 +58,40 @@ NDArray *NDArrayRing::addToEnd(NDArray *pArray)
 // Return the oldest frame in the buffer
 NDArray *NDArrayRing::readFromStart()
 {
-  if (wrapped_) {
-    readIndex_ = ((writeIndex_+1) % noOfBuffers_);
-  } else {
-    readIndex_ = 0;
-  }
-
-  //printf("readFromStart - Readindex %d\n", readIndex_);
-  return buffers_[readIndex_];
+  // Here readIndex is the position of the frame read out, counted from the oldest
+  readIndex_ = 0;
+  if (count_ == 0) return NULL;
+  return buffers_[startIndex_];
 }
 
 NDArray *NDArrayRing::readNext()
 {
-  readIndex_ = (readIndex_ + 1) % noOfBuffers_;
-  //printf("readNext - Readindex %d\n", readIndex_);
-  return buffers_[readIndex_];
+  readIndex_++;
+  return buffers_[(startIndex_ + readIndex_) % noOfBuffers_];
+}
+
+NDArray *NDArrayRing::removeFromStart()
+{
+  NDArray *retVal;
+
+  if (count_ == 0) return NULL;
+  retVal = buffers_[startIndex_];
+  buffers_[startIndex_] = NULL;
+  startIndex_ = (startIndex_ + 1) % noOfBuffers_;
+  count_--;
+  return retVal;
 }
 
 bool NDArrayRing::hasNext()
 {
-  // Here readIndex is index of last frame read out
-  if (readIndex_ == writeIndex_){
-    return false;
-  }
-  return true;
+  return (readIndex_ + 1 < count_);
 }
 
 void NDArrayRing::clear()
 {
-  writeIndex_ = -1;
   readIndex_  = -1;
-  wrapped_ = 0;
+  startIndex_ = 0;
+  count_ = 0;
   if (buffers_){
     for (int index = 0; index < noOfBuffers_; index++){
       if (buffers_[index]){
@@ -101,5 +101,3 @@ void NDArrayRing::clear()
     }
   }
 }
-
-
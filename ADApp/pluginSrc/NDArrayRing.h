@@ -25,6 +25,9 @@ class NDArrayRing
     // Read out the next buffer reference from the ring
     NDArray *readNext();
 
+    // Remove the oldest buffer reference from the ring and return it
+    NDArray *removeFromStart();
+
     // Does the ring have any other data
     bool hasNext();
 
@@ -41,11 +44,11 @@ class NDArrayRing
     // Index to read the next buffer
     int  readIndex_;
 
-    // Index to write a new NDArray pointer into the ring
-    int  writeIndex_;
+    // Index of the oldest NDArray pointer in the ring
+    int  startIndex_;
 
-    // Has the ring wrapped yet
-    int  wrapped_;
+    // Number of NDArray pointers in the ring
+    int  count_;
 };
 
 #endif
@@ -0,0 +1,286 @@
+/*
+ * NDArraySpillStore.cpp
+ *
+ * First-in first-out store of NDArrays in a memory-mapped file
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <epicsStdio.h>
+
+#if !defined(_WIN32) && !defined(vxWorks) && !defined(__rtems__)
+#define HAVE_SPILL_MMAP
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+#include "NDArraySpillStore.h"
+
+/** Value returned by allocate() when there is no room in the file */
+#define SPILL_NO_ROOM ((size_t)-1)
+
+/** Minimum amount of disk space reserved at a time as the file fills */
+#define SPILL_RESERVE_STEP ((size_t)64 * 1024 * 1024)
+
+NDArraySpillStore::NDArraySpillStore()
+  : fd_(-1), pMap_(NULL), mapSize_(0), reserved_(0), pageSize_(4096), tail_(0), bytesUsed_(0), numAdvised_(0)
+{
+#ifdef HAVE_SPILL_MMAP
+  long pageSize = sysconf(_SC_PAGESIZE);
+  if (pageSize > 0) pageSize_ = (size_t)pageSize;
+#endif
+}
+
+NDArraySpillStore::~NDArraySpillStore()
+{
+  close();
+}
+
+/** Creates the file of the store and maps it.  If the store is already open with the same directory and size
+  * it is only cleared, and keeps its file; otherwise it is closed first.
+  * \param[in] directory The directory in which to create the file, normally on a local SSD.
+  * \param[in] maxBytes The size of the file, which limits the total size of the arrays in the store.
+  * \param[out] errorMessage The reason the store cannot be opened.
+  * \return ND_SUCCESS, or ND_ERROR if the file cannot be created or mapped,
+  *         or memory-mapped files are not supported on this platform.
+  */
+int NDArraySpillStore::open(const char *directory, size_t maxBytes, std::string& errorMessage)
+{
+  if (pMap_ && directory && (directory_ == directory) && (mapSize_ == (maxBytes / pageSize_) * pageSize_)) {
+    clear();
+    return ND_SUCCESS;
+  }
+  close();
+#ifdef HAVE_SPILL_MMAP
+  std::string path;
+  std::vector<char> fileName;
+  char message[256];
+
+  mapSize_ = (maxBytes / pageSize_) * pageSize_;
+  if (!directory || (directory[0] == 0) || (mapSize_ == 0)) {
+    errorMessage = "a directory and a size of at least one page are required";
+    mapSize_ = 0;
+    return ND_ERROR;
+  }
+  path = directory;
+  if (path[path.size()-1] != '/') path += '/';
+  path += "NDArraySpillXXXXXX";
+  fileName.assign(path.begin(), path.end());
+  fileName.push_back(0);
+  fd_ = mkstemp(&fileName[0]);
+  if (fd_ < 0) {
+    epicsSnprintf(message, sizeof(message), "cannot create file %s: %s", &fileName[0], strerror(errno));
+    errorMessage = message;
+    mapSize_ = 0;
+    return ND_ERROR;
+  }
+  // The file is only used through the open descriptor
+  unlink(&fileName[0]);
+  // Set the size without allocating the space, which reserve() does as the file fills
+  if (ftruncate(fd_, (off_t)mapSize_) != 0) {
+    epicsSnprintf(message, sizeof(message), "cannot set the size of the file in %s: %s", directory, strerror(errno));
+    errorMessage = message;
+    close();
+    return ND_ERROR;
+  }
+  pMap_ = (char *)mmap(NULL, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (pMap_ == MAP_FAILED) {
+    epicsSnprintf(message, sizeof(message), "cannot map the file in %s: %s", directory, strerror(errno));
+    errorMessage = message;
+    pMap_ = NULL;
+    close();
+    return ND_ERROR;
+  }
+  directory_ = directory;
+  return ND_SUCCESS;
+#else
+  errorMessage = "memory-mapped files are not supported on this platform";
+  return ND_ERROR;
+#endif
+}
+
+/** Releases the arrays in the store and deletes its file.
+  */
+void NDArraySpillStore::close()
+{
+  clear();
+#ifdef HAVE_SPILL_MMAP
+  if (pMap_) munmap(pMap_, mapSize_);
+  if (fd_ >= 0) ::close(fd_);
+#endif
+  pMap_ = NULL;
+  fd_ = -1;
+  mapSize_ = 0;
+  reserved_ = 0;
+  directory_.clear();
+}
+
+/** Returns true if the store is open.
+  */
+bool NDArraySpillStore::isOpen()
+{
+  return (pMap_ != NULL);
+}
+
+/** Finds room for data at the end of the ring.
+  * \param[in] mapBytes The size of the data, a multiple of the page size.
+  * \return The offset of the room in the file, or SPILL_NO_ROOM.
+  */
+size_t NDArraySpillStore::allocate(size_t mapBytes)
+{
+  size_t start;
+
+  if (mapBytes > mapSize_) return SPILL_NO_ROOM;
+  if (entries_.empty()) return 0;
+  start = entries_.front().offset;
+  if (tail_ > start) {
+    // The arrays are in one block from start to tail_, so there is room after it or before start
+    if (tail_ + mapBytes <= mapSize_) return tail_;
+    if (mapBytes <= start) return 0;
+  } else {
+    // The newest arrays have wrapped to the start of the file, so there is only room up to start
+    if (tail_ + mapBytes <= start) return tail_;
+  }
+  return SPILL_NO_ROOM;
+}
+
+/** Reserves the disk space of the file up to an offset, if it is not already reserved, so that writing to the
+  * mapping cannot fail when the disk is full.  The space is reserved in steps of at least SPILL_RESERVE_STEP.
+  * \param[in] end The offset.
+  * \return ND_SUCCESS, or ND_ERROR if the space cannot be reserved.
+  */
+int NDArraySpillStore::reserve(size_t end)
+{
+  if (end <= reserved_) return ND_SUCCESS;
+#ifdef HAVE_SPILL_MMAP
+  size_t newReserved = std::min(mapSize_, std::max(end, reserved_ + SPILL_RESERVE_STEP));
+  if (posix_fallocate(fd_, (off_t)reserved_, (off_t)(newReserved - reserved_)) != 0) return ND_ERROR;
+  reserved_ = newReserved;
+  return ND_SUCCESS;
+#else
+  return ND_ERROR;
+#endif
+}
+
+/** Copies an array to the end of the store.  The caller still owns the array and may release it.
+  * \param[in] pArray The array.
+  * \return ND_SUCCESS, or ND_ERROR if the store is not open or is full, or the disk is full.
+  */
+int NDArraySpillStore::push(NDArray *pArray)
+{
+  Entry entry;
+  NDArrayInfo_t arrayInfo;
+
+  if (!pMap_) return ND_ERROR;
+  pArray->getInfo(&arrayInfo);
+  entry.numBytes = pArray->codec.empty() ? arrayInfo.totalBytes : pArray->compressedSize;
+  if (entry.numBytes > pArray->dataSize) entry.numBytes = pArray->dataSize;
+  entry.mapBytes = ((entry.numBytes + pageSize_ - 1) / pageSize_) * pageSize_;
+  if (entry.mapBytes == 0) entry.mapBytes = pageSize_;
+  entry.offset = allocate(entry.mapBytes);
+  if (entry.offset == SPILL_NO_ROOM) return ND_ERROR;
+  if (reserve(entry.offset + entry.mapBytes) != ND_SUCCESS) return ND_ERROR;
+
+  memcpy(pMap_ + entry.offset, pArray->pData, entry.numBytes);
+  // Keep everything except the data in memory
+  entry.pHeader = new NDArray();
+  pArray->pNDArrayPool->copy(pArray, entry.pHeader, false);
+  entry.pHeader->dataSize = 0;
+  entries_.push_back(entry);
+  tail_ = entry.offset + entry.mapBytes;
+  bytesUsed_ += entry.numBytes;
+  return ND_SUCCESS;
+}
+
+/** Removes the oldest array from the store and returns a copy of it allocated from a pool.
+  * Reading the data waits for it to be read from the file unless readahead() was called for it first.
+  * \param[in] pNDArrayPool The pool to allocate the copy from.
+  * \return The array, or NULL if the store is empty or the pool cannot allocate the array;
+  *         the array is removed from the store in both cases.
+  */
+NDArray *NDArraySpillStore::pop(NDArrayPool *pNDArrayPool)
+{
+  NDArray *pArray;
+  size_t dims[ND_ARRAY_MAX_DIMS];
+
+  if (entries_.empty()) return NULL;
+  Entry& entry = entries_.front();
+  for (int i=0; i<entry.pHeader->ndims; i++) dims[i] = entry.pHeader->dims[i].size;
+  pArray = pNDArrayPool->alloc(entry.pHeader->ndims, dims, entry.pHeader->dataType, entry.numBytes, NULL);
+  if (pArray) {
+    pNDArrayPool->copy(entry.pHeader, pArray, false);
+    memcpy(pArray->pData, pMap_ + entry.offset, entry.numBytes);
+  }
+  discard();
+  return pArray;
+}
+
+/** Removes the oldest array from the store without reading it.
+  */
+void NDArraySpillStore::discard()
+{
+  if (entries_.empty()) return;
+  release(entries_.front());
+  entries_.pop_front();
+  if (numAdvised_ > 0) numAdvised_--;
+  if (entries_.empty()) tail_ = 0;
+}
+
+/** Asks the operating system to start reading the data of the oldest arrays from the file, so that
+  * pop() does not wait for it.  Requests are only made once for each array.
+  * \param[in] numArrays The number of arrays, from the oldest, that will be read soon.
+  */
+void NDArraySpillStore::readahead(int numArrays)
+{
+  if (numArrays > (int)entries_.size()) numArrays = (int)entries_.size();
+  for (; numAdvised_ < numArrays; numAdvised_++) {
+#ifdef HAVE_SPILL_MMAP
+    Entry& entry = entries_[numAdvised_];
+    posix_madvise(pMap_ + entry.offset, entry.mapBytes, POSIX_MADV_WILLNEED);
+#endif
+  }
+}
+
+/** Releases the memory held for an array that is leaving the store.
+  * \param[in] entry The entry of the array.
+  */
+void NDArraySpillStore::release(Entry& entry)
+{
+#if defined(HAVE_SPILL_MMAP) && defined(MADV_DONTNEED)
+  // The data is no longer needed, so the pages need not stay mapped
+  madvise(pMap_ + entry.offset, entry.mapBytes, MADV_DONTNEED);
+#endif
+  delete entry.pHeader;
+  bytesUsed_ -= entry.numBytes;
+}
+
+/** Removes all the arrays from the store.
+  */
+void NDArraySpillStore::clear()
+{
+  while (!entries_.empty()) discard();
+  numAdvised_ = 0;
+  tail_ = 0;
+}
+
+/** Returns the number of arrays in the store.
+  */
+int NDArraySpillStore::size()
+{
+  return (int)entries_.size();
+}
+
+/** Returns the total size of the data of the arrays in the store.
+  */
+size_t NDArraySpillStore::bytesUsed()
+{
+  return bytesUsed_;
+}
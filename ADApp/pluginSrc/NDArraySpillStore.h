@@ -0,0 +1,69 @@
+/*
+ * NDArraySpillStore.h
+ *
+ * First-in first-out store of NDArrays in a memory-mapped file
+ *
+ */
+
+#ifndef NDARRAYSPILLSTORE_H
+#define NDARRAYSPILLSTORE_H
+
+#include <deque>
+#include <string>
+
+#include "NDPluginAPI.h"
+#include "NDArray.h"
+
+/** Number of arrays for which readahead() is requested before they are removed by pop() */
+#define ND_SPILL_READAHEAD_ARRAYS 4
+
+/** NDArraySpillStore class; holds NDArrays in a file on local disk, so that plugins can keep more arrays than fit in memory.
+  * The file is created in a directory when the store is opened, and is removed from the directory immediately,
+  * so it is deleted when the store is closed or the IOC exits.  Opening the store again with the same directory
+  * and size keeps the file, so plugins can open it for each capture.  The disk space of the file is reserved in
+  * steps as arrays are first written to it, so opening the store does not wait for the whole file to be allocated.
+  * The data of each array is copied into the file through a shared memory mapping, and its attributes, dimensions
+  * and other properties are kept in memory.  The file is used as a ring: arrays are removed from the start
+  * in the order they were added, and new arrays are written after the newest one, wrapping to the start of the file.
+  * The store is not thread safe; plugins call it with their lock held.
+  */
+class NDPLUGIN_API NDArraySpillStore
+{
+  public:
+    NDArraySpillStore();
+    ~NDArraySpillStore();
+    int open(const char *directory, size_t maxBytes, std::string& errorMessage);
+    void close();
+    bool isOpen();
+    int push(NDArray *pArray);
+    NDArray *pop(NDArrayPool *pNDArrayPool);
+    void discard();
+    void readahead(int numArrays);
+    void clear();
+    int size();
+    size_t bytesUsed();
+
+  private:
+    struct Entry {
+      size_t offset;      /**< Offset of the data in the file */
+      size_t numBytes;    /**< Size of the data */
+      size_t mapBytes;    /**< Size of the data rounded up to whole pages */
+      NDArray *pHeader;   /**< Properties and attributes of the array, without data */
+    };
+    size_t allocate(size_t mapBytes);
+    int reserve(size_t end);
+    void release(Entry& entry);
+
+    int fd_;                      /**< File descriptor of the file, -1 when the store is closed */
+    char *pMap_;                  /**< Start of the mapping of the file */
+    size_t mapSize_;              /**< Size of the file and of the mapping */
+    size_t reserved_;             /**< Size of the start of the file whose disk space is reserved */
+    std::string directory_;       /**< Directory of the file */
+    size_t pageSize_;             /**< Size of memory pages, to which the data of each array is aligned */
+    size_t tail_;                 /**< Offset after the data of the newest array */
+    size_t bytesUsed_;            /**< Sum of the data sizes of the arrays in the store */
+    int numAdvised_;              /**< Number of arrays from the start for which readahead was requested */
+    std::deque<Entry> entries_;   /**< Arrays in the store, oldest first */
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * NDAttributeEnvelope.cpp
+ *
+ * Decimated min/max/mean envelopes of attribute values, used by the bulk mode of NDPluginAttribute
+ *
+ */
+
+#include <algorithm>
+
+#include <epicsMath.h>
+
+#include "NDAttributeEnvelope.h"
+
+NDAttributeEnvelope::NDAttributeEnvelope()
+  : numSignals_(0), numBins_(1), decimation_(1), numSamples_(0),
+    nextBin_(0), numValid_(0), numNew_(0)
+{
+}
+
+/** Sets the sizes of the envelope and clears it.
+  * \param[in] numSignals The number of values in each frame.
+  * \param[in] numBins The number of bins kept for each signal; at least 1.
+  * \param[in] decimation The number of frames in each bin; at least 1.
+  */
+void NDAttributeEnvelope::configure(int numSignals, int numBins, int decimation)
+{
+  numSignals_ = std::max(numSignals, 0);
+  numBins_ = std::max(numBins, 1);
+  decimation_ = std::max(decimation, 1);
+  binMin_.resize(numSignals_);
+  binMax_.resize(numSignals_);
+  binSum_.resize(numSignals_);
+  binCount_.resize(numSignals_);
+  newSums_.resize(numSignals_);
+  for (int i=0; i<3; i++) {
+    columns_[i].assign((size_t)numSignals_ * numBins_, epicsNAN);
+  }
+  clear();
+}
+
+/** Removes all the bins, including the frames added to the current bin.
+  */
+void NDAttributeEnvelope::clear()
+{
+  std::fill(binSum_.begin(), binSum_.end(), 0.);
+  std::fill(binCount_.begin(), binCount_.end(), 0);
+  std::fill(newSums_.begin(), newSums_.end(), 0.);
+  numSamples_ = 0;
+  nextBin_ = 0;
+  numValid_ = 0;
+  numNew_ = 0;
+}
+
+/** Returns the number of values in each frame.
+  */
+int NDAttributeEnvelope::numSignals() const
+{
+  return numSignals_;
+}
+
+/** Returns the number of bins kept for each signal.
+  */
+int NDAttributeEnvelope::numBins() const
+{
+  return numBins_;
+}
+
+/** Returns the number of frames in each bin.
+  */
+int NDAttributeEnvelope::decimation() const
+{
+  return decimation_;
+}
+
+/** Adds the values of one frame to the current bin.
+  * \param[in] values The value of each signal; NaN for a missing value.
+  * \return Returns true if the frame completed a bin.
+  */
+bool NDAttributeEnvelope::add(const double *values)
+{
+  for (int i=0; i<numSignals_; i++) {
+    double value = values[i];
+    if (value != value) continue;
+    if (binCount_[i] == 0) {
+      binMin_[i] = value;
+      binMax_[i] = value;
+    } else if (value < binMin_[i]) {
+      binMin_[i] = value;
+    } else if (value > binMax_[i]) {
+      binMax_[i] = value;
+    }
+    binSum_[i] += value;
+    binCount_[i]++;
+  }
+  if (++numSamples_ < decimation_) return false;
+  closeBin();
+  return true;
+}
+
+/** Returns the number of completed bins, up to numBins().
+  */
+int NDAttributeEnvelope::numValid() const
+{
+  return numValid_;
+}
+
+/** Returns the number of bins completed since the last call to markPublished(), up to numBins().
+  */
+int NDAttributeEnvelope::numNew() const
+{
+  return numNew_;
+}
+
+/** Copies one statistic of a signal for the completed bins, oldest first.
+  * \param[in] statistic The statistic.
+  * \param[in] signal The signal, 0 to numSignals()-1.
+  * \param[out] pValues The values; must have room for numValid() elements.
+  */
+void NDAttributeEnvelope::get(Statistic statistic, int signal, double *pValues) const
+{
+  const double *pColumn = &columns_[statistic][(size_t)signal * numBins_];
+  int first = binIndex(numValid_);
+  int numToEnd = std::min(numValid_, numBins_ - first);
+
+  std::copy(pColumn + first, pColumn + first + numToEnd, pValues);
+  std::copy(pColumn, pColumn + (numValid_ - numToEnd), pValues + numToEnd);
+}
+
+/** Copies the means of all signals for the new bins, oldest first.
+  * The values of each bin are contiguous, which is the layout of a [numSignals, numNew] NDArray
+  * that NDPluginTimeSeries reads as numNew time points.
+  * \param[out] pValues The values; must have room for numSignals()*numNew() elements.
+  */
+void NDAttributeEnvelope::getNewMeans(double *pValues) const
+{
+  if (numSignals_ == 0) return;
+  const double *pMeans = &columns_[Mean][0];
+
+  for (int age=numNew_; age>0; age--) {
+    int bin = binIndex(age);
+    for (int i=0; i<numSignals_; i++) {
+      *pValues++ = pMeans[(size_t)i * numBins_ + bin];
+    }
+  }
+}
+
+/** Returns the mean of a signal in the last completed bin, or NaN if there is none.
+  * \param[in] signal The signal, 0 to numSignals()-1.
+  */
+double NDAttributeEnvelope::lastMean(int signal) const
+{
+  if (numValid_ == 0) return epicsNAN;
+  return columns_[Mean][(size_t)signal * numBins_ + binIndex(1)];
+}
+
+/** Returns the sum of the samples of a signal in the bins completed since the last call to markPublished().
+  * \param[in] signal The signal, 0 to numSignals()-1.
+  */
+double NDAttributeEnvelope::newSum(int signal) const
+{
+  return newSums_[signal];
+}
+
+/** Marks the completed bins as published, so that there are no new bins.
+  */
+void NDAttributeEnvelope::markPublished()
+{
+  std::fill(newSums_.begin(), newSums_.end(), 0.);
+  numNew_ = 0;
+}
+
+/** Stores the statistics of the current bin in the ring and starts the next bin.
+  */
+void NDAttributeEnvelope::closeBin()
+{
+  for (int i=0; i<numSignals_; i++) {
+    size_t index = (size_t)i * numBins_ + nextBin_;
+    if (binCount_[i] > 0) {
+      columns_[Min][index] = binMin_[i];
+      columns_[Max][index] = binMax_[i];
+      columns_[Mean][index] = binSum_[i] / binCount_[i];
+      newSums_[i] += binSum_[i];
+    } else {
+      columns_[Min][index] = epicsNAN;
+      columns_[Max][index] = epicsNAN;
+      columns_[Mean][index] = epicsNAN;
+    }
+    binSum_[i] = 0.;
+    binCount_[i] = 0;
+  }
+  numSamples_ = 0;
+  nextBin_ = (nextBin_ + 1) % numBins_;
+  if (numValid_ < numBins_) numValid_++;
+  if (numNew_ < numBins_) numNew_++;
+}
+
+/** Returns the ring index of a completed bin.
+  * \param[in] age 1 for the last completed bin, 2 for the one before it, up to numBins().
+  */
+int NDAttributeEnvelope::binIndex(int age) const
+{
+  return (nextBin_ + numBins_ - age) % numBins_;
+}
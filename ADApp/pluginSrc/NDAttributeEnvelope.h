@@ -0,0 +1,66 @@
+/*
+ * NDAttributeEnvelope.h
+ *
+ * Decimated min/max/mean envelopes of attribute values, used by the bulk mode of NDPluginAttribute
+ *
+ */
+
+#ifndef NDATTRIBUTEENVELOPE_H_
+#define NDATTRIBUTEENVELOPE_H_
+
+#include <vector>
+
+#include "NDPluginAPI.h"
+
+/** NDAttributeEnvelope class; accumulates one value per signal for each frame, and reduces every
+  * decimation() frames to one bin holding the minimum, maximum and mean of each signal.
+  * The last numBins() bins are kept in a ring, stored as one contiguous column per signal and statistic,
+  * so adding a frame only updates the running statistics of the current bin and no samples are stored.
+  * Values that are NaN are missing samples; a bin without samples for a signal holds NaN for that signal.
+  * The bins completed since the last call to markPublished() are the new bins.
+  */
+class NDPLUGIN_API NDAttributeEnvelope
+{
+public:
+  /** The statistics of each bin */
+  typedef enum {
+    Min,
+    Max,
+    Mean
+  } Statistic;
+
+  NDAttributeEnvelope();
+  void configure(int numSignals, int numBins, int decimation);
+  void clear();
+  int numSignals() const;
+  int numBins() const;
+  int decimation() const;
+  bool add(const double *values);
+  int numValid() const;
+  int numNew() const;
+  void get(Statistic statistic, int signal, double *pValues) const;
+  void getNewMeans(double *pValues) const;
+  double lastMean(int signal) const;
+  double newSum(int signal) const;
+  void markPublished();
+
+private:
+  void closeBin();
+  int binIndex(int age) const;
+
+  int numSignals_;
+  int numBins_;
+  int decimation_;
+  int numSamples_;                     /**< Number of frames added to the current bin */
+  std::vector<double> binMin_;         /**< Minimum of each signal in the current bin */
+  std::vector<double> binMax_;         /**< Maximum of each signal in the current bin */
+  std::vector<double> binSum_;         /**< Sum of each signal in the current bin */
+  std::vector<int> binCount_;          /**< Number of samples of each signal in the current bin */
+  std::vector<double> columns_[3];     /**< Completed bins of each statistic, numBins_ per signal */
+  std::vector<double> newSums_;        /**< Sum of each signal over the new bins */
+  int nextBin_;                        /**< Ring index of the next bin to complete */
+  int numValid_;
+  int numNew_;
+};
+
+#endif /* NDATTRIBUTEENVELOPE_H_ */
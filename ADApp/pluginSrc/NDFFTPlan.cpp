@@ -0,0 +1,539 @@
+/*
+ * NDFFTPlan.cpp
+ *
+ * Mixed-radix real-to-complex FFTs with precomputed plans
+ *
+ */
+
+#include <math.h>
+#include <algorithm>
+
+#include <epicsAtomic.h>
+
+#include "NDFFTPlan.h"
+
+/* Some systems do not define M_PI in math.h */
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
+/** Computes exp(-2 pi i k / n) in double precision.
+  */
+template <typename T>
+static std::complex<T> twiddle(int k, int n)
+{
+  double phase = -2. * M_PI * k / n;
+  return std::complex<T>((T)cos(phase), (T)sin(phase));
+}
+
+NDFFTWorkers::Worker::Worker(NDFFTWorkers *pWorkers, int index)
+  : pWorkers_(pWorkers), index_(index),
+    thread_(*this, "FFTWorker", epicsThreadGetStackSize(epicsThreadStackMedium), epicsThreadPriorityMedium)
+{
+}
+
+NDFFTWorkers::Worker::~Worker()
+{
+}
+
+void NDFFTWorkers::Worker::run()
+{
+  while (1) {
+    startEvent_.wait();
+    if (pWorkers_->exiting_) return;
+    pWorkers_->runChunk(index_);
+    if (epicsAtomicDecrIntT(&pWorkers_->remaining_) == 0) pWorkers_->doneEvent_.signal();
+  }
+}
+
+/** Constructor for NDFFTWorkers; starts the threads.
+  * \param[in] numThreads The number of threads that share the work, including the caller of parallelFor().
+  */
+NDFFTWorkers::NDFFTWorkers(int numThreads)
+  : numThreads_(numThreads < 1 ? 1 : numThreads),
+    task_(NULL), arg_(NULL), count_(0), remaining_(0), exiting_(false)
+{
+  for (int i=1; i<numThreads_; i++) {
+    Worker *pWorker = new Worker(this, i);
+    workers_.push_back(pWorker);
+    pWorker->thread_.start();
+  }
+}
+
+NDFFTWorkers::~NDFFTWorkers()
+{
+  size_t i;
+
+  exiting_ = true;
+  for (i=0; i<workers_.size(); i++) workers_[i]->startEvent_.signal();
+  for (i=0; i<workers_.size(); i++) {
+    workers_[i]->thread_.exitWait();
+    delete workers_[i];
+  }
+}
+
+/** Returns the number of threads that share the work, including the caller of parallelFor().
+  */
+int NDFFTWorkers::numThreads()
+{
+  return numThreads_;
+}
+
+/** Runs one contiguous share of the items of the current parallelFor().
+  * \param[in] index The index of the share, from 0 to numThreads-1.
+  */
+void NDFFTWorkers::runChunk(int index)
+{
+  int begin = (int)((long long)count_ * index / numThreads_);
+  int end = (int)((long long)count_ * (index+1) / numThreads_);
+
+  if (end > begin) task_(arg_, index, begin, end);
+}
+
+/** Calls a task for the items [0, count) split into one contiguous range per thread,
+  * and returns when all of them have been processed.
+  * \param[in] count The number of items.
+  * \param[in] task The function that processes a range of items; the thread index passed to it is
+  *                 less than numThreads(), and each index is used by one thread at a time.
+  * \param[in] arg The argument passed to task.
+  */
+void NDFFTWorkers::parallelFor(int count, NDFFTTask task, void *arg)
+{
+  size_t i;
+
+  if (workers_.empty() || (count < 2)) {
+    if (count > 0) task(arg, 0, 0, count);
+    return;
+  }
+  lock_.lock();
+  task_ = task;
+  arg_ = arg;
+  count_ = count;
+  epicsAtomicSetIntT(&remaining_, (int)workers_.size());
+  for (i=0; i<workers_.size(); i++) workers_[i]->startEvent_.signal();
+  runChunk(0);
+  doneEvent_.wait();
+  lock_.unlock();
+}
+
+/** Constructor for NDFFTComplexPlan; factors the size and computes the twiddle factors.
+  * \param[in] n The size of the transform, at least 1.
+  */
+template <typename T>
+NDFFTComplexPlan<T>::NDFFTComplexPlan(int n)
+  : n_(n < 1 ? 1 : n), scratchSize_(0)
+{
+  int remaining = n_;
+  int p = 4;
+
+  twiddles_.resize(n_);
+  for (int k=0; k<n_; k++) twiddles_[k] = twiddle<T>(k, n_);
+
+  // Factor out 4s first, then 2, 3, 5 and other odd numbers; the butterflies run from the last factor to the first
+  while (remaining > 1) {
+    while (remaining % p) {
+      switch (p) {
+        case 4: p = 2; break;
+        case 2: p = 3; break;
+        default: p += 2; break;
+      }
+      if ((long long)p * p > remaining) p = remaining;
+    }
+    remaining /= p;
+    if ((p > 5) && (p > scratchSize_)) scratchSize_ = p;
+    factors_.push_back(p);
+    factors_.push_back(remaining);
+  }
+}
+
+/** Returns the size of the transform.
+  */
+template <typename T>
+int NDFFTComplexPlan<T>::size() const
+{
+  return n_;
+}
+
+/** Returns the number of complex values of scratch space that transform() needs.
+  */
+template <typename T>
+int NDFFTComplexPlan<T>::scratchSize() const
+{
+  return scratchSize_;
+}
+
+/** Computes the forward transform, out[k] = sum in[j*inStride] exp(-2 pi i j k / n).
+  * \param[in] in The input data.
+  * \param[in] inStride The distance between input values, so that columns of an image can be transformed in place.
+  * \param[out] out The n output values; must not overlap the input.
+  * \param[in] scratch Scratch space of scratchSize() values; may be NULL if scratchSize() is 0.
+  */
+template <typename T>
+void NDFFTComplexPlan<T>::transform(const Complex *in, int inStride, Complex *out, Complex *scratch) const
+{
+  if (n_ == 1) {
+    out[0] = in[0];
+    return;
+  }
+  work(out, in, 1, inStride, &factors_[0], scratch);
+}
+
+/** Computes one stage of the transform: the sub-transforms of size m of each decimated input sequence,
+  * then the butterflies of radix p that combine them.
+  */
+template <typename T>
+void NDFFTComplexPlan<T>::work(Complex *out, const Complex *in, int fstride, int inStride, const int *factors,
+                               Complex *scratch) const
+{
+  Complex *outBegin = out;
+  int p = factors[0];
+  int m = factors[1];
+  Complex *outEnd = out + p*m;
+
+  if (m == 1) {
+    do {
+      *out = *in;
+      in += fstride*inStride;
+    } while (++out != outEnd);
+  } else {
+    do {
+      work(out, in, fstride*p, inStride, factors+2, scratch);
+      in += fstride*inStride;
+    } while ((out += m) != outEnd);
+  }
+
+  out = outBegin;
+  switch (p) {
+    case 2: butterfly2(out, fstride, m); break;
+    case 3: butterfly3(out, fstride, m); break;
+    case 4: butterfly4(out, fstride, m); break;
+    case 5: butterfly5(out, fstride, m); break;
+    default: butterflyGeneric(out, fstride, m, p, scratch); break;
+  }
+}
+
+template <typename T>
+void NDFFTComplexPlan<T>::butterfly2(Complex *out, int fstride, int m) const
+{
+  Complex *out2 = out + m;
+  const Complex *tw = &twiddles_[0];
+  Complex t;
+
+  for (int k=0; k<m; k++) {
+    t = out2[k] * tw[k*fstride];
+    out2[k] = out[k] - t;
+    out[k] += t;
+  }
+}
+
+template <typename T>
+void NDFFTComplexPlan<T>::butterfly3(Complex *out, int fstride, int m) const
+{
+  const Complex *tw = &twiddles_[0];
+  T sin3 = twiddles_[fstride*m].imag();
+  Complex s0, s1, s2, s3;
+
+  for (int k=0; k<m; k++) {
+    s1 = out[k+m] * tw[k*fstride];
+    s2 = out[k+2*m] * tw[2*k*fstride];
+    s3 = s1 + s2;
+    s0 = (s1 - s2) * sin3;
+    out[k+m] = out[k] - s3 * (T)0.5;
+    out[k] += s3;
+    out[k+2*m] = Complex(out[k+m].real() + s0.imag(), out[k+m].imag() - s0.real());
+    out[k+m]   = Complex(out[k+m].real() - s0.imag(), out[k+m].imag() + s0.real());
+  }
+}
+
+template <typename T>
+void NDFFTComplexPlan<T>::butterfly4(Complex *out, int fstride, int m) const
+{
+  const Complex *tw = &twiddles_[0];
+  Complex s0, s1, s2, s3, s4, s5;
+
+  for (int k=0; k<m; k++) {
+    s0 = out[k+m] * tw[k*fstride];
+    s1 = out[k+2*m] * tw[2*k*fstride];
+    s2 = out[k+3*m] * tw[3*k*fstride];
+    s5 = out[k] - s1;
+    out[k] += s1;
+    s3 = s0 + s2;
+    s4 = s0 - s2;
+    out[k+2*m] = out[k] - s3;
+    out[k] += s3;
+    out[k+m]   = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+    out[k+3*m] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+  }
+}
+
+template <typename T>
+void NDFFTComplexPlan<T>::butterfly5(Complex *out, int fstride, int m) const
+{
+  const Complex *tw = &twiddles_[0];
+  Complex ya = twiddles_[fstride*m];
+  Complex yb = twiddles_[2*fstride*m];
+  Complex s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12;
+
+  for (int k=0; k<m; k++) {
+    s0 = out[k];
+    s1 = out[k+m] * tw[k*fstride];
+    s2 = out[k+2*m] * tw[2*k*fstride];
+    s3 = out[k+3*m] * tw[3*k*fstride];
+    s4 = out[k+4*m] * tw[4*k*fstride];
+    s7 = s1 + s4;
+    s10 = s1 - s4;
+    s8 = s2 + s3;
+    s9 = s2 - s3;
+    out[k] = s0 + s7 + s8;
+
+    s5 = Complex(s0.real() + s7.real()*ya.real() + s8.real()*yb.real(),
+                 s0.imag() + s7.imag()*ya.real() + s8.imag()*yb.real());
+    s6 = Complex( s10.imag()*ya.imag() + s9.imag()*yb.imag(),
+                 -s10.real()*ya.imag() - s9.real()*yb.imag());
+    out[k+m]   = s5 - s6;
+    out[k+4*m] = s5 + s6;
+
+    s11 = Complex(s0.real() + s7.real()*yb.real() + s8.real()*ya.real(),
+                  s0.imag() + s7.imag()*yb.real() + s8.imag()*ya.real());
+    s12 = Complex(-s10.imag()*yb.imag() + s9.imag()*ya.imag(),
+                   s10.real()*yb.imag() - s9.real()*ya.imag());
+    out[k+2*m] = s11 + s12;
+    out[k+3*m] = s11 - s12;
+  }
+}
+
+/** Butterfly for any other radix, which computes the DFT of size p directly in p values of scratch space.
+  */
+template <typename T>
+void NDFFTComplexPlan<T>::butterflyGeneric(Complex *out, int fstride, int m, int p, Complex *scratch) const
+{
+  const Complex *tw = &twiddles_[0];
+  int k, q, q1, twIndex;
+
+  for (int u=0; u<m; u++) {
+    for (q1=0, k=u; q1<p; q1++, k+=m) scratch[q1] = out[k];
+    for (q1=0, k=u; q1<p; q1++, k+=m) {
+      twIndex = 0;
+      out[k] = scratch[0];
+      for (q=1; q<p; q++) {
+        twIndex += fstride*k;
+        if (twIndex >= n_) twIndex -= n_;
+        out[k] += scratch[q] * tw[twIndex];
+      }
+    }
+  }
+}
+
+/** Constructor for NDFFTRealPlan.
+  * \param[in] n The number of real input values, at least 1.
+  */
+template <typename T>
+NDFFTRealPlan<T>::NDFFTRealPlan(int n)
+  : n_(n < 1 ? 1 : n),
+    plan_((n_ % 2) ? n_ : n_/2)
+{
+  if (n_ % 2 == 0) {
+    twiddles_.resize(n_/2);
+    for (int k=0; k<n_/2; k++) twiddles_[k] = twiddle<T>(k, n_);
+  }
+}
+
+/** Returns the number of real input values.
+  */
+template <typename T>
+int NDFFTRealPlan<T>::size() const
+{
+  return n_;
+}
+
+/** Returns the number of complex values of work space that transform() needs.
+  */
+template <typename T>
+int NDFFTRealPlan<T>::workSize() const
+{
+  return ((n_ % 2) ? 2*n_ : n_/2) + plan_.scratchSize();
+}
+
+/** Computes the forward transform of n real values.
+  * \param[in] in The n input values.
+  * \param[out] out The n/2+1 output values.
+  * \param[in] work Work space of workSize() values.
+  */
+template <typename T>
+void NDFFTRealPlan<T>::transform(const T *in, Complex *out, Complex *work) const
+{
+  int half = n_/2;
+  int k;
+  Complex a, b, even, odd;
+
+  if (n_ % 2) {
+    for (k=0; k<n_; k++) work[k] = Complex(in[k], 0);
+    plan_.transform(work, 1, work + n_, work + 2*n_);
+    for (k=0; k<=half; k++) out[k] = work[n_ + k];
+    return;
+  }
+
+  // Transform the even and odd values as the real and imaginary parts of one complex sequence of n/2 values,
+  // then separate the two transforms and combine them
+  plan_.transform(reinterpret_cast<const Complex *>(in), 1, work, work + half);
+  out[0]    = Complex(work[0].real() + work[0].imag(), 0);
+  out[half] = Complex(work[0].real() - work[0].imag(), 0);
+  for (k=1; k<half; k++) {
+    a = work[k];
+    b = std::conj(work[half-k]);
+    even = (a + b) * (T)0.5;
+    odd  = (a - b) * (T)0.5;
+    // odd * -i is the transform of the odd values
+    out[k] = even + twiddles_[k] * Complex(odd.imag(), -odd.real());
+  }
+}
+
+/** Constructor for NDFFTPlan.
+  * \param[in] nx The number of values in each row.
+  * \param[in] ny The number of rows, 1 for 1-D data.
+  */
+template <typename T>
+NDFFTPlan<T>::NDFFTPlan(int nx, int ny)
+  : nx_(nx < 1 ? 1 : nx), ny_(ny < 1 ? 1 : ny),
+    rowPlan_(nx_), columnPlan_(ny_)
+{
+  threadWorkSize_ = rowPlan_.workSize();
+  if (ny_ > 1) threadWorkSize_ = std::max(threadWorkSize_, ny_ + columnPlan_.scratchSize());
+}
+
+template <typename T>
+NDFFTPlan<T>::~NDFFTPlan()
+{
+  for (size_t i=0; i<freeWorkspaces_.size(); i++) delete freeWorkspaces_[i];
+}
+
+/** Returns the number of values in each input row.
+  */
+template <typename T>
+int NDFFTPlan<T>::nx() const
+{
+  return nx_;
+}
+
+/** Returns the number of rows.
+  */
+template <typename T>
+int NDFFTPlan<T>::ny() const
+{
+  return ny_;
+}
+
+/** Returns the number of values in each output row, nx/2+1.
+  */
+template <typename T>
+int NDFFTPlan<T>::nOutX() const
+{
+  return nx_/2 + 1;
+}
+
+/** Returns a workspace for one execution of the plan; a workspace released by an earlier execution
+  * if there is one, or else a new one.
+  */
+template <typename T>
+NDFFTWorkspace<T> *NDFFTPlan<T>::getWorkspace() const
+{
+  NDFFTWorkspace<T> *pWorkspace = NULL;
+
+  lock_.lock();
+  if (!freeWorkspaces_.empty()) {
+    pWorkspace = freeWorkspaces_.back();
+    freeWorkspaces_.pop_back();
+  }
+  lock_.unlock();
+  if (!pWorkspace) {
+    pWorkspace = new NDFFTWorkspace<T>;
+    pWorkspace->input_.resize((size_t)nx_ * ny_);
+    pWorkspace->output_.resize((size_t)nOutX() * ny_);
+    pWorkspace->work_.resize(threadWorkSize_);
+  }
+  return pWorkspace;
+}
+
+/** Gives back a workspace obtained with getWorkspace(), which the plan keeps for the next executions.
+  * \param[in] pWorkspace The workspace.
+  */
+template <typename T>
+void NDFFTPlan<T>::releaseWorkspace(NDFFTWorkspace<T> *pWorkspace) const
+{
+  lock_.lock();
+  freeWorkspaces_.push_back(pWorkspace);
+  lock_.unlock();
+}
+
+template <typename T>
+struct NDFFTPlanArgs {
+  const NDFFTPlan<T> *pPlan;
+  const T *in;
+  std::complex<T> *out;
+  std::complex<T> *work;
+};
+
+template <typename T>
+void NDFFTPlan<T>::rowTask(void *arg, int thread, int begin, int end)
+{
+  NDFFTPlanArgs<T> *pArgs = (NDFFTPlanArgs<T> *)arg;
+  const NDFFTPlan<T> *pPlan = pArgs->pPlan;
+  Complex *work = pArgs->work + (size_t)thread * pPlan->threadWorkSize_;
+  int nOutX = pPlan->nOutX();
+
+  for (int y=begin; y<end; y++) {
+    pPlan->rowPlan_.transform(pArgs->in + (size_t)y*pPlan->nx_, pArgs->out + (size_t)y*nOutX, work);
+  }
+}
+
+template <typename T>
+void NDFFTPlan<T>::columnTask(void *arg, int thread, int begin, int end)
+{
+  NDFFTPlanArgs<T> *pArgs = (NDFFTPlanArgs<T> *)arg;
+  const NDFFTPlan<T> *pPlan = pArgs->pPlan;
+  Complex *column = pArgs->work + (size_t)thread * pPlan->threadWorkSize_;
+  int nOutX = pPlan->nOutX();
+  Complex *pOut;
+
+  for (int x=begin; x<end; x++) {
+    pOut = pArgs->out + x;
+    pPlan->columnPlan_.transform(pOut, nOutX, column, column + pPlan->ny_);
+    for (int y=0; y<pPlan->ny_; y++) pOut[(size_t)y*nOutX] = column[y];
+  }
+}
+
+/** Computes the forward transform.
+  * \param[in] in The nx*ny input values; may be the input() of pWorkspace.
+  * \param[out] out The nOutX()*ny output values, with x varying fastest; may be the output() of pWorkspace.
+  * \param[in] pWorkers The threads to share the work with; NULL to do all the work in the calling thread.
+  * \param[in] pWorkspace The workspace from getWorkspace(); NULL to use one only for this execution.
+  */
+template <typename T>
+void NDFFTPlan<T>::execute(const T *in, Complex *out, NDFFTWorkers *pWorkers, NDFFTWorkspace<T> *pWorkspace) const
+{
+  NDFFTWorkspace<T> *pOwnWorkspace = pWorkspace ? NULL : getWorkspace();
+  int numThreads = pWorkers ? pWorkers->numThreads() : 1;
+
+  if (pOwnWorkspace) pWorkspace = pOwnWorkspace;
+  // Only grows the first time the workspace is used with more threads
+  if (pWorkspace->work_.size() < (size_t)numThreads * threadWorkSize_) {
+    pWorkspace->work_.resize((size_t)numThreads * threadWorkSize_);
+  }
+  NDFFTPlanArgs<T> args = {this, in, out, &pWorkspace->work_[0]};
+
+  if (pWorkers) {
+    pWorkers->parallelFor(ny_, rowTask, &args);
+    if (ny_ > 1) pWorkers->parallelFor(nOutX(), columnTask, &args);
+  } else {
+    rowTask(&args, 0, 0, ny_);
+    if (ny_ > 1) columnTask(&args, 0, 0, nOutX());
+  }
+  if (pOwnWorkspace) releaseWorkspace(pOwnWorkspace);
+}
+
+template class NDFFTComplexPlan<float>;
+template class NDFFTComplexPlan<double>;
+template class NDFFTRealPlan<float>;
+template class NDFFTRealPlan<double>;
+template class NDFFTPlan<float>;
+template class NDFFTPlan<double>;
@@ -0,0 +1,171 @@
+/*
+ * NDFFTPlan.h
+ *
+ * Mixed-radix real-to-complex FFTs with precomputed plans
+ *
+ */
+
+#ifndef NDFFTPLAN_H
+#define NDFFTPLAN_H
+
+#include <complex>
+#include <vector>
+
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsThread.h>
+
+#include "NDPluginAPI.h"
+
+/** NDFFTWorkers class; a pool of threads that run the row and column passes of 2-D transforms.
+  * The thread calling parallelFor() does a share of the work too, so a pool of N threads starts N-1 threads.
+  * parallelFor() may be called from several threads; the calls are run one at a time.
+  * Each share is passed the index of its thread, so tasks can use work space of their own without locking.
+  */
+class NDPLUGIN_API NDFFTWorkers
+{
+  public:
+    /** Function that processes the items [begin, end) of a parallelFor() in the thread with index thread */
+    typedef void (*NDFFTTask)(void *arg, int thread, int begin, int end);
+
+    NDFFTWorkers(int numThreads);
+    ~NDFFTWorkers();
+    int numThreads();
+    void parallelFor(int count, NDFFTTask task, void *arg);
+
+  private:
+    class Worker : public epicsThreadRunable {
+      public:
+        Worker(NDFFTWorkers *pWorkers, int index);
+        ~Worker();
+        void run();
+        NDFFTWorkers *pWorkers_;
+        int index_;
+        epicsEvent startEvent_;
+        epicsThread thread_;
+    };
+    void runChunk(int index);
+
+    int numThreads_;
+    std::vector<Worker *> workers_;
+    epicsMutex lock_;              /**< Serializes calls to parallelFor() */
+    epicsEvent doneEvent_;         /**< Signalled by the last worker to finish its chunk */
+    NDFFTTask task_;
+    void *arg_;
+    int count_;
+    int remaining_;                /**< Workers that have not finished their chunk */
+    bool exiting_;
+};
+
+/** NDFFTComplexPlan class; the forward complex FFT of one size.
+  * The size is factored into radices 4, 2, 3 and 5, which have dedicated butterflies, and any other
+  * primes, so no padding is needed.  The twiddle factors for all stages are computed once by the constructor.
+  * A plan is not modified by transform(), so one plan can be used by several threads at once;
+  * each thread passes its own scratch space for the butterflies of the other primes.
+  */
+template <typename T>
+class NDPLUGIN_API NDFFTComplexPlan
+{
+  public:
+    typedef std::complex<T> Complex;
+
+    NDFFTComplexPlan(int n);
+    int size() const;
+    int scratchSize() const;
+    void transform(const Complex *in, int inStride, Complex *out, Complex *scratch) const;
+
+  private:
+    void work(Complex *out, const Complex *in, int fstride, int inStride, const int *factors, Complex *scratch) const;
+    void butterfly2(Complex *out, int fstride, int m) const;
+    void butterfly3(Complex *out, int fstride, int m) const;
+    void butterfly4(Complex *out, int fstride, int m) const;
+    void butterfly5(Complex *out, int fstride, int m) const;
+    void butterflyGeneric(Complex *out, int fstride, int m, int p, Complex *scratch) const;
+
+    int n_;
+    int scratchSize_;                  /**< Largest radix without a dedicated butterfly, 0 if there is none */
+    std::vector<int> factors_;         /**< Pairs of radix and remaining size for each stage */
+    std::vector<Complex> twiddles_;    /**< exp(-2 pi i k / n) for k < n */
+};
+
+/** NDFFTRealPlan class; the forward FFT of real data of one size, returning the n/2+1 non-redundant
+  * complex values.  Even sizes are computed with a complex FFT of half the size.
+  */
+template <typename T>
+class NDPLUGIN_API NDFFTRealPlan
+{
+  public:
+    typedef std::complex<T> Complex;
+
+    NDFFTRealPlan(int n);
+    int size() const;
+    int workSize() const;
+    void transform(const T *in, Complex *out, Complex *work) const;
+
+  private:
+    int n_;
+    NDFFTComplexPlan<T> plan_;         /**< Plan of size n/2 for even n, n for odd n */
+    std::vector<Complex> twiddles_;    /**< exp(-2 pi i k / n) for k < n/2, for even n */
+};
+
+template <typename T> class NDFFTPlan;
+
+/** NDFFTWorkspace class; the buffers used by one execution of an NDFFTPlan at a time.
+  * Workspaces are obtained from the plan with getWorkspace() and given back with releaseWorkspace(),
+  * and the plan keeps them for the next executions, so executing a plan does not allocate memory.
+  */
+template <typename T>
+class NDPLUGIN_API NDFFTWorkspace
+{
+  public:
+    typedef std::complex<T> Complex;
+
+    /** Returns a buffer of nx*ny values that callers can fill with the input, for example to convert or window it */
+    T *input() { return &input_[0]; }
+    /** Returns a buffer of nOutX*ny values that callers can use for the output */
+    Complex *output() { return &output_[0]; }
+
+  private:
+    friend class NDFFTPlan<T>;
+    std::vector<T> input_;
+    std::vector<Complex> output_;
+    std::vector<Complex> work_;        /**< Work space of the row and column passes for each thread */
+};
+
+/** NDFFTPlan class; the forward FFT of a real 1-D or 2-D array of nx by ny values, with x varying fastest.
+  * Each row is transformed with a real plan, then each of the nx/2+1 columns of the result with a complex plan.
+  * The rows and then the columns are shared between the threads of an NDFFTWorkers pool.
+  * The plan keeps the workspaces of finished executions, so several threads can execute it at once,
+  * each with a workspace of its own.
+  */
+template <typename T>
+class NDPLUGIN_API NDFFTPlan
+{
+  public:
+    typedef std::complex<T> Complex;
+
+    NDFFTPlan(int nx, int ny);
+    ~NDFFTPlan();
+    int nx() const;
+    int ny() const;
+    int nOutX() const;
+    NDFFTWorkspace<T> *getWorkspace() const;
+    void releaseWorkspace(NDFFTWorkspace<T> *pWorkspace) const;
+    void execute(const T *in, Complex *out, NDFFTWorkers *pWorkers, NDFFTWorkspace<T> *pWorkspace=NULL) const;
+
+  private:
+    NDFFTPlan(const NDFFTPlan&);
+    NDFFTPlan& operator=(const NDFFTPlan&);
+    static void rowTask(void *arg, int thread, int begin, int end);
+    static void columnTask(void *arg, int thread, int begin, int end);
+
+    int nx_;
+    int ny_;
+    NDFFTRealPlan<T> rowPlan_;
+    NDFFTComplexPlan<T> columnPlan_;
+    int threadWorkSize_;               /**< Work space of the row and column passes for one thread */
+    mutable epicsMutex lock_;          /**< Protects freeWorkspaces_ */
+    mutable std::vector<NDFFTWorkspace<T> *> freeWorkspaces_;
+};
+
+#endif
@@ -41,6 +41,9 @@ enum HDF5Compression_t {HDF5CompressNone=0,
                         HDF5CompressBshuf,
                         HDF5CompressLZ4,
                         HDF5CompressJPEG};
+
+enum HDF5AccessPattern_t {HDF5AccessFrames=0,
+                          HDF5AccessTimeSeries};
 /* Filter ID officially assigned to blosc */
 #define FILTER_BLOSC 32001
 /* Filter ID officially assigned to bitshuffle */
@@ -53,6 +56,13 @@ enum HDF5Compression_t {HDF5CompressNone=0,
 #define DIMSREPORTSIZE 512
 #define DIMNAMESIZE 40
 #define ALIGNMENT_BOUNDARY 1048576
+#define DIRECT_IO_BLOCK_SIZE 4096    /* Default device block size for the direct virtual file driver */
+#define DIRECT_IO_MIN_BUFFER 1048576 /* Minimum size of the direct driver copy buffer */
+#define CHUNK_ADVISOR_TARGET_BYTES 1048576 /* Chunk size aimed for by the chunk advisor */
+#define CHUNK_ADVISOR_MAX_BYTES 4194304    /* Frames larger than this are split into several chunks */
+#define CHUNK_ADVISOR_SERIES_FRAMES 64     /* Frames per chunk for the time series access pattern */
+#define CHUNK_ADVISOR_MIN_SLOTS 521        /* The HDF5 default number of chunk cache slots */
+#define STRIPE_IDS_DATASET "/stripe/uniqueId" /* uniqueIds of the arrays in a stripe file */
 #define INFINITE_FRAMES_CAPTURE 10000 /* Used to calculate istorek (the size of the chunk index binar search tree) when capturing infinite number of frames */
 
 #ifdef HDF5_BTREE_IK_MAX_ENTRIES
@@ -159,6 +169,15 @@ static void flushTaskC(void *drvPvt)
     pPlugin->flushTask();
 }
 
+/** The task to run the write-behind thread
+ * \param[in] drvPvt Pointer to the NDFileHDF5 object
+ */
+static void writeTaskC(void *drvPvt)
+{
+    NDFileHDF5 *pPlugin = (NDFileHDF5 *)drvPvt;
+    pPlugin->writeTask();
+}
+
 /** Opens a HDF5 file.
  * In write mode if NDFileModeMultiple is set then the first dataspace dimension is set to H5S_UNLIMITED to allow
  * multiple arrays to be written to the same file.
@@ -175,17 +194,38 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
   int storeAttributes, storePerformance;
   static const char *functionName = "openFile";
   int numCapture;
+  int stripeCount, stripeIndex, stripeVDS, extraDims, posRunning;
+  std::string outputFileName(fileName);
   asynStatus status = asynSuccess;
 
   asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "%s::%s Filename: %s\n", driverName, functionName, fileName);
 
+  // Arrays queued for a previous file must be written before anything is reset
+  this->waitForWrites();
+  writeQueueLock.lock();
+  this->writeStatus = asynSuccess;
+  this->writeLatencyMax = 0.0;
+  writeQueueLock.unlock();
+
   /* These operations are accessing parameter library, must take lock */
   this->lock();
   // Reset flush counter
   setIntegerParam(NDFileHDF5_SWMRCbCounter, 0);
+  // Reset the write-behind statistics
+  setIntegerParam(NDFileHDF5_writeQueueStalls, 0);
+  setDoubleParam(NDFileHDF5_writeLatency, 0.0);
+  setDoubleParam(NDFileHDF5_writeLatencyMax, 0.0);
+  // Reset the chunk cache statistics
+  setDoubleParam(NDFileHDF5_chunkCacheHitObserved, 100.0);
+  setIntegerParam(NDFileHDF5_partialChunkFlushes, 0);
   getIntegerParam(NDFileNumCapture, &numCapture);
   getIntegerParam(NDFileHDF5_storeAttributes, &storeAttributes);
   getIntegerParam(NDFileHDF5_storePerformance, &storePerformance);
+  getIntegerParam(NDFileHDF5_stripeCount, &stripeCount);
+  getIntegerParam(NDFileHDF5_stripeIndex, &stripeIndex);
+  getIntegerParam(NDFileHDF5_stripeVDS, &stripeVDS);
+  getIntegerParam(NDFileHDF5_nExtraDims, &extraDims);
+  getIntegerParam(NDFileHDF5_posRunning, &posRunning);
 
   // We don't support reading yet
   if (openMode & NDFileModeRead) {
@@ -209,6 +249,24 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
     status = asynError;
   }
 
+  // Striping interleaves frames along the first dimension of the detector dataset only
+  if (stripeCount > 1) {
+    if (!(openMode & NDFileModeMultiple) || extraDims > 0 || posRunning == 1) {
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s Striping requires Capture or Stream mode without extra dimensions or positional placement\n",
+                driverName, functionName);
+      status = asynError;
+    } else if (stripeIndex >= stripeCount) {
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s Invalid stripe index %d for %d stripes\n",
+                driverName, functionName, stripeIndex, stripeCount);
+      status = asynError;
+    } else {
+      outputFileName = this->stripeFileName(fileName, stripeIndex);
+    }
+  }
+  setStringParam(NDFileHDF5_stripeFileName, outputFileName.c_str());
+
   // Verify the XML path and filename. Must be called with lock held.
   if (this->verifyLayoutXMLFile()){
     status = asynError;
@@ -216,6 +274,11 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
   this->unlock();
   if (status != asynSuccess) return status;
 
+  this->stripeCount = stripeCount;
+  this->stripeIndex = stripeIndex;
+  this->stripeIds.clear();
+  this->stripeMasterFile = "";
+
 
   // Check to see if a file is already open and close it
   this->checkForOpenFile();
@@ -243,7 +306,7 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
   this->pFileAttributes->clear();
 
   // Insert default NDAttribute from the NDArray object (timestamps etc)
-  this->addDefaultAttributes(pArray);
+  this->addDefaultAttributes(pArray, this->pFileAttributes);
 
   // Now get the current values of the attributes for this plugin
   this->getAttributes(this->pFileAttributes);
@@ -267,7 +330,7 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
   }
 
   // Create the new file
-  if (this->createNewFile(fileName)){
+  if (this->createNewFile(outputFileName.c_str())){
     asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
               "%s::%s ERROR Failed to create a new output file\n",
               driverName, functionName);
@@ -319,6 +382,12 @@ asynStatus NDFileHDF5::openFile(const char *fileName, NDFileOpenMode_t openMode,
   hdf5::Root *root = this->layout.get_hdftree();
   this->createHardLinks(root);
 
+  // The master file of a striped acquisition is built from the uniqueIds recorded in all the
+  // stripe files.  Only stripe 0 creates it, waiting for the other stripes when it closes its file.
+  if (this->stripeCount > 1 && this->stripeIndex == 0 && stripeVDS == 1){
+    this->stripeMasterFile = fileName;
+  }
+
   // Check if we are in SWMR mode
   if (checkForSWMRMode()){
     // Call the method to place the file into SWMR
@@ -401,6 +470,66 @@ void NDFileHDF5::flushTask()
     }
 }
 
+/** Write-behind thread.
+ * Waits for NDArrays to be queued by writeFile and writes them to the open file in the order
+ * they were queued.  Each array is released once it has been written, and the queue use and
+ * the latency from queueing to the end of the write are posted.
+ */
+void NDFileHDF5::writeTask()
+{
+    const char* functionName = "writeTask";
+    NDFileHDF5WriteRequest_t request;
+    asynStatus status;
+    epicsTimeStamp now;
+    double latency, latencyMax;
+    int queueUse;
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "%s::%s Started writeTask thread\n", driverName, functionName);
+    while (1){
+        // Wait for an array to be queued
+        epicsEventWait(this->writeEventId);
+        while (1){
+            writeQueueLock.lock();
+            if (this->writeQueue.empty()){
+                this->writeBusy = false;
+                writeQueueLock.unlock();
+                epicsEventSignal(this->writeIdleEventId);
+                break;
+            }
+            request = this->writeQueue.front();
+            this->writeQueue.pop_front();
+            this->writeBusy = true;
+            queueUse = (int)this->writeQueue.size();
+            writeQueueLock.unlock();
+            // There is now room in the queue
+            epicsEventSignal(this->writeSpaceEventId);
+
+            status = this->writeArray(request.pArray, request.pAttributes, request.numCaptured);
+            epicsTimeGetCurrent(&now);
+            latency = epicsTimeDiffInSeconds(&now, &request.queued) * 1000.0;
+            if (status != asynSuccess){
+                asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                          "%s::%s ERROR: could not write queued array %d\n",
+                          driverName, functionName, request.pArray->uniqueId);
+            }
+            request.pArray->release();
+
+            writeQueueLock.lock();
+            if (request.pAttributes) this->freeAttributeLists.push_back(request.pAttributes);
+            if (status != asynSuccess && this->writeStatus == asynSuccess) this->writeStatus = status;
+            if (latency > this->writeLatencyMax) this->writeLatencyMax = latency;
+            latencyMax = this->writeLatencyMax;
+            writeQueueLock.unlock();
+
+            this->lock();
+            setIntegerParam(NDFileHDF5_writeQueueUse, queueUse);
+            setDoubleParam(NDFileHDF5_writeLatency, latency);
+            setDoubleParam(NDFileHDF5_writeLatencyMax, latencyMax);
+            callParamCallbacks();
+            this->unlock();
+        }
+    }
+}
+
 asynStatus NDFileHDF5::startSWMR()
 {
   const char* functionName = "startSWMR";
@@ -1336,6 +1465,14 @@ hid_t NDFileHDF5::createDatasetDetector(hid_t group, hdf5::Dataset *dset)
             (int)nbytes, (int)nslots);
   H5Pset_chunk_cache( dset_access_plist, (size_t)nslots, (size_t)nbytes, 1.0);
 
+  // The expected hit rate assumes frames appended in order, as without positional placement
+  double hitRate = NDFileHDF5ChunkTracker::expectedHitRate(this->rank, this->frameRank, this->chunkdims,
+                                                           this->maxdims, this->bytesPerElement, (size_t)nbytes);
+  this->lock();
+  setIntegerParam(NDFileHDF5_chunkCacheSize, (int)nbytes);
+  setDoubleParam(NDFileHDF5_chunkCacheHitExpected, 100.0 * hitRate);
+  this->unlock();
+
   /*
    * Create a new dataset within the file using cparms
    * creation properties.
@@ -1356,12 +1493,195 @@ hid_t NDFileHDF5::createDatasetDetector(hid_t group, hdf5::Dataset *dset)
   return dataset;
 }
 
+/** Callback function that is called by the NDArray driver with new NDArray data.
+  * When striping, the arrays owned by the other writers are dropped here, before they are
+  * queued, counted or buffered for capture, so each writer only handles its own share.
+  * \param[in] pasynUser  The pasynUser from the callback.
+  * \param[in] genericPointer The NDArray from the callback.
+  */
+void NDFileHDF5::driverCallback(asynUser *pasynUser, void *genericPointer)
+{
+  NDArray *pArray = (NDArray *)genericPointer;
+  int stripeCount, stripeIndex;
+
+  this->lock();
+  getIntegerParam(NDFileHDF5_stripeCount, &stripeCount);
+  getIntegerParam(NDFileHDF5_stripeIndex, &stripeIndex);
+  this->unlock();
+  if (stripeCount > 1 && !this->stripeOwns(pArray->uniqueId, stripeCount, stripeIndex)) return;
+
+  NDPluginFile::driverCallback(pasynUser, genericPointer);
+}
+
 /** Writes NDArray data to a HDF5 file.
+  * When striping is enabled only arrays with uniqueId % HDF5_stripeCount == HDF5_stripeIndex are written.
+  * If write-behind is enabled the array is queued for the write thread and this method returns
+  * as soon as there is room in the queue; an error from an earlier queued write is returned here.
   * \param[in] pArray Pointer to an NDArray to write to the file. This function can be called multiple
   *            times between the call to openFile and closeFile if NDFileModeMultiple was set in
   *            openMode in the call to NDFileHDF5::openFile.
   */
 asynStatus NDFileHDF5::writeFile(NDArray *pArray)
+{
+  int writeBehind = 0;
+  epicsInt32 numCaptured;
+
+  // Arrays owned by the other writers are normally dropped in driverCallback, but
+  // processCallbacks can also be called directly
+  if (this->stripeCount > 1 && !this->stripeOwns(pArray->uniqueId, this->stripeCount, this->stripeIndex)){
+    return asynSuccess;
+  }
+
+  this->lock();
+  getIntegerParam(NDFileHDF5_writeBehind, &writeBehind);
+  getIntegerParam(NDFileNumCaptured, &numCaptured);
+  this->unlock();
+
+  if (writeBehind == 1){
+    return this->queueArray(pArray, numCaptured);
+  }
+  return this->writeArray(pArray, NULL, numCaptured);
+}
+
+/** Queue an NDArray for the write-behind thread.
+  * The array is reserved and its attribute values are captured now so that the file contents are
+  * the same as for a synchronous write.  If the queue is full this method blocks until the write
+  * thread has taken an array, and the stall is counted in NDFileHDF5_writeQueueStalls.
+  * \param[in] pArray Pointer to the NDArray to write.
+  * \param[in] numCaptured The number of arrays captured including this one.
+  */
+asynStatus NDFileHDF5::queueArray(NDArray *pArray, epicsInt32 numCaptured)
+{
+  NDFileHDF5WriteRequest_t request;
+  int storeAttributes, queueSize, stalls;
+  bool stalled = false;
+  asynStatus status = asynSuccess;
+  static const char *functionName = "queueArray";
+
+  this->lock();
+  getIntegerParam(NDFileHDF5_storeAttributes, &storeAttributes);
+  getIntegerParam(NDFileHDF5_writeQueueSize, &queueSize);
+  this->unlock();
+
+  request.pArray = pArray;
+  request.pAttributes = NULL;
+  request.numCaptured = numCaptured;
+
+  if (storeAttributes == 1){
+    writeQueueLock.lock();
+    if (!this->freeAttributeLists.empty()){
+      request.pAttributes = this->freeAttributeLists.front();
+      this->freeAttributeLists.pop_front();
+    }
+    writeQueueLock.unlock();
+    if (request.pAttributes == NULL){
+      request.pAttributes = new NDAttributeList;
+    }
+    request.pAttributes->clear();
+    status = this->snapshotAttributes(pArray, request.pAttributes);
+    if (status != asynSuccess){
+      writeQueueLock.lock();
+      this->freeAttributeLists.push_back(request.pAttributes);
+      writeQueueLock.unlock();
+      return status;
+    }
+  }
+
+  // The array must stay valid until the write thread has written it
+  pArray->reserve();
+  epicsTimeGetCurrent(&request.queued);
+
+  writeQueueLock.lock();
+  while ((int)this->writeQueue.size() >= queueSize){
+    stalled = true;
+    writeQueueLock.unlock();
+    epicsEventWait(this->writeSpaceEventId);
+    writeQueueLock.lock();
+  }
+  this->writeQueue.push_back(request);
+  // Report any error from the previous writes back to NDPluginFile
+  status = this->writeStatus;
+  writeQueueLock.unlock();
+  epicsEventSignal(this->writeEventId);
+
+  if (stalled){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+              "%s::%s write queue was full, waited for the write thread\n",
+              driverName, functionName);
+    this->lock();
+    getIntegerParam(NDFileHDF5_writeQueueStalls, &stalls);
+    setIntegerParam(NDFileHDF5_writeQueueStalls, stalls+1);
+    callParamCallbacks();
+    this->unlock();
+  }
+
+  return status;
+}
+
+/** Wait until the write-behind thread has written every queued NDArray.
+  * Must not be called with the asynPortDriver lock held.
+  */
+void NDFileHDF5::waitForWrites()
+{
+  writeQueueLock.lock();
+  while (!this->writeQueue.empty() || this->writeBusy){
+    writeQueueLock.unlock();
+    epicsEventWait(this->writeIdleEventId);
+    writeQueueLock.lock();
+  }
+  writeQueueLock.unlock();
+  // Pass the wakeup on in case another thread is also waiting for the queue to drain
+  epicsEventSignal(this->writeIdleEventId);
+}
+
+/** Capture the attribute values that are written with an NDArray.
+  * The list receives the default NDArray attributes, the current values of the plugin
+  * attributes and a copy of the attributes attached to the NDArray.
+  * \param[in] pArray Pointer to the NDArray being written.
+  * \param[out] pList The attribute list to fill.
+  */
+asynStatus NDFileHDF5::snapshotAttributes(NDArray *pArray, NDAttributeList *pList)
+{
+  asynStatus status = asynSuccess;
+  static const char *functionName = "snapshotAttributes";
+
+  // Get the current values of the attributes for this plugin
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+            "%s::%s getting attribute list\n",
+            driverName, functionName);
+  status = (asynStatus)this->getAttributes(pList);
+  if (status != asynSuccess){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: could not update the attribute list\n",
+              driverName, functionName);
+    return asynError;
+  }
+
+  // Insert default NDAttribute from the NDArray object (timestamps etc)
+  this->addDefaultAttributes(pArray, pList);
+
+  // Now append the attributes from the array which are already up to date from
+  // the driver and prior plugins
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+            "%s::%s copying attribute list\n",
+            driverName, functionName);
+  status = (asynStatus)pArray->pAttributeList->copy(pList);
+  if (status != asynSuccess){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: could not append attributes to NDArray from driver\n",
+              driverName, functionName);
+    return asynError;
+  }
+  return asynSuccess;
+}
+
+/** Write an NDArray and its attributes to the open HDF5 file.
+  * \param[in] pArray Pointer to the NDArray to write.
+  * \param[in] pAttributes Attribute values captured when the array was queued, or NULL to
+  *            capture them now.
+  * \param[in] numCaptured The number of arrays captured including this one.
+  */
+asynStatus NDFileHDF5::writeArray(NDArray *pArray, NDAttributeList *pAttributes, epicsInt32 numCaptured)
 {
   herr_t hdfstatus = 0;
   asynStatus status = asynSuccess;
@@ -1370,11 +1690,10 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   int posRunning = 0;
   char posName[MAXEXTRADIMS][MAX_STRING_SIZE];
   epicsTimeStamp startts, endts;
-  epicsInt32 numCaptured;
   double dt=0.0, period=0.0, runtime = 0.0;
   int extradims = 0;
   hsize_t offsets[MAXEXTRADIMS] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  static const char *functionName = "writeFile";
+  static const char *functionName = "writeArray";
 
   // Take the flushing lock here, we do not let a manual flush occur
   // from a different thread during execution of this method.
@@ -1390,7 +1709,6 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
 
   this->lock();
   getIntegerParam(NDFileHDF5_dimAttDatasets, &dimAttDataset);
-  getIntegerParam(NDFileNumCaptured, &numCaptured);
   getIntegerParam(NDFileHDF5_storeAttributes, &storeAttributes);
   getIntegerParam(NDFileHDF5_storePerformance, &storePerformance);
   getIntegerParam(NDFileHDF5_flushNthFrame, &flush);
@@ -1413,32 +1731,13 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
   if (storeAttributes == 1){
     // Update attribute list. We use a separate attribute list
     // from the one in pArray to avoid the need to copy the array.
-    // Get the current values of the attributes for this plugin
-    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
-              "%s::%s getting attribute list\n",
-              driverName, functionName);
-    status = (asynStatus)this->getAttributes(this->pFileAttributes);
-    if (status != asynSuccess){
-      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
-                "%s::%s ERROR: could not update the attribute list\n",
-                driverName, functionName);
-      flushLock.unlock();
-      return asynError;
+    if (pAttributes){
+      // The values were captured when the array was queued
+      status = (asynStatus)pAttributes->copy(this->pFileAttributes);
+    } else {
+      status = this->snapshotAttributes(pArray, this->pFileAttributes);
     }
-
-    // Insert default NDAttribute from the NDArray object (timestamps etc)
-    this->addDefaultAttributes(pArray);
-
-    // Now append the attributes from the array which are already up to date from
-    // the driver and prior plugins
-    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
-              "%s::%s copying attribute list\n",
-              driverName, functionName);
-    status = (asynStatus)pArray->pAttributeList->copy(this->pFileAttributes);
     if (status != asynSuccess){
-      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
-                "%s::%s ERROR: could not append attributes to NDArray from driver\n",
-                driverName, functionName);
       flushLock.unlock();
       return asynError;
     }
@@ -1619,6 +1918,14 @@ asynStatus NDFileHDF5::writeFile(NDArray *pArray)
               "%s::%s wrote frame. dt=%.5fs (T=%.5fs)\n",
               driverName, functionName, dt, period);
 
+    // Report how the chunk cache served the writes to this dataset
+    NDFileHDF5ChunkTracker *tracker = this->detDataMap[destination]->getChunkTracker();
+    this->lock();
+    setDoubleParam(NDFileHDF5_chunkCacheHitObserved, 100.0 * tracker->getHitRate());
+    setIntegerParam(NDFileHDF5_partialChunkFlushes, (int)tracker->getPartialFlushes());
+    this->unlock();
+
+    if (this->stripeCount > 1) this->stripeIds.push_back(pArray->uniqueId);
     this->nextRecord++;
   }
 
@@ -1646,6 +1953,9 @@ asynStatus NDFileHDF5::closeFile()
   epicsInt32 numCaptured;
   static const char *functionName = "closeFile";
 
+  // Everything queued for this file must be written before it is closed
+  this->waitForWrites();
+
   if (this->file == 0){
     asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
               "%s::%s file was not open! Ignoring close command.\n",
@@ -1653,6 +1963,9 @@ asynStatus NDFileHDF5::closeFile()
     return asynSuccess;
   }
 
+  // Record which arrays this stripe holds, which also marks the stripe file as complete
+  if (this->stripeCount > 1) this->writeStripeIds();
+
   this->lock();
   getIntegerParam(NDFileHDF5_storeAttributes, &storeAttributes);
   getIntegerParam(NDFileHDF5_storePerformance, &storePerformance);
@@ -1727,6 +2040,14 @@ asynStatus NDFileHDF5::closeFile()
   H5Fclose(this->file);
   this->file = 0;
 
+  // A failure is reported but does not affect the stripe file itself
+  if (!this->stripeMasterFile.empty()){
+    double timeout;
+    getDoubleParam(NDFileHDF5_stripeVDSTimeout, &timeout);
+    this->createStripeMaster(this->stripeMasterFile.c_str(), timeout);
+    this->stripeMasterFile = "";
+  }
+
   // At this point we can clear the SWMR active flag, whether we were running
   // in SWMR mode or not
   setIntegerParam(NDFileHDF5_SWMRRunning, 0);
@@ -1856,6 +2177,41 @@ asynStatus NDFileHDF5::writeInt32(asynUser *pasynUser, epicsInt32 value)
     }
   }
 
+  else if (function == NDFileHDF5_NDAttributeFlush){
+    // The column buffers are sized when the file is opened
+    if (this->file != 0 || value < 0) {
+      status = asynError;
+      setIntegerParam(function, oldvalue);
+    }
+  }
+  else if (function == NDFileHDF5_directIO){
+    int directIOSupported = 0;
+    getIntegerParam(NDFileHDF5_directIOSupported, &directIOSupported);
+    // The file driver is selected when the file is created, and only if HDF5 was built with it
+    if (this->file != 0 || (value != 0 && directIOSupported == 0)) {
+      status = asynError;
+      setIntegerParam(function, oldvalue);
+    }
+  }
+  else if (function == NDFileHDF5_stripeCount ||
+           function == NDFileHDF5_stripeIndex){
+    // The frames owned by this writer are fixed for the lifetime of a file
+    if (this->file != 0 || value < 0 || (function == NDFileHDF5_stripeCount && value < 1)) {
+      status = asynError;
+      setIntegerParam(function, oldvalue);
+    }
+  }
+  else if (function == NDFileHDF5_writeBehind ||
+           function == NDFileHDF5_writeQueueSize){
+    // Arrays already queued for the open file must not change path
+    if (this->file != 0) {
+      status = asynError;
+      setIntegerParam(function, oldvalue);
+    } else if (function == NDFileHDF5_writeQueueSize && value < 1) {
+      status = asynError;
+      setIntegerParam(function, oldvalue);
+    }
+  }
   else if (function == NDFileHDF5_flushNthFrame){
     // You cannot set the flush parameter to less than nFramesChunks
     getIntegerParam(NDFileHDF5_nFramesChunks, &tmp);
@@ -2278,6 +2634,7 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   this->createParam(str_NDFileHDF5_chunkBoundaryAlign, asynParamInt32,&NDFileHDF5_chunkBoundaryAlign);
   this->createParam(str_NDFileHDF5_chunkBoundaryThreshold, asynParamInt32,&NDFileHDF5_chunkBoundaryThreshold);
   this->createParam(str_NDFileHDF5_NDAttributeChunk,asynParamInt32,   &NDFileHDF5_NDAttributeChunk);
+  this->createParam(str_NDFileHDF5_NDAttributeFlush,asynParamInt32,   &NDFileHDF5_NDAttributeFlush);
   this->createParam(str_NDFileHDF5_nExtraDims,      asynParamInt32,   &NDFileHDF5_nExtraDims);
   this->createParam(str_NDFileHDF5_extraDimOffsetX, asynParamInt32,   &NDFileHDF5_extraDimOffsetX);
   this->createParam(str_NDFileHDF5_extraDimOffsetY, asynParamInt32,   &NDFileHDF5_extraDimOffsetY);
@@ -2315,6 +2672,25 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   this->createParam(str_NDFileHDF5_SWMRSupported,   asynParamInt32,   &NDFileHDF5_SWMRSupported);
   this->createParam(str_NDFileHDF5_SWMRMode,        asynParamInt32,   &NDFileHDF5_SWMRMode);
   this->createParam(str_NDFileHDF5_SWMRRunning,     asynParamInt32,   &NDFileHDF5_SWMRRunning);
+  this->createParam(str_NDFileHDF5_writeBehind,     asynParamInt32,   &NDFileHDF5_writeBehind);
+  this->createParam(str_NDFileHDF5_writeQueueSize,  asynParamInt32,   &NDFileHDF5_writeQueueSize);
+  this->createParam(str_NDFileHDF5_writeQueueUse,   asynParamInt32,   &NDFileHDF5_writeQueueUse);
+  this->createParam(str_NDFileHDF5_writeQueueStalls,asynParamInt32,   &NDFileHDF5_writeQueueStalls);
+  this->createParam(str_NDFileHDF5_writeLatency,    asynParamFloat64, &NDFileHDF5_writeLatency);
+  this->createParam(str_NDFileHDF5_writeLatencyMax, asynParamFloat64, &NDFileHDF5_writeLatencyMax);
+  this->createParam(str_NDFileHDF5_directIO,        asynParamInt32,   &NDFileHDF5_directIO);
+  this->createParam(str_NDFileHDF5_directIOSupported, asynParamInt32, &NDFileHDF5_directIOSupported);
+  this->createParam(str_NDFileHDF5_stripeCount,     asynParamInt32,   &NDFileHDF5_stripeCount);
+  this->createParam(str_NDFileHDF5_stripeIndex,     asynParamInt32,   &NDFileHDF5_stripeIndex);
+  this->createParam(str_NDFileHDF5_stripeVDS,       asynParamInt32,   &NDFileHDF5_stripeVDS);
+  this->createParam(str_NDFileHDF5_stripeVDSTimeout, asynParamFloat64, &NDFileHDF5_stripeVDSTimeout);
+  this->createParam(str_NDFileHDF5_stripeFileName,  asynParamOctet,   &NDFileHDF5_stripeFileName);
+  this->createParam(str_NDFileHDF5_chunkAdvisor,    asynParamInt32,   &NDFileHDF5_chunkAdvisor);
+  this->createParam(str_NDFileHDF5_accessPattern,   asynParamInt32,   &NDFileHDF5_accessPattern);
+  this->createParam(str_NDFileHDF5_chunkCacheSize,  asynParamInt32,   &NDFileHDF5_chunkCacheSize);
+  this->createParam(str_NDFileHDF5_chunkCacheHitExpected, asynParamFloat64, &NDFileHDF5_chunkCacheHitExpected);
+  this->createParam(str_NDFileHDF5_chunkCacheHitObserved, asynParamFloat64, &NDFileHDF5_chunkCacheHitObserved);
+  this->createParam(str_NDFileHDF5_partialChunkFlushes,   asynParamInt32,   &NDFileHDF5_partialChunkFlushes);
 
   setIntegerParam(NDFileHDF5_chunkSizeAuto, 1);
   for (int chunkIndex = 0; chunkIndex < MAX_CHUNK_DIMS; chunkIndex++){
@@ -2322,6 +2698,7 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   }
   setIntegerParam(NDFileHDF5_nFramesChunks,   0);
   setIntegerParam(NDFileHDF5_NDAttributeChunk,0);
+  setIntegerParam(NDFileHDF5_NDAttributeFlush,1);
   setIntegerParam(NDFileHDF5_chunkBoundaryAlign, 0);
   setIntegerParam(NDFileHDF5_chunkBoundaryThreshold, 65536);
   setIntegerParam(NDFileHDF5_nExtraDims,      0);
@@ -2359,11 +2736,34 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   setIntegerParam(NDFileHDF5_SWMRCbCounter,   0);
   setIntegerParam(NDFileHDF5_SWMRMode,        0);
   setIntegerParam(NDFileHDF5_SWMRRunning,     0);
+  setIntegerParam(NDFileHDF5_writeBehind,     0);
+  setIntegerParam(NDFileHDF5_writeQueueSize,  16);
+  setIntegerParam(NDFileHDF5_writeQueueUse,   0);
+  setIntegerParam(NDFileHDF5_writeQueueStalls,0);
+  setDoubleParam (NDFileHDF5_writeLatency,    0.0);
+  setDoubleParam (NDFileHDF5_writeLatencyMax, 0.0);
   if (checkForSWMRSupported()){
     setIntegerParam(NDFileHDF5_SWMRSupported, 1);
   } else {
     setIntegerParam(NDFileHDF5_SWMRSupported, 0);
   }
+  setIntegerParam(NDFileHDF5_directIO,        0);
+  if (checkForDirectIOSupported()){
+    setIntegerParam(NDFileHDF5_directIOSupported, 1);
+  } else {
+    setIntegerParam(NDFileHDF5_directIOSupported, 0);
+  }
+  setIntegerParam(NDFileHDF5_stripeCount,     1);
+  setIntegerParam(NDFileHDF5_stripeIndex,     0);
+  setIntegerParam(NDFileHDF5_stripeVDS,       1);
+  setDoubleParam (NDFileHDF5_stripeVDSTimeout, 10.0);
+  setStringParam (NDFileHDF5_stripeFileName,  "");
+  setIntegerParam(NDFileHDF5_chunkAdvisor,    0);
+  setIntegerParam(NDFileHDF5_accessPattern,   HDF5AccessFrames);
+  setIntegerParam(NDFileHDF5_chunkCacheSize,  0);
+  setDoubleParam (NDFileHDF5_chunkCacheHitExpected, 100.0);
+  setDoubleParam (NDFileHDF5_chunkCacheHitObserved, 100.0);
+  setIntegerParam(NDFileHDF5_partialChunkFlushes,   0);
 
   /* Give the virtual dimensions some human readable names */
   this->extraDimNameN = (char*)calloc(DIMNAMESIZE, sizeof(char));
@@ -2407,6 +2807,14 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
   this->performanceBuf       = NULL;
   this->performancePtr       = NULL;
   this->numPerformancePoints = 0;
+  this->writeBusy            = false;
+  this->writeStatus          = asynSuccess;
+  this->writeLatencyMax      = 0.0;
+  this->stripeCount          = 1;
+  this->stripeIndex          = 0;
+  this->frameRank            = 0;
+  this->advisedCacheBytes    = 0;
+  this->advisedCacheSlots    = 0;
 
   this->hostname = (char*)calloc(MAXHOSTNAMELEN, sizeof(char));
   gethostname(this->hostname, MAXHOSTNAMELEN);
@@ -2427,6 +2835,25 @@ NDFileHDF5::NDFileHDF5(const char *portName, int queueSize, int blockingCallback
       printf("%s:%s epicsThreadCreate failure for flushing task\n", driverName, functionName);
       return;
   }
+
+  this->writeEventId = epicsEventCreate(epicsEventEmpty);
+  this->writeSpaceEventId = epicsEventCreate(epicsEventEmpty);
+  this->writeIdleEventId = epicsEventCreate(epicsEventEmpty);
+  if (!this->writeEventId || !this->writeSpaceEventId || !this->writeIdleEventId){
+      printf("%s:%s epicsEventCreate failure for write events\n", driverName, functionName);
+      return;
+  }
+
+  // Create the thread that writes queued arrays when write-behind is enabled
+  status = (epicsThreadCreate("HDF5WriteTask",
+                              epicsThreadPriorityMedium,
+                              epicsThreadGetStackSize(epicsThreadStackBig),
+                              (EPICSTHREADFUNC)writeTaskC,
+                              this) == NULL);
+  if (status){
+      printf("%s:%s epicsThreadCreate failure for write task\n", driverName, functionName);
+      return;
+  }
 }
 
 /** Calculate the total number of frames that the current configured dimensions can contain.
@@ -2502,9 +2929,12 @@ hsize_t NDFileHDF5::calcChunkCacheBytes()
 {
   hsize_t nbytes = 0;
   epicsInt32 n_frames_chunk=0;
+  int chunkAdvisor = 0;
   this->lock();
   getIntegerParam(NDFileHDF5_nFramesChunks, &n_frames_chunk);
+  getIntegerParam(NDFileHDF5_chunkAdvisor, &chunkAdvisor);
   this->unlock();
+  if (chunkAdvisor == 1) return this->advisedCacheBytes;
   nbytes = this->maxdims[this->rank - 1]  * this->bytesPerElement * n_frames_chunk;
   if ((this->multiFrameFile && this->rank >= 3) ||
       (!this->multiFrameFile && this->rank >= 2)) {
@@ -2535,12 +2965,15 @@ hsize_t NDFileHDF5::calcChunkCacheSlots()
   unsigned int long num_chunks = 1;
   double div_result = 0.0;
   epicsInt32 n_frames_chunk=0, n_extra_dims=0, n_frames_capture=0;
+  int chunkAdvisor = 0;
 
   this->lock();
   getIntegerParam(NDFileHDF5_nFramesChunks, &n_frames_chunk);
   getIntegerParam(NDFileHDF5_nExtraDims, &n_extra_dims);
   getIntegerParam(NDFileNumCapture, &n_frames_capture);
+  getIntegerParam(NDFileHDF5_chunkAdvisor, &chunkAdvisor);
   this->unlock();
+  if (chunkAdvisor == 1) return this->advisedCacheSlots;
 
   div_result = (double)this->maxdims[this->rank - 1] / (double)this->chunkdims[this->rank -1];
   num_chunks *= (unsigned int long)ceil(div_result);
@@ -2562,6 +2995,105 @@ hsize_t NDFileHDF5::calcChunkCacheSlots()
   return nslots;
 }
 
+/** Choose the chunk dimensions and chunk cache from the frame geometry, compression and access pattern.
+ * Called from configureDims with the lock held, after the user chunking has been applied.
+ *
+ * For the Frames access pattern each chunk holds a whole frame, split along the slowest
+ * frame dimension when the frame is larger than CHUNK_ADVISOR_MAX_BYTES.  Uncompressed frames
+ * are not grouped, since several frames per chunk only adds partial chunk writes; compressed
+ * frames are grouped up to CHUNK_ADVISOR_TARGET_BYTES for a better compression ratio.
+ * For the Time series pattern CHUNK_ADVISOR_SERIES_FRAMES frames are grouped in tiles of
+ * whole rows, so that a pixel can be read through time from few chunks.
+ * With extra dimensions the frames per chunk divide the frames per point (extra dimension N),
+ * and chunks never span points.  The chunk cache holds every chunk being filled, and the flush
+ * interval is rounded up to whole chunks.
+ * \param[in] pArray The first NDArray of the file.
+ * \param[in] extradims The number of dimensions in addition to the frame dimensions.
+ */
+void NDFileHDF5::adviseChunking(NDArray *pArray, int extradims)
+{
+  int accessPattern, compression, numFlush;
+  static const char *functionName = "adviseChunking";
+
+  getIntegerParam(NDFileHDF5_accessPattern, &accessPattern);
+  getIntegerParam(NDFileHDF5_compressionType, &compression);
+
+  // Index of the slowest frame dimension, which is split into tiles of whole rows
+  int first = this->rank - pArray->ndims;
+  hsize_t rows = this->maxdims[first];
+  hsize_t rowBytes = this->bytesPerElement;
+  for (int i = first + 1; i < this->rank; i++) rowBytes *= this->maxdims[i];
+  hsize_t frameBytes = rowBytes * rows;
+
+  hsize_t tileRows = rows;
+  hsize_t framesPerChunk = 1;
+  if (!pArray->codec.empty()){
+    // Pre-compressed arrays are written as whole frame chunks
+  } else if (accessPattern == HDF5AccessTimeSeries){
+    framesPerChunk = CHUNK_ADVISOR_SERIES_FRAMES;
+    tileRows = (CHUNK_ADVISOR_TARGET_BYTES / framesPerChunk) / rowBytes;
+  } else {
+    if (frameBytes > CHUNK_ADVISOR_MAX_BYTES){
+      hsize_t tiles = (frameBytes + CHUNK_ADVISOR_TARGET_BYTES - 1) / CHUNK_ADVISOR_TARGET_BYTES;
+      tileRows = (rows + tiles - 1) / tiles;
+    }
+    if (compression != HDF5CompressNone && frameBytes < CHUNK_ADVISOR_TARGET_BYTES){
+      framesPerChunk = CHUNK_ADVISOR_TARGET_BYTES / frameBytes;
+    }
+  }
+  if (tileRows < 1) tileRows = 1;
+  if (tileRows > rows) tileRows = rows;
+
+  if (extradims > 0){
+    // Chunks must not span more frames than one point, or than the whole capture
+    hsize_t pointFrames = this->maxdims[extradims - 1];
+    if (pointFrames != H5S_UNLIMITED && pointFrames > 0){
+      if (framesPerChunk > pointFrames) framesPerChunk = pointFrames;
+      if (extradims > 1){
+        while (pointFrames % framesPerChunk != 0) framesPerChunk--;
+      }
+    }
+    for (int i = 0; i < extradims - 1; i++) this->chunkdims[i] = 1;
+    this->chunkdims[extradims - 1] = framesPerChunk;
+  } else {
+    framesPerChunk = 1;
+  }
+  this->chunkdims[first] = tileRows;
+  for (int i = first + 1; i < this->rank; i++) this->chunkdims[i] = this->maxdims[i];
+
+  // Publish the choice in the chunking parameters, which are in NDArray dimension order
+  for (int i = 0; i < pArray->ndims && i < MAX_CHUNK_DIMS; i++){
+    setIntegerParam(NDFileHDF5_chunkSize[i], (int)this->chunkdims[this->rank - 1 - i]);
+  }
+  if (extradims > 0){
+    setIntegerParam(NDFileHDF5_nFramesChunks, (int)framesPerChunk);
+    for (int i = 1; i < extradims && i < MAXEXTRADIMS; i++){
+      setIntegerParam(NDFileHDF5_extraDimChunk[i], 1);
+    }
+    // A flush part way through a chunk writes it incomplete
+    getIntegerParam(NDFileHDF5_flushNthFrame, &numFlush);
+    if (numFlush > 0 && numFlush % (int)framesPerChunk != 0){
+      numFlush = (numFlush / (int)framesPerChunk + 1) * (int)framesPerChunk;
+      setIntegerParam(NDFileHDF5_flushNthFrame, numFlush);
+    }
+  }
+
+  // The cache must hold every tile of a frame while its chunks are being filled
+  hsize_t chunkBytes = tileRows * rowBytes * framesPerChunk;
+  hsize_t openChunks = 1;
+  if (framesPerChunk > 1) openChunks = (rows + tileRows - 1) / tileRows;
+  this->advisedCacheBytes = openChunks * chunkBytes;
+  hsize_t nslots = openChunks * 100;
+  if (nslots < CHUNK_ADVISOR_MIN_SLOTS) nslots = CHUNK_ADVISOR_MIN_SLOTS;
+  while (!IsPrime((int)nslots)) nslots++;
+  this->advisedCacheSlots = nslots;
+
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+            "%s::%s rows per chunk=%d frames per chunk=%d cache=%d bytes slots=%d\n",
+            driverName, functionName, (int)tileRows, (int)framesPerChunk,
+            (int)this->advisedCacheBytes, (int)this->advisedCacheSlots);
+}
+
 /** Setup the required allocation for the performance dataset
  */
 asynStatus NDFileHDF5::configurePerformanceDataset()
@@ -2711,6 +3243,7 @@ asynStatus NDFileHDF5::createAttributeDataset(NDArray *pArray)
   //int fileWriteMode = 0;
   int dimAttDataset = 0;
   int posRunning = 0;
+  int flushInterval = 1;
   hid_t groupDefault = -1;
   const char *attrNames[5] = {"NDAttrName", "NDAttrDescription", "NDAttrSourceType", "NDAttrSource", NULL};
   const char *attrStrings[5] = {NULL,NULL,NULL,NULL,NULL};
@@ -2723,6 +3256,7 @@ asynStatus NDFileHDF5::createAttributeDataset(NDArray *pArray)
   getIntegerParam(NDFileHDF5_dimAttDatasets, &dimAttDataset);
   getIntegerParam(NDFileHDF5_nExtraDims, &extraDims);
   getIntegerParam(NDFileHDF5_posRunning, &posRunning);
+  getIntegerParam(NDFileHDF5_NDAttributeFlush, &flushInterval);
 
   if (this->multiFrameFile){
     struct extradimdefs_t {
@@ -2756,6 +3290,8 @@ asynStatus NDFileHDF5::createAttributeDataset(NDArray *pArray)
     user_chunking[index] = 0;
   }
   calculateAttributeChunking(&chunking, user_chunking);
+  // A flush interval of zero writes the attribute values out one chunk at a time
+  if (flushInterval == 0) flushInterval = chunking;
 
   asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW, "%s::%s Creating attribute datasets. extradims=%d attribute count=%d\n",
             driverName, functionName, extraDims, this->pFileAttributes->count());
@@ -2798,6 +3334,7 @@ asynStatus NDFileHDF5::createAttributeDataset(NDArray *pArray)
       attDset->setDsetName(dset->get_name());
       attDset->setWhenToSave(dsource.get_when_to_save());
       attDset->setParentGroupName(dset->get_parent()->get_full_name());
+      attDset->setFlushInterval(flushInterval);
       if (dimAttDataset == 1){
         if (isAttributeIndex(atName) > -1 && posRunning == 1){
           // This dataset is specified as an index dataset
@@ -2831,6 +3368,7 @@ asynStatus NDFileHDF5::createAttributeDataset(NDArray *pArray)
         if(def_group != NULL) {
           attDset->setParentGroupName(def_group->get_full_name().c_str());
         }
+        attDset->setFlushInterval(flushInterval);
         if (dimAttDataset == 1){
           if (isAttributeIndex(atName) > -1 && posRunning == 1){
             // This dataset is specified as an index dataset
@@ -3216,6 +3754,7 @@ asynStatus NDFileHDF5::configureDims(NDArray *pArray)
   }
 
   this->rank = ndims;
+  this->frameRank = pArray->ndims;
   //asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
   //  "%s::%s initialising the basic frame dimension sizes. rank=%d\n",
   //  driverName, functionName, this->rank);
@@ -3272,6 +3811,13 @@ asynStatus NDFileHDF5::configureDims(NDArray *pArray)
     setIntegerParam(NDFileHDF5_nFramesChunks, nFramesChunks);
   }
 
+  // Let the chunk advisor replace the chunking chosen above
+  int chunkAdvisor = 0;
+  getIntegerParam(NDFileHDF5_chunkAdvisor, &chunkAdvisor);
+  if (chunkAdvisor == 1){
+    this->adviseChunking(pArray, extradims);
+  }
+
   // Check flushing parameter, if it is less than nFramesChunks then make them match
   int nFramesChunk;
   getIntegerParam(NDFileHDF5_nFramesChunks, &nFramesChunk);
@@ -3642,25 +4188,36 @@ bool NDFileHDF5::checkForSWMRSupported()
   return SWMRSupported;
 }
 
-/** Add the default attributes from NDArrays into the local NDAttribute list.
+/** Check whether the HDF5 library was built with the direct I/O virtual file driver.
+ */
+bool NDFileHDF5::checkForDirectIOSupported()
+{
+  #ifdef H5_HAVE_DIRECT
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+/** Add the default attributes from NDArrays into an NDAttribute list.
  *
  * The relevant attributes are: uniqueId, timeStamp, epicsTS.secPastEpoch and
  * epicsTS.nsec.
  */
-void NDFileHDF5::addDefaultAttributes(NDArray *pArray)
-{
-  this->pFileAttributes->add("NDArrayUniqueId",
-                             "The unique ID of the NDArray",
-                             NDAttrInt32, (void*)&(pArray->uniqueId));
-  this->pFileAttributes->add("NDArrayTimeStamp",
-                             "The timestamp of the NDArray as float64",
-                             NDAttrFloat64, (void*)&(pArray->timeStamp));
-  this->pFileAttributes->add("NDArrayEpicsTSSec",
-                             "The NDArray EPICS timestamp seconds past epoch",
-                             NDAttrUInt32, (void*)&(pArray->epicsTS.secPastEpoch));
-  this->pFileAttributes->add("NDArrayEpicsTSnSec",
-                             "The NDArray EPICS timestamp nanoseconds",
-                             NDAttrUInt32, (void*)&(pArray->epicsTS.nsec));
+void NDFileHDF5::addDefaultAttributes(NDArray *pArray, NDAttributeList *pList)
+{
+  pList->add("NDArrayUniqueId",
+             "The unique ID of the NDArray",
+             NDAttrInt32, (void*)&(pArray->uniqueId));
+  pList->add("NDArrayTimeStamp",
+             "The timestamp of the NDArray as float64",
+             NDAttrFloat64, (void*)&(pArray->timeStamp));
+  pList->add("NDArrayEpicsTSSec",
+             "The NDArray EPICS timestamp seconds past epoch",
+             NDAttrUInt32, (void*)&(pArray->epicsTS.secPastEpoch));
+  pList->add("NDArrayEpicsTSnSec",
+             "The NDArray EPICS timestamp nanoseconds",
+             NDAttrUInt32, (void*)&(pArray->epicsTS.nsec));
 }
 
 /** Helper function to create a comma separated list of integers in a string
@@ -3746,6 +4303,7 @@ asynStatus NDFileHDF5::createNewFile(const char *fileName)
   int tempAlign = 0;
   int tempThreshold = 0;
   int SWMRMode = 0;
+  int directIO = 0;
   static const char *functionName = "createNewFile";
 
   this->lock();
@@ -3753,6 +4311,7 @@ asynStatus NDFileHDF5::createNewFile(const char *fileName)
   getIntegerParam(NDFileHDF5_chunkBoundaryThreshold, (int*)&tempThreshold);
   // Check if we are in SWMR mode
   getIntegerParam(NDFileHDF5_SWMRMode, &SWMRMode);
+  getIntegerParam(NDFileHDF5_directIO, &directIO);
   this->unlock();
 
   /* File access property list: set the alignment boundary to a user defined block size
@@ -3767,6 +4326,12 @@ asynStatus NDFileHDF5::createNewFile(const char *fileName)
   if (tempThreshold > 0){
     threshold = tempThreshold;
   }
+  if (directIO == 1 && align == 0){
+    // Direct I/O transfers must start on a device block boundary, so every
+    // chunk is placed on one even when no alignment has been requested
+    align = DIRECT_IO_BLOCK_SIZE;
+    threshold = 0;
+  }
   if (align > 0){
     hdfstatus = H5Pset_alignment( access_plist, threshold, align );
     if (hdfstatus < 0){
@@ -3781,6 +4346,13 @@ asynStatus NDFileHDF5::createNewFile(const char *fileName)
     }
   }
 
+  if (directIO == 1){
+    if (this->configureDirectIO(access_plist, (size_t)align) != asynSuccess){
+      H5Pclose(access_plist);
+      return asynError;
+    }
+  }
+
   /* File creation property list: set the i-storek according to HDF group recommendations */
   H5Pset_fclose_degree(access_plist, H5F_CLOSE_STRONG);
 
@@ -3845,6 +4417,404 @@ asynStatus NDFileHDF5::createNewFile(const char *fileName)
   return asynSuccess;
 }
 
+/** Select the direct I/O virtual file driver for a new file.
+ * The direct driver bypasses the operating system page cache.  Its copy buffer is sized to
+ * hold at least one chunk so that a chunk is transferred with a single aligned write.  The file
+ * is refused if the chunk size is not a multiple of the block size, or if the driver cannot be
+ * selected.
+ * \param[in] access_plist File access property list of the new file.
+ * \param[in] align Device block size in bytes; file objects are aligned to this boundary.
+ */
+asynStatus NDFileHDF5::configureDirectIO(hid_t access_plist, size_t align)
+{
+  static const char *functionName = "configureDirectIO";
+
+#ifdef H5_HAVE_DIRECT
+  herr_t hdfstatus;
+  size_t chunkBytes = this->bytesPerElement;
+  size_t bufferSize;
+
+  for (int i = 0; i < this->rank; i++){
+    chunkBytes *= (size_t)this->chunkdims[i];
+  }
+  if (chunkBytes % align != 0){
+    // A partial block at the end of each chunk would be written through the copy buffer
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: chunk size of %lu bytes is not a multiple of the %lu byte block size\n",
+              driverName, functionName, (unsigned long)chunkBytes, (unsigned long)align);
+    return asynError;
+  }
+  bufferSize = chunkBytes;
+  if (bufferSize < DIRECT_IO_MIN_BUFFER){
+    bufferSize = DIRECT_IO_MIN_BUFFER;
+  }
+  hdfstatus = H5Pset_fapl_direct(access_plist, align, align, bufferSize);
+  if (hdfstatus < 0){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s ERROR: failed to select the direct I/O driver\n",
+              driverName, functionName);
+    return asynError;
+  }
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+            "%s::%s using direct I/O, block size=%lu copy buffer=%lu\n",
+            driverName, functionName, (unsigned long)align, (unsigned long)bufferSize);
+  return asynSuccess;
+#else
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s ERROR: the HDF5 library does not support direct I/O\n",
+            driverName, functionName);
+  return asynError;
+#endif
+}
+
+/** Return the name of the file written by one writer of a striped acquisition.
+ * The suffix _stripe<index> is inserted before the file extension.
+ * \param[in] fileName Full file name of the acquisition, which is used for the master file.
+ * \param[in] index Stripe index of the writer.
+ */
+std::string NDFileHDF5::stripeFileName(const char *fileName, int index)
+{
+  std::string name(fileName);
+  std::ostringstream suffix;
+  suffix << "_stripe" << index;
+  size_t dot = name.find_last_of('.');
+  size_t sep = name.find_last_of("/\\");
+  if (dot == std::string::npos || (sep != std::string::npos && dot < sep)){
+    return name + suffix.str();
+  }
+  return name.insert(dot, suffix.str());
+}
+
+/** Return whether an array belongs to a stripe of a striped acquisition.
+ * \param[in] uniqueId uniqueId of the array.
+ * \param[in] count Number of stripes.
+ * \param[in] index Stripe index.
+ */
+bool NDFileHDF5::stripeOwns(int uniqueId, int count, int index)
+{
+  return ((uniqueId % count) + count) % count == index;
+}
+
+/** Write a scalar integer attribute.
+ * \param[in] element HDF5 object to attach the attribute to.
+ * \param[in] name Name of the attribute.
+ * \param[in] value Value of the attribute.
+ */
+static herr_t writeStripeAttribute(hid_t element, const char *name, int value)
+{
+  hid_t space = H5Screate(H5S_SCALAR);
+  hid_t attr = H5Acreate2(element, name, H5T_NATIVE_INT32, space, H5P_DEFAULT, H5P_DEFAULT);
+  herr_t status = attr < 0 ? -1 : H5Awrite(attr, H5T_NATIVE_INT32, &value);
+  if (attr >= 0) H5Aclose(attr);
+  H5Sclose(space);
+  return status;
+}
+
+/** Read a scalar integer attribute, returning -1 if it does not exist.
+ * \param[in] element HDF5 object the attribute is attached to.
+ * \param[in] name Name of the attribute.
+ */
+static int readStripeAttribute(hid_t element, const char *name)
+{
+  int value = -1;
+  if (H5Aexists(element, name) > 0){
+    hid_t attr = H5Aopen(element, name, H5P_DEFAULT);
+    if (attr < 0 || H5Aread(attr, H5T_NATIVE_INT32, &value) < 0) value = -1;
+    if (attr >= 0) H5Aclose(attr);
+  }
+  return value;
+}
+
+/** Record the uniqueIds of the arrays written by this writer of a striped acquisition.
+ * The uniqueIds are written in file order to the dataset /stripe/uniqueId, with the attributes
+ * stripe_count and stripe_index.  The master file is built from these datasets, and the dataset
+ * is written last, so its presence shows that the stripe file is complete.
+ */
+asynStatus NDFileHDF5::writeStripeIds()
+{
+  hsize_t dims[1] = {this->stripeIds.size()};
+  asynStatus status = asynSuccess;
+  static const char *functionName = "writeStripeIds";
+
+  hid_t lcpl = H5Pcreate(H5P_LINK_CREATE);
+  H5Pset_create_intermediate_group(lcpl, 1);
+  hid_t space = H5Screate_simple(1, dims, NULL);
+  hid_t dataset = H5Dcreate2(this->file, STRIPE_IDS_DATASET, H5T_NATIVE_INT32, space,
+                             lcpl, H5P_DEFAULT, H5P_DEFAULT);
+  if (dataset < 0 ||
+      (dims[0] > 0 && H5Dwrite(dataset, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, &this->stripeIds[0]) < 0) ||
+      writeStripeAttribute(dataset, "stripe_count", this->stripeCount) < 0 ||
+      writeStripeAttribute(dataset, "stripe_index", this->stripeIndex) < 0){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+              "%s::%s Unable to record the uniqueIds of stripe %d\n",
+              driverName, functionName, this->stripeIndex);
+    status = asynError;
+  }
+  if (dataset >= 0) H5Dclose(dataset);
+  H5Sclose(space);
+  H5Pclose(lcpl);
+  return status;
+}
+
+/** Return whether the file of a stripe is complete, that is it can be opened and holds the uniqueIds
+ * recorded when it is closed (see writeStripeIds).
+ * \param[in] fileName Full file name of the stripe file.
+ */
+bool NDFileHDF5::stripeFileComplete(const char *fileName)
+{
+  hid_t file;
+  H5E_BEGIN_TRY {
+    file = H5Fopen(fileName, H5F_ACC_RDONLY, H5P_DEFAULT);
+  } H5E_END_TRY;
+  if (file < 0) return false;
+  bool complete = H5Lexists(file, "/stripe", H5P_DEFAULT) > 0 &&
+                  H5Lexists(file, STRIPE_IDS_DATASET, H5P_DEFAULT) > 0;
+  H5Fclose(file);
+  return complete;
+}
+
+/** Create the master file of a striped acquisition once all the stripe files are complete.
+ * The master file contains a virtual dataset with the full path of the default detector dataset.
+ * Frame n of the virtual dataset maps to the stripe frame holding uniqueId firstId + n, where firstId
+ * is the lowest uniqueId recorded by any stripe (see writeStripeIds), so the mapping follows the
+ * arrays each writer actually wrote.  Consecutive frames of a stripe whose uniqueIds step by the
+ * stripe count share one strided mapping.  Frames no writer wrote, such as dropped arrays, read as
+ * the fill value and are counted in the attribute missing_frames of the virtual dataset.
+ * This is only called by stripe 0 once its own file is closed, so a single writer creates the master
+ * file.  It waits for the other stripe files to be complete, and if one is not complete within the
+ * timeout no master file is created.  If the stripe files disagree on the stripe count, hold uniqueIds
+ * of another stripe or differ in frame shape or datatype no master file is created either.  The file
+ * is written under a temporary name and renamed, so a reader never sees a partial master file.
+ * Stripe files are referred to by name relative to the master file, which must be in the same directory.
+ * \param[in] fileName Full file name of the master file.
+ * \param[in] timeout Time in seconds to wait for the other stripe files.
+ */
+asynStatus NDFileHDF5::createStripeMaster(const char *fileName, double timeout)
+{
+  static const char *functionName = "createStripeMaster";
+
+#if H5_VERSION_GE(1,10,0)
+  std::vector<std::vector<epicsInt32> > ids(this->stripeCount);
+  hsize_t dims[H5S_MAX_RANK], sdims[H5S_MAX_RANK];
+  hsize_t vstart[H5S_MAX_RANK], vstride[H5S_MAX_RANK], sstart[H5S_MAX_RANK], sstride[H5S_MAX_RANK];
+  hsize_t count[H5S_MAX_RANK], block[H5S_MAX_RANK];
+  std::vector<char> fillValue;
+  hid_t datatype = -1;
+  int rank = 0;
+  asynStatus status = asynSuccess;
+  epicsTimeStamp start, now;
+
+  // Wait for the other writers to close their stripe files
+  epicsTimeGetCurrent(&start);
+  for (int index = 1; index < this->stripeCount && status == asynSuccess; index++){
+    std::string name = this->stripeFileName(fileName, index);
+    while (!this->stripeFileComplete(name.c_str())){
+      epicsTimeGetCurrent(&now);
+      if (epicsTimeDiffInSeconds(&now, &start) > timeout){
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s %s was not complete within %g seconds, no master file created\n",
+                  driverName, functionName, name.c_str(), timeout);
+        status = asynError;
+        break;
+      }
+      epicsThreadSleep(0.1);
+    }
+  }
+
+  // Read the uniqueIds, frame shape and datatype of every stripe
+  for (int index = 0; index < this->stripeCount && status == asynSuccess; index++){
+    std::string name = this->stripeFileName(fileName, index);
+    hid_t file;
+    H5E_BEGIN_TRY {
+      file = H5Fopen(name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    } H5E_END_TRY;
+    if (file < 0){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s Unable to open %s\n",
+                driverName, functionName, name.c_str());
+      status = asynError;
+      break;
+    }
+
+    hid_t dataset = H5Dopen2(file, STRIPE_IDS_DATASET, H5P_DEFAULT);
+    hid_t space = H5Dget_space(dataset);
+    ids[index].resize((size_t)H5Sget_simple_extent_npoints(space));
+    H5Sclose(space);
+    if (!ids[index].empty() &&
+        H5Dread(dataset, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, &ids[index][0]) < 0){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s Unable to read the uniqueIds of %s\n",
+                driverName, functionName, name.c_str());
+      status = asynError;
+    } else if (readStripeAttribute(dataset, "stripe_count") != this->stripeCount ||
+               readStripeAttribute(dataset, "stripe_index") != index){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s %s was not written as stripe %d of %d\n",
+                driverName, functionName, name.c_str(), index, this->stripeCount);
+      status = asynError;
+    }
+    H5Dclose(dataset);
+    for (size_t k = 0; k < ids[index].size() && status == asynSuccess; k++){
+      if (!this->stripeOwns(ids[index][k], this->stripeCount, index) ||
+          (k > 0 && ids[index][k] <= ids[index][k-1])){
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s %s holds uniqueId %d out of order or owned by another stripe\n",
+                  driverName, functionName, name.c_str(), ids[index][k]);
+        status = asynError;
+      }
+    }
+
+    if (status == asynSuccess){
+      dataset = H5Dopen2(file, this->defDsetName.c_str(), H5P_DEFAULT);
+      int srank = -1;
+      if (dataset >= 0){
+        space = H5Dget_space(dataset);
+        srank = H5Sget_simple_extent_dims(space, sdims, NULL);
+        H5Sclose(space);
+      }
+      bool agree = srank >= 1 && sdims[0] == ids[index].size();
+      if (agree && datatype < 0){
+        rank = srank;
+        for (int i = 0; i < rank; i++) dims[i] = sdims[i];
+        datatype = H5Dget_type(dataset);
+        fillValue.resize(H5Tget_size(datatype));
+        hid_t dcpl = H5Dget_create_plist(dataset);
+        H5Pget_fill_value(dcpl, datatype, &fillValue[0]);
+        H5Pclose(dcpl);
+      } else if (agree){
+        hid_t stype = H5Dget_type(dataset);
+        agree = srank == rank && H5Tequal(stype, datatype) > 0;
+        for (int i = 1; i < rank && agree; i++) agree = sdims[i] == dims[i];
+        H5Tclose(stype);
+      }
+      if (!agree){
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s Dataset %s of %s does not match its uniqueIds or the other stripes\n",
+                  driverName, functionName, this->defDsetName.c_str(), name.c_str());
+        status = asynError;
+      }
+      if (dataset >= 0) H5Dclose(dataset);
+    }
+    H5Fclose(file);
+  }
+
+  // The virtual dataset spans the uniqueIds from the first to the last array written by any stripe
+  long firstId = 0, lastId = -1;
+  size_t written = 0;
+  for (int index = 0; index < this->stripeCount; index++){
+    if (ids[index].empty()) continue;
+    if (written == 0 || ids[index].front() < firstId) firstId = ids[index].front();
+    if (written == 0 || ids[index].back() > lastId) lastId = ids[index].back();
+    written += ids[index].size();
+  }
+  if (status != asynSuccess || written == 0){
+    if (status == asynSuccess){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+                "%s::%s No stripe wrote any frames, no master file created\n",
+                driverName, functionName);
+    }
+    if (datatype >= 0) H5Tclose(datatype);
+    return status;
+  }
+  dims[0] = lastId - firstId + 1;
+  int missing = (int)(dims[0] - written);
+  if (missing > 0){
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_WARNING,
+              "%s::%s %d of the frames with uniqueIds %ld to %ld were not written by any stripe\n",
+              driverName, functionName, missing, firstId, lastId);
+  }
+
+  for (int i = 0; i < rank; i++){
+    vstart[i]  = sstart[i]  = 0;
+    vstride[i] = sstride[i] = 1;
+    count[i]   = 1;
+    block[i]   = dims[i];
+  }
+  block[0] = 1;
+  hid_t vspace = H5Screate_simple(rank, dims, NULL);
+  hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_fill_value(dcpl, datatype, &fillValue[0]);
+
+  for (int index = 0; index < this->stripeCount && status == asynSuccess; index++){
+    const std::vector<epicsInt32>& sids = ids[index];
+    if (sids.empty()) continue;
+    std::string source = this->stripeFileName(fileName, index);
+    size_t sep = source.find_last_of("/\\");
+    if (sep != std::string::npos) source.erase(0, sep + 1);
+    // Source names are printf-like patterns in which a literal % must be doubled
+    for (size_t pos = source.find('%'); pos != std::string::npos; pos = source.find('%', pos + 2)){
+      source.insert(pos, 1, '%');
+    }
+    for (int i = 1; i < rank; i++) sdims[i] = dims[i];
+    sdims[0] = sids.size();
+    hid_t sspace = H5Screate_simple(rank, sdims, NULL);
+    // Each run of frames without a gap in the uniqueIds is one mapping
+    for (size_t first = 0, k = 1; k <= sids.size() && status == asynSuccess; k++){
+      if (k < sids.size() && sids[k] == sids[k-1] + this->stripeCount) continue;
+      vstart[0]  = sids[first] - firstId;
+      vstride[0] = this->stripeCount;
+      sstart[0]  = first;
+      count[0]   = k - first;
+      if (H5Sselect_hyperslab(vspace, H5S_SELECT_SET, vstart, vstride, count, block) < 0 ||
+          H5Sselect_hyperslab(sspace, H5S_SELECT_SET, sstart, sstride, count, block) < 0 ||
+          H5Pset_virtual(dcpl, vspace, source.c_str(), this->defDsetName.c_str(), sspace) < 0){
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s Unable to map stripe %d from %s\n",
+                  driverName, functionName, index, source.c_str());
+        status = asynError;
+      }
+      first = k;
+    }
+    H5Sclose(sspace);
+  }
+  H5Sselect_all(vspace);
+
+  std::string tmpName = this->stripeFileName(fileName, this->stripeIndex) + ".master";
+  if (status == asynSuccess){
+    hid_t master = H5Fcreate(tmpName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (master < 0){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s Unable to create master file %s\n",
+                driverName, functionName, tmpName.c_str());
+      status = asynError;
+    } else {
+      hid_t lcpl = H5Pcreate(H5P_LINK_CREATE);
+      H5Pset_create_intermediate_group(lcpl, 1);
+      hid_t dataset = H5Dcreate2(master, this->defDsetName.c_str(), datatype, vspace,
+                                 lcpl, dcpl, H5P_DEFAULT);
+      if (dataset < 0 || writeStripeAttribute(dataset, "missing_frames", missing) < 0){
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s Unable to create virtual dataset %s\n",
+                  driverName, functionName, this->defDsetName.c_str());
+        status = asynError;
+      }
+      if (dataset >= 0) H5Dclose(dataset);
+      H5Pclose(lcpl);
+      H5Fclose(master);
+    }
+    // rename does not replace an existing file on all platforms
+    if (status == asynSuccess && rename(tmpName.c_str(), fileName) != 0 &&
+        (remove(fileName) != 0 || rename(tmpName.c_str(), fileName) != 0)){
+      asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s Unable to rename %s to %s\n",
+                driverName, functionName, tmpName.c_str(), fileName);
+      status = asynError;
+    }
+    if (status != asynSuccess) remove(tmpName.c_str());
+  }
+
+  H5Pclose(dcpl);
+  H5Sclose(vspace);
+  H5Tclose(datatype);
+  return status;
+#else
+  asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s Virtual datasets require HDF5 1.10 or later\n",
+            driverName, functionName);
+  return asynError;
+#endif
+}
+
 /** Create the output file layout as specified by the XML layout.
  */
 asynStatus NDFileHDF5::createFileLayout(NDArray *pArray)
@@ -8,6 +8,8 @@
 #define NDFileHDF5_H
 
 #include <list>
+#include <deque>
+#include <vector>
 #include <string.h>
 #include <hdf5.h>
 #include <NDPluginFile.h>
@@ -27,6 +29,7 @@
 #define str_NDFileHDF5_chunkBoundaryAlign "HDF5_chunkBoundaryAlign"
 #define str_NDFileHDF5_chunkBoundaryThreshold "HDF5_chunkBoundaryThreshold"
 #define str_NDFileHDF5_NDAttributeChunk  "HDF5_NDAttributeChunk"
+#define str_NDFileHDF5_NDAttributeFlush  "HDF5_NDAttributeFlush"
 #define str_NDFileHDF5_nExtraDims        "HDF5_nExtraDims"
 #define str_NDFileHDF5_extraDimOffsetX   "HDF5_extraDimOffsetX"
 #define str_NDFileHDF5_extraDimOffsetY   "HDF5_extraDimOffsetY"
@@ -61,6 +64,34 @@
 #define str_NDFileHDF5_SWMRSupported     "HDF5_SWMRSupported"
 #define str_NDFileHDF5_SWMRMode          "HDF5_SWMRMode"
 #define str_NDFileHDF5_SWMRRunning       "HDF5_SWMRRunning"
+#define str_NDFileHDF5_writeBehind       "HDF5_writeBehind"
+#define str_NDFileHDF5_writeQueueSize    "HDF5_writeQueueSize"
+#define str_NDFileHDF5_writeQueueUse     "HDF5_writeQueueUse"
+#define str_NDFileHDF5_writeQueueStalls  "HDF5_writeQueueStalls"
+#define str_NDFileHDF5_writeLatency      "HDF5_writeLatency"
+#define str_NDFileHDF5_writeLatencyMax   "HDF5_writeLatencyMax"
+#define str_NDFileHDF5_directIO          "HDF5_directIO"
+#define str_NDFileHDF5_directIOSupported "HDF5_directIOSupported"
+#define str_NDFileHDF5_stripeCount       "HDF5_stripeCount"
+#define str_NDFileHDF5_stripeIndex       "HDF5_stripeIndex"
+#define str_NDFileHDF5_stripeVDS         "HDF5_stripeVDS"
+#define str_NDFileHDF5_stripeVDSTimeout  "HDF5_stripeVDSTimeout"
+#define str_NDFileHDF5_stripeFileName    "HDF5_stripeFileName"
+#define str_NDFileHDF5_chunkAdvisor      "HDF5_chunkAdvisor"
+#define str_NDFileHDF5_accessPattern     "HDF5_accessPattern"
+#define str_NDFileHDF5_chunkCacheSize    "HDF5_chunkCacheSize"
+#define str_NDFileHDF5_chunkCacheHitExpected "HDF5_chunkCacheHitExpected"
+#define str_NDFileHDF5_chunkCacheHitObserved "HDF5_chunkCacheHitObserved"
+#define str_NDFileHDF5_partialChunkFlushes   "HDF5_partialChunkFlushes"
+
+/** An NDArray waiting in the write-behind queue of NDFileHDF5.
+  */
+typedef struct {
+    NDArray *pArray;              /** < The array to write, reserved until the write completes */
+    NDAttributeList *pAttributes; /** < Attribute values captured when the array was queued */
+    epicsInt32 numCaptured;       /** < Value of NDFileNumCaptured when the array was queued */
+    epicsTimeStamp queued;        /** < Time the array was queued, used for the latency statistics */
+} NDFileHDF5WriteRequest_t;
 
 /** Writes NDArrays in the HDF5 file format; an XML file can control the structure of the HDF5 file.
   */
@@ -83,11 +114,13 @@ class NDPLUGIN_API NDFileHDF5 : public NDPluginFile
     virtual asynStatus readFile(NDArray **pArray);
     virtual asynStatus writeFile(NDArray *pArray);
     virtual asynStatus closeFile();
+    virtual void driverCallback(asynUser *pasynUser, void *genericPointer);
     virtual void report(FILE *fp, int details);
     virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
     virtual asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t nChars, size_t *nActual);
 
     void flushTask();
+    void writeTask();
     asynStatus startSWMR();
     asynStatus flushCallback();
     asynStatus createXMLFileLayout();
@@ -138,6 +171,7 @@ class NDPLUGIN_API NDFileHDF5 : public NDPluginFile
     int NDFileHDF5_chunkBoundaryAlign;
     int NDFileHDF5_chunkBoundaryThreshold;
     int NDFileHDF5_NDAttributeChunk;
+    int NDFileHDF5_NDAttributeFlush;
     int NDFileHDF5_nExtraDims;
     int NDFileHDF5_extraDimOffsetX;
     int NDFileHDF5_extraDimOffsetY;
@@ -171,6 +205,25 @@ class NDPLUGIN_API NDFileHDF5 : public NDPluginFile
     int NDFileHDF5_SWMRSupported;
     int NDFileHDF5_SWMRMode;
     int NDFileHDF5_SWMRRunning;
+    int NDFileHDF5_writeBehind;
+    int NDFileHDF5_writeQueueSize;
+    int NDFileHDF5_writeQueueUse;
+    int NDFileHDF5_writeQueueStalls;
+    int NDFileHDF5_writeLatency;
+    int NDFileHDF5_writeLatencyMax;
+    int NDFileHDF5_directIO;
+    int NDFileHDF5_directIOSupported;
+    int NDFileHDF5_stripeCount;
+    int NDFileHDF5_stripeIndex;
+    int NDFileHDF5_stripeVDS;
+    int NDFileHDF5_stripeVDSTimeout;
+    int NDFileHDF5_stripeFileName;
+    int NDFileHDF5_chunkAdvisor;
+    int NDFileHDF5_accessPattern;
+    int NDFileHDF5_chunkCacheSize;
+    int NDFileHDF5_chunkCacheHitExpected;
+    int NDFileHDF5_chunkCacheHitObserved;
+    int NDFileHDF5_partialChunkFlushes;
 
     asynStatus configureDims(NDArray *pArray);
     void calcNumFrames();
@@ -207,13 +260,25 @@ class NDPLUGIN_API NDFileHDF5 : public NDPluginFile
     unsigned int calcIstorek();
     hsize_t calcChunkCacheBytes();
     hsize_t calcChunkCacheSlots();
+    void adviseChunking(NDArray *pArray, int extradims);
 
     void checkForOpenFile();
     bool checkForSWMRMode();
     bool checkForSWMRSupported();
-    void addDefaultAttributes(NDArray *pArray);
+    bool checkForDirectIOSupported();
+    void addDefaultAttributes(NDArray *pArray, NDAttributeList *pList);
+    asynStatus snapshotAttributes(NDArray *pArray, NDAttributeList *pList);
+    asynStatus writeArray(NDArray *pArray, NDAttributeList *pAttributes, epicsInt32 numCaptured);
+    asynStatus queueArray(NDArray *pArray, epicsInt32 numCaptured);
+    void waitForWrites();
     asynStatus writeDefaultDatasetAttributes(NDArray *pArray);
     asynStatus createNewFile(const char *fileName);
+    asynStatus configureDirectIO(hid_t access_plist, size_t align);
+    std::string stripeFileName(const char *fileName, int index);
+    bool stripeOwns(int uniqueId, int count, int index);
+    asynStatus writeStripeIds();
+    bool stripeFileComplete(const char *fileName);
+    asynStatus createStripeMaster(const char *fileName, double timeout);
     asynStatus createFileLayout(NDArray *pArray);
     asynStatus createAttributeDataset(NDArray *pArray);
     int isAttributeIndex(const std::string& attName);
@@ -238,11 +303,31 @@ class NDPLUGIN_API NDFileHDF5 : public NDPluginFile
     epicsTimeStamp firstFrame;
     double frameSize;  /** < frame size in megabits. For performance measurement. */
     int bytesPerElement;
+    int frameRank;                  /** < Number of dimensions of the frames in the detector datasets */
+    hsize_t advisedCacheBytes;      /** < Chunk cache size chosen by the chunk advisor */
+    hsize_t advisedCacheSlots;      /** < Chunk cache hash slots chosen by the chunk advisor */
     char *hostname;
 
     epicsEventId flushEventId;
     epicsMutex flushLock;
 
+    /* write-behind queue, protected by writeQueueLock */
+    epicsEventId writeEventId;      /** < Signalled when an array has been added to the write queue */
+    epicsEventId writeSpaceEventId; /** < Signalled when the write thread takes an array from the queue */
+    epicsEventId writeIdleEventId;  /** < Signalled when the write thread has emptied the queue */
+    epicsMutex writeQueueLock;
+    std::deque<NDFileHDF5WriteRequest_t> writeQueue;
+    std::list<NDAttributeList *> freeAttributeLists; /** < Attribute lists available for reuse by queued arrays */
+    bool writeBusy;                 /** < True while the write thread is writing an array */
+    asynStatus writeStatus;         /** < First error returned by the write thread since the file was opened */
+    double writeLatencyMax;
+
+    /* striping across several writers, fixed while a file is open */
+    int stripeCount;                /** < Number of writers sharing the frames, 1 when not striping */
+    int stripeIndex;                /** < Frames with uniqueId % stripeCount == stripeIndex are written */
+    std::vector<epicsInt32> stripeIds; /** < uniqueIds of the arrays written to this stripe, in file order */
+    std::string stripeMasterFile;   /** < Master file to create when the file is closed, empty if none */
+
     std::list<NDFileHDF5AttributeDataset*> attrList;
 
     /* HDF5 handles and references */
@@ -38,7 +38,12 @@ NDFileHDF5AttributeDataset::NDFileHDF5AttributeDataset(hid_t file, const std::st
   rank_(0),
   nextRecord_(0),
   extraDimensions_(0),
-  whenToSave_(hdf5::OnFrame)
+  whenToSave_(hdf5::OnFrame),
+  flushInterval_(1),
+  nStaged_(0),
+  valueSize_(0),
+  stagedValues_(NULL),
+  stagedOffsets_(NULL)
 {
   //printf("Constructor called for %s\n", name.c_str());
   // Allocate enough memory for the fill value to accept any data type
@@ -55,6 +60,8 @@ NDFileHDF5AttributeDataset::~NDFileHDF5AttributeDataset()
   if (this->dims_        != NULL) free(this->dims_);
   if (this->offset_      != NULL) free(this->offset_);
   if (this->elementSize_ != NULL) free(this->elementSize_);
+  if (this->stagedValues_  != NULL) free(this->stagedValues_);
+  if (this->stagedOffsets_ != NULL) free(this->stagedOffsets_);
 }
 
 void NDFileHDF5AttributeDataset::setDsetName(const std::string& dsetName)
@@ -72,6 +79,17 @@ void NDFileHDF5AttributeDataset::setParentGroupName(const std::string& group)
   groupName_ = group;
 }
 
+/** Set the number of records that are held in memory before being written to the file.
+ * Must be called before the dataset is created.  Records are also written out when the
+ * dataset is flushed or closed, so the layout of the file is not affected by this setting.
+ * \param[in] frames - Number of records to hold in memory. Values less than 1 are treated as 1.
+ */
+void NDFileHDF5AttributeDataset::setFlushInterval(int frames)
+{
+  if (frames < 1) frames = 1;
+  flushInterval_ = frames;
+}
+
 asynStatus NDFileHDF5AttributeDataset::createDataset(int user_chunking)
 {
   asynStatus status = asynSuccess;
@@ -130,43 +148,37 @@ asynStatus NDFileHDF5AttributeDataset::createHDF5Dataset()
 
   memspace_ = H5Screate_simple(rank_, elementSize_, NULL);
 
+  // Allocate the column buffer used to stage records before writing them
+  valueSize_ = H5Tget_size(datatype_);
+  nStaged_ = 0;
+  if (this->stagedValues_  != NULL) free(this->stagedValues_);
+  if (this->stagedOffsets_ != NULL) free(this->stagedOffsets_);
+  this->stagedValues_  = (char*)calloc(flushInterval_, valueSize_);
+  this->stagedOffsets_ = (hsize_t*)calloc(flushInterval_ * rank_, sizeof(hsize_t));
+
   return status;
 }
 
 asynStatus NDFileHDF5AttributeDataset::writeAttributeDataset(hdf5::When_t whenToSave, NDAttribute *ndAttr, int flush)
 {
   asynStatus status = asynSuccess;
-  char * stackbuf[MAX_ATTRIBUTE_STRING_SIZE];
-  void* pDatavalue = stackbuf;
-  int ret;
   //check if the attribute is meant to be saved at this time
   if (whenToSave_ == whenToSave) {
     // Extend the dataset as required to store the data
     extendDataSet();
 
-    // find the data based on datatype
-    ret = ndAttr->getValue(ndAttr->getDataType(), pDatavalue, MAX_ATTRIBUTE_STRING_SIZE);
-    if (ret == ND_ERROR) {
-      memset(pDatavalue, 0, MAX_ATTRIBUTE_STRING_SIZE);
-    }
-    // Work with HDF5 library to select a suitable hyperslab (one element) and write the new data to it
-    H5Dset_extent(dataset_, dims_);
-    filespace_ = H5Dget_space(dataset_);
-
-    // Select the hyperslab
-    H5Sselect_hyperslab(filespace_, H5S_SELECT_SET, offset_, NULL, elementSize_, NULL);
-
-    // Write the data to the hyperslab if data is defined
-    if (!isUndefined_) {
-       H5Dwrite(dataset_, datatype_, memspace_, filespace_, H5P_DEFAULT, pDatavalue);
-    }
+    // Store the value in the column buffer, it is written out once the flush
+    // interval has been reached.  Open and close attributes are only written once
+    // so there is nothing to gain from holding them back.
+    status = this->stageAttribute(ndAttr);
 
     // Check if we are being asked to flush
     if (flush == 1){
       status = this->flushDataset();
+    } else if (nStaged_ >= flushInterval_ || whenToSave != hdf5::OnFrame){
+      status = this->writeStagedAttributes();
     }
 
-    H5Sclose(filespace_);
     nextRecord_++;
   }
 
@@ -182,6 +194,8 @@ asynStatus NDFileHDF5AttributeDataset::writeAttributeDataset(hdf5::When_t whenTo
   //check if the attribute is meant to be saved at this time
   if (whenToSave_ == whenToSave) {
     // Extend the dataset as required to store the data
+    // Positions may be revisited so staged records are written before this one
+    this->writeStagedAttributes();
     if (indexed == -1){
       extendDataSet(offsets);
     } else {
@@ -218,6 +232,8 @@ asynStatus NDFileHDF5AttributeDataset::writeAttributeDataset(hdf5::When_t whenTo
 asynStatus NDFileHDF5AttributeDataset::closeAttributeDataset()
 {
   //printf("close called for %s\n", name_.c_str());
+  // Write out any records still held in memory
+  this->writeStagedAttributes();
   H5Dclose(dataset_);
   H5Sclose(memspace_);
   H5Sclose(dataspace_);
@@ -456,10 +472,68 @@ hid_t NDFileHDF5AttributeDataset::getHandle()
   return dataset_;
 }
 
+/** Copy the value of an attribute and the current offset into the column buffer.
+ * \param[in] ndAttr - The attribute to store.
+ */
+asynStatus NDFileHDF5AttributeDataset::stageAttribute(NDAttribute *ndAttr)
+{
+  int ret;
+  char *pValue = stagedValues_ + (nStaged_ * valueSize_);
+
+  // Undefined attributes are never written, only the extent of the dataset grows
+  if (!isUndefined_) {
+    memset(pValue, 0, valueSize_);
+    ret = ndAttr->getValue(type_, pValue, valueSize_);
+    if (ret == ND_ERROR) {
+      memset(pValue, 0, valueSize_);
+    }
+  }
+  memcpy(stagedOffsets_ + (nStaged_ * rank_), offset_, rank_ * sizeof(hsize_t));
+  nStaged_++;
+
+  return asynSuccess;
+}
+
+/** Write all records held in the column buffer to the file with a single HDF5 write.
+ * Records of a one dimensional dataset are contiguous and written as a single hyperslab,
+ * records of a multi-dimensional dataset are written as a point selection.
+ */
+asynStatus NDFileHDF5AttributeDataset::writeStagedAttributes()
+{
+  asynStatus status = asynSuccess;
+  hsize_t nRecords = nStaged_;
+  herr_t hdfstatus = 0;
+
+  if (nStaged_ == 0) return status;
+
+  // Extend the dataset to cover every staged record
+  H5Dset_extent(dataset_, dims_);
+
+  if (!isUndefined_) {
+    filespace_ = H5Dget_space(dataset_);
+    hid_t memspace = H5Screate_simple(1, &nRecords, NULL);
+    if (rank_ == 1) {
+      H5Sselect_hyperslab(filespace_, H5S_SELECT_SET, stagedOffsets_, NULL, &nRecords, NULL);
+    } else {
+      H5Sselect_elements(filespace_, H5S_SELECT_SET, nStaged_, stagedOffsets_);
+    }
+    hdfstatus = H5Dwrite(dataset_, datatype_, memspace, filespace_, H5P_DEFAULT, stagedValues_);
+    H5Sclose(memspace);
+    H5Sclose(filespace_);
+  }
+  nStaged_ = 0;
+
+  if (hdfstatus < 0) status = asynError;
+  return status;
+}
+
 asynStatus NDFileHDF5AttributeDataset::flushDataset()
 {
   asynStatus status = asynSuccess;
 
+  // Make sure all staged records are in the file before flushing
+  status = this->writeStagedAttributes();
+
   // We cannot flush for SWMR if the HDF version doesn't support it
   #if H5_VERSION_GE(1,9,178)
 
@@ -24,6 +24,7 @@ public:
   void setDsetName(const std::string& dsetName);
   void setWhenToSave(hdf5::When_t whenToSave);
   void setParentGroupName(const std::string& group);
+  void setFlushInterval(int frames);
   asynStatus createDataset(int user_chunking);
   asynStatus createDataset(bool multiframe, int extradimensions, int *extra_dims, int *user_chunking);
   asynStatus writeAttributeDataset(hdf5::When_t whenToSave, NDAttribute *ndAttr, int flush);
@@ -41,6 +42,8 @@ private:
   void extendDataSet();
   void extendDataSet(hsize_t *offsets);
   void extendIndexDataSet(hsize_t offset);
+  asynStatus stageAttribute(NDAttribute *ndAttr);
+  asynStatus writeStagedAttributes();
 
   std::string      name_;            // Name of the attribute
   std::string      dsetName_;        // Name of the dataset to store
@@ -65,6 +68,11 @@ private:
   int              nextRecord_;
   int              extraDimensions_;
   hdf5::When_t     whenToSave_;
+  int              flushInterval_;   // Number of records held in memory before they are written to file
+  int              nStaged_;         // Number of records currently held in memory
+  size_t           valueSize_;       // Size in bytes of a single record
+  char             *stagedValues_;   // Column buffer of records waiting to be written
+  hsize_t          *stagedOffsets_;  // File offsets (rank_ per record) of the records waiting to be written
 
 };
 
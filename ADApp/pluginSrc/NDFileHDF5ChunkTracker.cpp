@@ -0,0 +1,314 @@
+/*
+ * NDFileHDF5ChunkTracker.cpp
+ *
+ * Follows the chunks touched by the writes to a chunked dataset through a model
+ * of the HDF5 raw data chunk cache.
+ */
+
+#include "NDFileHDF5ChunkTracker.h"
+
+/** Number of hash bits used for an unlimited dimension other than the first */
+#define UNLIMITED_ENCODE_BITS 16
+
+static bool isUnlimited(hsize_t dim)
+{
+  return dim == 0 || dim == H5S_UNLIMITED;
+}
+
+NDFileHDF5ChunkTracker::NDFileHDF5ChunkTracker() :
+  rank_(0), chunkBytes_(0), cacheBytes_(0), cacheSlots_(1), residentBytes_(0),
+  accesses_(0), misses_(0), partialFlushes_(0)
+{
+}
+
+NDFileHDF5ChunkTracker::~NDFileHDF5ChunkTracker()
+{
+}
+
+/** Configure the dataset geometry and chunk cache to follow, and clear the statistics.
+ * \param[in] rank - Number of dimensions of the dataset.
+ * \param[in] chunkdims - Chunk dimensions, slowest varying first.
+ * \param[in] maxdims - Maximum dimensions, 0 or H5S_UNLIMITED for an unlimited dimension.
+ * \param[in] elementSize - Size in bytes of one element.
+ * \param[in] cacheBytes - Size in bytes of the chunk cache.
+ * \param[in] cacheSlots - Number of hash slots of the chunk cache.
+ */
+void NDFileHDF5ChunkTracker::configure(int rank, const hsize_t *chunkdims, const hsize_t *maxdims,
+                                       size_t elementSize, size_t cacheBytes, size_t cacheSlots)
+{
+  this->rank_ = rank;
+  this->chunkdims_.assign(chunkdims, chunkdims + rank);
+  this->maxdims_.assign(maxdims, maxdims + rank);
+  this->encodeBits_.assign(rank, 0);
+  this->chunkBytes_ = elementSize;
+  for (int i = 0; i < rank; i++){
+    if (this->chunkdims_[i] < 1) this->chunkdims_[i] = 1;
+    this->chunkBytes_ *= (size_t)this->chunkdims_[i];
+    // As HDF5, the scaled chunk indices are combined with enough bits for each dimension
+    if (isUnlimited(this->maxdims_[i])){
+      this->encodeBits_[i] = UNLIMITED_ENCODE_BITS;
+    } else {
+      hsize_t nchunks = (this->maxdims_[i] + this->chunkdims_[i] - 1) / this->chunkdims_[i];
+      while (((hsize_t)1 << this->encodeBits_[i]) < nchunks) this->encodeBits_[i]++;
+    }
+  }
+  this->cacheBytes_ = cacheBytes;
+  this->cacheSlots_ = cacheSlots < 1 ? 1 : cacheSlots;
+  this->slots_.resize(this->cacheSlots_);
+  this->slotKeys_.assign(this->cacheSlots_ * rank, 0);
+  this->first_.resize(rank);
+  this->last_.resize(rank);
+  this->key_.resize(rank);
+  this->reset();
+}
+
+/** Configure from the chunking and chunk cache settings of an open dataset.
+ * \param[in] dataset - HDF5 handle to a chunked dataset.
+ */
+void NDFileHDF5ChunkTracker::configure(hid_t dataset)
+{
+  hsize_t chunkdims[H5S_MAX_RANK], dims[H5S_MAX_RANK], maxdims[H5S_MAX_RANK];
+  size_t nslots = 0, nbytes = 0;
+  double w0 = 0.0;
+  int rank = 0;
+
+  hid_t cparms = H5Dget_create_plist(dataset);
+  if (cparms >= 0 && H5Pget_layout(cparms) == H5D_CHUNKED){
+    rank = H5Pget_chunk(cparms, H5S_MAX_RANK, chunkdims);
+  }
+  if (cparms >= 0) H5Pclose(cparms);
+  if (rank <= 0){
+    this->rank_ = 0;
+    this->reset();
+    return;
+  }
+  hid_t aparms = H5Dget_access_plist(dataset);
+  H5Pget_chunk_cache(aparms, &nslots, &nbytes, &w0);
+  H5Pclose(aparms);
+  hid_t space = H5Dget_space(dataset);
+  H5Sget_simple_extent_dims(space, dims, maxdims);
+  H5Sclose(space);
+  hid_t type = H5Dget_type(dataset);
+  size_t elementSize = H5Tget_size(type);
+  H5Tclose(type);
+  this->configure(rank, chunkdims, maxdims, elementSize, nbytes, nslots);
+}
+
+/** Forget all chunks and clear the statistics.
+ */
+void NDFileHDF5ChunkTracker::reset()
+{
+  for (size_t slot = 0; slot < this->slots_.size(); slot++){
+    this->slots_[slot].used = false;
+  }
+  for (int list = Incomplete; list <= Complete; list++){
+    this->head_[list] = -1;
+    this->tail_[list] = -1;
+  }
+  this->residentBytes_ = 0;
+  this->accesses_ = 0;
+  this->misses_ = 0;
+  this->partialFlushes_ = 0;
+}
+
+/** Record a write of the hyperslab starting at offset with the given count.
+ * \param[in] offset - Start of the hyperslab, rank elements.
+ * \param[in] count - Size of the hyperslab, rank elements.
+ */
+void NDFileHDF5ChunkTracker::write(const hsize_t *offset, const hsize_t *count)
+{
+  if (this->rank_ <= 0) return;
+  hsize_t *first = &this->first_[0], *last = &this->last_[0], *key = &this->key_[0];
+  for (int i = 0; i < this->rank_; i++){
+    if (count[i] == 0) return;
+    first[i] = offset[i] / this->chunkdims_[i];
+    last[i] = (offset[i] + count[i] - 1) / this->chunkdims_[i];
+    key[i] = first[i];
+  }
+  // Visit every chunk overlapping the hyperslab.  The chunk was written before if the
+  // write starts after its origin, and is complete if the write reaches its far corner.
+  while (true){
+    bool started = false, completes = true;
+    for (int i = 0; i < this->rank_; i++){
+      hsize_t start = key[i] * this->chunkdims_[i];
+      hsize_t end = start + this->chunkdims_[i];
+      if (!isUnlimited(this->maxdims_[i]) && this->maxdims_[i] < end) end = this->maxdims_[i];
+      if (offset[i] > start) started = true;
+      if (offset[i] + count[i] < end) completes = false;
+    }
+    this->touch(key, started, completes);
+    int dim = this->rank_ - 1;
+    while (dim >= 0 && key[dim] == last[dim]){
+      key[dim] = first[dim];
+      dim--;
+    }
+    if (dim < 0) break;
+    key[dim]++;
+  }
+}
+
+/** Record a flush of the dataset.  Chunks stay in the cache but incomplete ones are written.
+ */
+void NDFileHDF5ChunkTracker::flush()
+{
+  for (long slot = this->head_[Incomplete]; slot >= 0; slot = this->slots_[slot].next){
+    this->partialFlushes_++;
+  }
+}
+
+unsigned long NDFileHDF5ChunkTracker::getAccesses() const
+{
+  return this->accesses_;
+}
+
+unsigned long NDFileHDF5ChunkTracker::getMisses() const
+{
+  return this->misses_;
+}
+
+unsigned long NDFileHDF5ChunkTracker::getPartialFlushes() const
+{
+  return this->partialFlushes_;
+}
+
+/** Fraction of chunk accesses that did not need the chunk to be read back from the file.
+ */
+double NDFileHDF5ChunkTracker::getHitRate() const
+{
+  if (this->accesses_ == 0) return 1.0;
+  return (double)(this->accesses_ - this->misses_) / (double)this->accesses_;
+}
+
+/** Estimate the chunk cache hit rate for frames appended to a dataset.
+ * Each write covers one frame, the last frameRank dimensions, at one position of the
+ * other (extra) dimensions, with the fastest extra dimension advancing first.  A chunk
+ * spanning several frames stays incomplete until all of its frames are written, and every
+ * chunk that is incomplete at the same time must fit in the cache.  If they do, every
+ * access hits; otherwise each chunk is evicted between its frames and only the first
+ * access of each chunk avoids a read.
+ * \param[in] rank - Number of dimensions of the dataset.
+ * \param[in] frameRank - Number of dimensions of one frame.
+ * \param[in] chunkdims - Chunk dimensions, slowest varying first.
+ * \param[in] maxdims - Maximum dimensions, 0 or H5S_UNLIMITED for an unlimited dimension.
+ * \param[in] elementSize - Size in bytes of one element.
+ * \param[in] cacheBytes - Size in bytes of the chunk cache.
+ */
+double NDFileHDF5ChunkTracker::expectedHitRate(int rank, int frameRank, const hsize_t *chunkdims,
+                                               const hsize_t *maxdims, size_t elementSize, size_t cacheBytes)
+{
+  int extraRank = rank - frameRank;
+  double chunkBytes = (double)elementSize;
+  double framesPerChunk = 1.0;
+  double openChunks = 1.0;
+  int slowest = -1;
+
+  for (int i = 0; i < rank; i++) chunkBytes *= (double)chunkdims[i];
+  for (int i = extraRank; i < rank; i++){
+    openChunks *= (double)((maxdims[i] + chunkdims[i] - 1) / chunkdims[i]);
+  }
+  for (int i = 0; i < extraRank; i++){
+    framesPerChunk *= (double)chunkdims[i];
+    if (slowest < 0 && chunkdims[i] > 1) slowest = i;
+  }
+  if (slowest < 0) return 1.0;
+
+  // Chunks along the extra dimensions faster than the slowest chunked one are all open
+  for (int i = slowest + 1; i < extraRank; i++){
+    if (isUnlimited(maxdims[i])) return 1.0 / framesPerChunk;
+    openChunks *= (double)((maxdims[i] + chunkdims[i] - 1) / chunkdims[i]);
+  }
+  if (chunkBytes <= (double)cacheBytes && openChunks * chunkBytes <= (double)cacheBytes){
+    return 1.0;
+  }
+  return 1.0 / framesPerChunk;
+}
+
+/** Record one access to a chunk.
+ * \param[in] key - Scaled chunk indices, rank elements.
+ * \param[in] started - Part of the chunk was written by earlier writes.
+ * \param[in] completes - This write fills the rest of the chunk.
+ */
+void NDFileHDF5ChunkTracker::touch(const hsize_t *key, bool started, bool completes)
+{
+  size_t slot = this->hashSlot(key);
+  hsize_t *slotKey = &this->slotKeys_[slot * this->rank_];
+  bool resident = this->slots_[slot].used;
+  for (int i = 0; i < this->rank_ && resident; i++){
+    resident = slotKey[i] == key[i];
+  }
+
+  this->accesses_++;
+  // Part of this chunk is already in the file and has to be read back
+  if (started && !resident) this->misses_++;
+
+  if (this->chunkBytes_ > this->cacheBytes_){
+    // Chunks larger than the cache are written straight to the file
+    if (!completes) this->partialFlushes_++;
+    return;
+  }
+
+  if (resident){
+    this->unlink(slot);
+  } else {
+    // A different chunk in the same hash slot is evicted first
+    if (this->slots_[slot].used) this->evict(slot);
+    for (int i = 0; i < this->rank_; i++) slotKey[i] = key[i];
+    this->slots_[slot].used = true;
+    this->residentBytes_ += this->chunkBytes_;
+  }
+  this->link(slot, completes ? Complete : Incomplete);
+
+  // Make room, evicting the least recently used complete chunks before incomplete ones
+  while (this->residentBytes_ > this->cacheBytes_){
+    long victim = this->tail_[Complete];
+    if (victim < 0 || victim == (long)slot) victim = this->tail_[Incomplete];
+    if (victim < 0 || victim == (long)slot) break;
+    this->evict((size_t)victim);
+  }
+}
+
+/** Remove the chunk in a hash slot from the cache, writing it to the file.
+ */
+void NDFileHDF5ChunkTracker::evict(size_t slot)
+{
+  if (this->slots_[slot].list == Incomplete) this->partialFlushes_++;
+  this->unlink(slot);
+  this->slots_[slot].used = false;
+  this->residentBytes_ -= this->chunkBytes_;
+}
+
+/** Insert a hash slot as the most recently used of a list.
+ */
+void NDFileHDF5ChunkTracker::link(size_t slot, int list)
+{
+  Slot& entry = this->slots_[slot];
+  entry.list = list;
+  entry.prev = -1;
+  entry.next = this->head_[list];
+  if (entry.next >= 0) this->slots_[entry.next].prev = (long)slot;
+  else this->tail_[list] = (long)slot;
+  this->head_[list] = (long)slot;
+}
+
+/** Remove a hash slot from its list.
+ */
+void NDFileHDF5ChunkTracker::unlink(size_t slot)
+{
+  Slot& entry = this->slots_[slot];
+  if (entry.prev >= 0) this->slots_[entry.prev].next = entry.next;
+  else this->head_[entry.list] = entry.next;
+  if (entry.next >= 0) this->slots_[entry.next].prev = entry.prev;
+  else this->tail_[entry.list] = entry.prev;
+}
+
+/** Hash slot of a chunk, combining the scaled chunk indices as HDF5 does.
+ */
+size_t NDFileHDF5ChunkTracker::hashSlot(const hsize_t *key) const
+{
+  hsize_t value = key[0];
+  for (int i = 1; i < this->rank_; i++){
+    value <<= this->encodeBits_[i];
+    value ^= key[i];
+  }
+  return (size_t)(value % this->cacheSlots_);
+}
@@ -0,0 +1,83 @@
+/*
+ * NDFileHDF5ChunkTracker.h
+ *
+ * Follows the chunks touched by the writes to a chunked dataset through a model
+ * of the HDF5 raw data chunk cache.
+ */
+
+#ifndef ADAPP_PLUGINSRC_NDFILEHDF5CHUNKTRACKER_H_
+#define ADAPP_PLUGINSRC_NDFILEHDF5CHUNKTRACKER_H_
+
+#include <vector>
+#include <hdf5.h>
+
+/** Tracks the chunks written to a dataset as the HDF5 chunk cache would hold them.
+  * HDF5 does not report the behaviour of its raw data chunk cache, so every write and
+  * flush is replayed against a model with the same size, number of hash slots and
+  * preference for evicting fully written chunks (w0 = 1).  A write to a chunk that has
+  * already been written to the file before it was complete counts as a miss, since HDF5
+  * has to read the chunk back.  Writing an incomplete chunk to the file, because it was
+  * evicted, did not fit in the cache or was flushed, counts as a partial chunk flush.
+  * Writes are assumed to fill each chunk in order, as appending frames does, so whether
+  * a chunk was written before and whether a write completes it follow from the position
+  * of the write within the chunk, and nothing is kept for chunks outside the cache.
+  * The model holds at most one chunk per hash slot, so all its state is allocated by
+  * configure() and recording a write does not allocate.
+  */
+class NDFileHDF5ChunkTracker
+{
+public:
+  NDFileHDF5ChunkTracker();
+  virtual ~NDFileHDF5ChunkTracker();
+
+  void configure(int rank, const hsize_t *chunkdims, const hsize_t *maxdims,
+                 size_t elementSize, size_t cacheBytes, size_t cacheSlots);
+  void configure(hid_t dataset);
+  void reset();
+  void write(const hsize_t *offset, const hsize_t *count);
+  void flush();
+  unsigned long getAccesses() const;
+  unsigned long getMisses() const;
+  unsigned long getPartialFlushes() const;
+  double getHitRate() const;
+
+  static double expectedHitRate(int rank, int frameRank, const hsize_t *chunkdims, const hsize_t *maxdims,
+                                size_t elementSize, size_t cacheBytes);
+
+private:
+  /** The resident chunks are kept in two least recently used lists, linked through the hash slots */
+  enum { Incomplete, Complete };
+  struct Slot {
+    bool used;                             // Holds a resident chunk
+    int list;                              // Incomplete or Complete
+    long prev;                             // More recently used slot in the same list, or -1
+    long next;                             // Less recently used slot in the same list, or -1
+  };
+
+  void touch(const hsize_t *key, bool started, bool completes);
+  void evict(size_t slot);
+  void link(size_t slot, int list);
+  void unlink(size_t slot);
+  size_t hashSlot(const hsize_t *key) const;
+
+  int rank_;
+  std::vector<hsize_t> chunkdims_;
+  std::vector<hsize_t> maxdims_;
+  std::vector<unsigned> encodeBits_;
+  size_t chunkBytes_;
+  size_t cacheBytes_;
+  size_t cacheSlots_;
+  size_t residentBytes_;
+  std::vector<Slot> slots_;                // One entry per hash slot
+  std::vector<hsize_t> slotKeys_;          // Scaled chunk indices of the chunk in each slot, rank_ per slot
+  long head_[2];                           // Most recently used slot of each list, or -1
+  long tail_[2];                           // Least recently used slot of each list, or -1
+  std::vector<hsize_t> first_;             // Work space of write(), rank_ elements each
+  std::vector<hsize_t> last_;
+  std::vector<hsize_t> key_;
+  unsigned long accesses_;
+  unsigned long misses_;
+  unsigned long partialFlushes_;
+};
+
+#endif /* ADAPP_PLUGINSRC_NDFILEHDF5CHUNKTRACKER_H_ */
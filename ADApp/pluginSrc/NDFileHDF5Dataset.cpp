@@ -28,6 +28,7 @@ NDFileHDF5Dataset::NDFileHDF5Dataset(asynUser *pAsynUser, const std::string& nam
   this->offset_      = NULL;
   this->virtualdims_ = NULL;
   this->virtualchunkdims_ = NULL;
+  if (dataset >= 0) this->chunkTracker_.configure(dataset);
 }
 
 NDFileHDF5Dataset::~NDFileHDF5Dataset()
@@ -352,6 +353,8 @@ asynStatus NDFileHDF5Dataset::writeFile(NDArray *pArray, hid_t datatype, hid_t d
               "%s::%s NDArray not correctly chunked. Using standard write\n",
               fileName, functionName);
     hdfstatus = H5Dwrite(this->dataset_, datatype, dataspace, fspace, H5P_DEFAULT, pArray->pData);
+    // Direct chunk writes bypass the chunk cache, so only these writes are followed
+    this->chunkTracker_.write(this->offset_, framesize);
   }
 
   if (hdfstatus){
@@ -399,6 +402,7 @@ asynStatus NDFileHDF5Dataset::flushDataset()
               fileName, functionName, this->name_.c_str());
     return asynError;
   }
+  this->chunkTracker_.flush();
   #else
   // If this is called when we do not support SWMR then someone has done something
   // bad, so return an asynError
@@ -411,6 +415,13 @@ asynStatus NDFileHDF5Dataset::flushDataset()
   return asynSuccess;
 }
 
+/** Return the tracker following the chunk cache of this dataset.
+  */
+NDFileHDF5ChunkTracker *NDFileHDF5Dataset::getChunkTracker()
+{
+  return &this->chunkTracker_;
+}
+
 /** Return the requested dimension size.
   * \param[in] index of dimension
   * \return size of the dimension
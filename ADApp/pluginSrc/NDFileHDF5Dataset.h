@@ -5,6 +5,7 @@
 #include <hdf5.h>
 #include "NDPluginFile.h"
 #include "NDFileHDF5VersionCheck.h"
+#include "NDFileHDF5ChunkTracker.h"
 
 /** Class used for writing a Dataset with the NDFileHDF5 plugin.
   */
@@ -26,6 +27,7 @@ class NDFileHDF5Dataset
     hsize_t getMaxDim(int index);
     hsize_t getOffset(int index);
     hsize_t getVirtualDim(int index);
+    NDFileHDF5ChunkTracker *getChunkTracker();
 
   private:
 
@@ -44,6 +46,7 @@ class NDFileHDF5Dataset
     hsize_t     *virtualdims_; // The desired sizes of the extra (virtual) dimensions: {Y, X, n}
     hsize_t     *virtualchunkdims_;   // The chunk sizes of the extra (virtual) dimensions: {Y, X, n}
     Codec_t codec;             // Definition of codec used to compress the data.
+    NDFileHDF5ChunkTracker chunkTracker_; // Follows the chunk cache through the writes to this dataset
 };
 
 
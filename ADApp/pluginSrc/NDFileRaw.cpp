@@ -0,0 +1,388 @@
+/* NDFileRaw.cpp
+ * Writes NDArrays to raw binary files.
+ *
+ * The data of each array is appended to the file with no header.  With direct I/O enabled
+ * the file is opened with O_DIRECT and all writes are made from a staging buffer aligned to
+ * the device block size, so that streaming at high rates does not fill the page cache.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <iocsh.h>
+#include "NDPluginFile.h"
+#include "NDFileRaw.h"
+
+#include <epicsExport.h>
+
+#ifdef O_DIRECT
+  #include <unistd.h>
+  #define HAVE_DIRECT_IO
+#endif
+
+#define DEFAULT_BLOCK_SIZE  4096
+#define DEFAULT_BUFFER_SIZE (4*1024*1024)
+
+static const char *driverName = "NDFileRaw";
+
+/** Opens a raw file.
+  * \param[in] fileName The name of the file to open.
+  * \param[in] openMode Mask defining how the file should be opened; bits are
+  *            NDFileModeRead, NDFileModeWrite, NDFileModeAppend, NDFileModeMultiple
+  * \param[in] pArray A pointer to an NDArray; not used by this plugin.
+  */
+asynStatus NDFileRaw::openFile(const char *fileName, NDFileOpenMode_t openMode, NDArray *pArray)
+{
+    static const char *functionName = "openFile";
+    int directIO, blockSizeParam, bufferSizeParam;
+    int directActive = 0;
+
+    /* We don't support reading yet */
+    if (openMode & NDFileModeRead) return(asynError);
+
+    /* We don't support opening an existing file for appending yet */
+    if (openMode & NDFileModeAppend) return(asynError);
+
+    /* Must lock when accessing parameter library */
+    this->lock();
+    getIntegerParam(NDFileRawDirectIO, &directIO);
+    getIntegerParam(NDFileRawBlockSize, &blockSizeParam);
+    getIntegerParam(NDFileRawBufferSize, &bufferSizeParam);
+    this->unlock();
+
+    this->fileBytes = 0;
+    this->bufferUsed = 0;
+
+    if (directIO) {
+#ifdef HAVE_DIRECT_IO
+        /* The staging buffer is a whole number of blocks and starts on a block boundary */
+        this->blockSize = blockSizeParam;
+        this->bufferSize = ((size_t)bufferSizeParam + this->blockSize - 1) / this->blockSize * this->blockSize;
+        free(this->bufferAlloc);
+        this->bufferAlloc = (char *)malloc(this->bufferSize + this->blockSize);
+        if (this->bufferAlloc == NULL) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s error allocating %lu byte staging buffer\n",
+                driverName, functionName, (unsigned long)this->bufferSize);
+            return(asynError);
+        }
+        this->buffer = (char *)(((size_t)this->bufferAlloc + this->blockSize - 1) / this->blockSize * this->blockSize);
+        this->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+        if (this->fd >= 0) {
+            directActive = 1;
+        } else if (errno == EINVAL) {
+            /* Some file systems (e.g. tmpfs) do not support O_DIRECT */
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_WARNING,
+                "%s:%s file system does not support direct I/O for %s, using buffered I/O\n",
+                driverName, functionName, fileName);
+        } else {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s error opening file %s, errno=%d\n",
+                driverName, functionName, fileName, errno);
+            return(asynError);
+        }
+#else
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_WARNING,
+            "%s:%s direct I/O is not supported on this platform, using buffered I/O\n",
+            driverName, functionName);
+#endif
+    }
+
+    if (!directActive) {
+        if ((this->outFile = fopen(fileName, "wb")) == NULL ) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s error opening file %s\n",
+                driverName, functionName, fileName);
+            return(asynError);
+        }
+    }
+
+    this->lock();
+    setIntegerParam(NDFileRawDirectIOActive, directActive);
+    callParamCallbacks();
+    this->unlock();
+    return(asynSuccess);
+}
+
+/** Writes the data of a single NDArray to the raw file.
+  * \param[in] pArray Pointer to the NDArray to be written
+  */
+asynStatus NDFileRaw::writeFile(NDArray *pArray)
+{
+    NDArrayInfo_t arrayInfo;
+    size_t nBytes;
+    static const char *functionName = "writeFile";
+
+    pArray->getInfo(&arrayInfo);
+    nBytes = pArray->codec.empty() ? arrayInfo.totalBytes : pArray->compressedSize;
+
+    asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
+              "%s:%s: writing %lu bytes\n",
+              driverName, functionName, (unsigned long)nBytes);
+
+    if (this->fd >= 0) {
+        return this->writeDirect((const char *)pArray->pData, nBytes);
+    }
+    if (this->outFile == NULL) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s:%s: file is not open\n",
+            driverName, functionName);
+        return(asynError);
+    }
+    if (fwrite(pArray->pData, 1, nBytes, this->outFile) != nBytes) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s:%s: error writing data to file\n",
+            driverName, functionName);
+        return(asynError);
+    }
+    this->fileBytes += nBytes;
+    return(asynSuccess);
+}
+
+/** Appends data to a file opened for direct I/O.
+  * Data is gathered into the aligned staging buffer and written a full buffer at a time.
+  * While the staging buffer is empty, block aligned data is written straight from the array
+  * without being copied.
+  * \param[in] pData Pointer to the data to write
+  * \param[in] nBytes Number of bytes to write
+  */
+asynStatus NDFileRaw::writeDirect(const char *pData, size_t nBytes)
+{
+    size_t nCopy;
+
+    if ((this->bufferUsed == 0) && ((size_t)pData % this->blockSize == 0) && (nBytes >= this->blockSize)) {
+        nCopy = nBytes - nBytes % this->blockSize;
+        if (this->writeBuffer(pData, nCopy)) return(asynError);
+        pData += nCopy;
+        nBytes -= nCopy;
+    }
+    while (nBytes > 0) {
+        nCopy = this->bufferSize - this->bufferUsed;
+        if (nCopy > nBytes) nCopy = nBytes;
+        memcpy(this->buffer + this->bufferUsed, pData, nCopy);
+        this->bufferUsed += nCopy;
+        pData += nCopy;
+        nBytes -= nCopy;
+        if (this->bufferUsed == this->bufferSize) {
+            if (this->writeBuffer(this->buffer, this->bufferSize)) return(asynError);
+            this->bufferUsed = 0;
+        }
+    }
+    return(asynSuccess);
+}
+
+/** Writes block aligned data to the file descriptor, retrying after partial writes.
+  * \param[in] pData Pointer to the data to write; must be aligned to blockSize
+  * \param[in] nBytes Number of bytes to write; must be a multiple of blockSize
+  */
+asynStatus NDFileRaw::writeBuffer(const char *pData, size_t nBytes)
+{
+#ifdef HAVE_DIRECT_IO
+    static const char *functionName = "writeBuffer";
+    ssize_t nWritten;
+
+    while (nBytes > 0) {
+        nWritten = write(this->fd, pData, nBytes);
+        if (nWritten < 0) {
+            if (errno == EINTR) continue;
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: error writing data to file, errno=%d\n",
+                driverName, functionName, errno);
+            return(asynError);
+        }
+        pData += nWritten;
+        nBytes -= nWritten;
+        this->fileBytes += nWritten;
+    }
+    return(asynSuccess);
+#else
+    return(asynError);
+#endif
+}
+
+/** Reads single NDArray from a raw file; NOT CURRENTLY IMPLEMENTED.
+  * \param[in] pArray Pointer to the NDArray to be read
+  */
+asynStatus NDFileRaw::readFile(NDArray **pArray)
+{
+    //static const char *functionName = "readFile";
+
+    return asynError;
+}
+
+
+/** Closes the raw file.
+  * With direct I/O the partly filled staging buffer is written padded to a whole block,
+  * and the file is then truncated to the number of data bytes written.
+  */
+asynStatus NDFileRaw::closeFile()
+{
+    asynStatus status = asynSuccess;
+    static const char *functionName = "closeFile";
+
+    if (this->outFile) {
+        if (fclose(this->outFile) != 0) status = asynError;
+        this->outFile = NULL;
+    }
+#ifdef HAVE_DIRECT_IO
+    if (this->fd >= 0) {
+        epicsUInt64 dataBytes = this->fileBytes + this->bufferUsed;
+        if (this->bufferUsed > 0) {
+            size_t nPadded = (this->bufferUsed + this->blockSize - 1) / this->blockSize * this->blockSize;
+            memset(this->buffer + this->bufferUsed, 0, nPadded - this->bufferUsed);
+            status = this->writeBuffer(this->buffer, nPadded);
+            this->bufferUsed = 0;
+        }
+        if (ftruncate(this->fd, (off_t)dataBytes) != 0) {
+            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s:%s: error truncating file, errno=%d\n",
+                driverName, functionName, errno);
+            status = asynError;
+        }
+        this->fileBytes = dataBytes;
+        if (close(this->fd) != 0) status = asynError;
+        this->fd = -1;
+    }
+#endif
+    if (status) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s:%s: error closing file\n",
+            driverName, functionName);
+    }
+    return status;
+}
+
+/** Called when asyn clients call pasynInt32->write().
+  * Validates the direct I/O block and buffer sizes, which can only be changed while no file is open,
+  * and calls NDPluginFile::writeInt32 for all other parameters.
+  * \param[in] pasynUser pasynUser structure that encodes the reason and address.
+  * \param[in] value The value to write.
+  */
+asynStatus NDFileRaw::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    int function = pasynUser->reason;
+    int oldValue;
+    asynStatus status = asynSuccess;
+    static const char *functionName = "writeInt32";
+
+    if ((function == NDFileRawDirectIO) ||
+        (function == NDFileRawBlockSize) ||
+        (function == NDFileRawBufferSize)) {
+        getIntegerParam(function, &oldValue);
+        if ((this->outFile != NULL) || (this->fd >= 0)) {
+            status = asynError;
+        } else if ((function == NDFileRawBlockSize) &&
+                   ((value < 512) || ((value & (value - 1)) != 0))) {
+            /* Device blocks are a power of 2 and at least one sector */
+            status = asynError;
+        } else if ((function == NDFileRawBufferSize) && (value < 1)) {
+            status = asynError;
+        }
+        if (status) {
+            asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                "%s:%s: cannot set function=%d to value=%d\n",
+                driverName, functionName, function, value);
+            value = oldValue;
+        }
+        setIntegerParam(function, value);
+        callParamCallbacks();
+    } else {
+        status = NDPluginFile::writeInt32(pasynUser, value);
+    }
+    return status;
+}
+
+
+/** Constructor for NDFileRaw; all parameters are simply passed to NDPluginFile::NDPluginFile.
+  * \param[in] portName The name of the asyn port driver to be created.
+  * \param[in] queueSize The number of NDArrays that the input queue for this plugin can hold when
+  *            NDPluginDriverBlockingCallbacks=0.  Larger queues can decrease the number of dropped arrays,
+  *            at the expense of more NDArray buffers being allocated from the underlying driver's NDArrayPool.
+  * \param[in] blockingCallbacks Initial setting for the NDPluginDriverBlockingCallbacks flag.
+  *            0=callbacks are queued and executed by the callback thread; 1 callbacks execute in the thread
+  *            of the driver doing the callbacks.
+  * \param[in] NDArrayPort Name of asyn port driver for initial source of NDArray callbacks.
+  * \param[in] NDArrayAddr asyn port driver address for initial source of NDArray callbacks.
+  * \param[in] priority The thread priority for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
+  * \param[in] stackSize The stack size for the asyn port driver thread if ASYN_CANBLOCK is set in asynFlags.
+  */
+NDFileRaw::NDFileRaw(const char *portName, int queueSize, int blockingCallbacks,
+                     const char *NDArrayPort, int NDArrayAddr,
+                     int priority, int stackSize)
+    /* Invoke the base class constructor.
+     * We allocate 2 NDArrays of unlimited size in the NDArray pool.
+     * This driver can block (because writing a file can be slow), and it is not multi-device.
+     * Set autoconnect to 1.  priority and stacksize can be 0, which will use defaults. */
+    : NDPluginFile(portName, queueSize, blockingCallbacks,
+                   NDArrayPort, NDArrayAddr, 1,
+                   2, 0, asynGenericPointerMask, asynGenericPointerMask,
+                   ASYN_CANBLOCK, 1, priority, stackSize, 1),
+      outFile(NULL), fd(-1), bufferAlloc(NULL), buffer(NULL),
+      bufferSize(0), bufferUsed(0), blockSize(DEFAULT_BLOCK_SIZE), fileBytes(0)
+{
+    //static const char *functionName = "NDFileRaw";
+
+    createParam(NDFileRawDirectIOString,       asynParamInt32, &NDFileRawDirectIO);
+    createParam(NDFileRawDirectIOActiveString, asynParamInt32, &NDFileRawDirectIOActive);
+    createParam(NDFileRawBlockSizeString,      asynParamInt32, &NDFileRawBlockSize);
+    createParam(NDFileRawBufferSizeString,     asynParamInt32, &NDFileRawBufferSize);
+
+    /* Set the plugin type string */
+    setStringParam(NDPluginDriverPluginType, "NDFileRaw");
+    this->supportsMultipleArrays = 1;
+    setIntegerParam(NDFileRawDirectIO, 0);
+    setIntegerParam(NDFileRawDirectIOActive, 0);
+    setIntegerParam(NDFileRawBlockSize, DEFAULT_BLOCK_SIZE);
+    setIntegerParam(NDFileRawBufferSize, DEFAULT_BUFFER_SIZE);
+}
+
+NDFileRaw::~NDFileRaw()
+{
+    free(this->bufferAlloc);
+}
+
+/* Configuration routine.  Called directly, or from the iocsh  */
+
+extern "C" int NDFileRawConfigure(const char *portName, int queueSize, int blockingCallbacks,
+                                  const char *NDArrayPort, int NDArrayAddr,
+                                  int priority, int stackSize)
+{
+    NDFileRaw *pPlugin = new NDFileRaw(portName, queueSize, blockingCallbacks, NDArrayPort, NDArrayAddr,
+                                       priority, stackSize);
+    return pPlugin->start();
+}
+
+
+/* EPICS iocsh shell commands */
+
+static const iocshArg initArg0 = { "portName",iocshArgString};
+static const iocshArg initArg1 = { "frame queue size",iocshArgInt};
+static const iocshArg initArg2 = { "blocking callbacks",iocshArgInt};
+static const iocshArg initArg3 = { "NDArray Port",iocshArgString};
+static const iocshArg initArg4 = { "NDArray Addr",iocshArgInt};
+static const iocshArg initArg5 = { "priority",iocshArgInt};
+static const iocshArg initArg6 = { "stack size",iocshArgInt};
+static const iocshArg * const initArgs[] = {&initArg0,
+                                            &initArg1,
+                                            &initArg2,
+                                            &initArg3,
+                                            &initArg4,
+                                            &initArg5,
+                                            &initArg6};
+static const iocshFuncDef initFuncDef = {"NDFileRawConfigure",7,initArgs};
+static void initCallFunc(const iocshArgBuf *args)
+{
+    NDFileRawConfigure(args[0].sval, args[1].ival, args[2].ival, args[3].sval, args[4].ival, args[5].ival, args[6].ival);
+}
+
+extern "C" void NDFileRawRegister(void)
+{
+    iocshRegister(&initFuncDef,initCallFunc);
+}
+
+extern "C" {
+epicsExportRegistrar(NDFileRawRegister);
+}
@@ -0,0 +1,58 @@
+/*
+ * NDFileRaw.h
+ * Writes NDArrays to raw binary files, optionally bypassing the page cache.
+ */
+
+#ifndef DRV_NDFileRaw_H
+#define DRV_NDFileRaw_H
+
+#include <stdio.h>
+
+#include "NDPluginFile.h"
+
+#define NDFileRawDirectIOString        "RAW_DIRECT_IO"         /* (asynInt32, r/w) Write with O_DIRECT */
+#define NDFileRawDirectIOActiveString  "RAW_DIRECT_IO_ACTIVE"  /* (asynInt32, r/o) Current file uses O_DIRECT */
+#define NDFileRawBlockSizeString       "RAW_BLOCK_SIZE"        /* (asynInt32, r/w) Device block size in bytes */
+#define NDFileRawBufferSizeString      "RAW_BUFFER_SIZE"       /* (asynInt32, r/w) Aligned staging buffer size in bytes */
+
+/** Writes the data of each NDArray, with no header, to a raw binary file.
+  * Multiple arrays are appended to the same file.  When direct I/O is enabled the file is
+  * opened with O_DIRECT and written from a staging buffer aligned to the device block size,
+  * so that the data bypasses the operating system page cache.
+  */
+class NDPLUGIN_API NDFileRaw : public NDPluginFile {
+public:
+    NDFileRaw(const char *portName, int queueSize, int blockingCallbacks,
+              const char *NDArrayPort, int NDArrayAddr,
+              int priority, int stackSize);
+    ~NDFileRaw();
+
+    /* The methods that this class implements */
+    virtual asynStatus openFile(const char *fileName, NDFileOpenMode_t openMode, NDArray *pArray);
+    virtual asynStatus readFile(NDArray **pArray);
+    virtual asynStatus writeFile(NDArray *pArray);
+    virtual asynStatus closeFile();
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+
+protected:
+    int NDFileRawDirectIO;
+    #define FIRST_NDFILE_RAW_PARAM NDFileRawDirectIO
+    int NDFileRawDirectIOActive;
+    int NDFileRawBlockSize;
+    int NDFileRawBufferSize;
+
+private:
+    asynStatus writeDirect(const char *pData, size_t nBytes);
+    asynStatus writeBuffer(const char *pData, size_t nBytes);
+
+    FILE *outFile;          /**< Output file when direct I/O is not in use */
+    int fd;                 /**< Output file descriptor when direct I/O is in use, -1 otherwise */
+    char *bufferAlloc;      /**< Allocation holding the staging buffer */
+    char *buffer;           /**< Staging buffer aligned to blockSize */
+    size_t bufferSize;      /**< Size of the staging buffer, a multiple of blockSize */
+    size_t bufferUsed;      /**< Number of bytes currently held in the staging buffer */
+    size_t blockSize;       /**< Device block size used for alignment */
+    epicsUInt64 fileBytes;  /**< Number of data bytes written to the current file */
+};
+
+#endif
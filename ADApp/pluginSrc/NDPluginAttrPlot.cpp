@@ -65,13 +65,20 @@ NDPluginAttrPlot::NDPluginAttrPlot(const char * port, int n_attributes,
       uids_(cache_size),
       n_attributes_(n_attributes),
       attributes_(),
+      attribute_handles_(),
+      values_(n_attributes),
       n_data_blocks_(n_data_blocks),
       data_selections_(n_data_blocks, ND_ATTRPLOT_NONE_INDEX),
+      block_data_(n_data_blocks, std::vector<double>(cache_size, epicsNAN)),
+      data_version_(0),
+      block_versions_(n_data_blocks, 0),
+      block_invalid_(n_data_blocks, true),
       expose_task_(*this)
 {
     data_.reserve(n_attributes_);
     for (size_t i = 0; i < n_attributes_; ++i) {
         data_.push_back(CB(cache_size));
+        attribute_handles_.add("");
     }
 
     createParam(NDAttrPlotDataString, asynParamFloat64Array, &NDAttrPlotData);
@@ -97,37 +104,46 @@ void NDPluginAttrPlot::callback_data() {
 
     size_t size = uids_.size();
     size_t cache_size = uids_.max_size();
-    double * const tmp_arr = new double[cache_size];
 
     size_t n_copied;
     for (size_t i = 0; i < n_data_blocks_; ++i) {
         int selected = data_selections_[i];
+        bool has_data = selected == ND_ATTRPLOT_UID_INDEX ||
+                (selected >= 0 &&
+                 static_cast<unsigned>(selected) < data_.size());
+        // A block of "None" only changes when its selection does
+        if (!block_invalid_[i] &&
+                (!has_data || block_versions_[i] == data_version_)) {
+            continue;
+        }
+
+        double * const block = &block_data_[i][0];
         if (selected == ND_ATTRPLOT_UID_INDEX) {
-            n_copied = uids_.copy_to_array(tmp_arr, size);
-        } else if (selected >= 0 &&
-                static_cast<unsigned>(selected) < data_.size()) {
-            n_copied = data_[selected].copy_to_array(tmp_arr,
-                    size);
+            n_copied = uids_.copy_to_array(block, size);
+        } else if (has_data) {
+            n_copied = data_[selected].copy_to_array(block, size);
         } else {
-            std::fill(tmp_arr, tmp_arr + size, epicsNAN);
-            n_copied = size;
+            n_copied = 0;
         }
         // To remove visual artifacts on EDM plots fill
         // the remaining arrays with the last point
-        std::fill(tmp_arr + n_copied,
-                tmp_arr + cache_size,
-                *(tmp_arr + n_copied - 1));
-        doCallbacksFloat64Array(tmp_arr, cache_size, NDAttrPlotData, (int)i);
+        std::fill(block + n_copied, block + cache_size,
+                n_copied > 0 ? block[n_copied - 1] : epicsNAN);
+        doCallbacksFloat64Array(block, cache_size, NDAttrPlotData, (int)i);
+
+        block_versions_[i] = data_version_;
+        block_invalid_[i] = false;
     }
+}
 
-    delete[] tmp_arr;
+void NDPluginAttrPlot::invalidate_block(size_t block) {
+    block_invalid_[block] = true;
 }
 
 void NDPluginAttrPlot::processCallbacks(NDArray *pArray) {
-    NDAttributeList attr_list;
+    NDAttributeList& attr_list = *pArray->pAttributeList;
 
     NDPluginDriver::beginProcessCallbacks(pArray);
-    pArray->pAttributeList->copy(&attr_list);
 
     epicsInt32 uid;
     getIntegerParam(NDUniqueId, &uid);
@@ -160,7 +176,7 @@ void NDPluginAttrPlot::rebuild_attributes(NDAttributeList& attr_list) {
 
     attributes_.clear();
     for (NDAttribute * attr = attr_list.next(NULL);
-            attr != NULL && attributes_.size() <= n_attributes_;
+            attr != NULL && attributes_.size() < n_attributes_;
             attr = attr_list.next(attr)) {
         std::string name(attr->getName());
         NDAttrDataType_t type = attr->getDataType();
@@ -182,19 +198,30 @@ void NDPluginAttrPlot::rebuild_attributes(NDAttributeList& attr_list) {
 
     std::sort(attributes_.begin(), attributes_.end());
 
+    // The values of each frame are read by handle instead of by name
+    for (size_t i = 0; i < n_attributes_; ++i) {
+        attribute_handles_.setName((int)i,
+                i < attributes_.size() ? attributes_[i].c_str() : "");
+    }
+
     for (unsigned i = 0; i < n_data_blocks_; ++i) {
+        int selection;
         if (selections[i] == ND_ATTRPLOT_UID_LABEL) {
-            data_selections_[i] = ND_ATTRPLOT_UID_INDEX;
+            selection = ND_ATTRPLOT_UID_INDEX;
         } else {
             std::vector<std::string>::const_iterator attr_it =
                 std::find(attributes_.begin(), attributes_.end(),
                         selections[i]);
             if (attr_it != attributes_.end()) {
-                data_selections_[i] = (int)(attr_it - attributes_.begin());
+                selection = (int)(attr_it - attributes_.begin());
             } else {
-                data_selections_[i] = ND_ATTRPLOT_NONE_INDEX;
+                selection = ND_ATTRPLOT_NONE_INDEX;
             }
         }
+        if (selection != data_selections_[i]) {
+            data_selections_[i] = selection;
+            invalidate_block(i);
+        }
     }
 
     callback_attributes();
@@ -204,6 +231,7 @@ void NDPluginAttrPlot::rebuild_attributes(NDAttributeList& attr_list) {
 
 void NDPluginAttrPlot::reset_data() {
     state_ = NDAttrPlot_InitState;
+    ++data_version_;
     uids_.clear();
     for (std::vector<CB>::iterator it = data_.begin();
             it != data_.end(); ++it) {
@@ -242,28 +270,19 @@ void NDPluginAttrPlot::callback_selected() {
 
 asynStatus NDPluginAttrPlot::push_data(epicsInt32 uid, NDAttributeList& list) {
     size_t length = attributes_.size();
-    double *new_values = new double[length];
-    std::fill(new_values, new_values + length, epicsNAN);
 
     // Populate the new values with values from the attribute list
-    for (NDAttribute * attr = list.next(NULL);
-            attr != NULL; attr = list.next(attr)) {
-        std::string name(attr->getName());
-        std::vector<std::string>::const_iterator it = std::find(
-                attributes_.begin(), attributes_.end(), name);
-        if (it != attributes_.end()) {
-            ptrdiff_t index = it - attributes_.begin();
-            attr->getValue(NDAttrFloat64, &new_values[index], 1);
-        }
+    if (length > 0) {
+        attribute_handles_.getValues(&list, &values_[0], epicsNAN);
     }
 
     // Push the new values to the data block
     uids_.push_back(uid);
     for (size_t i = 0; i < length; ++i) {
-        data_[i].push_back(new_values[i]);
+        data_[i].push_back(values_[i]);
     }
 
-    delete [] new_values;
+    ++data_version_;
     return asynSuccess;
 }
 
@@ -284,6 +303,7 @@ asynStatus NDPluginAttrPlot::writeInt32(asynUser * pasynUser, epicsInt32 value)
             return asynError;
         }
         data_selections_[addr] = value;
+        invalidate_block(addr);
         callback_selected();
         callback_data();
         return asynSuccess;
@@ -18,6 +18,7 @@
 #include "CircularBuffer.h"
 
 #include <NDPluginDriver.h>
+#include <NDAttributeHandles.h>
 #include <epicsThread.h>
 
 #include <string>
@@ -185,9 +186,18 @@ private:
 
     /**
      * \brief Exposes the selected data fields to EPICS layer.
+     *
+     * Only the data blocks whose selection or data changed since they were
+     * last exposed are copied and published.
      */
     void callback_data();
 
+    /**
+     * \brief Marks a data block to be published on the next exposure.
+     * \param block Index of the data block.
+     */
+    void invalidate_block(size_t block);
+
     /**
      * \brief Exposes the attribute names to the EPICS layer.
      */
@@ -214,9 +224,27 @@ private:
     /** Attribute names of the saved data */
     std::vector<std::string> attributes_;
 
+    /** Handles of the saved attributes, indexed like attributes_ */
+    NDAttributeHandles attribute_handles_;
+
+    /** Values of the saved attributes for the current NDArray */
+    std::vector<double> values_;
+
     const unsigned n_data_blocks_;
     std::vector<int> data_selections_;
 
+    /** Output buffer of each data block, kept between exposures */
+    std::vector<std::vector<double> > block_data_;
+
+    /** Counter that changes whenever the cached data changes */
+    unsigned long data_version_;
+
+    /** Value of data_version_ when each data block was last published */
+    std::vector<unsigned long> block_versions_;
+
+    /** True for data blocks that must be published on the next exposure */
+    std::vector<bool> block_invalid_;
+
     /** Task that periodically exposes the data */
     ExposeDataTask expose_task_;
 };
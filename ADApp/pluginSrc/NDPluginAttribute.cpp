@@ -13,6 +13,7 @@
 #include <algorithm>
 
 #include <iocsh.h>
+#include <epicsMath.h>
 
 #include "NDPluginAttribute.h"
 
@@ -39,6 +40,7 @@ void NDPluginAttribute::processCallbacks(NDArray *pArray)
   int status = 0;
   double valueSum;
   int i;
+  int bulkMode;
   char attrName[MAX_ATTR_NAME_] = {0};
   NDAttribute *pAttribute = NULL;
   NDAttributeList *pAttrList = NULL;
@@ -49,6 +51,12 @@ void NDPluginAttribute::processCallbacks(NDArray *pArray)
   /* Call the base class method */
   NDPluginDriver::beginProcessCallbacks(pArray);
 
+  getIntegerParam(NDPluginAttributeBulkMode, &bulkMode);
+  if (bulkMode) {
+    doBulkCallbacks(pArray);
+    return;
+  }
+
   /* Get the attributes for this driver */
   pAttrList = pArray->pAttributeList;
 
@@ -66,7 +74,7 @@ void NDPluginAttribute::processCallbacks(NDArray *pArray)
     } else if (strcmp(attrName, EPICS_TS_NSEC_NAME_) == 0) {
       attrValue = (epicsFloat64)pArray->epicsTS.nsec;
     } else {
-      pAttribute = pAttrList->find(attrName);
+      pAttribute = attributeHandles_.get(pAttrList, i);
       if (pAttribute) {
         status = pAttribute->getValue(NDAttrFloat64, &attrValue);
         if (status != asynSuccess) {
@@ -110,6 +118,138 @@ void NDPluginAttribute::doTimeSeriesCallbacks(NDArray *pArray)
 }
 
 
+/** Adds the attribute values of an NDArray to the envelopes in bulk mode, and publishes the envelopes
+  * when the publish period has elapsed.
+  * \param[in] pArray  The NDArray from the callback.
+  */
+void NDPluginAttribute::doBulkCallbacks(NDArray *pArray)
+{
+  int i;
+  double publishPeriod;
+  epicsTimeStamp now;
+
+  /* Read all the attributes by handle; the virtual attributes have no name and are set below */
+  attributeHandles_.getValues(pArray->pAttributeList, &values_[0], epicsNAN);
+  for (i=0; i<maxAttributes_; i++) {
+    switch (sources_[i]) {
+      case AttrSourceUniqueId:
+        values_[i] = (epicsFloat64)pArray->uniqueId;
+        break;
+      case AttrSourceTimeStamp:
+        values_[i] = pArray->timeStamp;
+        break;
+      case AttrSourceEpicsTSSec:
+        values_[i] = (epicsFloat64)pArray->epicsTS.secPastEpoch;
+        break;
+      case AttrSourceEpicsTSnSec:
+        values_[i] = (epicsFloat64)pArray->epicsTS.nsec;
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (!envelope_.add(&values_[0])) return;
+
+  /* Publish when the period has elapsed, or before bins that were not published are overwritten */
+  if (envelope_.numNew() < envelope_.numBins()) {
+    getDoubleParam(NDPluginAttributePublishPeriod, &publishPeriod);
+    epicsTimeGetCurrent(&now);
+    if (epicsTimeDiffInSeconds(&now, &lastPublishTime_) < publishPeriod) return;
+  }
+  publishEnvelope(pArray);
+}
+
+
+/** Publishes the min, max and mean envelopes of each attribute, and passes the means of the bins
+  * completed since the last publish to the time series as one 2-D NDArray.
+  * \param[in] pArray  The NDArray from the callback, for the unique ID and time stamps.
+  */
+void NDPluginAttribute::publishEnvelope(NDArray *pArray)
+{
+  int i;
+  int numValid = envelope_.numValid();
+  double valueSum;
+  double lastMean;
+  size_t dims[2];
+  NDArray *pTimeSeriesArray;
+
+  for (i=0; i<maxAttributes_; i++) {
+    envelope_.get(NDAttributeEnvelope::Min, i, &envBuffer_[0]);
+    doCallbacksFloat64Array(&envBuffer_[0], numValid, NDPluginAttributeEnvMin, i);
+    envelope_.get(NDAttributeEnvelope::Max, i, &envBuffer_[0]);
+    doCallbacksFloat64Array(&envBuffer_[0], numValid, NDPluginAttributeEnvMax, i);
+    envelope_.get(NDAttributeEnvelope::Mean, i, &envBuffer_[0]);
+    doCallbacksFloat64Array(&envBuffer_[0], numValid, NDPluginAttributeEnvMean, i);
+    lastMean = envelope_.lastMean(i);
+    if (lastMean == lastMean) setDoubleParam(i, NDPluginAttributeVal, lastMean);
+    getDoubleParam(i, NDPluginAttributeValSum, &valueSum);
+    setDoubleParam(i, NDPluginAttributeValSum, valueSum + envelope_.newSum(i));
+    callParamCallbacks(i);
+  }
+
+  dims[0] = maxAttributes_;
+  dims[1] = envelope_.numNew();
+  pTimeSeriesArray = this->pNDArrayPool->alloc(2, dims, NDFloat64, 0, NULL);
+  if (pTimeSeriesArray) {
+    envelope_.getNewMeans((epicsFloat64 *)pTimeSeriesArray->pData);
+    pTimeSeriesArray->uniqueId  = pArray->uniqueId;
+    pTimeSeriesArray->timeStamp = pArray->timeStamp;
+    pTimeSeriesArray->epicsTS   = pArray->epicsTS;
+    doCallbacksGenericPointer(pTimeSeriesArray, NDArrayData, 1);
+    pTimeSeriesArray->release();
+  }
+  envelope_.markPublished();
+  epicsTimeGetCurrent(&lastPublishTime_);
+}
+
+
+/** Looks up the source of an attribute when its name changes, so that bulk mode does not compare names for each frame.
+  * \param[in] addr  The attribute address.
+  */
+void NDPluginAttribute::resolveAttrName(int addr)
+{
+  char attrName[MAX_ATTR_NAME_] = {0};
+  BulkSource_t source = AttrSourceAttribute;
+
+  getStringParam(addr, NDPluginAttributeAttrName, MAX_ATTR_NAME_, attrName);
+  if (strcmp(attrName, UNIQUE_ID_NAME_) == 0) {
+    source = AttrSourceUniqueId;
+  } else if (strcmp(attrName, TIMESTAMP_NAME_) == 0) {
+    source = AttrSourceTimeStamp;
+  } else if (strcmp(attrName, EPICS_TS_SEC_NAME_) == 0) {
+    source = AttrSourceEpicsTSSec;
+  } else if (strcmp(attrName, EPICS_TS_NSEC_NAME_) == 0) {
+    source = AttrSourceEpicsTSnSec;
+  }
+  sources_[addr] = source;
+  attributeHandles_.setName(addr, (source == AttrSourceAttribute) ? attrName : "");
+}
+
+
+/** Sizes the envelopes from the decimation and number of bins, and clears them.
+  * The bins are only allocated in bulk mode.
+  */
+void NDPluginAttribute::configureEnvelope()
+{
+  int bulkMode;
+  int decimation;
+  int numBins;
+
+  getIntegerParam(NDPluginAttributeBulkMode, &bulkMode);
+  getIntegerParam(NDPluginAttributeDecimation, &decimation);
+  getIntegerParam(NDPluginAttributeNumBins, &numBins);
+  if (decimation < 1) decimation = 1;
+  if (numBins < 1) numBins = 1;
+  setIntegerParam(NDPluginAttributeDecimation, decimation);
+  setIntegerParam(NDPluginAttributeNumBins, numBins);
+  if (!bulkMode) numBins = 1;
+  envelope_.configure(maxAttributes_, numBins, decimation);
+  envBuffer_.resize(numBins);
+  epicsTimeGetCurrent(&lastPublishTime_);
+}
+
+
 asynStatus NDPluginAttribute::writeInt32(asynUser *pasynUser, epicsInt32 value)
 {
   int function = pasynUser->reason;
@@ -125,6 +265,12 @@ asynStatus NDPluginAttribute::writeInt32(asynUser *pasynUser, epicsInt32 value)
       setDoubleParam(i, NDPluginAttributeVal, 0.0);
       setDoubleParam(i, NDPluginAttributeValSum, 0.0);
     }
+    envelope_.clear();
+  }
+  else if ((function == NDPluginAttributeBulkMode) ||
+           (function == NDPluginAttributeDecimation) ||
+           (function == NDPluginAttributeNumBins)) {
+    configureEnvelope();
   }
   else {
     /* If this parameter belongs to a base class call its method */
@@ -147,6 +293,33 @@ asynStatus NDPluginAttribute::writeInt32(asynUser *pasynUser, epicsInt32 value)
 }
 
 
+/** Called when asyn clients call pasynOctet->write().
+  * Resolves the source of an attribute when its name is written, and clears the envelopes.
+  * For all parameters it calls NDPluginDriver::writeOctet.
+  * \param[in] pasynUser pasynUser structure that encodes the reason and address.
+  * \param[in] value Address of the string to write.
+  * \param[in] nChars Number of characters to write.
+  * \param[out] nActual Number of characters actually written. */
+asynStatus NDPluginAttribute::writeOctet(asynUser *pasynUser, const char *value,
+                                         size_t nChars, size_t *nActual)
+{
+  int function = pasynUser->reason;
+  int addr;
+  asynStatus status;
+
+  status = NDPluginDriver::writeOctet(pasynUser, value, nChars, nActual);
+
+  if (function == NDPluginAttributeAttrName) {
+    getAddress(pasynUser, &addr);
+    if ((addr >= 0) && (addr < maxAttributes_)) {
+      resolveAttrName(addr);
+      envelope_.clear();
+    }
+  }
+  return status;
+}
+
+
 /** Constructor for NDPluginAttribute; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   *
   * \param[in] portName The name of the asyn port driver to be created.
@@ -182,21 +355,37 @@ NDPluginAttribute::NDPluginAttribute(const char *portName, int queueSize, int bl
 
   maxAttributes_ = maxAttributes;
   if (maxAttributes_ < 1) maxAttributes_ = 1;
+  for (i=0; i<maxAttributes_; i++) attributeHandles_.add("");
   /* parameters */
   createParam(NDPluginAttributeAttrNameString,       asynParamOctet,        &NDPluginAttributeAttrName);
   createParam(NDPluginAttributeResetString,          asynParamInt32,        &NDPluginAttributeReset);
   createParam(NDPluginAttributeValString,            asynParamFloat64,      &NDPluginAttributeVal);
   createParam(NDPluginAttributeValSumString,         asynParamFloat64,      &NDPluginAttributeValSum);
+  createParam(NDPluginAttributeBulkModeString,       asynParamInt32,        &NDPluginAttributeBulkMode);
+  createParam(NDPluginAttributeDecimationString,     asynParamInt32,        &NDPluginAttributeDecimation);
+  createParam(NDPluginAttributeNumBinsString,        asynParamInt32,        &NDPluginAttributeNumBins);
+  createParam(NDPluginAttributePublishPeriodString,  asynParamFloat64,      &NDPluginAttributePublishPeriod);
+  createParam(NDPluginAttributeEnvMinString,         asynParamFloat64Array, &NDPluginAttributeEnvMin);
+  createParam(NDPluginAttributeEnvMaxString,         asynParamFloat64Array, &NDPluginAttributeEnvMax);
+  createParam(NDPluginAttributeEnvMeanString,        asynParamFloat64Array, &NDPluginAttributeEnvMean);
 
   /* Set the plugin type string */
   setStringParam(NDPluginDriverPluginType, "NDPluginAttribute");
 
+  setIntegerParam(NDPluginAttributeBulkMode, 0);
+  setIntegerParam(NDPluginAttributeDecimation, 1);
+  setIntegerParam(NDPluginAttributeNumBins, DEFAULT_NUM_TSPOINTS);
+  setDoubleParam(NDPluginAttributePublishPeriod, 1.0);
+
+  sources_.assign(maxAttributes_, AttrSourceAttribute);
+  values_.resize(maxAttributes_);
   for (i=0; i<maxAttributes_; i++) {
     setDoubleParam(i, NDPluginAttributeVal, 0.0);
     setDoubleParam(i, NDPluginAttributeValSum, 0.0);
     setStringParam(i, NDPluginAttributeAttrName, "");
     callParamCallbacks(i);
   }
+  configureEnvelope();
 
   // Disable ArrayCallbacks.
   // This plugin currently does not do array callbacks, so make the setting reflect the behavior
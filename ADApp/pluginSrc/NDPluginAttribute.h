@@ -2,15 +2,27 @@
 #ifndef NDPluginAttribute_H
 #define NDPluginAttribute_H
 
+#include <vector>
+
 #include <epicsTypes.h>
+#include <epicsTime.h>
 
 #include "NDPluginDriver.h"
+#include "NDAttributeHandles.h"
+#include "NDAttributeEnvelope.h"
 
 /* General parameters */
 #define NDPluginAttributeAttrNameString       "ATTR_ATTRNAME"         /* (asynInt32,        r/w) Name of Attribute */
 #define NDPluginAttributeResetString          "ATTR_RESET"            /* (asynInt32,        r/w) Clear the sum data */
 #define NDPluginAttributeValString            "ATTR_VAL"              /* (asynFloat64,      r/o) Value of Attribute */
 #define NDPluginAttributeValSumString         "ATTR_VAL_SUM"          /* (asynFloat64,      r/o) Integrated Value of Attribute */
+#define NDPluginAttributeBulkModeString       "ATTR_BULK_MODE"        /* (asynInt32,        r/w) Decimate the values instead of publishing each frame */
+#define NDPluginAttributeDecimationString     "ATTR_DECIMATION"       /* (asynInt32,        r/w) Number of frames in each bin in bulk mode */
+#define NDPluginAttributeNumBinsString        "ATTR_NUM_BINS"         /* (asynInt32,        r/w) Number of bins in the envelopes */
+#define NDPluginAttributePublishPeriodString  "ATTR_PUBLISH_PERIOD"   /* (asynFloat64,      r/w) Minimum time between publishing the envelopes */
+#define NDPluginAttributeEnvMinString         "ATTR_ENV_MIN"          /* (asynFloat64Array, r/o) Minimum of Attribute in each bin */
+#define NDPluginAttributeEnvMaxString         "ATTR_ENV_MAX"          /* (asynFloat64Array, r/o) Maximum of Attribute in each bin */
+#define NDPluginAttributeEnvMeanString        "ATTR_ENV_MEAN"         /* (asynFloat64Array, r/o) Mean of Attribute in each bin */
 
 /** Extract an Attribute from an NDArray and publish the value (and array of values) over channel access.  */
 class NDPLUGIN_API NDPluginAttribute : public NDPluginDriver {
@@ -22,6 +34,7 @@ public:
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
     asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t nChars, size_t *nActual);
 
 protected:
     int NDPluginAttributeAttrName;
@@ -29,10 +42,30 @@ protected:
     int NDPluginAttributeReset;
     int NDPluginAttributeVal;
     int NDPluginAttributeValSum;
+    int NDPluginAttributeBulkMode;
+    int NDPluginAttributeDecimation;
+    int NDPluginAttributeNumBins;
+    int NDPluginAttributePublishPeriod;
+    int NDPluginAttributeEnvMin;
+    int NDPluginAttributeEnvMax;
+    int NDPluginAttributeEnvMean;
 
 private:
 
+    /** Where bulk mode reads the value of an attribute from */
+    typedef enum {
+        AttrSourceAttribute,
+        AttrSourceUniqueId,
+        AttrSourceTimeStamp,
+        AttrSourceEpicsTSSec,
+        AttrSourceEpicsTSnSec
+    } BulkSource_t;
+
     void doTimeSeriesCallbacks(NDArray *pArray);
+    void resolveAttrName(int addr);
+    void configureEnvelope();
+    void doBulkCallbacks(NDArray *pArray);
+    void publishEnvelope(NDArray *pArray);
     static const epicsInt32 MAX_ATTR_NAME_;
     static const char*      UNIQUE_ID_NAME_;
     static const char*      TIMESTAMP_NAME_;
@@ -40,6 +73,12 @@ private:
     static const char*      EPICS_TS_NSEC_NAME_;
 
     int maxAttributes_;
+    NDAttributeHandles attributeHandles_;  /**< Handles of the attribute names, indexed by addr */
+    std::vector<BulkSource_t> sources_;     /**< Source of each attribute, indexed by addr */
+    std::vector<epicsFloat64> values_;      /**< Values of the current frame in bulk mode, indexed by addr */
+    std::vector<epicsFloat64> envBuffer_;   /**< Buffer for the envelope callbacks */
+    NDAttributeEnvelope envelope_;          /**< Decimated values in bulk mode */
+    epicsTimeStamp lastPublishTime_;        /**< Time the envelopes were last published */
 
 };
 
@@ -51,7 +51,8 @@ NDPluginBadPixel::NDPluginBadPixel(const char *portName, int queueSize, int bloc
                      NDArrayPort, NDArrayAddr, 1, maxBuffers, maxMemory,
                      asynOctetMask | asynGenericPointerMask,
                      asynOctetMask | asynGenericPointerMask,
-                     0, 1, priority, stackSize, maxThreads)
+                     0, 1, priority, stackSize, maxThreads),
+      listVersion_(0)
 { 
     //static const char *functionName = "NDPluginBadPixel";
 
@@ -69,7 +70,7 @@ NDPluginBadPixel::NDPluginBadPixel(const char *portName, int queueSize, int bloc
     connectToArrayPort();
 }
 
-epicsInt64 NDPluginBadPixel::computePixelOffset(pixelCoordinate coord, badPixDimInfo_t& dimInfo, NDArrayInfo_t *pArrayInfo)
+epicsInt64 NDPluginBadPixel::computePixelOffset(pixelCoordinate coord, badPixDimInfo_t& dimInfo)
 {
     // This function should return -1 if either the X or Y coordinate is out of range
     // It should be enhanced to deal with the following detector readout settings.
@@ -85,16 +86,13 @@ epicsInt64 NDPluginBadPixel::computePixelOffset(pixelCoordinate coord, badPixDim
         (x < dimInfo.sizeX) &&
         (y < dimInfo.sizeY))
     {
-        offset = y * pArrayInfo->xSize + x;
+        offset = y * dimInfo.sizeX + x;
     }
     return offset;
 }
-template <typename epicsType>
-void NDPluginBadPixel::fixBadPixelsT(NDArray *pArray, badPixelList_t &badPixels, NDArrayInfo_t *pArrayInfo)
-{
-    epicsType *pData=(epicsType *)pArray->pData;
 
-    badPixDimInfo_t dimInfo;
+void NDPluginBadPixel::getDimInfo(NDArray *pArray, NDArrayInfo_t *pArrayInfo, badPixDimInfo_t& dimInfo)
+{
     dimInfo.sizeX = pArrayInfo->xSize;
     dimInfo.offsetX = pArray->dims[pArrayInfo->xDim].offset;
     dimInfo.binX = pArray->dims[pArrayInfo->xDim].binning;
@@ -107,98 +105,176 @@ void NDPluginBadPixel::fixBadPixelsT(NDArray *pArray, badPixelList_t &badPixels,
         dimInfo.offsetY = 0;
         dimInfo.binY = 1;
     }
+}
+
+static bool sameDimInfo(const badPixDimInfo_t& a, const badPixDimInfo_t& b)
+{
+    return (a.sizeX == b.sizeX) && (a.sizeY == b.sizeY) &&
+           (a.offsetX == b.offsetX) && (a.offsetY == b.offsetY) &&
+           (a.binX == b.binX) && (a.binY == b.binY);
+}
+
+static bool compareOffset(const badPixelCorrection& lhs, const badPixelCorrection& rhs)
+{
+    return lhs.offset < rhs.offset;
+}
+
+/** Compiles the bad pixel list into the offsets to correct for an array geometry.
+  * Pixels outside the array, and replacement or median pixels that are outside the array or are also bad,
+  * are removed here so that they do not need to be checked for each array.
+  * Called with the mutex locked. */
+std::shared_ptr<badPixelPlan> NDPluginBadPixel::buildPlan(badPixDimInfo_t& dimInfo)
+{
+    std::shared_ptr<badPixelPlan> plan = std::make_shared<badPixelPlan>();
     int scaleX = dimInfo.binX;
     int scaleY = dimInfo.binY;
 
-    for (auto bp : badPixels) {
-        epicsInt64 offset = computePixelOffset(bp.coordinate, dimInfo, pArrayInfo);
-        if (offset < 0) continue;
+    plan->dimInfo = dimInfo;
+    plan->listVersion = listVersion_;
+    plan->maxNeighbours = 0;
+    for (auto& bp : badPixelList) {
+        badPixelCorrection correction;
+        correction.offset = computePixelOffset(bp.coordinate, dimInfo);
+        if (correction.offset < 0) continue;
+        correction.source = -1;
+        correction.numNeighbours = 0;
+        correction.setValue = 0.;
         switch (bp.mode) {
           case badPixelModeSet:
-            pData[offset]=(epicsType)bp.setValue;
+            correction.setValue = bp.setValue;
+            plan->sets.push_back(correction);
             break;
 
           case badPixelModeReplace: {
             pixelCoordinate coord = {bp.coordinate.x + bp.replaceCoordinate.x*scaleX, 
                                      bp.coordinate.y + bp.replaceCoordinate.y*scaleY};
             badPixel dummy(coord);
-            if (badPixels.find(dummy) != badPixels.end()) {
+            if (badPixelList.find(dummy) != badPixelList.end()) {
                 asynPrint(pasynUserSelf, ASYN_TRACE_WARNING, "replacement pixel [%d,%d] is also bad\n", (int)coord.x, (int)coord.y);
                 continue;
             }
-            epicsInt64 replaceOffset = computePixelOffset(coord, dimInfo, pArrayInfo);
-            if (replaceOffset < 0) continue;
-            pData[offset] = pData[replaceOffset];
+            correction.source = computePixelOffset(coord, dimInfo);
+            if (correction.source < 0) continue;
+            plan->replaces.push_back(correction);
             break; }
           
           case badPixelModeMedian: {
-            std::vector<double> medianValues;
             pixelCoordinate coord;
             epicsInt64 medianOffset;
+            correction.source = (epicsInt64)plan->neighbours.size();
             for (epicsInt64 i=-bp.medianCoordinate.y; i<=bp.medianCoordinate.y; i++) {
                 coord.y = bp.coordinate.y + i*scaleY;
                 for (epicsInt64 j=-bp.medianCoordinate.x; j<=bp.medianCoordinate.x; j++) {
                     if ((i==0) && (j==0)) continue;
                     coord.x = bp.coordinate.x + j*scaleX;
                     badPixel dummy(coord);
-                    if (badPixels.find(dummy) != badPixels.end()) {
+                    if (badPixelList.find(dummy) != badPixelList.end()) {
                         asynPrint(pasynUserSelf, ASYN_TRACE_WARNING, "replacement pixel [%d,%d] is also bad\n", (int)coord.x, (int)coord.y);
                         continue;
                     }
-                    medianOffset = computePixelOffset(coord, dimInfo, pArrayInfo);
+                    medianOffset = computePixelOffset(coord, dimInfo);
                     if (medianOffset < 0) continue;
-                    medianValues.push_back((double)pData[medianOffset]);
+                    plan->neighbours.push_back(medianOffset);
+                    correction.numNeighbours++;
                 }
             }
-            size_t numValues = medianValues.size();
-            if (numValues > 0 ) {
-                double replaceValue;
-                size_t middle = numValues/2;
-                std::sort(medianValues.begin(), medianValues.end());
-                if ((numValues % 2) == 0) {
-                    replaceValue = (medianValues[middle-1] + medianValues[middle]) / 2.;
-                } else {
-                    replaceValue = medianValues[middle];
-                }
-                pData[offset] = (epicsType)replaceValue;
-            }
+            if (correction.numNeighbours == 0) continue;
+            if (correction.numNeighbours > plan->maxNeighbours) plan->maxNeighbours = correction.numNeighbours;
+            plan->medians.push_back(correction);
             break; }
         }
     }
+    // Correcting in memory order keeps the accesses to the array as local as possible
+    std::sort(plan->sets.begin(), plan->sets.end(), compareOffset);
+    std::sort(plan->replaces.begin(), plan->replaces.end(), compareOffset);
+    std::sort(plan->medians.begin(), plan->medians.end(), compareOffset);
+    return plan;
 }
 
-int NDPluginBadPixel::fixBadPixels(NDArray *pArray, badPixelList_t &badPixels, NDArrayInfo_t *pArrayInfo)
+/** Returns the median of values, reordering them.
+  * Neighbourhoods of up to 16 pixels, such as the 8 pixels around a pixel, are insertion sorted,
+  * which is faster than a general sort at this size; larger ones are partially sorted. */
+static double medianValue(double *pValues, int numValues)
+{
+    int middle = numValues/2;
+
+    if (numValues <= 16) {
+        for (int i=1; i<numValues; i++) {
+            double value = pValues[i];
+            int j = i;
+            for (; (j > 0) && (pValues[j-1] > value); j--) pValues[j] = pValues[j-1];
+            pValues[j] = value;
+        }
+        if ((numValues % 2) == 0) return (pValues[middle-1] + pValues[middle]) / 2.;
+        return pValues[middle];
+    }
+    std::nth_element(pValues, pValues + middle, pValues + numValues);
+    if ((numValues % 2) == 0) {
+        return (*std::max_element(pValues, pValues + middle) + pValues[middle]) / 2.;
+    }
+    return pValues[middle];
+}
+
+template <typename epicsType>
+void NDPluginBadPixel::fixBadPixelsT(NDArray *pArray, const badPixelPlan &plan)
+{
+    epicsType *pData=(epicsType *)pArray->pData;
+    size_t i;
+    int k;
+
+    // Replacement and median pixels are never bad pixels, so the corrections do not depend on each other
+    for (i=0; i<plan.sets.size(); i++) {
+        const badPixelCorrection& correction = plan.sets[i];
+        pData[correction.offset] = (epicsType)correction.setValue;
+    }
+    for (i=0; i<plan.replaces.size(); i++) {
+        const badPixelCorrection& correction = plan.replaces[i];
+        pData[correction.offset] = pData[correction.source];
+    }
+    if (plan.medians.empty()) return;
+    std::vector<double> medianValues(plan.maxNeighbours);
+    for (i=0; i<plan.medians.size(); i++) {
+        const badPixelCorrection& correction = plan.medians[i];
+        const epicsInt64 *pNeighbours = &plan.neighbours[correction.source];
+        for (k=0; k<correction.numNeighbours; k++) {
+            medianValues[k] = (double)pData[pNeighbours[k]];
+        }
+        pData[correction.offset] = (epicsType)medianValue(&medianValues[0], correction.numNeighbours);
+    }
+}
+
+int NDPluginBadPixel::fixBadPixels(NDArray *pArray, const badPixelPlan &plan)
 {
     switch(pArray->dataType) {
       case NDInt8:
-        fixBadPixelsT<epicsInt8>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsInt8>(pArray, plan);
         break;
       case NDUInt8:
-        fixBadPixelsT<epicsUInt8>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsUInt8>(pArray, plan);
         break;
       case NDInt16:
-        fixBadPixelsT<epicsInt16>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsInt16>(pArray, plan);
         break;
       case NDUInt16:
-        fixBadPixelsT<epicsUInt16>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsUInt16>(pArray, plan);
         break;
       case NDInt32:
-        fixBadPixelsT<epicsInt32>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsInt32>(pArray, plan);
         break;
       case NDUInt32:
-        fixBadPixelsT<epicsUInt32>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsUInt32>(pArray, plan);
         break;
       case NDInt64:
-        fixBadPixelsT<epicsInt64>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsInt64>(pArray, plan);
         break;
       case NDUInt64:
-        fixBadPixelsT<epicsUInt64>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsUInt64>(pArray, plan);
         break;
       case NDFloat32:
-        fixBadPixelsT<epicsFloat32>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsFloat32>(pArray, plan);
         break;
       case NDFloat64:
-        fixBadPixelsT<epicsFloat64>(pArray, badPixels, pArrayInfo);
+        fixBadPixelsT<epicsFloat64>(pArray, plan);
         break;
       default:
         return(ND_ERROR);
@@ -219,14 +295,20 @@ void NDPluginBadPixel::processCallbacks(NDArray *pArray)
      * structures don't need to be protected.
      */
     NDArray *pArrayOut = NULL;
+    badPixDimInfo_t dimInfo;
     static const char* functionName = "processCallbacks";
 
     /* Call the base class method */
     NDPluginDriver::beginProcessCallbacks(pArray);
     
-    auto badPixels = this->badPixelList;
     NDArrayInfo arrayInfo;
     pArray->getInfo(&arrayInfo);
+    getDimInfo(pArray, &arrayInfo, dimInfo);
+    if (!plan_ || (plan_->listVersion != listVersion_) || !sameDimInfo(plan_->dimInfo, dimInfo)) {
+        plan_ = buildPlan(dimInfo);
+    }
+    /* Other threads may build a new plan while this one is in use */
+    std::shared_ptr<badPixelPlan> plan = plan_;
 
     /* Release the lock now that we are only doing things that don't involve memory other thread
      * cannot access */
@@ -240,7 +322,7 @@ void NDPluginBadPixel::processCallbacks(NDArray *pArray)
             driverName, functionName);
         goto doCallbacks;
     }
-    fixBadPixels(pArrayOut, badPixels, &arrayInfo);
+    fixBadPixels(pArrayOut, *plan);
 
     doCallbacks:
     /* We must exit with the mutex locked */
@@ -262,6 +344,7 @@ asynStatus NDPluginBadPixel::readBadPixelFile(const char *fileName)
         file >> j;
         auto badPixels = j["Bad pixels"];
         badPixelList.clear();
+        listVersion_++;
         pixelCoordinate coord;
         for (auto pixel : badPixels) {
             coord.x = pixel["Pixel"][0];
@@ -363,6 +446,11 @@ void NDPluginBadPixel::report(FILE *fp, int details)
           i++;
       }
   }
+  if (plan_) {
+      fprintf(fp, "Correction plan for array size=[%d,%d], corrections Set=%d, Replace=%d, Median=%d\n",
+              (int)plan_->dimInfo.sizeX, (int)plan_->dimInfo.sizeY, (int)plan_->sets.size(),
+              (int)plan_->replaces.size(), (int)plan_->medians.size());
+  }
   // Call the base class report
   NDPluginDriver::report(fp, details);
 }
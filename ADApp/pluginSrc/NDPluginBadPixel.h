@@ -2,6 +2,7 @@
 #define NDPluginProcess_H
 
 #include <vector>
+#include <memory>
 
 #include "NDPluginDriver.h"
 
@@ -47,6 +48,27 @@ typedef struct {
 } badPixDimInfo_t;
 
 typedef std::set<badPixel> badPixelList_t;
+
+/** Correction of one bad pixel, with offsets computed for the current array geometry */
+typedef struct {
+    epicsInt64 offset;          /**< Offset of the bad pixel in the array */
+    epicsInt64 source;          /**< Replace: offset of the replacement pixel; Median: index of the first neighbour */
+    int numNeighbours;          /**< Median: number of neighbours */
+    double setValue;            /**< Set: value of the pixel */
+} badPixelCorrection;
+
+/** Bad pixel list compiled for one array geometry.
+  * It is rebuilt when the size, offset or binning of the array, or the bad pixel file, changes. */
+class badPixelPlan {
+    public:
+        badPixDimInfo_t dimInfo;                    /**< Geometry the plan was built for */
+        int listVersion;                            /**< Version of the bad pixel list the plan was built from */
+        std::vector<badPixelCorrection> sets;       /**< Set corrections, sorted by offset */
+        std::vector<badPixelCorrection> replaces;   /**< Replace corrections, sorted by offset */
+        std::vector<badPixelCorrection> medians;    /**< Median corrections, sorted by offset */
+        std::vector<epicsInt64> neighbours;         /**< Offsets of the good neighbours of the median corrections */
+        int maxNeighbours;                          /**< Largest numNeighbours of the median corrections */
+};
 /* Bad pixel file*/
 #define NDPluginBadPixelFileNameString "BAD_PIXEL_FILE_NAME"    /* (asynOctet,   r/w) Name of the bad pixel file */
 
@@ -67,11 +89,15 @@ protected:
     #define FIRST_NDPLUGIN_BAD_PIXEL_PARAM NDPluginBadPixelFileName
 
 private:
-    template <typename epicsType> void fixBadPixelsT(NDArray *pArray, badPixelList_t &badPixels, NDArrayInfo_t *pArrayInfo);
-    int fixBadPixels(NDArray *pArray, badPixelList_t &badPixels, NDArrayInfo_t *pArrayInfo);
+    template <typename epicsType> void fixBadPixelsT(NDArray *pArray, const badPixelPlan &plan);
+    int fixBadPixels(NDArray *pArray, const badPixelPlan &plan);
     asynStatus readBadPixelFile(const char* fileName);
-    epicsInt64 computePixelOffset(pixelCoordinate coord, badPixDimInfo_t& dimInfo, NDArrayInfo_t *pArrayInfo);
+    epicsInt64 computePixelOffset(pixelCoordinate coord, badPixDimInfo_t& dimInfo);
+    void getDimInfo(NDArray *pArray, NDArrayInfo_t *pArrayInfo, badPixDimInfo_t& dimInfo);
+    std::shared_ptr<badPixelPlan> buildPlan(badPixDimInfo_t& dimInfo);
     badPixelList_t badPixelList;
+    int listVersion_;                           /**< Incremented each time the bad pixel file is read */
+    std::shared_ptr<badPixelPlan> plan_;        /**< Plan for the last array geometry; shared with threads using it */
 };
 
 #endif
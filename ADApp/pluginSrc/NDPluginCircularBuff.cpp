@@ -16,6 +16,7 @@
 #include <iocsh.h>
 
 #include "NDPluginCircularBuff.h"
+#include "NDPluginCodec.h"
 
 #include <epicsExport.h>
 
@@ -23,11 +24,79 @@ static const char *driverName="NDPluginCircularBuff";
 
 #define DEFAULT_TRIGGER_CALC "0"
 
+/** Computes the sum and maximum of the elements of an array */
+template <typename epicsType>
+static void arrayStatsT(NDArray *pArray, size_t nElements, double *pSum, double *pMax)
+{
+    epicsType *pData = (epicsType *)pArray->pData;
+    double sum = 0., max = -epicsINF;
+
+    for (size_t i=0; i<nElements; i++) {
+        double value = (double)pData[i];
+        sum += value;
+        if (value > max) max = value;
+    }
+    *pSum = sum;
+    *pMax = max;
+}
+
+/** Computes the sum and maximum of the elements of an array for trigger inputs I and J;
+  * both are NAN if the array is compressed or has an unknown data type */
+static void arrayStats(NDArray *pArray, double *pSum, double *pMax)
+{
+    NDArrayInfo arrayInfo;
+
+    *pSum = epicsNAN;
+    *pMax = epicsNAN;
+    if (!pArray->codec.empty()) return;
+    pArray->getInfo(&arrayInfo);
+    switch(pArray->dataType) {
+        case NDInt8:
+            arrayStatsT<epicsInt8>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDUInt8:
+            arrayStatsT<epicsUInt8>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDInt16:
+            arrayStatsT<epicsInt16>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDUInt16:
+            arrayStatsT<epicsUInt16>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDInt32:
+            arrayStatsT<epicsInt32>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDUInt32:
+            arrayStatsT<epicsUInt32>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDInt64:
+            arrayStatsT<epicsInt64>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDUInt64:
+            arrayStatsT<epicsUInt64>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDFloat32:
+            arrayStatsT<epicsFloat32>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        case NDFloat64:
+            arrayStatsT<epicsFloat64>(pArray, arrayInfo.nElements, pSum, pMax);
+            break;
+        default:
+            break;
+    }
+}
+
+/** Evaluates the trigger calculation for an array.
+  * The calculation arguments are A and B, the values of the trigger attributes;
+  * C, D, E and F, the pre-trigger count, post-trigger count, current image and triggered state;
+  * G and H, the values of the trigger attributes if they are named and the calculation uses them;
+  * and I and J, the sum and maximum of the array elements if the calculation uses them and stores neither.
+  * Otherwise G to J keep the values the calculation stored in them on previous arrays, as K and L always do.
+  * \param[in] pArray The array.
+  * \param[out] trig 1 if the calculation result is a non-zero number, else 0.
+  */
 asynStatus NDPluginCircularBuff::calculateTrigger(NDArray *pArray, int *trig)
 {
-    NDAttribute *trigger;
-    char triggerString[256];
-    double triggerValue;
     double calcResult;
     int status;
     int preTrigger, postTrigger, currentImage, triggered;
@@ -47,25 +116,24 @@ asynStatus NDPluginCircularBuff::calculateTrigger(NDArray *pArray, int *trig)
     triggerCalcArgs_[4] = currentImage;
     triggerCalcArgs_[5] = triggered;
 
-    getStringParam(NDCircBuffTriggerA, sizeof(triggerString), triggerString);
-    trigger = pArray->pAttributeList->find(triggerString);
-    if (trigger != NULL) {
-        status = trigger->getValue(NDAttrFloat64, &triggerValue);
-        if (status == asynSuccess) {
-            triggerCalcArgs_[0] = triggerValue;
-        }
+    triggerHandles_.getValue(pArray->pAttributeList, NDCircBuffHandleA, NDAttrFloat64, &triggerCalcArgs_[0]);
+    triggerHandles_.getValue(pArray->pAttributeList, NDCircBuffHandleB, NDAttrFloat64, &triggerCalcArgs_[1]);
+    setDoubleParam(NDCircBuffTriggerAVal, triggerCalcArgs_[0]);
+    setDoubleParam(NDCircBuffTriggerBVal, triggerCalcArgs_[1]);
+    // G to J keep any value the expression stored in them unless they are used as inputs
+    if (triggerHandles_.getName(NDCircBuffHandleG)[0] && (triggerCalcInputs_ & (1 << 6))) {
+        triggerCalcArgs_[6] = epicsNAN;
+        triggerHandles_.getValue(pArray->pAttributeList, NDCircBuffHandleG, NDAttrFloat64, &triggerCalcArgs_[6]);
+        setDoubleParam(NDCircBuffTriggerGVal, triggerCalcArgs_[6]);
     }
-    getStringParam(NDCircBuffTriggerB, sizeof(triggerString), triggerString);
-    trigger = pArray->pAttributeList->find(triggerString);
-    if (trigger != NULL) {
-        status = trigger->getValue(NDAttrFloat64, &triggerValue);
-        if (status == asynSuccess) {
-            triggerCalcArgs_[1] = triggerValue;
-        }
+    if (triggerHandles_.getName(NDCircBuffHandleH)[0] && (triggerCalcInputs_ & (1 << 7))) {
+        triggerCalcArgs_[7] = epicsNAN;
+        triggerHandles_.getValue(pArray->pAttributeList, NDCircBuffHandleH, NDAttrFloat64, &triggerCalcArgs_[7]);
+        setDoubleParam(NDCircBuffTriggerHVal, triggerCalcArgs_[7]);
     }
+    if (triggerReadsArrayData())
+        arrayStats(pArray, &triggerCalcArgs_[8], &triggerCalcArgs_[9]);
 
-    setDoubleParam(NDCircBuffTriggerAVal, triggerCalcArgs_[0]);
-    setDoubleParam(NDCircBuffTriggerBVal, triggerCalcArgs_[1]);
     status = calcPerform(triggerCalcArgs_, &calcResult, triggerCalcPostfix_);
     if (status) {
         asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
@@ -80,6 +148,78 @@ asynStatus NDPluginCircularBuff::calculateTrigger(NDArray *pArray, int *trig)
     return asynSuccess;
 }
 
+/** Returns true if the trigger calculation reads the array elements, as inputs I and J */
+bool NDPluginCircularBuff::triggerReadsArrayData()
+{
+    return (triggerCalcInputs_ & ((1 << 8) | (1 << 9))) && !(triggerCalcStores_ & ((1 << 8) | (1 << 9)));
+}
+
+/** Finds the trigger result that driverCallback() computed for an array, discarding the results of any
+  * earlier arrays, which were dropped before they were processed.
+  * \param[in] pArray The array.
+  * \param[out] trig The trigger result.
+  * \return Returns false if the trigger was not evaluated in driverCallback() for this array.
+  */
+bool NDPluginCircularBuff::takeEarlyResult(NDArray *pArray, int *trig)
+{
+    size_t i;
+
+    for (i=0; i<earlyResults_.size(); i++) {
+        if ((earlyResults_[i].pArray == pArray) && (earlyResults_[i].uniqueId == pArray->uniqueId)) break;
+    }
+    if (i == earlyResults_.size()) return false;
+    *trig = earlyResults_[i].triggered;
+    earlyResults_.erase(earlyResults_.begin(), earlyResults_.begin() + i + 1);
+    if (*trig) earlyTriggerPending_ = false;
+    return true;
+}
+
+/** Discards the trigger results of driverCallback() that have not been processed */
+void NDPluginCircularBuff::clearEarlyResults()
+{
+    earlyResults_.clear();
+    earlyTriggerPending_ = false;
+}
+
+/** Callback function that is called by the NDArray driver with new NDArray data.
+  * If CIRC_BUFF_EARLY_TRIGGER is set and capture is waiting for a trigger, evaluates the trigger here in the thread
+  * of the driver, before the array is queued, unless the calculation reads the array elements, which would
+  * delay the driver by a pass over every array; it is then evaluated in processCallbacks() as usual.  When there are no pre-trigger arrays to keep, arrays that do not
+  * trigger are then dropped without being queued or copied.  Otherwise the result is kept for processCallbacks().
+  * \param[in] pasynUser  The pasynUser from the callback.
+  * \param[in] genericPointer The NDArray from the callback.
+  */
+void NDPluginCircularBuff::driverCallback(asynUser *pasynUser, void *genericPointer)
+{
+    NDArray *pArray = (NDArray *)genericPointer;
+    int earlyTrigger, scopeControl, triggered, softTrigger, preCount, earlyDropped;
+    EarlyResult result;
+
+    this->lock();
+    getIntegerParam(NDCircBuffEarlyTrigger, &earlyTrigger);
+    getIntegerParam(NDCircBuffControl,      &scopeControl);
+    getIntegerParam(NDCircBuffTriggered,    &triggered);
+    getIntegerParam(NDCircBuffSoftTrigger,  &softTrigger);
+    getIntegerParam(NDCircBuffPreTrigger,   &preCount);
+    if (earlyTrigger && scopeControl && !triggered && !softTrigger && !earlyTriggerPending_ &&
+        !triggerReadsArrayData()) {
+        result.pArray = pArray;
+        result.uniqueId = pArray->uniqueId;
+        calculateTrigger(pArray, &result.triggered);
+        if (!result.triggered && (preCount == 0)) {
+            getIntegerParam(NDCircBuffEarlyDropped, &earlyDropped);
+            setIntegerParam(NDCircBuffEarlyDropped, earlyDropped+1);
+            callParamCallbacks();
+            this->unlock();
+            return;
+        }
+        if (result.triggered) earlyTriggerPending_ = true;
+        earlyResults_.push_back(result);
+    }
+    this->unlock();
+    NDPluginDriver::driverCallback(pasynUser, genericPointer);
+}
+
 
 /** Callback function that is called by the NDArray driver with new NDArray data.
   * Stores the number of pre-trigger images prior to the trigger in a ring buffer.
@@ -94,7 +234,7 @@ void NDPluginCircularBuff::processCallbacks(NDArray *pArray)
      * structures don't need to be protected.
      */
     int scopeControl, preCount, postCount, currentImage, currentPostCount, softTrigger;
-    int presetTriggerCount, actualTriggerCount;
+    int presetTriggerCount, actualTriggerCount, flushDecompress;
     NDArray *pArrayCpy = NULL;
     NDArrayInfo arrayInfo;
     int triggered = 0;
@@ -127,29 +267,70 @@ void NDPluginCircularBuff::processCallbacks(NDArray *pArray)
       } else {
         getIntegerParam(NDCircBuffTriggered, &triggered);
         if (!triggered) {
-          // Check for the trigger based on meta-data in the NDArray and the trigger calculation
-          calculateTrigger(pArray, &triggered);
+          // Check for the trigger based on meta-data in the NDArray and the trigger calculation,
+          // unless it was already checked when the array was queued
+          if (!takeEarlyResult(pArray, &triggered)) calculateTrigger(pArray, &triggered);
           setIntegerParam(NDCircBuffTriggered, triggered);
         }
       }
 
-      // First copy the buffer into our buffer pool so we can release the resource on the driver
-      pArrayCpy = this->pNDArrayPool->copy(pArray, NULL, 1);
+      // First copy the buffer into our buffer pool so we can release the resource on the driver.
+      // It is compressed if it goes into the pre-trigger ring, and after the trigger if the ring is flushed
+      // compressed, so that the output is either all compressed or all uncompressed
+      getIntegerParam(NDCircBuffFlushDecompress, &flushDecompress);
+      if (triggered && flushDecompress) {
+        pArrayCpy = this->pNDArrayPool->copy(pArray, NULL, 1);
+      } else {
+        pArrayCpy = copyCompressed(pArray);
+      }
 
       if (pArrayCpy){
 
         // Have we detected a trigger event yet?
         if (!triggered) {
           // No trigger so add the NDArray to the pre-trigger ring
+          int maxMemory, compressor;
+          bool memoryFull = false;
+          getIntegerParam(NDCircBuffMaxMemory, &maxMemory);
+          getIntegerParam(NDCircBuffCompressor, &compressor);
+          // With a spill store the ring can be longer than the pool has buffers for
+          int maxRing = ((maxBuffers_ > 0) && spillStore_.isOpen()) ? maxRingBuffers(compressor) : preCount;
+          // The oldest arrays are on disk, so make room for this one there
+          if ((preBuffer_->size() + spillStore_.size() >= preCount) && (spillStore_.size() > 0)){
+            spillStore_.discard();
+          }
+          preBufferBytes_ += pArrayCpy->dataSize;
           pOldArray_ = preBuffer_->addToEnd(pArrayCpy);
           // If we overwrote an existing array in the ring, release it here
           if (pOldArray_){
+            preBufferBytes_ -= pOldArray_->dataSize;
+            pOldArray_->release();
+            pOldArray_ = NULL;
+          }
+          // Move the oldest arrays to disk, or release them if there is no room there,
+          // while the ring uses more than the maximum memory or holds all the buffers of the pool
+          while ((preBuffer_->size() > 0) &&
+                 (((maxMemory > 0) && (preBufferBytes_ > (size_t)maxMemory * 1024 * 1024)) ||
+                  (preBuffer_->size() > maxRing))){
+            pOldArray_ = preBuffer_->removeFromStart();
+            preBufferBytes_ -= pOldArray_->dataSize;
+            if (spillStore_.isOpen()){
+              while ((spillStore_.push(pOldArray_) != ND_SUCCESS) && (spillStore_.size() > 0)){
+                spillStore_.discard();
+                memoryFull = true;
+              }
+              if (spillStore_.size() == 0) memoryFull = true;
+            } else {
+              memoryFull = true;
+            }
             pOldArray_->release();
             pOldArray_ = NULL;
           }
           // Set the size
-          setIntegerParam(NDCircBuffCurrentImage,  preBuffer_->size());
-          if (preBuffer_->size() == preCount){
+          setIntegerParam(NDCircBuffCurrentImage,  preBuffer_->size() + spillStore_.size());
+          setDoubleParam(NDCircBuffMemoryUsed, preBufferBytes_ / 1048576.);
+          setDoubleParam(NDCircBuffSpillUsed, spillStore_.bytesUsed() / 1048576.);
+          if (memoryFull || (preBuffer_->size() + spillStore_.size() == preCount)){
             setStringParam(NDCircBuffStatus,
                 preCount ? "Buffer Wrapping" : "Dropping frames");
           }
@@ -176,6 +357,7 @@ void NDPluginCircularBuff::processCallbacks(NDArray *pArray)
 
         // Stop recording once we have reached the post-trigger count, wait for a restart
         if (currentPostCount >= postCount){
+          clearEarlyResults();
           actualTriggerCount++;
           setIntegerParam(NDCircBuffActualTriggerCount, actualTriggerCount);
           if ((presetTriggerCount == 0) ||
@@ -205,16 +387,182 @@ void NDPluginCircularBuff::processCallbacks(NDArray *pArray)
     callParamCallbacks();
 }
 
+/** Copies an array compressed with the selected codec.
+  * The array is compressed into pCompressBuffer_, which is kept from one array to the next and only reallocated
+  * when a larger array needs more room, and the compressed bytes are then copied to an array of their own size,
+  * so that the ring holds only the compressed bytes.  If the array cannot be compressed it is copied uncompressed.
+  * \param[in] pArray The array.
+  * \return The copy, or NULL if no array could be allocated.
+  */
+NDArray *NDPluginCircularBuff::copyCompressed(NDArray *pArray)
+{
+    int compressor;
+    size_t bound = 0;
+    NDArray *pCompressed = NULL;
+    NDArray *pArrayCpy;
+    NDCodecStatus_t codecStatus = NDCODEC_SUCCESS;
+    char errorMessage[256] = "";
+    size_t dims[ND_ARRAY_MAX_DIMS];
+    static const char *functionName = "copyCompressed";
+
+    getIntegerParam(NDCircBuffCompressor, &compressor);
+    if (compressor == NDCircBuffCompressorNone) {
+        releaseCompressBuffer();
+        return this->pNDArrayPool->copy(pArray, NULL, 1);
+    }
+
+    if (compressor == NDCircBuffCompressorLZ4) {
+        bound = compressBoundLZ4(pArray);
+    } else if (compressor == NDCircBuffCompressorBSLZ4) {
+        bound = compressBoundBSLZ4(pArray);
+    }
+    if (pCompressBuffer_ && (pCompressBuffer_->dataSize < bound)) {
+        pCompressBuffer_->release();
+        pCompressBuffer_ = NULL;
+    }
+    if (!pCompressBuffer_ && (bound > 0)) {
+        pCompressBuffer_ = this->pNDArrayPool->alloc(1, &bound, NDInt8, bound, NULL);
+    }
+    if (bound == 0) {
+        sprintf(errorMessage, "Codec is not available");
+    } else if (!pCompressBuffer_) {
+        sprintf(errorMessage, "Failed to allocate compression buffer");
+    } else if (compressor == NDCircBuffCompressorLZ4) {
+        pCompressed = compressLZ4(pArray, &codecStatus, errorMessage, pCompressBuffer_);
+    } else {
+        pCompressed = compressBSLZ4(pArray, &codecStatus, errorMessage, pCompressBuffer_);
+    }
+    if (!pCompressed) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+            "%s::%s cannot compress array, storing it uncompressed: %s\n",
+            driverName, functionName, errorMessage);
+        return this->pNDArrayPool->copy(pArray, NULL, 1);
+    }
+
+    for (int i=0; i<pArray->ndims; i++) dims[i] = pArray->dims[i].size;
+    pArrayCpy = this->pNDArrayPool->alloc(pArray->ndims, dims, pArray->dataType, pCompressed->compressedSize, NULL);
+    if (!pArrayCpy) return NULL;
+    this->pNDArrayPool->copy(pArray, pArrayCpy, 0);
+    memcpy(pArrayCpy->pData, pCompressed->pData, pCompressed->compressedSize);
+    pArrayCpy->codec = pCompressed->codec;
+    pArrayCpy->compressedSize = pCompressed->compressedSize;
+    return pArrayCpy;
+}
+
+/** Passes an array from the pre-trigger ring downstream, decompressed if it was compressed by copyToPreBuffer()
+  * and CIRC_BUFF_FLUSH_DECOMPRESS is set.
+  * \param[in] pArray The array.
+  */
+void NDPluginCircularBuff::flushArray(NDArray *pArray)
+{
+    int flushDecompress;
+    NDArray *pDecompressed = NULL;
+    NDCodecStatus_t codecStatus = NDCODEC_SUCCESS;
+    char errorMessage[256] = "";
+    static const char *functionName = "flushArray";
+
+    getIntegerParam(NDCircBuffFlushDecompress, &flushDecompress);
+    if (flushDecompress && !pArray->codec.empty()) {
+        if (pArray->codec.name == codecName[NDCODEC_LZ4]) {
+            pDecompressed = decompressLZ4(pArray, &codecStatus, errorMessage);
+        } else if (pArray->codec.name == codecName[NDCODEC_BSLZ4]) {
+            pDecompressed = decompressBSLZ4(pArray, &codecStatus, errorMessage);
+        }
+        if (!pDecompressed) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                "%s::%s cannot decompress array uniqueId=%d: %s\n",
+                driverName, functionName, pArray->uniqueId, errorMessage);
+            return;
+        }
+        doCallbacksGenericPointer(pDecompressed, NDArrayData, 0);
+        pDecompressed->release();
+        return;
+    }
+    doCallbacksGenericPointer(pArray, NDArrayData, 0);
+}
+
+/** Returns pCompressBuffer_ to the NDArrayPool; it is allocated again by the next copyCompressed() that needs it.
+  */
+void NDPluginCircularBuff::releaseCompressBuffer()
+{
+    if (pCompressBuffer_) {
+        pCompressBuffer_->release();
+        pCompressBuffer_ = NULL;
+    }
+}
+
+/** Returns the largest number of arrays the pre-trigger ring can hold in the NDArrayPool of the plugin.
+  * One buffer is left for the copy of the incoming array, and one for pCompressBuffer_ if arrays are compressed.
+  * \param[in] compressor The selected compressor, NDCircBuffCompressor_t.
+  */
+int NDPluginCircularBuff::maxRingBuffers(int compressor)
+{
+    int numBuffers = maxBuffers_ - 1;
+
+    if (compressor != NDCircBuffCompressorNone) numBuffers--;
+    return numBuffers;
+}
+
+/** Opens the store for pre-trigger arrays on disk if CIRC_BUFF_SPILL_PATH and CIRC_BUFF_SPILL_MAX_SIZE are set,
+  * and closes it otherwise.  The store keeps its file if they have not changed since it was last opened, and
+  * only reserves disk space as arrays are spilled, so this is called when they are written and for each capture.
+  */
+void NDPluginCircularBuff::openSpillStore()
+{
+    std::string spillPath;
+    std::string errorMessage;
+    int spillMaxSize;
+    int preCount, compressor;
+    static const char *functionName = "openSpillStore";
+
+    getStringParam(NDCircBuffSpillPath, spillPath);
+    getIntegerParam(NDCircBuffSpillMaxSize, &spillMaxSize);
+    if (spillPath.empty() || (spillMaxSize <= 0)) {
+        spillStore_.close();
+    } else if (spillStore_.open(spillPath.c_str(), (size_t)spillMaxSize * 1024 * 1024, errorMessage) != ND_SUCCESS) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s cannot open the spill store, pre-trigger arrays are only kept in memory: %s\n",
+            driverName, functionName, errorMessage.c_str());
+    }
+    setDoubleParam(NDCircBuffSpillUsed, 0.);
+    // Without the store the ring must fit in the pool
+    getIntegerParam(NDCircBuffPreTrigger, &preCount);
+    getIntegerParam(NDCircBuffCompressor, &compressor);
+    if (!spillStore_.isOpen() && (preCount > maxRingBuffers(compressor))) {
+        setIntegerParam(NDCircBuffPreTrigger, maxRingBuffers(compressor));
+        setStringParam(NDCircBuffStatus, "Pre-count too high");
+    }
+}
+
 void NDPluginCircularBuff::flushPreBuffer()
 {
+    NDArray *pArray;
+    static const char *functionName = "flushPreBuffer";
+
     if (NULL == preBuffer_) return;
+    // The arrays on disk are older than those in memory
+    while (spillStore_.size() > 0) {
+      spillStore_.readahead(ND_SPILL_READAHEAD_ARRAYS);
+      pArray = spillStore_.pop(this->pNDArrayPool);
+      if (!pArray) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s cannot allocate an array to read from the spill store\n",
+            driverName, functionName);
+        continue;
+      }
+      flushArray(pArray);
+      pArray->release();
+    }
+    setDoubleParam(NDCircBuffSpillUsed, 0.);
     if (preBuffer_->size() > 0) {
-      doCallbacksGenericPointer(preBuffer_->readFromStart(), NDArrayData, 0);
+      flushArray(preBuffer_->readFromStart());
       while (preBuffer_->hasNext()) {
-        doCallbacksGenericPointer(preBuffer_->readNext(), NDArrayData, 0);
+        flushArray(preBuffer_->readNext());
       }
       preBuffer_->clear();
     }
+    preBufferBytes_ = 0;
+    setDoubleParam(NDCircBuffMemoryUsed, 0.);
 }
 
 /** Called when asyn clients call pasynInt32->write().
@@ -226,7 +574,7 @@ asynStatus NDPluginCircularBuff::writeInt32(asynUser *pasynUser, epicsInt32 valu
 {
     int function = pasynUser->reason;
     asynStatus status = asynSuccess;
-    int scopeControl, preCount;
+    int scopeControl, preCount, compressor;
     static const char *functionName = "writeInt32";
 
     if (function == NDCircBuffControl){
@@ -237,18 +585,23 @@ asynStatus NDPluginCircularBuff::writeInt32(asynUser *pasynUser, epicsInt32 valu
             delete preBuffer_;
           }
           preBuffer_ = new NDArrayRing(preCount);
+          preBufferBytes_ = 0;
+          setDoubleParam(NDCircBuffMemoryUsed, 0.);
+          openSpillStore();
           if (pOldArray_){
             pOldArray_->release();
           }
           pOldArray_ = NULL;
 
           previousTrigger_ = 0;
+          clearEarlyResults();
 
           // Set the status to buffer filling
           setIntegerParam(NDCircBuffSoftTrigger, 0);
           setIntegerParam(NDCircBuffTriggered, 0);
           setIntegerParam(NDCircBuffPostCount, 0);
           setIntegerParam(NDCircBuffActualTriggerCount, 0);
+          setIntegerParam(NDCircBuffEarlyDropped, 0);
           setStringParam(NDCircBuffStatus,
               preCount ? "Buffer filling" : "Dropping frames");
         } else {
@@ -258,6 +611,7 @@ asynStatus NDPluginCircularBuff::writeInt32(asynUser *pasynUser, epicsInt32 valu
           setIntegerParam(NDCircBuffTriggered, 0);
           setIntegerParam(NDCircBuffCurrentImage, 0);
           setStringParam(NDCircBuffStatus, "Acquisition Stopped");
+          releaseCompressBuffer();
         }
 
         // Set the parameter in the parameter library.
@@ -279,10 +633,12 @@ asynStatus NDPluginCircularBuff::writeInt32(asynUser *pasynUser, epicsInt32 valu
 
     }  else if (function == NDCircBuffPreTrigger){
         getIntegerParam(NDCircBuffControl, &scopeControl);
+        getIntegerParam(NDCircBuffCompressor, &compressor);
         if (scopeControl) {
           setStringParam(NDCircBuffStatus, "Stop acquisition to set pre-count");
-        } else if (value > (maxBuffers_ - 1)){
-          // The value of pretrigger should not exceed max buffers
+        } else if ((value > maxRingBuffers(compressor)) && !spillStore_.isOpen()){
+          // The value of pretrigger should not exceed max buffers, less the compression buffer,
+          // unless arrays can be spilled to disk
           setStringParam(NDCircBuffStatus, "Pre-count too high");
         } else if (value < 0) {
           setStringParam(NDCircBuffStatus, "Invalid pre-count value");
@@ -290,6 +646,20 @@ asynStatus NDPluginCircularBuff::writeInt32(asynUser *pasynUser, epicsInt32 valu
           // Set the parameter in the parameter library.
           status = (asynStatus) setIntegerParam(function, value);
         }
+    }  else if (function == NDCircBuffCompressor){
+        getIntegerParam(NDCircBuffPreTrigger, &preCount);
+        if ((preCount > maxRingBuffers(value)) && !spillStore_.isOpen()){
+          // The compression buffer is taken from the same pool as the pre-trigger ring
+          setStringParam(NDCircBuffStatus, "Pre-count too high");
+        } else {
+          status = (asynStatus) setIntegerParam(function, value);
+        }
+    }  else if (function == NDCircBuffSpillMaxSize){
+        // Set the parameter in the parameter library.
+        status = (asynStatus) setIntegerParam(function, value);
+        // A running capture keeps its store, and uses the new size when it is restarted
+        getIntegerParam(NDCircBuffControl, &scopeControl);
+        if (!scopeControl) openSpillStore();
     } else {
         // Set the parameter in the parameter library.
         status = (asynStatus) setIntegerParam(function, value);
@@ -333,7 +703,19 @@ asynStatus NDPluginCircularBuff::writeOctet(asynUser *pasynUser, const char *val
   status = (asynStatus)setStringParam(addr, function, (char *)value);
   if (status != asynSuccess) return(status);
 
-  if (function == NDCircBuffTriggerCalc){
+  if (function == NDCircBuffTriggerA) {
+    triggerHandles_.setName(NDCircBuffHandleA, value);
+  } else if (function == NDCircBuffTriggerB) {
+    triggerHandles_.setName(NDCircBuffHandleB, value);
+  } else if (function == NDCircBuffTriggerG) {
+    triggerHandles_.setName(NDCircBuffHandleG, value);
+  } else if (function == NDCircBuffTriggerH) {
+    triggerHandles_.setName(NDCircBuffHandleH, value);
+  } else if (function == NDCircBuffSpillPath) {
+    int scopeControl;
+    getIntegerParam(NDCircBuffControl, &scopeControl);
+    if (!scopeControl) openSpillStore();
+  } else if (function == NDCircBuffTriggerCalc){
     if (nChars > sizeof(triggerCalcInfix_)) nChars = sizeof(triggerCalcInfix_);
     // If the input string is empty then use a value of "0", otherwise there is an error
     if ((value == 0) || (strlen(value) == 0)) {
@@ -348,6 +730,11 @@ asynStatus NDPluginCircularBuff::writeOctet(asynUser *pasynUser, const char *val
       "%s::%s error processing infix expression=%s, error=%s\n",
       driverName, functionName, triggerCalcInfix_, calcErrorStr(postfixError));
     }
+    // Find the arguments the calculation uses, so that unused inputs are not computed
+    if (status || calcArgUsage(triggerCalcPostfix_, &triggerCalcInputs_, &triggerCalcStores_)) {
+      triggerCalcInputs_ = ~0UL;
+      triggerCalcStores_ = 0;
+    }
   }
 
   else if (function < FIRST_NDPLUGIN_CIRC_BUFF_PARAM) {
@@ -399,7 +786,8 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
                    NDArrayPort, NDArrayAddr, 1, maxBuffers, maxMemory,
                    asynInt32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask,
                    asynInt32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask,
-                   0, 1, priority, stackSize, 1), pOldArray_(NULL)
+                   0, 1, priority, stackSize, 1), pOldArray_(NULL), triggerCalcInputs_(~0UL), triggerCalcStores_(0),
+      earlyTriggerPending_(false), preBufferBytes_(0), pCompressBuffer_(NULL)
 {
     //const char *functionName = "NDPluginCircularBuff";
     preBuffer_ = NULL;
@@ -413,6 +801,10 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
     createParam(NDCircBuffTriggerBString,           asynParamOctet,      &NDCircBuffTriggerB);
     createParam(NDCircBuffTriggerAValString,        asynParamFloat64,    &NDCircBuffTriggerAVal);
     createParam(NDCircBuffTriggerBValString,        asynParamFloat64,    &NDCircBuffTriggerBVal);
+    createParam(NDCircBuffTriggerGString,           asynParamOctet,      &NDCircBuffTriggerG);
+    createParam(NDCircBuffTriggerHString,           asynParamOctet,      &NDCircBuffTriggerH);
+    createParam(NDCircBuffTriggerGValString,        asynParamFloat64,    &NDCircBuffTriggerGVal);
+    createParam(NDCircBuffTriggerHValString,        asynParamFloat64,    &NDCircBuffTriggerHVal);
     createParam(NDCircBuffTriggerCalcString,        asynParamOctet,      &NDCircBuffTriggerCalc);
     createParam(NDCircBuffTriggerCalcValString,     asynParamFloat64,    &NDCircBuffTriggerCalcVal);
     createParam(NDCircBuffPresetTriggerCountString, asynParamInt32,      &NDCircBuffPresetTriggerCount);
@@ -424,6 +816,17 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
     createParam(NDCircBuffSoftTriggerString,        asynParamInt32,      &NDCircBuffSoftTrigger);
     createParam(NDCircBuffTriggeredString,          asynParamInt32,      &NDCircBuffTriggered);
     createParam(NDCircBuffFlushOnSoftTrigString,    asynParamInt32,      &NDCircBuffFlushOnSoftTrig);
+    createParam(NDCircBuffEarlyTriggerString,       asynParamInt32,      &NDCircBuffEarlyTrigger);
+    createParam(NDCircBuffEarlyDroppedString,       asynParamInt32,      &NDCircBuffEarlyDropped);
+    createParam(NDCircBuffCompressorString,         asynParamInt32,      &NDCircBuffCompressor);
+    createParam(NDCircBuffFlushDecompressString,    asynParamInt32,      &NDCircBuffFlushDecompress);
+    createParam(NDCircBuffMaxMemoryString,          asynParamInt32,      &NDCircBuffMaxMemory);
+    createParam(NDCircBuffMemoryUsedString,         asynParamFloat64,    &NDCircBuffMemoryUsed);
+    createParam(NDCircBuffSpillPathString,          asynParamOctet,      &NDCircBuffSpillPath);
+    createParam(NDCircBuffSpillMaxSizeString,       asynParamInt32,      &NDCircBuffSpillMaxSize);
+    createParam(NDCircBuffSpillUsedString,          asynParamFloat64,    &NDCircBuffSpillUsed);
+
+    for (int i=0; i<NDCircBuffNumHandles; i++) triggerHandles_.add("");
 
     // Set the plugin type string
     setStringParam(NDPluginDriverPluginType, "NDPluginCircularBuff");
@@ -447,6 +850,15 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
     setIntegerParam(NDCircBuffActualTriggerCount, 0);
 
     setIntegerParam(NDCircBuffFlushOnSoftTrig, 0);
+    setIntegerParam(NDCircBuffEarlyTrigger, 0);
+    setIntegerParam(NDCircBuffEarlyDropped, 0);
+    setIntegerParam(NDCircBuffCompressor, NDCircBuffCompressorNone);
+    setIntegerParam(NDCircBuffFlushDecompress, 1);
+    setIntegerParam(NDCircBuffMaxMemory, 0);
+    setDoubleParam(NDCircBuffMemoryUsed, 0.);
+    setStringParam(NDCircBuffSpillPath, "");
+    setIntegerParam(NDCircBuffSpillMaxSize, 0);
+    setDoubleParam(NDCircBuffSpillUsed, 0.);
 
     // Enable ArrayCallbacks.
     // This plugin currently ignores this setting and always does callbacks, so make the setting reflect the behavior
@@ -456,6 +868,19 @@ NDPluginCircularBuff::NDPluginCircularBuff(const char *portName, int queueSize,
     connectToArrayPort();
 }
 
+/** Destructor for NDPluginCircularBuff; returns the arrays it holds to the NDArrayPool.
+  */
+NDPluginCircularBuff::~NDPluginCircularBuff()
+{
+    this->lock();
+    releaseCompressBuffer();
+    delete preBuffer_;
+    preBuffer_ = NULL;
+    if (pOldArray_) pOldArray_->release();
+    pOldArray_ = NULL;
+    this->unlock();
+}
+
 /** Configuration command */
 extern "C" int NDCircularBuffConfigure(const char *portName, int queueSize, int blockingCallbacks,
                                 const char *NDArrayPort, int NDArrayAddr,
@@ -1,11 +1,15 @@
 #ifndef NDPluginCircularBuff_H
 #define NDPluginCircularBuff_H
 
+#include <deque>
+
 #include <epicsTypes.h>
 #include <postfix.h>
 
 #include "NDPluginDriver.h"
 #include "NDArrayRing.h"
+#include "NDArraySpillStore.h"
+#include "NDAttributeHandles.h"
 
 /* Param definitions */
 #define NDCircBuffControlString             "CIRC_BUFF_CONTROL"               /* (asynInt32,        r/w) Run scope? */
@@ -14,6 +18,10 @@
 #define NDCircBuffTriggerBString            "CIRC_BUFF_TRIGGER_B"             /* (asynOctetWrite,   r/w) Trigger B attribute name */
 #define NDCircBuffTriggerAValString         "CIRC_BUFF_TRIGGER_A_VAL"         /* (asynFloat64,      r/o) Trigger A value */
 #define NDCircBuffTriggerBValString         "CIRC_BUFF_TRIGGER_B_VAL"         /* (asynFloat64,      r/o) Trigger B value */
+#define NDCircBuffTriggerGString            "CIRC_BUFF_TRIGGER_G"             /* (asynOctetWrite,   r/w) Trigger G attribute name */
+#define NDCircBuffTriggerHString            "CIRC_BUFF_TRIGGER_H"             /* (asynOctetWrite,   r/w) Trigger H attribute name */
+#define NDCircBuffTriggerGValString         "CIRC_BUFF_TRIGGER_G_VAL"         /* (asynFloat64,      r/o) Trigger G value */
+#define NDCircBuffTriggerHValString         "CIRC_BUFF_TRIGGER_H_VAL"         /* (asynFloat64,      r/o) Trigger H value */
 #define NDCircBuffTriggerCalcString         "CIRC_BUFF_TRIGGER_CALC"          /* (asynOctetWrite,   r/w) Trigger calculation expression */
 #define NDCircBuffTriggerCalcValString      "CIRC_BUFF_TRIGGER_CALC_VAL"      /* (asynFloat64,   r/o) Trigger calculation value */
 #define NDCircBuffPresetTriggerCountString  "CIRC_BUFF_PRESET_TRIGGER_COUNT"  /* (asynInt32,        r/w) Preset number of triggers 0=infinite*/
@@ -25,6 +33,31 @@
 #define NDCircBuffSoftTriggerString         "CIRC_BUFF_SOFT_TRIGGER"          /* (asynInt32,        r/w) Force a soft trigger */
 #define NDCircBuffTriggeredString           "CIRC_BUFF_TRIGGERED"             /* (asynInt32,        r/o) Have we had a trigger event */
 #define NDCircBuffFlushOnSoftTrigString     "CIRC_BUFF_FLUSH_ON_SOFTTRIGGER"  /* (asynInt32,        r/w) Flush buffer immediatelly when software trigger obtained */
+#define NDCircBuffEarlyTriggerString        "CIRC_BUFF_EARLY_TRIGGER"         /* (asynInt32,        r/w) Evaluate the trigger in the driver callback thread */
+#define NDCircBuffEarlyDroppedString        "CIRC_BUFF_EARLY_DROPPED"         /* (asynInt32,        r/o) Arrays dropped before they were queued */
+#define NDCircBuffCompressorString          "CIRC_BUFF_COMPRESSOR"            /* (asynInt32,        r/w) Codec for pre-trigger arrays */
+#define NDCircBuffFlushDecompressString     "CIRC_BUFF_FLUSH_DECOMPRESS"      /* (asynInt32,        r/w) Decompress pre-trigger arrays when flushed */
+#define NDCircBuffMaxMemoryString           "CIRC_BUFF_MAX_MEMORY"            /* (asynInt32,        r/w) Maximum memory for pre-trigger arrays (MB), 0=no limit */
+#define NDCircBuffMemoryUsedString          "CIRC_BUFF_MEMORY_USED"           /* (asynFloat64,      r/o) Memory used by pre-trigger arrays (MB) */
+#define NDCircBuffSpillPathString           "CIRC_BUFF_SPILL_PATH"            /* (asynOctet,        r/w) Directory for pre-trigger arrays beyond the maximum memory */
+#define NDCircBuffSpillMaxSizeString        "CIRC_BUFF_SPILL_MAX_SIZE"        /* (asynInt32,        r/w) Maximum disk space for pre-trigger arrays (MB) */
+#define NDCircBuffSpillUsedString           "CIRC_BUFF_SPILL_USED"            /* (asynFloat64,      r/o) Disk space used by pre-trigger arrays (MB) */
+
+/** Codecs for the arrays in the pre-trigger ring */
+typedef enum {
+    NDCircBuffCompressorNone,
+    NDCircBuffCompressorLZ4,
+    NDCircBuffCompressorBSLZ4
+} NDCircBuffCompressor_t;
+
+/** Handles of the trigger attributes in triggerHandles_ */
+typedef enum {
+    NDCircBuffHandleA,
+    NDCircBuffHandleB,
+    NDCircBuffHandleG,
+    NDCircBuffHandleH,
+    NDCircBuffNumHandles
+} NDCircBuffHandle_t;
 
 
 /** Performs a scope like capture.  Records a quantity
@@ -36,10 +69,12 @@ public:
                  const char *NDArrayPort, int NDArrayAddr,
                  int maxBuffers, size_t maxMemory,
                  int priority, int stackSize);
+    ~NDPluginCircularBuff();
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
     asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
     asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t nChars, size_t *nActual);
+    void driverCallback(asynUser *pasynUser, void *genericPointer);
 
     //template <typename epicsType> asynStatus doProcessCircularBuffT(NDArray *pArray);
     //asynStatus doProcessCircularBuff(NDArray *pArray);
@@ -53,6 +88,10 @@ protected:
     int NDCircBuffTriggerB;
     int NDCircBuffTriggerAVal;
     int NDCircBuffTriggerBVal;
+    int NDCircBuffTriggerG;
+    int NDCircBuffTriggerH;
+    int NDCircBuffTriggerGVal;
+    int NDCircBuffTriggerHVal;
     int NDCircBuffTriggerCalc;
     int NDCircBuffTriggerCalcVal;
     int NDCircBuffPresetTriggerCount;
@@ -64,12 +103,35 @@ protected:
     int NDCircBuffSoftTrigger;
     int NDCircBuffTriggered;
     int NDCircBuffFlushOnSoftTrig;
+    int NDCircBuffEarlyTrigger;
+    int NDCircBuffEarlyDropped;
+    int NDCircBuffCompressor;
+    int NDCircBuffFlushDecompress;
+    int NDCircBuffMaxMemory;
+    int NDCircBuffMemoryUsed;
+    int NDCircBuffSpillPath;
+    int NDCircBuffSpillMaxSize;
+    int NDCircBuffSpillUsed;
 
     void flushPreBuffer();
 
 private:
 
+    /** Trigger result for an array evaluated in driverCallback() and not yet processed */
+    struct EarlyResult {
+        NDArray *pArray;
+        int uniqueId;
+        int triggered;
+    };
     asynStatus calculateTrigger(NDArray *pArray, int *trig);
+    bool triggerReadsArrayData();
+    bool takeEarlyResult(NDArray *pArray, int *trig);
+    void clearEarlyResults();
+    NDArray *copyCompressed(NDArray *pArray);
+    void releaseCompressBuffer();
+    int maxRingBuffers(int compressor);
+    void flushArray(NDArray *pArray);
+    void openSpillStore();
     NDArrayRing *preBuffer_;
     NDArray *pOldArray_;
     int previousTrigger_;
@@ -77,6 +139,14 @@ private:
     char triggerCalcInfix_[MAX_INFIX_SIZE];
     char triggerCalcPostfix_[MAX_POSTFIX_SIZE];
     double triggerCalcArgs_[CALCPERFORM_NARGS];
+    unsigned long triggerCalcInputs_;       /**< Bit mask of the arguments used by the trigger calculation */
+    unsigned long triggerCalcStores_;       /**< Bit mask of the arguments stored by the trigger calculation */
+    NDAttributeHandles triggerHandles_;     /**< Trigger attributes, indexed by NDCircBuffHandle_t */
+    std::deque<EarlyResult> earlyResults_;  /**< Results of driverCallback() in the order the arrays were queued */
+    bool earlyTriggerPending_;              /**< driverCallback() found a trigger that processCallbacks() has not reached */
+    size_t preBufferBytes_;                 /**< Memory used by the arrays in preBuffer_ */
+    NDArraySpillStore spillStore_;          /**< Pre-trigger arrays older than those in preBuffer_, on disk */
+    NDArray *pCompressBuffer_;              /**< Buffer the arrays are compressed into by copyCompressed() */
 };
 
 #endif
@@ -457,7 +457,14 @@ NDArray *decompressBlosc(NDArray *input, int numThreads, NDCodecStatus_t *status
 #include <bitshuffle.h>
 #include <lz4.h>
 
-NDArray *compressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage)
+size_t compressBoundLZ4(NDArray *input)
+{
+    NDArrayInfo_t info;
+    input->getInfo(&info);
+    return (size_t)LZ4_compressBound((int)info.totalBytes);
+}
+
+NDArray *compressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage, NDArray *output)
 {
     if (!input->codec.empty()) {
         sprintf(errorMessage, "Array is already compressed");
@@ -468,7 +475,15 @@ NDArray *compressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage
     NDArrayInfo_t info;
     input->getInfo(&info);
     int outputSize = LZ4_compressBound((int)info.totalBytes);
-    NDArray *output = allocArray(input, -1, outputSize);
+    bool ownOutput = (output == NULL);
+
+    if (ownOutput) {
+        output = allocArray(input, -1, outputSize);
+    } else if (output->dataSize < (size_t)outputSize) {
+        sprintf(errorMessage, "LZ4 output array is too small");
+        *status = NDCODEC_ERROR;
+        return NULL;
+    }
 
     if (!output) {
         sprintf(errorMessage, "Failed to allocate BZLZ4 output array");
@@ -479,7 +494,7 @@ NDArray *compressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage
     int compSize = LZ4_compress_default((const char*)input->pData, (char*)output->pData, (int)info.totalBytes, outputSize);
 
     if (compSize <= 0) {
-        output->release();
+        if (ownOutput) output->release();
         sprintf(errorMessage, "Internal Z4 error");
         *status = NDCODEC_ERROR;
         return NULL;
@@ -528,7 +543,14 @@ NDArray *decompressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessa
 }
 
 
-NDArray *compressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage)
+size_t compressBoundBSLZ4(NDArray *input)
+{
+    NDArrayInfo_t info;
+    input->getInfo(&info);
+    return (size_t)bshuf_compress_lz4_bound(info.nElements, info.bytesPerElement, 0);
+}
+
+NDArray *compressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage, NDArray *output)
 {
     if (!input->codec.empty()) {
         sprintf(errorMessage, "Array is already compressed");
@@ -538,8 +560,15 @@ NDArray *compressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessa
 
     NDArrayInfo_t info;
     input->getInfo(&info);
+    bool ownOutput = (output == NULL);
 
-    NDArray *output = allocArray(input, -1, info.totalBytes);
+    if (ownOutput) {
+        output = allocArray(input, -1, info.totalBytes);
+    } else if (output->dataSize < compressBoundBSLZ4(input)) {
+        sprintf(errorMessage, "BSLZ4 output array is too small");
+        *status = NDCODEC_ERROR;
+        return NULL;
+    }
 
     if (!output) {
         sprintf(errorMessage, "Failed to allocate BZLZ4 output array");
@@ -553,7 +582,7 @@ NDArray *compressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessa
                                           info.bytesPerElement, blockSize);
 
     if (compSize < 0) {
-        output->release();
+        if (ownOutput) output->release();
         sprintf(errorMessage, "Internal BSLZ4 error");
         *status = NDCODEC_ERROR;
         return NULL;
@@ -605,7 +634,12 @@ NDArray *decompressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMes
 }
 #else
 
-NDArray *compressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage)
+size_t compressBoundLZ4(NDArray *input)
+{
+    return 0;
+}
+
+NDArray *compressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage, NDArray *output)
 {
     sprintf(errorMessage, "No LZ4 support");
     *status = NDCODEC_ERROR;
@@ -619,7 +653,12 @@ NDArray *decompressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessa
     return NULL;
 }
 
-NDArray *compressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage)
+size_t compressBoundBSLZ4(NDArray *input)
+{
+    return 0;
+}
+
+NDArray *compressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage, NDArray *output)
 {
     sprintf(errorMessage, "No Bitshuffle support");
     *status = NDCODEC_ERROR;
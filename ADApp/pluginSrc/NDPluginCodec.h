@@ -50,6 +50,12 @@ typedef enum {
  * The [de]compress* functions below take an input array and return a
  * pool-allocated output array on success or NULL on error. They are
  * thread-safe.
+ *
+ * compressLZ4 and compressBSLZ4 can instead compress into an existing output
+ * array, whose buffer must hold at least compressBoundLZ4/compressBoundBSLZ4
+ * bytes; only its data, codec and compressedSize are set, and it is returned
+ * on success.  A caller can keep such an array to compress every NDArray
+ * without allocating memory.
  */
 
 NDArray *compressJPEG(NDArray *input, int quality, NDCodecStatus_t *status, char *errorMessage);
@@ -58,10 +64,12 @@ NDArray *decompressJPEG(NDArray *input, NDCodecStatus_t *status, char *errorMess
 NDArray *compressBlosc(NDArray *input, int clevel, int shuffle, NDCodecBloscComp_t compressor,
                        int numThreads, NDCodecStatus_t *status, char *errorMessage);
 NDArray *decompressBlosc(NDArray *input, int numThreads, NDCodecStatus_t *status, char *errorMessage);
-NDArray *compressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage);
+NDArray *compressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage, NDArray *output=NULL);
 NDArray *decompressLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage);
-NDArray *compressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage);
+NDArray *compressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage, NDArray *output=NULL);
 NDArray *decompressBSLZ4(NDArray *input, NDCodecStatus_t *status, char *errorMessage);
+size_t compressBoundLZ4(NDArray *input);
+size_t compressBoundBSLZ4(NDArray *input);
 
 
 class NDPLUGIN_API NDPluginCodec : public NDPluginDriver {
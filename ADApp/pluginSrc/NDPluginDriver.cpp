@@ -12,8 +12,10 @@
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
+#include <limits.h>
 
 #include <epicsMessageQueue.h>
+#include <epicsAtomic.h>
 #include <cantProceed.h>
 
 #include "NDPluginDriver.h"
@@ -43,9 +45,6 @@ typedef struct {
 
 static const char *driverName="NDPluginDriver";
 
-sortedListElement::sortedListElement(NDArray *pArray, epicsTimeStamp time)
-    : pArray_(pArray), insertionTime_(time) {}
-
 static void sortingTaskC(void *drvPvt)
 {
     NDPluginDriver *pPvt = (NDPluginDriver *)drvPvt;
@@ -99,7 +98,9 @@ NDPluginDriver::NDPluginDriver(const char *portName, int queueSize, int blocking
     prevUniqueId_(-1000),
     sortingThreadId_(0),
     compressionAware_(compressionAware),
-    throttler_(new Throttler())
+    throttler_(new Throttler()),
+    queueFree_(queueSize),
+    executionTimeUs_(0)
 {
     asynUser *pasynUser;
     //static const char *functionName = "NDPluginDriver";
@@ -243,7 +244,8 @@ void NDPluginDriver::beginProcessCallbacks(NDArray *pArray)
   * \param[in] readAttributes This flag must be true if the derived class has not yet called readAttributes() for pArray.
   *
   * This method does NDArray callbacks to downstream plugins if NDArrayCallbacks is true and SortMode is Unsorted.
-  * If SortMode is sorted it inserts the NDArray into the std::multilist for callbacks in SortThread().
+  * If SortMode is sorted it outputs the NDArray if it is the next in uniqueId order, and otherwise
+  * inserts it into the sort buffer until the preceding arrays have arrived or SortTime has passed.
   * It keeps track of DisorderedArrays and DroppedOutputArrays.
   * It caches the most recent NDArray in pArrays[0]. */
 asynStatus NDPluginDriver::endProcessCallbacks(NDArray *pArray, bool copyArray, bool readAttributes)
@@ -292,43 +294,88 @@ asynStatus NDPluginDriver::endProcessCallbacks(NDArray *pArray, bool copyArray,
         setIntegerParam(NDPluginDriverDroppedOutputArrays, droppedOutputArrays);
         return asynSuccess;
     }
-    bool orderOK = (pArrayOut->uniqueId == prevUniqueId_)   ||
-                   (pArrayOut->uniqueId == prevUniqueId_+1);
-    if (callbacksSorted && !orderOK) {
-        int sortSize;
-        int listSize = (int)sortedNDArrayList_.size();
-        getIntegerParam(NDPluginDriverSortSize, &sortSize);
-        setIntegerParam(NDPluginDriverSortFree, sortSize-listSize);
-        if (listSize >= sortSize) {
+    if (!callbacksSorted) {
+        outputArray(pArrayOut);
+        return asynSuccess;
+    }
+    int sortSize;
+    double sortTime;
+    epicsTimeStamp now;
+    getIntegerParam(NDPluginDriverSortSize, &sortSize);
+    getDoubleParam(NDPluginDriverSortTime, &sortTime);
+    epicsTimeGetCurrent(&now);
+    if (sortBuffer_.getSize() != sortSize) {
+        // Output the arrays in the buffer in order before resizing it
+        outputSortedArrays(&now, -1.);
+        sortBuffer_.setSize(sortSize);
+    }
+    if (!firstOutputArray_ && (pArrayOut->uniqueId <= prevUniqueId_+1)) {
+        // The next array in order, or an array that arrived after its successors were output
+        outputArray(pArrayOut);
+    } else {
+        // Skip the oldest gaps if the uniqueIds would span more than the buffer
+        while ((sortBuffer_.count() > 0) && !sortBuffer_.fits(pArrayOut->uniqueId)) {
+            NDArray *pSkipped = sortBuffer_.pop(INT_MAX);
+            outputArray(pSkipped);
+            pSkipped->release();
+        }
+        if (sortBuffer_.push(pArrayOut, &now)) {
             asynPrint(pasynUserSelf, ASYN_TRACE_WARNING,
-                "%s::%s std::multilist size exceeded, dropped array uniqueId=%d\n",
+                "%s::%s sort buffer full, dropped array uniqueId=%d\n",
                 driverName, functionName, pArrayOut->uniqueId);
             droppedOutputArrays++;
             setIntegerParam(NDPluginDriverDroppedOutputArrays, droppedOutputArrays);
-        } else {
-            epicsTimeStamp now;
-            epicsTimeGetCurrent(&now);
-            pArrayOut->reserve();
-            sortedListElement *pListElement = new sortedListElement(pArrayOut, now);
-            sortedNDArrayList_.insert(*pListElement);
         }
-    } else {
-        doCallbacksGenericPointer(pArrayOut, NDArrayData, 0);
-        if (!firstOutputArray_ && !orderOK) {
-            int disorderedArrays;
-            getIntegerParam(NDPluginDriverDisorderedArrays, &disorderedArrays);
-            disorderedArrays++;
-            setIntegerParam(NDPluginDriverDisorderedArrays, disorderedArrays);
-            asynPrint(pasynUserSelf, ASYN_TRACE_WARNING,
-                "%s::%s disordered array found uniqueId=%d, prevUniqueId_=%d, orderOK=%d, disorderedArrays=%d\n",
-                driverName, functionName, pArrayOut->uniqueId, prevUniqueId_, orderOK, disorderedArrays);
-        }
-        firstOutputArray_ = false;
-        prevUniqueId_ = pArrayOut->uniqueId;
     }
+    outputSortedArrays(&now, sortTime);
+    setIntegerParam(NDPluginDriverSortFree, sortBuffer_.getSize() - sortBuffer_.count());
     return asynSuccess;
 }
 
+/** Does the NDArray callbacks for an output array and keeps track of DisorderedArrays.
+  * \param[in] pArray  The NDArray to output. */
+void NDPluginDriver::outputArray(NDArray *pArray)
+{
+    static const char *functionName = "outputArray";
+
+    bool orderOK = (pArray->uniqueId == prevUniqueId_)   ||
+                   (pArray->uniqueId == prevUniqueId_+1);
+    doCallbacksGenericPointer(pArray, NDArrayData, 0);
+    if (!firstOutputArray_ && !orderOK) {
+        int disorderedArrays;
+        getIntegerParam(NDPluginDriverDisorderedArrays, &disorderedArrays);
+        disorderedArrays++;
+        setIntegerParam(NDPluginDriverDisorderedArrays, disorderedArrays);
+        asynPrint(pasynUserSelf, ASYN_TRACE_WARNING,
+            "%s::%s disordered array found uniqueId=%d, prevUniqueId_=%d, orderOK=%d, disorderedArrays=%d\n",
+            driverName, functionName, pArray->uniqueId, prevUniqueId_, orderOK, disorderedArrays);
+    }
+    firstOutputArray_ = false;
+    prevUniqueId_ = pArray->uniqueId;
+}
+
+/** Outputs the arrays in the sort buffer that are next in uniqueId order.
+  * If the array with the lowest uniqueId has waited longer than sortTime the arrays before it are
+  * assumed to be lost, so it is output, followed by any arrays that follow it in order.
+  * \param[in] pNow The current time.
+  * \param[in] sortTime The time to wait for missing arrays; a negative time outputs all the arrays. */
+void NDPluginDriver::outputSortedArrays(const epicsTimeStamp *pNow, double sortTime)
+{
+    NDArray *pArray;
+
+    while (sortBuffer_.count() > 0) {
+        pArray = NULL;
+        if (!firstOutputArray_) pArray = sortBuffer_.pop(prevUniqueId_+1);
+        if (!pArray && sortBuffer_.expired(pNow, sortTime)) pArray = sortBuffer_.pop(INT_MAX);
+        if (!pArray) break;
+        asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
+            "%s::outputSortedArrays, buffer count=%d, uniqueId=%d\n",
+            driverName, sortBuffer_.count(), pArray->uniqueId);
+        outputArray(pArray);
+        pArray->release();
+    }
+}
+
 
 extern "C" {static void driverCallback(void *drvPvt, asynUser *pasynUser, void *genericPointer)
 {
@@ -357,6 +404,47 @@ bool NDPluginDriver::throttled(NDArray *pArray)
     return !throttler_->tryTake(needed);
 }
 
+/** Sets NDPluginDriverQueueFree, and the copy of it that getQueueFree() reads without the lock.
+  * Called with the lock held.
+  * \param[in] queueFree The number of free elements in the input queue. */
+void NDPluginDriver::setQueueFree(int queueFree)
+{
+    setIntegerParam(NDPluginDriverQueueFree, queueFree);
+    epicsAtomicSetIntT(&queueFree_, queueFree);
+}
+
+/** Sets NDPluginDriverExecutionTime, and the copy of it that getExecutionTime() reads without the lock.
+  * Called with the lock held.
+  * \param[in] executionTime The execution time of the last array in milliseconds. */
+void NDPluginDriver::setExecutionTime(double executionTime)
+{
+    setDoubleParam(NDPluginDriverExecutionTime, executionTime);
+    epicsAtomicSetIntT(&executionTimeUs_, (int)(executionTime*1e3));
+}
+
+/** Returns the number of free elements in the input queue, without taking the lock.
+  * Used by plugins that choose which downstream plugin to pass an array to. */
+int NDPluginDriver::getQueueFree()
+{
+    return epicsAtomicGetIntT(&queueFree_);
+}
+
+/** Returns the execution time of the last array in milliseconds, without taking the lock;
+  * 0 if no array has been processed yet.
+  * Used by plugins that choose which downstream plugin to pass an array to. */
+double NDPluginDriver::getExecutionTime()
+{
+    return epicsAtomicGetIntT(&executionTimeUs_) / 1e3;
+}
+
+/** Returns the plugin that registered a callback for NDArrays, or NULL if the client is not an NDPluginDriver.
+  * \param[in] pInterrupt The interrupt of the client in the asynGenericPointer client list. */
+NDPluginDriver* NDPluginDriver::getInterruptPlugin(asynGenericPointerInterrupt *pInterrupt)
+{
+    if (pInterrupt->callback != ::driverCallback) return NULL;
+    return (NDPluginDriver *)pInterrupt->userPvt;
+}
+
 /** Method that is called from the driver with a new NDArray.
   * It calls the processCallbacks function, which typically is implemented in the
   * derived class.
@@ -419,7 +507,7 @@ void NDPluginDriver::driverCallback(asynUser *pasynUser, void *genericPointer)
         if (blockingCallbacks) {
             processCallbacks(pArray);
             epicsTimeGetCurrent(&tEnd);
-            setDoubleParam(NDPluginDriverExecutionTime, epicsTimeDiffInSeconds(&tEnd, &tNow)*1e3);
+            setExecutionTime(epicsTimeDiffInSeconds(&tEnd, &tNow)*1e3);
         } else {
             /* Increase the reference count again on this array
              * It will be released in the background task when processing is done */
@@ -429,7 +517,7 @@ void NDPluginDriver::driverCallback(asynUser *pasynUser, void *genericPointer)
             ToThreadMessage_t msg = {ToThreadMessageData, pArray};
             status = pToThreadMsgQ_->trySend(&msg, sizeof(msg));
             queueFree = queueSize - pToThreadMsgQ_->pending();
-            setIntegerParam(NDPluginDriverQueueFree, queueFree);
+            setQueueFree(queueFree);
             if (status) {
                 pasynUser->auxStatus = asynOverflow;
                 if (!ignoreQueueFull) {
@@ -510,7 +598,7 @@ void NDPluginDriver::processTask()
         epicsTimeGetCurrent(&tStart);
         getIntegerParam(NDPluginDriverQueueSize, &queueSize);
         queueFree = queueSize - pToThreadMsgQ_->pending();
-        setIntegerParam(NDPluginDriverQueueFree, queueFree);
+        setQueueFree(queueFree);
 
         /* Call the function that does the business of this callback.
          * This function should release the lock during time-consuming operations,
@@ -518,7 +606,7 @@ void NDPluginDriver::processTask()
         processCallbacks(pArray);
 
         epicsTimeGetCurrent(&tEnd);
-        setDoubleParam(NDPluginDriverExecutionTime, epicsTimeDiffInSeconds(&tEnd, &tStart)*1e3);
+        setExecutionTime(epicsTimeDiffInSeconds(&tEnd, &tStart)*1e3);
         pArray->pDriver->decrementQueuedArrayCount();
         callParamCallbacks();
         /* We are done with this array buffer */
@@ -620,11 +708,7 @@ void NDPluginDriver::sortingTask()
 {
     double sortTime;
     epicsTimeStamp now;
-    int sortSize;
-    double deltaTime;
-    int listSize;
-    std::multiset<sortedListElement>::iterator pListElement;
-    static const char *functionName = "sortingTask";
+    //static const char *functionName = "sortingTask";
 
     lock();
     while (1) {
@@ -633,38 +717,9 @@ void NDPluginDriver::sortingTask()
         epicsThreadSleep(sortTime);
         lock();
         epicsTimeGetCurrent(&now);
-        getIntegerParam(NDPluginDriverSortSize, &sortSize);
-        while ((listSize=(int)sortedNDArrayList_.size()) > 0) {
-            bool orderOK;
-            pListElement = sortedNDArrayList_.begin();
-            deltaTime = epicsTimeDiffInSeconds(&now, &pListElement->insertionTime_);
-            asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
-                "%s::%s, deltaTime=%f, list size=%d, uniqueId=%d\n",
-                driverName, functionName, deltaTime, listSize, pListElement->pArray_->uniqueId);
-            orderOK = (pListElement->pArray_->uniqueId == prevUniqueId_)   ||
-                      (pListElement->pArray_->uniqueId == prevUniqueId_+1);
-            if ((!firstOutputArray_ && orderOK) || (deltaTime > sortTime)) {
-                doCallbacksGenericPointer(pListElement->pArray_, NDArrayData, 0);
-                if (!firstOutputArray_ && !orderOK) {
-                    int disorderedArrays;
-                    getIntegerParam(NDPluginDriverDisorderedArrays, &disorderedArrays);
-                    disorderedArrays++;
-                    setIntegerParam(NDPluginDriverDisorderedArrays, disorderedArrays);
-                    asynPrint(pasynUserSelf, ASYN_TRACE_WARNING,
-                        "%s::%s disordered array found uniqueId=%d, prevUniqueId_=%d, orderOK=%d, disorderedArrays=%d\n",
-                        driverName, functionName, pListElement->pArray_->uniqueId, prevUniqueId_,
-                        orderOK, disorderedArrays);
-                }
-                prevUniqueId_ = pListElement->pArray_->uniqueId;
-                pListElement->pArray_->release();
-                sortedNDArrayList_.erase(pListElement);
-                firstOutputArray_ = false;
-            } else  {
-                break;
-            }
-        }
-        listSize=(int)sortedNDArrayList_.size();
-        setIntegerParam(NDPluginDriverSortFree, sortSize-listSize);
+        // Arrays that are next in order are output as they arrive, this outputs the arrays after missing ones
+        outputSortedArrays(&now, sortTime);
+        setIntegerParam(NDPluginDriverSortFree, sortBuffer_.getSize() - sortBuffer_.count());
         callParamCallbacks();
     }
 }
@@ -1005,7 +1060,7 @@ asynStatus NDPluginDriver::createCallbackThreads()
         status |= startCallbackThreads();
     }
     getIntegerParam(NDPluginDriverEnableCallbacks, &enableCallbacks);
-    setIntegerParam(NDPluginDriverQueueFree, queueSize);
+    setQueueFree(queueSize);
     if (enableCallbacks) this->setArrayInterrupt(1);
     return (asynStatus) status;
 }
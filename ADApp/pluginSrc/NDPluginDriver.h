@@ -10,28 +10,10 @@
 #include <NDPluginAPI.h>
 
 #include "asynNDArrayDriver.h"
+#include "NDArrayReorderBuffer.h"
 
 class Throttler;
 
-// This class defines the object that is contained in the std::multilist for sorting output NDArrays
-// It contains a pointer to the NDArray and the time that the object was added to the list
-// It defines the < operator to use the NDArray::uniqueId field as the sort key
-
-// We would like to hide this class definition in NDPluginDriver.cpp and just forward reference it here.
-// That works on Visual Studio, and on gcc if instantiating plugins as heap variables with "new", but fails on gcc
-// if instantiating plugins as automatic variables.
-//class sortedListElement;
-
-class sortedListElement {
-    public:
-        sortedListElement(NDArray *pArray, epicsTimeStamp time);
-        friend bool operator<(const sortedListElement& lhs, const sortedListElement& rhs) {
-            return (lhs.pArray_->uniqueId < rhs.pArray_->uniqueId);
-        }
-        NDArray *pArray_;
-        epicsTimeStamp insertionTime_;
-};
-
 #define NDPluginDriverArrayPortString           "NDARRAY_PORT"          /**< (asynOctet,    r/w) The port for the NDArray interface */
 #define NDPluginDriverArrayAddrString           "NDARRAY_ADDR"          /**< (asynInt32,    r/w) The address on the port */
 #define NDPluginDriverPluginTypeString          "PLUGIN_TYPE"           /**< (asynOctet,    r/o) The type of plugin */
@@ -42,8 +24,8 @@ class sortedListElement {
 #define NDPluginDriverNumThreadsString          "NUM_THREADS"           /**< (asynInt32,    r/w) Number of threads */
 #define NDPluginDriverSortModeString            "SORT_MODE"             /**< (asynInt32,    r/w) sorted callback mode */
 #define NDPluginDriverSortTimeString            "SORT_TIME"             /**< (asynFloat64,  r/w) sorted callback time */
-#define NDPluginDriverSortSizeString            "SORT_SIZE"             /**< (asynInt32,    r/o) std::multiset maximum # elements */
-#define NDPluginDriverSortFreeString            "SORT_FREE"             /**< (asynInt32,    r/o) std::multiset free elements */
+#define NDPluginDriverSortSizeString            "SORT_SIZE"             /**< (asynInt32,    r/o) sort buffer maximum # elements */
+#define NDPluginDriverSortFreeString            "SORT_FREE"             /**< (asynInt32,    r/o) sort buffer free elements */
 #define NDPluginDriverDisorderedArraysString    "DISORDERED_ARRAYS"     /**< (asynInt32,    r/o) Number of out of order output arrays */
 #define NDPluginDriverDroppedOutputArraysString "DROPPED_OUTPUT_ARRAYS" /**< (asynInt32,    r/o) Number of dropped output arrays */
 #define NDPluginDriverEnableCallbacksString     "ENABLE_CALLBACKS"      /**< (asynInt32,    r/w) Enable callbacks from driver (1=Yes, 0=No) */
@@ -76,6 +58,9 @@ public:
     virtual void run(void);
     virtual asynStatus start(void);
     void sortingTask();
+    int getQueueFree();
+    double getExecutionTime();
+    static NDPluginDriver* getInterruptPlugin(asynGenericPointerInterrupt *pInterrupt);
 
 protected:
     virtual void processCallbacks(NDArray *pArray) = 0;
@@ -112,10 +97,14 @@ protected:
 
 private:
     void processTask();
+    void setQueueFree(int queueFree);
+    void setExecutionTime(double executionTime);
     asynStatus createCallbackThreads();
     asynStatus startCallbackThreads();
     asynStatus deleteCallbackThreads();
     asynStatus createSortingThread();
+    void outputArray(NDArray *pArray);
+    void outputSortedArrays(const epicsTimeStamp *pNow, double sortTime);
 
     /* The asyn interfaces we access as a client */
     void *asynGenericPointerInterruptPvt_;
@@ -131,13 +120,15 @@ private:
     std::vector<epicsThread*>pThreads_;
     epicsMessageQueue *pToThreadMsgQ_;
     epicsMessageQueue *pFromThreadMsgQ_;
-    std::multiset<sortedListElement> sortedNDArrayList_;
+    NDArrayReorderBuffer sortBuffer_;            /**< Output arrays waiting for preceding arrays when SortMode=1 */
     int prevUniqueId_;
     epicsThreadId sortingThreadId_;
     epicsTimeStamp lastProcessTime_;
     int dimsPrev_[ND_ARRAY_MAX_DIMS];
     bool compressionAware_;
     Throttler *throttler_;
+    int queueFree_;                              /**< Copy of NDPluginDriverQueueFree for getQueueFree() */
+    int executionTimeUs_;                        /**< Copy of NDPluginDriverExecutionTime in microseconds */
 };
 
 
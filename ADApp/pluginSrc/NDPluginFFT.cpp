@@ -11,18 +11,26 @@
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#include <algorithm>
 
 #include <iocsh.h>
 
 #include "NDPluginFFT.h"
-#include "fft.h"
 
 #include <epicsExport.h>
 
 #define MIN(A,B) ((A <= B) ? A : B)
 
+/* Some systems do not define M_PI in math.h */
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
 //static const char *driverName = "NDPluginFFT";
 
+/* Windows are cached by type and size; scanning the segment size must not keep one for every size */
+static const size_t maxCachedWindows = 16;
+
 /** Constructor for NDPluginFFT; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   * \param[in] portName The name of the asyn port driver to be created.
   * \param[in] queueSize The number of NDArrays that the input queue for this plugin can hold when
@@ -51,7 +59,8 @@ NDPluginFFT::NDPluginFFT(const char *portName, int queueSize, int blockingCallba
              asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
              asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
              0, 1, priority, stackSize, maxThreads),
-    numAverage_(0), uniqueId_(0), nTimeXIn_(0), nTimeYIn_(0), FFTAbsValue_(0), timePerPoint_(0), timeAxis_(0), freqAxis_(0)
+    numAverage_(0), uniqueId_(0), nTimeXIn_(0), nTimeYIn_(0), nTimeX_(0),
+    windowType_(FFTWindowRectangular), output_(FFTOutputMagnitude), decimationCount_(0), FFTAbsValue_(0), timePerPoint_(0), timeAxis_(0), freqAxis_(0)
 {
   //const char *functionName = "NDPluginFFT::NDPluginFFT";
 
@@ -68,6 +77,23 @@ NDPluginFFT::NDPluginFFT(const char *portName, int queueSize, int blockingCallba
   createParam(FFTRealString,             asynParamFloat64Array, &P_FFTReal);
   createParam(FFTImaginaryString,        asynParamFloat64Array, &P_FFTImaginary);
   createParam(FFTAbsValueString,         asynParamFloat64Array, &P_FFTAbsValue);
+  createParam(FFTPrecisionString,               asynParamInt32, &P_FFTPrecision);
+  createParam(FFTNumThreadsString,              asynParamInt32, &P_FFTNumThreads);
+  createParam(FFTWindowString,                  asynParamInt32, &P_FFTWindow);
+  createParam(FFTOutputString,                  asynParamInt32, &P_FFTOutput);
+  createParam(FFTSegmentSizeString,             asynParamInt32, &P_FFTSegmentSize);
+  createParam(FFTSegmentOverlapString,        asynParamFloat64, &P_FFTSegmentOverlap);
+  createParam(FFTNumSegmentsString,             asynParamInt32, &P_FFTNumSegments);
+  createParam(FFTDecimationString,              asynParamInt32, &P_FFTDecimation);
+
+  setIntegerParam(P_FFTPrecision, FFTPrecisionFloat64);
+  setIntegerParam(P_FFTNumThreads, 1);
+  setIntegerParam(P_FFTWindow, FFTWindowRectangular);
+  setIntegerParam(P_FFTOutput, FFTOutputMagnitude);
+  setIntegerParam(P_FFTSegmentSize, 0);
+  setDoubleParam(P_FFTSegmentOverlap, 50.);
+  setIntegerParam(P_FFTNumSegments, 1);
+  setIntegerParam(P_FFTDecimation, 1);
 
   /* Set the plugin type string */
   setStringParam(NDPluginDriverPluginType, "NDPluginFFT");
@@ -79,32 +105,106 @@ NDPluginFFT::NDPluginFFT(const char *portName, int queueSize, int blockingCallba
 
 }
 
-int NDPluginFFT::nextPow2(int v)
+/** Gets the size of the FFT and the segments of the input array.  1-D arrays can be split into segments
+  * of SegmentSize points, which overlap by SegmentOverlap percent.  Each segment is transformed and the
+  * results are averaged (Welch's method).  Points after the last whole segment are not used.
+  * The FFT handles any size, so the data are not padded.  Called with the lock taken.
+  * \param[in] pPvt Private pointer for FFT plugin
+  */
+void NDPluginFFT::getSegments(fftPvt_t *pPvt)
 {
-  v--;
-  v |= v >> 1;
-  v |= v >> 2;
-  v |= v >> 4;
-  v |= v >> 8;
-  v |= v >> 16;
-  v++;
-  return v;
+  int segmentSize;
+  double overlap;
+
+  getIntegerParam(P_FFTSegmentSize,   &segmentSize);
+  getDoubleParam(P_FFTSegmentOverlap, &overlap);
+  pPvt->nTimeX = pPvt->nTimeXIn;
+  pPvt->nTimeY = pPvt->nTimeYIn;
+  pPvt->segmentStep = pPvt->nTimeXIn;
+  pPvt->numSegments = 1;
+  if ((pPvt->rank == 1) && (segmentSize > 0) && (segmentSize < pPvt->nTimeXIn)) {
+    if (overlap < 0) overlap = 0;
+    pPvt->nTimeX = segmentSize;
+    pPvt->segmentStep = (int)(segmentSize * (1. - overlap/100.) + 0.5);
+    if (pPvt->segmentStep < 1) pPvt->segmentStep = 1;
+    pPvt->numSegments = (pPvt->nTimeXIn - segmentSize) / pPvt->segmentStep + 1;
+  }
+  setIntegerParam(P_FFTNumSegments, pPvt->numSegments);
 }
 
-void NDPluginFFT::allocateArrays(fftPvt_t *pPvt, bool sizeChanged)
+/** Returns a coefficient of a periodic window of size n. */
+static double windowValue(int windowType, int i, int n)
+{
+  double x = 2. * M_PI * i / n;
+
+  switch (windowType) {
+    case FFTWindowHann:
+      return 0.5 - 0.5*cos(x);
+    case FFTWindowHamming:
+      return 0.54 - 0.46*cos(x);
+    case FFTWindowBlackman:
+      return 0.42 - 0.5*cos(x) + 0.08*cos(2*x);
+    case FFTWindowFlatTop:
+      return 0.21557895 - 0.41663158*cos(x) + 0.277263158*cos(2*x) - 0.083578947*cos(3*x) + 0.006947368*cos(4*x);
+    default:
+      return 1.;
+  }
+}
+
+/** Gets the window and the output type of this FFT.  Each window is only computed the first time its type and size
+  * are used.
+  * 2-D FFTs are not windowed and always compute the magnitude.  Called with the lock taken.
+  * \param[in] pPvt Private pointer for FFT plugin
+  */
+void NDPluginFFT::getWindow(fftPvt_t *pPvt)
 {
-  // Round dimensions up to next power of 2
-  pPvt->nTimeX = nextPow2(pPvt->nTimeXIn);
-  pPvt->nTimeY = nextPow2(pPvt->nTimeYIn);
+  int windowType;
+  int i;
+  int n = pPvt->nTimeX;
+  double value;
+
+  getIntegerParam(P_FFTWindow, &windowType);
+  getIntegerParam(P_FFTOutput, &pPvt->output);
+  if (pPvt->rank != 1) {
+    windowType = FFTWindowRectangular;
+    pPvt->output = FFTOutputMagnitude;
+  }
+  if ((windowType != windowType_) || (pPvt->output != output_)) {
+    // Spectra computed with different windows or outputs cannot be averaged together
+    windowType_ = windowType;
+    output_ = pPvt->output;
+    setIntegerParam(P_FFTResetAverage, 1);
+  }
+  pPvt->windowSum = n;
+  pPvt->windowSumSquares = n;
+  if (windowType == FFTWindowRectangular) return;
+
+  std::pair<int, int> key(windowType, n);
+  if ((windows_.find(key) == windows_.end()) && (windows_.size() >= maxCachedWindows)) windows_.clear();
+  std::shared_ptr<std::vector<double> >& window = windows_[key];
+  if (!window) {
+    window = std::make_shared<std::vector<double> >(n);
+    for (i=0; i<n; i++) (*window)[i] = windowValue(windowType, i, n);
+  }
+  pPvt->window = window;
+  pPvt->windowSum = 0;
+  pPvt->windowSumSquares = 0;
+  for (i=0; i<n; i++) {
+    value = (*window)[i];
+    pPvt->windowSum += value;
+    pPvt->windowSumSquares += value * value;
+  }
+}
 
+void NDPluginFFT::allocateArrays(fftPvt_t *pPvt, bool sizeChanged)
+{
   pPvt->nFreqX = pPvt->nTimeX / 2;
   pPvt->nFreqY = pPvt->nTimeY / 2;
   if (pPvt->nFreqY < 1) pPvt->nFreqY = 1;
 
-  size_t timeSize = pPvt->nTimeX * pPvt->nTimeY;
+  size_t timeSize = pPvt->nTimeXIn * pPvt->nTimeYIn;
   size_t freqSize = pPvt->nFreqX * pPvt->nFreqY;
   pPvt->timeSeries   = (double *)calloc(timeSize, sizeof(double));
-  pPvt->FFTComplex   = (double *)calloc(timeSize, sizeof(double) * 2); // Complex data
   pPvt->FFTReal      = (double *)calloc(freqSize, sizeof(double));
   pPvt->FFTImaginary = (double *)calloc(freqSize, sizeof(double));
   pPvt->FFTAbsValue  = (double *)calloc(freqSize, sizeof(double));
@@ -119,51 +219,106 @@ void NDPluginFFT::allocateArrays(fftPvt_t *pPvt, bool sizeChanged)
   }
 }
 
-void NDPluginFFT::computeFFT_1D(fftPvt_t *pPvt)
+/** Gets the plan for the size and precision of this FFT, and the threads for 2-D FFTs.
+  * Plans are only created when the size or precision changes.  Called with the lock taken.
+  * \param[in] pPvt Private pointer for FFT plugin
+  */
+void NDPluginFFT::getPlans(fftPvt_t *pPvt)
 {
-  int j;
-
-  for (j=0; j<pPvt->nTimeX; j++) {
-    pPvt->FFTComplex[2*j] = pPvt->timeSeries[j];
-    pPvt->FFTComplex[2*j+1] = 0.;
-  }
-  fft_1D(pPvt->FFTComplex, pPvt->nTimeX, 1);
-  for (j=0; j<pPvt->nFreqX; j++) {
-    pPvt->FFTReal     [j] = pPvt->FFTComplex[2*j];
-    pPvt->FFTImaginary[j] = pPvt->FFTComplex[2*j+1];
-    pPvt->FFTAbsValue [j] = sqrt((pPvt->FFTComplex[2*j]   * pPvt->FFTComplex[2*j] +
-                            pPvt->FFTComplex[2*j+1] * pPvt->FFTComplex[2*j+1])) / pPvt->nTimeX;
+  int precision;
+  int numThreads;
+
+  getIntegerParam(P_FFTPrecision,  &precision);
+  getIntegerParam(P_FFTNumThreads, &numThreads);
+  if (precision == FFTPrecisionFloat32) {
+    if (!planFloat32_ || (planFloat32_->nx() != pPvt->nTimeX) || (planFloat32_->ny() != pPvt->nTimeY)) {
+      planFloat32_ = std::make_shared<NDFFTPlan<float> >(pPvt->nTimeX, pPvt->nTimeY);
+    }
+    pPvt->planFloat32 = planFloat32_;
+  } else {
+    if (!planFloat64_ || (planFloat64_->nx() != pPvt->nTimeX) || (planFloat64_->ny() != pPvt->nTimeY)) {
+      planFloat64_ = std::make_shared<NDFFTPlan<double> >(pPvt->nTimeX, pPvt->nTimeY);
+    }
+    pPvt->planFloat64 = planFloat64_;
   }
-  if (pPvt->suppressDC) {
-    pPvt->FFTReal      [0] = 0;
-    pPvt->FFTImaginary [0] = 0;
-    pPvt->FFTAbsValue  [0] = 0;
+  if ((pPvt->rank == 2) && (numThreads > 1)) {
+    if (!workers_ || (workers_->numThreads() != numThreads)) {
+      workers_ = std::make_shared<NDFFTWorkers>(numThreads);
+    }
+    pPvt->workers = workers_;
   }
 }
 
-void NDPluginFFT::computeFFT_2D(fftPvt_t *pPvt)
+/** Returns the time series in the type of the FFT.  The time series is already double,
+  * so it is only converted into the buffer for float FFTs.
+  */
+static const double *FFTInput(const double *timeSeries, size_t size, double *buffer)
 {
-  int i,j, k;
-  double *pIn;
-  unsigned long dims[2];
+  return timeSeries;
+}
 
-  for (j=0; j<pPvt->nTimeX*pPvt->nTimeY; j++) {
-    pPvt->FFTComplex[2*j] = pPvt->timeSeries[j];
-    pPvt->FFTComplex[2*j+1] = 0.;
-  }
-  dims[0] = pPvt->nTimeX;
-  dims[1] = pPvt->nTimeY;
-  fft_ND(pPvt->FFTComplex, dims, 2, 1);
-  for (i=0, k=0, pIn=pPvt->FFTComplex;
-       i<pPvt->nFreqY;
-       i++, pIn+=pPvt->nTimeX*2) {
-    for (j=0; j<pPvt->nFreqX; j++, k++) {
-      pPvt->FFTReal     [k] = pIn[j*2];
-      pPvt->FFTImaginary[k] = pIn[j*2+1];
-      pPvt->FFTAbsValue [k]= sqrt((pPvt->FFTReal[k] * pPvt->FFTReal[k]) + (pPvt->FFTImaginary[k] * pPvt->FFTImaginary[k])) / (pPvt->nTimeX * pPvt->nTimeY);
+static const float *FFTInput(const double *timeSeries, size_t size, float *buffer)
+{
+  std::copy(timeSeries, timeSeries + size, buffer);
+  return buffer;
+}
+
+/**
+ * Templated function to compute the 1-D or 2-D FFT of the time series with a plan.
+ * The magnitude or PSD of each segment is added to FFTAbsValue as it is computed, then divided by the
+ * number of segments.  FFTReal and FFTImaginary are those of the last segment.
+ * The converted or windowed input and the complex output are kept in a workspace of the plan.
+ * \param[in] pPvt Private pointer for FFT plugin
+ * \param[in] pPlan The plan for the size of the FFT
+ */
+template <typename T>
+void NDPluginFFT::computeFFTT(fftPvt_t *pPvt, const NDFFTPlan<T> *pPlan)
+{
+  size_t fftSize = (size_t)pPvt->nTimeX * pPvt->nTimeY;
+  size_t freqSize = (size_t)pPvt->nFreqX * pPvt->nFreqY;
+  int nOutX = pPlan->nOutX();
+  NDFFTWorkspace<T> *pWorkspace = pPlan->getWorkspace();
+  T *buffer = pWorkspace->input();
+  std::complex<T> *FFTComplex = pWorkspace->output();
+  const std::complex<T> *pIn;
+  const double *pTime;
+  const double *pWindow = pPvt->window ? &(*pPvt->window)[0] : 0;
+  const T *pData;
+  double scale = 1. / (pPvt->windowSum * pPvt->nTimeY);
+  // One-sided PSD in units of signal^2/Hz; all frequencies except DC also have a negative frequency
+  double psdScale = 1. / (pPvt->sampleRate * pPvt->windowSumSquares);
+  double power;
+  int segment, i, j;
+  size_t k;
+
+  for (segment=0; segment<pPvt->numSegments; segment++) {
+    pTime = pPvt->timeSeries + (size_t)segment * pPvt->segmentStep;
+    if (pWindow) {
+      for (k=0; k<fftSize; k++) buffer[k] = (T)(pTime[k] * pWindow[k]);
+      pData = buffer;
+    } else {
+      pData = FFTInput(pTime, fftSize, buffer);
     }
+    pPlan->execute(pData, FFTComplex, pPvt->workers.get(), pWorkspace);
+    for (i=0, k=0; i<pPvt->nFreqY; i++) {
+      pIn = &FFTComplex[(size_t)i * nOutX];
+      for (j=0; j<pPvt->nFreqX; j++, k++) {
+        pPvt->FFTReal     [k] = pIn[j].real();
+        pPvt->FFTImaginary[k] = pIn[j].imag();
+        power = (pPvt->FFTReal[k] * pPvt->FFTReal[k]) + (pPvt->FFTImaginary[k] * pPvt->FFTImaginary[k]);
+        if (pPvt->output == FFTOutputPSD) {
+          pPvt->FFTAbsValue[k] += power * ((j == 0) ? psdScale : 2. * psdScale);
+        } else {
+          pPvt->FFTAbsValue[k] += sqrt(power) * scale;
+        }
+      }
+    }
+  }
+  pPlan->releaseWorkspace(pWorkspace);
+  if (pPvt->numSegments > 1) {
+    for (k=0; k<freqSize; k++) pPvt->FFTAbsValue[k] /= pPvt->numSegments;
   }
-  if (pPvt->suppressDC) {
+  if (pPvt->suppressDC && (pPvt->nFreqX > 0)) {
     pPvt->FFTReal      [0] = 0;
     pPvt->FFTImaginary [0] = 0;
     pPvt->FFTAbsValue  [0] = 0;
@@ -182,9 +337,11 @@ void NDPluginFFT::doArrayCallbacks(fftPvt_t *pPvt)
   int resetAverage;
   int freqSize;
   int arrayCallbacks;
+  int decimation;
   NDArray *pArrayOut;
 
   getIntegerParam(NDArrayCallbacks, &arrayCallbacks);
+  getIntegerParam(P_FFTDecimation,   &decimation);
   getIntegerParam(P_FFTResetAverage, &resetAverage);
   getIntegerParam(P_FFTNumAverage,   &numAverage);
   getIntegerParam(P_FFTNumAveraged,  &numAveraged);
@@ -206,6 +363,13 @@ void NDPluginFFT::doArrayCallbacks(fftPvt_t *pPvt)
   for (j=0; j < freqSize; j++) {
     FFTAbsValue_[j] = FFTAbsValue_[j] * oldFraction + pPvt->FFTAbsValue[j] * newFraction;
   }
+  // Arrays between outputs are only averaged
+  decimationCount_++;
+  if (decimationCount_ < decimation) {
+    arrayCallbacks = 0;
+  } else {
+    decimationCount_ = 0;
+  }
   if (arrayCallbacks) {
     dims[0] = pPvt->nFreqX;
     dims[1] = pPvt->nFreqY;
@@ -221,12 +385,13 @@ void NDPluginFFT::doArrayCallbacks(fftPvt_t *pPvt)
   }
 
   /* Do waveform callbacks.  This only does the first row for 2-D FFTs. */
-  doCallbacksFloat64Array(pPvt->timeSeries,   pPvt->nTimeX, P_FFTTimeSeries, 0);
-  doCallbacksFloat64Array(pPvt->FFTReal,      pPvt->nFreqX, P_FFTReal,       0);
-  doCallbacksFloat64Array(pPvt->FFTImaginary, pPvt->nFreqX, P_FFTImaginary,  0);
-  doCallbacksFloat64Array(FFTAbsValue_,       MIN(pPvt->nFreqX, nFreqX_), P_FFTAbsValue,   0);
+  if (decimationCount_ == 0) {
+    doCallbacksFloat64Array(pPvt->timeSeries,   pPvt->nTimeXIn, P_FFTTimeSeries, 0);
+    doCallbacksFloat64Array(pPvt->FFTReal,      pPvt->nFreqX, P_FFTReal,       0);
+    doCallbacksFloat64Array(pPvt->FFTImaginary, pPvt->nFreqX, P_FFTImaginary,  0);
+    doCallbacksFloat64Array(FFTAbsValue_,       MIN(pPvt->nFreqX, nFreqX_), P_FFTAbsValue,   0);
+  }
   free(pPvt->timeSeries);
-  free(pPvt->FFTComplex);
   free(pPvt->FFTReal);
   free(pPvt->FFTImaginary);
   free(pPvt->FFTAbsValue);
@@ -239,23 +404,23 @@ void NDPluginFFT::createAxisArrays(fftPvt_t *pPvt)
 
   if (timeAxis_) free(timeAxis_);
   if (freqAxis_) free(freqAxis_);
-  timeAxis_ = (double *)calloc(pPvt->nTimeX, sizeof(double));
+  timeAxis_ = (double *)calloc(pPvt->nTimeXIn, sizeof(double));
   freqAxis_ = (double *)calloc(pPvt->nFreqX, sizeof(double));
 
-  for (i=0; i<pPvt->nTimeX; i++) {
+  for (i=0; i<pPvt->nTimeXIn; i++) {
     timeAxis_[i] = i * timePerPoint_;
   }
-  // Check this - are the frequencies correct, or off-by-one?
-  freqStep = 0.5 / timePerPoint_ / (pPvt->nFreqX - 1);
+  // Point i of an FFT of nTimeX points is at frequency i / (nTimeX * timePerPoint)
+  freqStep = 1. / (pPvt->nTimeX * timePerPoint_);
   for (i=0; i<pPvt->nFreqX; i++) {
     freqAxis_[i] = i * freqStep;
   }
-  doCallbacksFloat64Array(timeAxis_, pPvt->nTimeX, P_FFTTimeAxis, 0);
+  doCallbacksFloat64Array(timeAxis_, pPvt->nTimeXIn, P_FFTTimeAxis, 0);
   doCallbacksFloat64Array(freqAxis_, pPvt->nFreqX, P_FFTFreqAxis, 0);
 }
 
 /**
- * Templated function to copy the data from the NDArray into double arrays with padding.
+ * Templated function to copy the data from the NDArray into double arrays.
  * \param[in] pArray The pointer to the NDArray object
  * \param[in] pPvt Private pointer for FFT plugin
  */
@@ -268,7 +433,7 @@ void NDPluginFFT::convertToDoubleT(NDArray *pArray, fftPvt_t *pPvt)
 
   for (i=0, pIn=(epicsType *)pArray->pData, pOut=pPvt->timeSeries;
        i<pPvt->nTimeYIn;
-       i++, pOut+=pPvt->nTimeX) {
+       i++, pOut+=pPvt->nTimeXIn) {
     for (j=0; j<pPvt->nTimeXIn; j++) {
       pOut[j] = (epicsFloat64)*pIn++;
     }
@@ -310,25 +475,32 @@ void NDPluginFFT::processCallbacks(NDArray *pArray)
       asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
         "%s: error, number of array dimensions must be 1 or 2\n",
         functionName);
+      delete pPvt;
       return;
       break;
   }
 
+  getSegments(pPvt);
   if ((pPvt->nTimeXIn != nTimeXIn_) ||
-      (pPvt->nTimeYIn != nTimeYIn_)) {
+      (pPvt->nTimeYIn != nTimeYIn_) ||
+      (pPvt->nTimeX   != nTimeX_)) {
     sizeChanged = true;
     nTimeXIn_ = pPvt->nTimeXIn;
     nTimeYIn_ = pPvt->nTimeYIn;
+    nTimeX_   = pPvt->nTimeX;
   }
 
   getIntegerParam(P_FFTSuppressDC, &pPvt->suppressDC);
 
   allocateArrays(pPvt, sizeChanged);
+  getWindow(pPvt);
+  getPlans(pPvt);
   getDoubleParam(P_FFTTimePerPoint, &timePerPoint);
   if (timePerPoint != timePerPoint_) {
     timePerPoint_ = timePerPoint;
     createAxisArrays(pPvt);
   }
+  pPvt->sampleRate = (timePerPoint_ > 0) ? 1. / timePerPoint_ : 1.;
 
   // Release the lock, things below don't access shared memory
   this->unlock();
@@ -366,8 +538,11 @@ void NDPluginFFT::processCallbacks(NDArray *pArray)
   default:
     break;
   }
-  if (pPvt->rank == 1) computeFFT_1D(pPvt);
-  if (pPvt->rank == 2) computeFFT_2D(pPvt);
+  if (pPvt->planFloat32) {
+    computeFFTT<float>(pPvt, pPvt->planFloat32.get());
+  } else {
+    computeFFTT<double>(pPvt, pPvt->planFloat64.get());
+  }
 
   // Take the lock again
   this->lock();
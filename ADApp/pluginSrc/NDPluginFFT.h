@@ -10,7 +10,12 @@
 #ifndef NDPluginFFT_H
 #define NDPluginFFT_H
 
+#include <map>
+#include <memory>
+#include <utility>
+
 #include "NDPluginDriver.h"
+#include "NDFFTPlan.h"
 
 #define FFTTimeAxisString        "FFT_TIME_AXIS"        /* (asynFloat64Array, r/o) Time axis array */
 #define FFTFreqAxisString        "FFT_FREQ_AXIS"        /* (asynFloat64Array, r/o) Frequency axis array */
@@ -24,6 +29,35 @@
 #define FFTRealString            "FFT_REAL"             /* (asynFloat64Array, r/o) Real part of FFT */
 #define FFTImaginaryString       "FFT_IMAGINARY"        /* (asynFloat64Array, r/o) Imaginary part of FFT */
 #define FFTAbsValueString        "FFT_ABS_VALUE"        /* (asynFloat64Array, r/o) Absolute value of FFT */
+#define FFTPrecisionString       "FFT_PRECISION"        /* (asynInt32,        r/w) Precision of FFT computation */
+#define FFTNumThreadsString      "FFT_NUM_THREADS"      /* (asynInt32,        r/w) # of threads for 2-D FFTs */
+#define FFTWindowString          "FFT_WINDOW"           /* (asynInt32,        r/w) Window function */
+#define FFTOutputString          "FFT_OUTPUT"           /* (asynInt32,        r/w) Magnitude or power spectral density */
+#define FFTSegmentSizeString     "FFT_SEGMENT_SIZE"     /* (asynInt32,        r/w) Points per segment of 1-D arrays, 0=whole array */
+#define FFTSegmentOverlapString  "FFT_SEGMENT_OVERLAP"  /* (asynFloat64,      r/w) Overlap of segments in percent */
+#define FFTNumSegmentsString     "FFT_NUM_SEGMENTS"     /* (asynInt32,        r/o) # of segments in each array */
+#define FFTDecimationString      "FFT_DECIMATION"       /* (asynInt32,        r/w) Output every Nth array */
+
+/** Precision of the FFT computation */
+typedef enum {
+  FFTPrecisionFloat64,
+  FFTPrecisionFloat32
+} FFTPrecision_t;
+
+/** Window applied to 1-D data before the FFT */
+typedef enum {
+  FFTWindowRectangular,
+  FFTWindowHann,
+  FFTWindowHamming,
+  FFTWindowBlackman,
+  FFTWindowFlatTop
+} FFTWindow_t;
+
+/** Quantity computed from the FFT */
+typedef enum {
+  FFTOutputMagnitude,
+  FFTOutputPSD
+} FFTOutput_t;
 
 typedef struct {
   int rank;
@@ -35,11 +69,20 @@ typedef struct {
   int nFreqY;
   int suppressDC;
   int numAverage;
+  int output;
+  int numSegments;
+  int segmentStep;
+  double sampleRate;
   double *timeSeries;
-  double *FFTComplex;
   double *FFTReal;
   double *FFTImaginary;
   double *FFTAbsValue;
+  std::shared_ptr<NDFFTPlan<double> > planFloat64;
+  std::shared_ptr<NDFFTPlan<float> > planFloat32;
+  std::shared_ptr<NDFFTWorkers> workers;
+  std::shared_ptr<std::vector<double> > window;   // NULL for a rectangular window
+  double windowSum;
+  double windowSumSquares;
 } fftPvt_t;
 
 /** Compute FFTs on signals */
@@ -69,20 +112,33 @@ protected:
   int P_FFTReal;
   int P_FFTImaginary;
   int P_FFTAbsValue;
+  int P_FFTPrecision;
+  int P_FFTNumThreads;
+  int P_FFTWindow;
+  int P_FFTOutput;
+  int P_FFTSegmentSize;
+  int P_FFTSegmentOverlap;
+  int P_FFTNumSegments;
+  int P_FFTDecimation;
 
 private:
   template <typename epicsType> void convertToDoubleT(NDArray *pArray, fftPvt_t *pPvt);
+  void getSegments(fftPvt_t *pPvt);
+  void getWindow(fftPvt_t *pPvt);
   void allocateArrays(fftPvt_t *pPvt, bool sizeChanged);
   void createAxisArrays(fftPvt_t *pPvt);
-  void computeFFT_1D(fftPvt_t *pPvt);
-  void computeFFT_2D(fftPvt_t *pPvt);
+  void getPlans(fftPvt_t *pPvt);
+  template <typename T> void computeFFTT(fftPvt_t *pPvt, const NDFFTPlan<T> *pPlan);
   void doArrayCallbacks(fftPvt_t *pPvt);
-  int nextPow2(int v);
 
   int numAverage_;
   int uniqueId_;
   int nTimeXIn_;
   int nTimeYIn_;
+  int nTimeX_;
+  int windowType_;
+  int output_;
+  int decimationCount_;
   // Note FFTAbsValue_ is guaranteed to be size nFreqX_ * nFreqY_
   // These could change between when a thread began computing the FFT and when it does the callbacks
   int nFreqX_;
@@ -91,6 +147,13 @@ private:
   double timePerPoint_; /* Actual time between points in input arrays */
   double *timeAxis_;
   double *freqAxis_;
+  // Plans for the current size, and the threads for 2-D FFTs.  Each FFT holds its own references,
+  // so these can be replaced while other threads are computing.
+  std::shared_ptr<NDFFTPlan<double> > planFloat64_;
+  std::shared_ptr<NDFFTPlan<float> > planFloat32_;
+  std::shared_ptr<NDFFTWorkers> workers_;
+  // Windows that have been computed, by type and size, so switching between them does not recompute them
+  std::map<std::pair<int, int>, std::shared_ptr<std::vector<double> > > windows_;
 };
 
 #endif //NDPluginFFT_H
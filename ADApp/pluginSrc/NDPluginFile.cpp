@@ -203,7 +203,7 @@ asynStatus NDPluginFile::writeFileBase()
     int status = asynSuccess;
     int fileWriteMode;
     int numCapture, numCaptured;
-    int i;
+    size_t i, numArrays;
     bool doLazyOpen;
     int deleteDriverFile;
     NDArray *pArray;
@@ -267,13 +267,14 @@ asynStatus NDPluginFile::writeFileBase()
             callParamCallbacks();
             break;
         case NDFileModeCapture:
-            /* Write the file */
-            if (pCapture.size() == 0) {
+            /* Write the file; the arrays may all be in the spill store */
+            if (pCapture.size() + captureSpill.size() == 0) {
                 asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
                     "%s::%s: ERROR, capture buffer is empty\n",
                     driverName, functionName);
                 setIntegerParam(NDFileWriteStatus, NDFileWriteError);
                 setStringParam(NDFileWriteMessage, "ERROR, no capture buffer present");
+                freeCaptureBuffer();
                 break;
             }
             setIntegerParam(NDWriteFile, 1);
@@ -281,8 +282,23 @@ asynStatus NDPluginFile::writeFileBase()
             if (this->supportsMultipleArrays)
                 status = this->openFileBase(NDFileModeWrite | NDFileModeMultiple, pArrayOut);
             if (status == asynSuccess) {
-                for (i=0; i<pCapture.size(); i++) {
-                    pArray = pCapture[i];
+                numArrays = pCapture.size() + captureSpill.size();
+                for (i=0; i<numArrays; i++) {
+                    if (i < pCapture.size()) {
+                        pArray = pCapture[i];
+                    } else {
+                        /* The arrays after those in memory are read back from disk, reading ahead of the writer */
+                        captureSpill.readahead(ND_SPILL_READAHEAD_ARRAYS);
+                        pArray = captureSpill.pop(this->pNDArrayPool);
+                        if (!pArray) {
+                            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                                "%s::%s: ERROR, cannot allocate array %d read from the spill store\n",
+                                driverName, functionName, (int)i);
+                            setIntegerParam(NDFileWriteStatus, NDFileWriteError);
+                            setStringParam(NDFileWriteMessage, "ERROR, cannot read array from spill store");
+                            continue;
+                        }
+                    }
                     if (!this->supportsMultipleArrays)
                         status = this->openFileBase(NDFileModeWrite, pArray);
                     else
@@ -307,6 +323,7 @@ asynStatus NDPluginFile::writeFileBase()
                                 status = this->closeFileBase();
                         }
                     }
+                    if (i >= pCapture.size()) pArray->release();
                 }
             }
             freeCaptureBuffer();
@@ -388,7 +405,7 @@ void NDPluginFile::freeCaptureBuffer()
 {
     NDArray *pArray;
 
-    if (pCapture.size() == 0) return;
+    if ((pCapture.size() == 0) && (captureSpill.size() == 0)) return;
     /* Free the capture buffer */
     for (size_t i=0; i<pCapture.size(); i++) {
         pArray = pCapture[i];
@@ -396,7 +413,35 @@ void NDPluginFile::freeCaptureBuffer()
         pArray->release();
     }
     pCapture.clear();
+    /* The spill file is kept for the next capture */
+    captureSpill.clear();
+    captureBytes = 0;
     setIntegerParam(NDFileNumCaptured, 0);
+    setDoubleParam(NDFileCaptureMemory, 0.);
+    setDoubleParam(NDFileSpillUsed, 0.);
+}
+
+/** Opens the store for captured arrays on disk if NDFileSpillPath and NDFileSpillMaxSize are set, and closes it
+  * otherwise.  The file of the store is kept from the previous capture if they have not changed, and its disk space
+  * is only reserved as arrays are spilled, so this does not delay the start of the capture. */
+void NDPluginFile::openCaptureSpill()
+{
+    std::string spillPath;
+    std::string errorMessage;
+    int spillMaxSize;
+    static const char* functionName = "openCaptureSpill";
+
+    getStringParam(NDFileSpillPath, spillPath);
+    getIntegerParam(NDFileSpillMaxSize, &spillMaxSize);
+    if (spillPath.empty() || (spillMaxSize <= 0)) {
+        captureSpill.close();
+        return;
+    }
+    if (captureSpill.open(spillPath.c_str(), (size_t)spillMaxSize * 1024 * 1024, errorMessage) != ND_SUCCESS) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s ERROR: cannot open the spill store, arrays are only captured in memory: %s\n",
+            driverName, functionName, errorMessage.c_str());
+    }
 }
 
 /** Handles the logic for when NDFileCapture changes state, starting or stopping capturing or streaming NDArrays
@@ -455,6 +500,7 @@ asynStatus NDPluginFile::doCapture(int capture)
                 }
                 pArray->getInfo(&arrayInfo);
                 this->registerInitFrameInfo(pArray);
+                openCaptureSpill();
             } else {
                 /* Stop capturing, nothing to do, setting the parameter is all that is needed */
             }
@@ -704,8 +750,9 @@ void NDPluginFile::processCallbacks(NDArray *pArray)
     int fileWriteMode, autoSave, capture;
     int arrayCounter;
     int numCapture, numCaptured;
+    int captureMaxMemory;
     asynStatus status = asynSuccess;
-    //static const char* functionName = "processCallbacks";
+    static const char* functionName = "processCallbacks";
 
     /* First check if the callback is really for this file saving plugin */
     if (!this->attrIsProcessingRequired(pArray->pAttributeList))
@@ -741,10 +788,27 @@ void NDPluginFile::processCallbacks(NDArray *pArray)
         case NDFileModeCapture:
             if (capture) {
                 if (numCaptured < numCapture && this->isFrameValid(pArray)) {
-                    pArray->reserve();
-                    pCapture.push_back(pArray);
-                    numCaptured = pCapture.size();
-                    arrayCounter++;
+                    getIntegerParam(NDFileCaptureMaxMemory, &captureMaxMemory);
+                    if (captureSpill.isOpen() && (captureMaxMemory > 0) &&
+                        ((captureBytes + pArray->dataSize > (size_t)captureMaxMemory * 1024 * 1024) ||
+                         (captureSpill.size() > 0))) {
+                        /* The capture buffer uses the maximum memory, so keep the array on disk */
+                        if (captureSpill.push(pArray) != ND_SUCCESS) {
+                            asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
+                                "%s::%s ERROR: spill store is full, stopping capture after %d arrays\n",
+                                driverName, functionName, numCaptured);
+                            setStringParam(NDFileWriteMessage, "Spill store full, capture stopped");
+                            numCapture = numCaptured;
+                        }
+                        setDoubleParam(NDFileSpillUsed, captureSpill.bytesUsed() / 1048576.);
+                    } else {
+                        pArray->reserve();
+                        pCapture.push_back(pArray);
+                        captureBytes += pArray->dataSize;
+                        setDoubleParam(NDFileCaptureMemory, captureBytes / 1048576.);
+                    }
+                    if ((int)(pCapture.size() + captureSpill.size()) > numCaptured) arrayCounter++;
+                    numCaptured = pCapture.size() + captureSpill.size();
                     setIntegerParam(NDFileNumCaptured, numCaptured);
                 }
                 if (numCaptured == numCapture) {
@@ -924,6 +988,7 @@ NDPluginFile::NDPluginFile(const char *portName, int queueSize, int blockingCall
 
     this->ndArrayInfoInit = NULL;
     this->lazyOpen = false;
+    this->captureBytes = 0;
 
     this->useAttrFilePrefix = false;
     this->fileMutexId = epicsMutexCreate();
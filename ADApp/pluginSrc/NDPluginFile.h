@@ -5,6 +5,7 @@
 #include <epicsMutex.h>
 
 #include "NDPluginDriver.h"
+#include "NDArraySpillStore.h"
 
 /** Mask to open file for reading */
 #define NDFileModeRead     0x01
@@ -73,6 +74,7 @@ private:
     asynStatus closeFileBase();
     asynStatus doCapture(int capture);
     void       freeCaptureBuffer();
+    void       openCaptureSpill();
     asynStatus attrFileCloseCheck();
     asynStatus attrFileNameCheck();
     asynStatus attrFileNameSet();
@@ -81,6 +83,8 @@ private:
     bool isFrameValid(NDArray *pArray); /**< Compare pArray dimensions and datatype against latched NDArrayInfo_t structure */
 
     std::vector<NDArray*> pCapture;
+    NDArraySpillStore captureSpill; /**< Captured arrays after those in pCapture, once it uses NDFileCaptureMaxMemory */
+    size_t captureBytes;            /**< Memory used by the arrays in pCapture */
     epicsMutexId fileMutexId;
     bool useAttrFilePrefix;
     bool lazyOpen;
@@ -26,11 +26,11 @@
 
 static const char *driverName="NDPluginOverlay";
 
-void NDPluginOverlay::addPixel(NDOverlay_t *pOverlay, int ix, int iy, NDArrayInfo_t *pArrayInfo)
+void NDPluginOverlay::addPixel(std::vector<int>& offsets, int ix, int iy, NDArrayInfo_t *pArrayInfo)
 {
   if ((ix >= 0) && (ix < (int)pArrayInfo->xSize) &&
       (iy >= 0) && (iy < (int)pArrayInfo->ySize))
-    pOverlay->pvt.addressOffset.push_back((int)(iy*pArrayInfo->yStride) + (int)(ix*pArrayInfo->xStride));
+    offsets.push_back((int)(iy*pArrayInfo->yStride) + (int)(ix*pArrayInfo->xStride));
 }
 
 template <typename epicsType>
@@ -61,186 +61,242 @@ void NDPluginOverlay::setPixel(epicsType *pValue, NDOverlay_t *pOverlay, NDArray
   }
 }
 
+/** Builds the text drawn by a text overlay, including its time stamp.
+  * \param[in] pArray The array, whose time stamp is used.
+  * \param[in] pOverlay The overlay.
+  * \param[out] text The text. */
+void NDPluginOverlay::renderText(NDArray *pArray, NDOverlay_t *pOverlay, std::string& text)
+{
+  char textOutStr[512];                    // our string, maybe with a time stamp, to place into the image array
+  char tstr[64];                           // Used to build the time string
 
+  if (strlen(pOverlay->TimeStampFormat) > 0) {
+    epicsTimeToStrftime(tstr, sizeof(tstr)-1, pOverlay->TimeStampFormat, &pArray->epicsTS);
+    epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s%s", pOverlay->DisplayText, tstr);
+  } else {
+    epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s", pOverlay->DisplayText);
+  }
+  textOutStr[sizeof(textOutStr)-1] = 0;
+  text = textOutStr;
+}
 
-template <typename epicsType>
-void NDPluginOverlay::doOverlayT(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
+/** Computes the pixels drawn by an overlay and stores them in pOverlay->pvt.raster.
+  * This is only done when the overlay geometry, its text or the array geometry changes;
+  * changes of color or draw mode reuse the raster.
+  * \param[in] pOverlay The overlay.
+  * \param[in] pArrayInfo The array geometry. */
+void NDPluginOverlay::rasterize(NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
 {
   int xmin, xmax, ymin, ymax, xcent, ycent, xsize, ysize, ix, iy, ii, jj, ib;
   int xwide, ywide, xwidemax_line, xwidemin_line;
+  std::vector<int> offsets;
   std::vector<int>::iterator it;
   int nSteps;
   double theta, thetaStep;
-  epicsType *pData=(epicsType *)pArray->pData;
-  char textOutStr[512];                    // our string, maybe with a time stamp, to place into the image array
-  char *cp;                                // character pointer to current character being rendered
+  const char *cp;                          // character pointer to current character being rendered
   int bmc;                                 // current byte in the font bitmap
   int mask;                                // selects the bit in bmc to look at
-  char tstr[64];                           // Used to build the time string
   NDPluginOverlayTextFontBitmapType *bmp;  // pointer to our font information (bitmap pointer, perhaps misnamed)
   int bpc;                                 // bytes per char, ie, 1 for 6x13 font, 2 for 9x15 font
   int sbc;                                 // "sub" byte counter to keep track of which byte we are looking at for multi byte fonts
-  //static const char *functionName = "doOverlayT";
-
-  asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
-    "NDPluginOverlay::DoOverlayT, shape=%d, Xpos=%d, Ypos=%d, Xsize=%d, Ysize=%d\n",
-    pOverlay->shape, (int)pOverlay->PositionX, (int)pOverlay->PositionY,
-    (int)pOverlay->SizeX, (int)pOverlay->SizeY);
-
-  if (pOverlay->pvt.changed) {
-    pOverlay->pvt.addressOffset.clear();
-
-    switch(pOverlay->shape) {
-      case NDOverlayCross:
-        xcent = pOverlay->PositionX + pOverlay->SizeX/2;
-        ycent = pOverlay->PositionY + pOverlay->SizeY/2;
-        xmin = xcent - pOverlay->SizeX/2;
-        xmax = xcent + pOverlay->SizeX/2;
-        ymin = ycent - pOverlay->SizeY/2;
-        ymax = ycent + pOverlay->SizeY/2;
-        xwide = pOverlay->WidthX / 2;
-        ywide = pOverlay->WidthY / 2;
-
-        for (iy=ymin; iy<=ymax; iy++) {
-          if ((iy >= (ycent - ywide)) && (iy <= ycent + ywide)) {
-            for (ix=xmin; ix<=xmax; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          } else {
-            xwidemin_line = xcent - xwide;
-            xwidemax_line = xcent + xwide;
-            for (ix=xwidemin_line; ix<=xwidemax_line; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
+  std::shared_ptr<NDOverlayRaster_t> raster = std::make_shared<NDOverlayRaster_t>();
+  NDOverlayRun_t run = {0, 0};
+  int xStride = (int)pArrayInfo->xStride;
+
+  switch(pOverlay->shape) {
+    case NDOverlayCross:
+      xcent = pOverlay->PositionX + pOverlay->SizeX/2;
+      ycent = pOverlay->PositionY + pOverlay->SizeY/2;
+      xmin = xcent - pOverlay->SizeX/2;
+      xmax = xcent + pOverlay->SizeX/2;
+      ymin = ycent - pOverlay->SizeY/2;
+      ymax = ycent + pOverlay->SizeY/2;
+      xwide = pOverlay->WidthX / 2;
+      ywide = pOverlay->WidthY / 2;
+
+      for (iy=ymin; iy<=ymax; iy++) {
+        if ((iy >= (ycent - ywide)) && (iy <= ycent + ywide)) {
+          for (ix=xmin; ix<=xmax; ++ix) {
+            addPixel(offsets, ix, iy, pArrayInfo);
           }
-        }
-        break;
-
-      case NDOverlayRectangle:
-        xmin = pOverlay->PositionX;
-        xmax = pOverlay->PositionX + pOverlay->SizeX;
-        ymin = pOverlay->PositionY;
-        ymax = pOverlay->PositionY + pOverlay->SizeY;
-        xwide = pOverlay->WidthX;
-        ywide = pOverlay->WidthY;
-        xwide = MIN(xwide, (int)pOverlay->SizeX-1);
-        ywide = MIN(ywide, (int)pOverlay->SizeY-1);
-
-        //For non-zero width, grow the rectangle towards the center.
-        for (iy=ymin; iy<=ymax; iy++) {
-          if ((iy < (ymin + ywide)) ||
-              (iy > (ymax - ywide))) {
-            for (ix=xmin; ix<=xmax; ix++) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-          } else {
-            for (ix=xmin; ix<(xmin+xwide); ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
-            for (ix=(xmax-xwide+1); ix<=xmax; ++ix) {
-              addPixel(pOverlay, ix, iy, pArrayInfo);
-            }
+        } else {
+          xwidemin_line = xcent - xwide;
+          xwidemax_line = xcent + xwide;
+          for (ix=xwidemin_line; ix<=xwidemax_line; ++ix) {
+            addPixel(offsets, ix, iy, pArrayInfo);
           }
         }
-        break;
+      }
+      break;
 
-      case NDOverlayEllipse:
-        xwide = pOverlay->WidthX;
-        ywide = pOverlay->WidthY;
-        xwide = MIN(xwide, (int)pOverlay->SizeX-1);
-        ywide = MIN(ywide, (int)pOverlay->SizeY-1);
-        xcent = pOverlay->PositionX + pOverlay->SizeX/2;
-        ycent = pOverlay->PositionY + pOverlay->SizeY/2;
-        xsize = pOverlay->SizeX/2;
-        ysize = pOverlay->SizeY/2;
-        xmax = (int)(pArrayInfo->xSize-1);
-        ymax = (int)(pArrayInfo->ySize-1);
-
-        // Use the parametric equation for an ellipse.
-        // Only need to compute 0 to pi/2, other quadrants by symmetry
-        // Make 2*(xsize + ysize) angle points
-        nSteps = 2*(xsize + ysize);
-        thetaStep = M_PI / 2. / nSteps;
-        for (ii=0, theta=0.; ii<=nSteps; ii++, theta+=thetaStep) {
-          for (jj=0; jj<xwide; jj++) {
-            ix = (int)((xsize-jj) * cos(theta) + 0.5);
-            iy = (int)((ysize-jj) * sin(theta) + 0.5);
-            addPixel(pOverlay, (xcent + ix), (ycent + iy), pArrayInfo);
-            addPixel(pOverlay, (xcent + ix), (ycent - iy), pArrayInfo);
-            addPixel(pOverlay, (xcent - ix), (ycent + iy), pArrayInfo);
-            addPixel(pOverlay, (xcent - ix), (ycent - iy), pArrayInfo);
+    case NDOverlayRectangle:
+      xmin = pOverlay->PositionX;
+      xmax = pOverlay->PositionX + pOverlay->SizeX;
+      ymin = pOverlay->PositionY;
+      ymax = pOverlay->PositionY + pOverlay->SizeY;
+      xwide = pOverlay->WidthX;
+      ywide = pOverlay->WidthY;
+      xwide = MIN(xwide, (int)pOverlay->SizeX-1);
+      ywide = MIN(ywide, (int)pOverlay->SizeY-1);
+
+      //For non-zero width, grow the rectangle towards the center.
+      for (iy=ymin; iy<=ymax; iy++) {
+        if ((iy < (ymin + ywide)) ||
+            (iy > (ymax - ywide))) {
+          for (ix=xmin; ix<=xmax; ix++) {
+            addPixel(offsets, ix, iy, pArrayInfo);
           }
-        }
-        // There may be duplicate pixels in the address list.
-        // We must remove them or the XOR draw mode won't work because the pixel will be set and then unset
-        std::sort(pOverlay->pvt.addressOffset.begin(), pOverlay->pvt.addressOffset.end());
-        it = std::unique(pOverlay->pvt.addressOffset.begin(), pOverlay->pvt.addressOffset.end());
-        pOverlay->pvt.addressOffset.resize(std::distance(pOverlay->pvt.addressOffset.begin(), it));
-        break;
-
-      case NDOverlayText:
-        if ((pOverlay->Font >= 0) && (pOverlay->Font < NDPluginOverlayTextFontBitmapTypeN)) {
-          bmp = &NDPluginOverlayTextFontBitmaps[pOverlay->Font];
         } else {
-          // Really, no reason to go on if the font is ill defined
-          return;
+          for (ix=xmin; ix<(xmin+xwide); ++ix) {
+            addPixel(offsets, ix, iy, pArrayInfo);
+          }
+          for (ix=(xmax-xwide+1); ix<=xmax; ++ix) {
+            addPixel(offsets, ix, iy, pArrayInfo);
+          }
         }
+      }
+      break;
 
-        bpc = bmp->width / 8 + 1;
-
-        if (strlen(pOverlay->TimeStampFormat) > 0) {
-          epicsTimeToStrftime(tstr, sizeof(tstr)-1, pOverlay->TimeStampFormat, &pArray->epicsTS);
-          epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s%s", pOverlay->DisplayText, tstr);
-        } else {
-          epicsSnprintf(textOutStr, sizeof(textOutStr)-1, "%s", pOverlay->DisplayText);
+    case NDOverlayEllipse:
+      xwide = pOverlay->WidthX;
+      ywide = pOverlay->WidthY;
+      xwide = MIN(xwide, (int)pOverlay->SizeX-1);
+      ywide = MIN(ywide, (int)pOverlay->SizeY-1);
+      xcent = pOverlay->PositionX + pOverlay->SizeX/2;
+      ycent = pOverlay->PositionY + pOverlay->SizeY/2;
+      xsize = pOverlay->SizeX/2;
+      ysize = pOverlay->SizeY/2;
+      xmax = (int)(pArrayInfo->xSize-1);
+      ymax = (int)(pArrayInfo->ySize-1);
+
+      // Use the parametric equation for an ellipse.
+      // Only need to compute 0 to pi/2, other quadrants by symmetry
+      // Make 2*(xsize + ysize) angle points
+      nSteps = 2*(xsize + ysize);
+      thetaStep = M_PI / 2. / nSteps;
+      for (ii=0, theta=0.; ii<=nSteps; ii++, theta+=thetaStep) {
+        for (jj=0; jj<xwide; jj++) {
+          ix = (int)((xsize-jj) * cos(theta) + 0.5);
+          iy = (int)((ysize-jj) * sin(theta) + 0.5);
+          addPixel(offsets, (xcent + ix), (ycent + iy), pArrayInfo);
+          addPixel(offsets, (xcent + ix), (ycent - iy), pArrayInfo);
+          addPixel(offsets, (xcent - ix), (ycent + iy), pArrayInfo);
+          addPixel(offsets, (xcent - ix), (ycent - iy), pArrayInfo);
         }
-        textOutStr[sizeof(textOutStr)-1] = 0;
-
-        cp   = textOutStr;
-        xmin = pOverlay->PositionX;
-        xmax = pOverlay->PositionX + pOverlay->SizeX;
-        ymin = pOverlay->PositionY;
-        ymax = pOverlay->PositionY + pOverlay->SizeY;
-        ymax = MIN(ymax, pOverlay->PositionY + bmp->height);
-
-        // Loop over vertical lines
-        for (jj=0, iy=ymin; iy<ymax; jj++, iy++) {
-
-          // Loop over characters
-          for (ii=0; cp[ii]!=0; ii++) {
-            if( cp[ii] < 32)
-              continue;
+      }
+      break;
 
-            if (xmin+ii * bmp->width >= xmax)
-              // None of this character can be written
+    case NDOverlayText:
+      if ((pOverlay->Font >= 0) && (pOverlay->Font < NDPluginOverlayTextFontBitmapTypeN)) {
+        bmp = &NDPluginOverlayTextFontBitmaps[pOverlay->Font];
+      } else {
+        // Really, no reason to go on if the font is ill defined
+        break;
+      }
+
+      bpc = bmp->width / 8 + 1;
+
+      cp   = pOverlay->pvt.text.c_str();
+      xmin = pOverlay->PositionX;
+      xmax = pOverlay->PositionX + pOverlay->SizeX;
+      ymin = pOverlay->PositionY;
+      ymax = pOverlay->PositionY + pOverlay->SizeY;
+      ymax = MIN(ymax, pOverlay->PositionY + bmp->height);
+
+      // Loop over vertical lines
+      for (jj=0, iy=ymin; iy<ymax; jj++, iy++) {
+
+        // Loop over characters
+        for (ii=0; cp[ii]!=0; ii++) {
+          if( cp[ii] < 32)
+            continue;
+
+          if (xmin+ii * bmp->width >= xmax)
+            // None of this character can be written
+            break;
+
+          sbc = 0;
+          bmc = bmp->bitmap[(bmp->height*(cp[ii] - 32) + jj)*bpc];
+          mask = 0x80;
+          for (ib=0; ib<bmp->width; ib++) {
+            ix = xmin + ii * bmp->width + ib;
+            if (ix >= xmax)
               break;
-
-            sbc = 0;
-            bmc = bmp->bitmap[(bmp->height*(cp[ii] - 32) + jj)*bpc];
-            mask = 0x80;
-            for (ib=0; ib<bmp->width; ib++) {
-              ix = xmin + ii * bmp->width + ib;
-              if (ix >= xmax)
-                break;
-              if (mask & bmc) {
-                addPixel(pOverlay, ix, iy, pArrayInfo);
-              }
-              mask >>= 1;
-              if (!mask) {
-                mask = 0x80;
-                sbc++;
-                bmc = bmp->bitmap[(bmp->height*(cp[ii] - 32) + jj)*bpc + sbc];
-              }
+            if (mask & bmc) {
+              addPixel(offsets, ix, iy, pArrayInfo);
+            }
+            mask >>= 1;
+            if (!mask) {
+              mask = 0x80;
+              sbc++;
+              bmc = bmp->bitmap[(bmp->height*(cp[ii] - 32) + jj)*bpc + sbc];
             }
           }
         }
-        break;
-    } // switch(pOverlay->shape)
-  } // if (pOverlay->pvt.changed)
+      }
+      break;
+  } // switch(pOverlay->shape)
+
+  // There may be duplicate pixels in the address list.
+  // We must remove them or the XOR draw mode won't work because the pixel will be set and then unset
+  std::sort(offsets.begin(), offsets.end());
+  it = std::unique(offsets.begin(), offsets.end());
+  offsets.resize(std::distance(offsets.begin(), it));
+
+  // Store pixels that follow each other in memory as runs, so they are drawn by simple loops
+  for (ii=0; ii<(int)offsets.size(); ii++) {
+    if ((ii > 0) && (offsets[ii] == run.offset + run.count*xStride)) {
+      run.count++;
+      continue;
+    }
+    if (ii > 0) raster->runs.push_back(run);
+    run.offset = offsets[ii];
+    run.count = 1;
+  }
+  if (!offsets.empty()) raster->runs.push_back(run);
+  raster->numPixels = (int)offsets.size();
+  pOverlay->pvt.raster = raster;
+}
 
-  // Set the pixels in the image from the addressOffset vector list
-  for (ii=0; ii<(int)pOverlay->pvt.addressOffset.size(); ii++) {
-    setPixel(pData + pOverlay->pvt.addressOffset[ii], pOverlay, pArrayInfo);
+template <typename epicsType>
+void NDPluginOverlay::doOverlayT(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo)
+{
+  epicsType *pData=(epicsType *)pArray->pData;
+  epicsType *pValue;
+  int xStride = (int)pArrayInfo->xStride;
+  size_t i;
+  int j;
+  bool mono = ((pArrayInfo->colorMode != NDColorModeRGB1) &&
+               (pArrayInfo->colorMode != NDColorModeRGB2) &&
+               (pArrayInfo->colorMode != NDColorModeRGB3));
+  //static const char *functionName = "doOverlayT";
+
+  asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
+    "NDPluginOverlay::DoOverlayT, shape=%d, Xpos=%d, Ypos=%d, Xsize=%d, Ysize=%d\n",
+    pOverlay->shape, (int)pOverlay->PositionX, (int)pOverlay->PositionY,
+    (int)pOverlay->SizeX, (int)pOverlay->SizeY);
+
+  if (!pOverlay->pvt.raster) return;
+  const std::vector<NDOverlayRun_t>& runs = pOverlay->pvt.raster->runs;
+
+  // Set the pixels in the image from the runs
+  if (mono && (pOverlay->drawMode == NDOverlaySet)) {
+    epicsType value = (epicsType)pOverlay->green;
+    for (i=0; i<runs.size(); i++) {
+      pValue = pData + runs[i].offset;
+      for (j=0; j<runs[i].count; j++) pValue[j*xStride] = value;
+    }
+  } else if (mono && (pOverlay->drawMode == NDOverlayXOR)) {
+    int value = pOverlay->green;
+    for (i=0; i<runs.size(); i++) {
+      pValue = pData + runs[i].offset;
+      for (j=0; j<runs[i].count; j++) pValue[j*xStride] = (epicsType)((int)pValue[j*xStride] ^ value);
+    }
+  } else {
+    for (i=0; i<runs.size(); i++) {
+      pValue = pData + runs[i].offset;
+      for (j=0; j<runs[i].count; j++) setPixel(pValue + j*xStride, pOverlay, pArrayInfo);
+    }
   }
 }
 
@@ -298,19 +354,34 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
 
   int overlay;
   int itemp;
+  int inPlace;
+  int blockingCallbacks;
   NDArray *pOutput;
   NDArrayInfo arrayInfo;
   std::vector<NDOverlay_t>pOverlays;
   NDOverlay_t *pOverlay;
+  NDOverlay_t *pPrev;
+  std::string text;
   bool arrayInfoChanged;
-  int overlayUserLen = sizeof(*pOverlay) - sizeof(pOverlay->pvt);
   static const char* functionName = "processCallbacks";
 
   /* Call the base class method */
   NDPluginDriver::beginProcessCallbacks(pArray);
 
-  /* Copy the input array so we can modify it. */
-  pOutput = this->pNDArrayPool->copy(pArray, NULL, 1);
+  /* Draw in the input array if that is enabled, its data can be modified, and nothing else holds it: the caller
+   * and pPrevInputArray_ each hold one reference, and no other plugin can get the array while it is queued for us.
+   * Otherwise copy the input array so we can modify it. */
+  getIntegerParam(0, NDPluginOverlayInPlace, &inPlace);
+  getIntegerParam(NDPluginDriverBlockingCallbacks, &blockingCallbacks);
+  if (inPlace && !blockingCallbacks && !pArray->readOnly &&
+      (this->pPrevInputArray_ == pArray) && (pArray->getReferenceCount() == 2)) {
+    this->pPrevInputArray_->release();
+    this->pPrevInputArray_ = NULL;
+    pArray->reserve();
+    pOutput = pArray;
+  } else {
+    pOutput = this->pNDArrayPool->copy(pArray, NULL, 1);
+  }
 
   /* Get information about the array needed later */
   pOutput->getInfo(&arrayInfo);
@@ -325,6 +396,8 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
   /* Loop over the overlays in this driver */
   for (overlay=0; overlay<this->maxOverlays_; overlay++) {
     pOverlay = &pOverlays[overlay];
+    /* Rasters of unused overlays are also for the old array geometry */
+    if (arrayInfoChanged) pOverlay->pvt.raster.reset();
     getIntegerParam(overlay, NDPluginOverlayUse, &pOverlay->use);
     if (!pOverlay->use) continue;
      /* Need to fetch all of these parameters while we still have the mutex */
@@ -345,12 +418,24 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
 
     pOverlay->DisplayText[sizeof(pOverlay->DisplayText)-1] = 0;
 
-    // Compare to see if any fields in the overlay have changed
-    pOverlay->pvt.changed = (memcmp(&this->prevOverlays_[overlay], pOverlay, overlayUserLen) != 0);
-    if (arrayInfoChanged) pOverlay->pvt.changed = true;
-    /* If this is a text overlay with a non-blank time stamp format then it always needs to be updated */
-    if ((pOverlay->shape == NDOverlayText) && (strlen(pOverlay->TimeStampFormat) > 0)) {
+    // The cached raster only needs to be computed again if the pixels it covers have changed.
+    // The color and draw mode are applied when drawing.
+    pPrev = &this->prevOverlays_[overlay];
+    pOverlay->pvt.changed = (!pOverlay->pvt.raster ||
+                             (pOverlay->PositionX != pPrev->PositionX) ||
+                             (pOverlay->PositionY != pPrev->PositionY) ||
+                             (pOverlay->SizeX     != pPrev->SizeX)     ||
+                             (pOverlay->SizeY     != pPrev->SizeY)     ||
+                             (pOverlay->WidthX    != pPrev->WidthX)    ||
+                             (pOverlay->WidthY    != pPrev->WidthY)    ||
+                             (pOverlay->shape     != pPrev->shape));
+    /* A text overlay also changes when its text does, which includes the time stamp if it has a format */
+    if (pOverlay->shape == NDOverlayText) {
+      renderText(pArray, pOverlay, text);
+      if ((pOverlay->Font != pPrev->Font) || (text != pOverlay->pvt.text)) {
+        pOverlay->pvt.text = text;
         pOverlay->pvt.changed = true;
+      }
     }
   }
   /* This function is called with the lock taken, and it must be set when we exit.
@@ -360,12 +445,19 @@ void NDPluginOverlay::processCallbacks(NDArray *pArray)
   for (overlay=0; overlay<this->maxOverlays_; overlay++) {
     pOverlay = &pOverlays[overlay];
     if (!pOverlay->use) continue;
+    if (pOverlay->pvt.changed) this->rasterize(pOverlay, &arrayInfo);
     this->doOverlay(pOutput, pOverlay, &arrayInfo);
     asynPrint(pasynUserSelf, ASYN_TRACEIO_DRIVER,
-      "%s::%s overlay %d, changed=%d, points=%d\n",
-      driverName, functionName, overlay, pOverlay->pvt.changed, (int)pOverlay->pvt.addressOffset.size());
+      "%s::%s overlay %d, changed=%d, points=%d, runs=%d\n",
+      driverName, functionName, overlay, pOverlay->pvt.changed,
+      pOverlay->pvt.raster->numPixels, (int)pOverlay->pvt.raster->runs.size());
   }
   this->lock();
+  /* writeInt32 may have changed the freeze flags while the lock was released */
+  for (overlay=0; overlay<this->maxOverlays_; overlay++) {
+    pOverlays[overlay].pvt.freezePositionX = this->prevOverlays_[overlay].pvt.freezePositionX;
+    pOverlays[overlay].pvt.freezePositionY = this->prevOverlays_[overlay].pvt.freezePositionY;
+  }
   this->prevOverlays_ = pOverlays;
   NDPluginDriver::endProcessCallbacks(pOutput, false, true);
   callParamCallbacks();
@@ -431,9 +523,11 @@ NDPluginOverlay::NDPluginOverlay(const char *portName, int queueSize, int blocki
   createParam(NDPluginOverlayTimeStampFormatString, asynParamOctet, &NDPluginOverlayTimeStampFormat);
   createParam(NDPluginOverlayFontString,            asynParamInt32, &NDPluginOverlayFont);
   createParam(NDPluginOverlayDisplayTextString,     asynParamOctet, &NDPluginOverlayDisplayText);
+  createParam(NDPluginOverlayInPlaceString,         asynParamInt32, &NDPluginOverlayInPlace);
 
   /* Set the plugin type string */
   setStringParam(NDPluginDriverPluginType, "NDPluginOverlay");
+  setIntegerParam(NDPluginOverlayInPlace, 0);
 
   // Enable ArrayCallbacks.
   // This plugin currently ignores this setting and always does callbacks, so make the setting reflect the behavior
@@ -2,6 +2,8 @@
 #define NDPluginOverlay_H
 
 #include <vector>
+#include <string>
+#include <memory>
 #include <algorithm>
 #include "NDPluginDriver.h"
 
@@ -17,8 +19,21 @@ typedef enum {
     NDOverlayXOR
 } NDOverlayDrawMode_t;
 
+/** Run of pixels that follow each other in memory, xStride apart */
 typedef struct {
-    std::vector<int> addressOffset;
+    int offset;     /**< Offset of the first pixel */
+    int count;      /**< Number of pixels */
+} NDOverlayRun_t;
+
+/** Pixels drawn by an overlay, rasterized for one array geometry */
+typedef struct {
+    std::vector<NDOverlayRun_t> runs;
+    int numPixels;
+} NDOverlayRaster_t;
+
+typedef struct {
+    std::shared_ptr<NDOverlayRaster_t> raster;  /**< Cached pixels; shared by the copies of the overlay */
+    std::string text;                           /**< Text the raster of a text overlay was rendered from */
     bool changed;
     bool freezePositionX;
     bool freezePositionY;
@@ -65,6 +80,7 @@ typedef struct NDOverlay {
 #define NDPluginOverlayTimeStampFormatString    "OVERLAY_TIMESTAMP_FORMAT" /* (asynOctet,r/w) Time stamp format */
 #define NDPluginOverlayFontString               "OVERLAY_FONT"          /* (asynInt32,   r/w) Type of Time Stamp to show (if any) */
 #define NDPluginOverlayDisplayTextString        "OVERLAY_DISPLAY_TEXT"  /* (asynOctet,   r/w) The text to display */
+#define NDPluginOverlayInPlaceString            "OVERLAY_IN_PLACE"      /* (asynInt32,   r/w) Draw in the input array if no other plugin uses it */
 
 /** Overlay graphics on top of an image.  Useful for highlighting ROIs and displaying cursors */
 class NDPLUGIN_API NDPluginOverlay : public NDPluginDriver {
@@ -99,12 +115,15 @@ protected:
     int NDPluginOverlayTimeStampFormat;
     int NDPluginOverlayFont;
     int NDPluginOverlayDisplayText;
+    int NDPluginOverlayInPlace;
 
 private:
     int maxOverlays_;
     NDArrayInfo prevArrayInfo_;
     std::vector<NDOverlay_t> prevOverlays_;    /* Vector of NDOverlay structures */
-    inline void addPixel(NDOverlay_t *pOverlay, int ix, int iy, NDArrayInfo_t *pArrayInfo);
+    inline void addPixel(std::vector<int>& offsets, int ix, int iy, NDArrayInfo_t *pArrayInfo);
+    void renderText(NDArray *pArray, NDOverlay_t *pOverlay, std::string& text);
+    void rasterize(NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
     template <typename epicsType> void doOverlayT(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
     int doOverlay(NDArray *pArray, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
     template <typename epicsType> void setPixel(epicsType *pValue, NDOverlay_t *pOverlay, NDArrayInfo_t *pArrayInfo);
@@ -8,8 +8,10 @@
  */
 
 #include <stdlib.h>
+#include <string>
 
 #include <iocsh.h>
+#include <epicsString.h>
 
 #include "NDPluginScatter.h"
 
@@ -27,6 +29,9 @@ void NDPluginScatter::processCallbacks(NDArray *pArray)
      * structures don't need to be protected.
      */
     int arrayCallbacks;
+    int method;
+    bool haveKey = false;
+    epicsUInt32 key = 0;
 
     static const char *functionName = "NDPluginScatter::processCallbacks";
 
@@ -38,8 +43,10 @@ void NDPluginScatter::processCallbacks(NDArray *pArray)
         NDArray *pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 1);
         if (NULL != pArrayOut) {
             this->getAttributes(pArrayOut->pAttributeList);
+            getIntegerParam(NDPluginScatterMethod, &method);
+            if (method == NDScatterAttribute) haveKey = getAttributeKey(pArrayOut, &key);
             this->unlock();
-            doNDArrayCallbacks(pArrayOut, NDArrayData, 0);
+            doNDArrayCallbacks(pArrayOut, NDArrayData, 0, method, haveKey, key);
             this->lock();
             if (this->pArrays[0]) this->pArrays[0]->release();
             this->pArrays[0] = pArrayOut;
@@ -52,43 +59,209 @@ void NDPluginScatter::processCallbacks(NDArray *pArray)
     }
 }
 
-/** Called by driver to do the callbacks to the next registered client on the asynGenericPointer interface.
+/** Computes the key that selects the client for NDScatterAttribute from the attribute named by NDPluginScatterAttribute.
+  * Called with the mutex locked.
+  * \param[in] pArray Pointer to the NDArray
+  * \param[out] pKey The key; numeric values are converted to integers, strings are hashed.
+  * \return Returns true if the array has the attribute, false otherwise. */
+bool NDPluginScatter::getAttributeKey(NDArray *pArray, epicsUInt32 *pKey)
+{
+    NDAttribute *pAttribute;
+    std::string value;
+    epicsInt64 i64;
+
+    pAttribute = attributeHandles_.get(pArray->pAttributeList, 0);
+    if (!pAttribute) return false;
+    switch (pAttribute->getDataType()) {
+        case NDAttrUndefined:
+            return false;
+        case NDAttrString:
+            if (pAttribute->getValue(value)) return false;
+            *pKey = epicsStrHash(value.c_str(), 0);
+            break;
+        default:
+            if (pAttribute->getValue(NDAttrInt64, &i64)) return false;
+            /* Keep consecutive negative values on different clients too */
+            *pKey = (epicsUInt32)(i64 < 0 ? -(i64 + 1) : i64);
+            break;
+    }
+    return true;
+}
+
+/** Returns the index in clients_ of the client with the most free elements in its input queue.
+  * Clients that are not plugins are treated as having empty queues.
+  * Ties are broken in round-robin order, starting from nextClient_. */
+int NDPluginScatter::selectLeastQueued()
+{
+    int numClients = (int)clients_.size();
+    int best = -1;
+    int bestFree = 0;
+    int i, client, queueFree;
+    NDPluginDriver *pPlugin;
+
+    for (i=0; i<numClients; i++) {
+        client = (nextClient_ + i) % numClients;
+        pPlugin = getInterruptPlugin(clients_[client]);
+        if (!pPlugin) return client;
+        queueFree = pPlugin->getQueueFree();
+        if ((best < 0) || (queueFree > bestFree)) {
+            best = client;
+            bestFree = queueFree;
+        }
+    }
+    return best;
+}
+
+/** Returns the index in clients_ of the next client in smooth weighted round-robin order.
+  * The weight of each client is the inverse of its execution time, so each client receives arrays in proportion
+  * to the rate at which it can process them, and the arrays sent to a client are spread evenly in time.
+  * Clients that are not plugins or have not processed an array yet get the average weight of the others. */
+int NDPluginScatter::selectWeighted()
+{
+    int numClients = (int)clients_.size();
+    int numKnown = 0;
+    int best = 0;
+    int i;
+    double executionTime, totalWeight = 0., knownWeight = 0.;
+    NDPluginDriver *pPlugin;
+
+    /* The credits carry over from array to array while the same clients are connected */
+    if (clients_ != creditClients_) {
+        creditClients_ = clients_;
+        credits_.assign(numClients, 0.);
+    }
+    weights_.resize(numClients);
+    for (i=0; i<numClients; i++) {
+        pPlugin = getInterruptPlugin(clients_[i]);
+        executionTime = pPlugin ? pPlugin->getExecutionTime() : 0.;
+        weights_[i] = (executionTime > 0.) ? 1./executionTime : 0.;
+        if (weights_[i] > 0.) {
+            knownWeight += weights_[i];
+            numKnown++;
+        }
+    }
+    for (i=0; i<numClients; i++) {
+        if (weights_[i] == 0.) weights_[i] = numKnown ? knownWeight/numKnown : 1.;
+        totalWeight += weights_[i];
+        credits_[i] += weights_[i];
+        if (credits_[i] > credits_[best]) best = i;
+    }
+    credits_[best] -= totalWeight;
+    return best;
+}
+
+/** Called by driver to do the callbacks to only one registered client on the asynGenericPointer interface.
+  * The client is chosen by the scatter method.  If its queue is full the array is offered to the following
+  * clients in turn, except for NDScatterAttribute, which always uses the same client for the same attribute value.
   * \param[in] pArray Pointer to the NDArray
   * \param[in] reason A client will be called if reason matches pasynUser->reason registered for that client.
-  * \param[in] address A client will be called if address matches the address registered for that client. */
-asynStatus NDPluginScatter::doNDArrayCallbacks(NDArray *pArray, int reason, int address)
+  * \param[in] address A client will be called if address matches the address registered for that client.
+  * \param[in] method The NDScatterMethod_t.
+  * \param[in] haveKey true if key is valid; NDScatterAttribute uses round-robin for arrays without the attribute.
+  * \param[in] key The key from getAttributeKey(). */
+asynStatus NDPluginScatter::doNDArrayCallbacks(NDArray *pArray, int reason, int address,
+                                               int method, bool haveKey, epicsUInt32 key)
 {
     ELLLIST *pclientList;
     interruptNode *pnode;
+    asynGenericPointerInterrupt *pInterrupt;
     int addr;
-    int numNodes;
+    int numClients, numTries;
+    int first, client;
     int i;
     //static const char *functionName = "doNDArrayCallbacks";
 
     pasynManager->interruptStart(this->asynStdInterfaces.genericPointerInterruptPvt, &pclientList);
-    numNodes = ellCount(pclientList);
-    for (i=0; i<numNodes; i++) {
-        if (nextClient_ > numNodes) nextClient_ = 1;
-        pnode = (interruptNode *)ellNth(pclientList, nextClient_);
-        nextClient_++;
-        asynGenericPointerInterrupt *pInterrupt = (asynGenericPointerInterrupt *)pnode->drvPvt;
+    /* Collect the matching clients in one pass, so the chosen one can be indexed directly */
+    clients_.clear();
+    for (pnode = (interruptNode *)ellFirst(pclientList); pnode; pnode = (interruptNode *)ellNext(&pnode->node)) {
+        pInterrupt = (asynGenericPointerInterrupt *)pnode->drvPvt;
         pasynManager->getAddr(pInterrupt->pasynUser, &addr);
         /* If this is not a multi-device then address is -1, change to 0 */
         if (addr == -1) addr = 0;
         if ((pInterrupt->pasynUser->reason != reason) || (address != addr)) continue;
-        /* Set pasynUser->auxStatus to asynOverflow.
-         * This is a flag that means return without generating an error if the queue is full.
-         * We don't set this for the last node because if the last node cannot queue the array
-         * then the array will be dropped */
-        pInterrupt->pasynUser->auxStatus = asynOverflow;
-        if (i == numNodes-1) pInterrupt->pasynUser->auxStatus = asynSuccess;
-        pInterrupt->callback(pInterrupt->userPvt, pInterrupt->pasynUser, pArray);
-        if (pInterrupt->pasynUser->auxStatus == asynSuccess) break;
+        clients_.push_back(pInterrupt);
+    }
+    numClients = (int)clients_.size();
+    if (numClients > 0) {
+        if (nextClient_ >= numClients) nextClient_ = 0;
+        numTries = numClients;
+        switch (method) {
+            case NDScatterLeastQueued:
+                first = selectLeastQueued();
+                break;
+            case NDScatterWeighted:
+                first = selectWeighted();
+                break;
+            case NDScatterAttribute:
+                if (haveKey) {
+                    first = (int)(key % numClients);
+                    numTries = 1;
+                } else {
+                    first = nextClient_;
+                }
+                break;
+            default:
+                first = nextClient_;
+                break;
+        }
+        for (i=0; i<numTries; i++) {
+            client = (first + i) % numClients;
+            pInterrupt = clients_[client];
+            nextClient_ = (client + 1) % numClients;
+            /* Set pasynUser->auxStatus to asynOverflow.
+             * This is a flag that means return without generating an error if the queue is full.
+             * We don't set this for the last node because if the last node cannot queue the array
+             * then the array will be dropped */
+            pInterrupt->pasynUser->auxStatus = asynOverflow;
+            if (i == numTries-1) pInterrupt->pasynUser->auxStatus = asynSuccess;
+            pInterrupt->callback(pInterrupt->userPvt, pInterrupt->pasynUser, pArray);
+            if (pInterrupt->pasynUser->auxStatus == asynSuccess) break;
+        }
     }
     pasynManager->interruptEnd(this->asynStdInterfaces.genericPointerInterruptPvt);
     return asynSuccess;
 }
 
+/** Called when asyn clients call pasynOctet->write().
+  * This function performs actions for some parameters, including NDPluginScatterAttribute.
+  * For other parameters it calls NDPluginDriver::writeOctet to see if that method understands the parameter.
+  * \param[in] pasynUser pasynUser structure that encodes the reason and address.
+  * \param[in] value Address of the string to write.
+  * \param[in] nChars Number of characters to write.
+  * \param[out] nActual Number of characters actually written. */
+asynStatus NDPluginScatter::writeOctet(asynUser *pasynUser, const char *value, size_t nChars, size_t *nActual)
+{
+    int addr=0;
+    int function = pasynUser->reason;
+    asynStatus status = asynSuccess;
+    static const char *functionName = "writeOctet";
+
+    status = getAddress(pasynUser, &addr); if (status != asynSuccess) return(status);
+    if (function == NDPluginScatterAttribute) {
+        status = (asynStatus)setStringParam(addr, function, (char *)value);
+        attributeHandles_.setName(0, value);
+        *nActual = nChars;
+    } else {
+        /* If this parameter belongs to a base class call its method */
+        status = NDPluginDriver::writeOctet(pasynUser, value, nChars, nActual);
+    }
+
+    /* Do callbacks so higher layers see any changes */
+    callParamCallbacks(addr, addr);
+
+    if (status) {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR,
+              "%s:%s: status=%d, function=%d, value=%s\n",
+              driverName, functionName, status, function, value);
+    } else {
+        asynPrint(pasynUser, ASYN_TRACEIO_DRIVER,
+              "%s:%s: function=%d, value=%s\n",
+              driverName, functionName, function, value);
+    }
+    return status;
+}
+
 /** Constructor for NDPluginScatter; most parameters are simply passed to NDPluginDriver::NDPluginDriver.
   *
   * \param[in] portName The name of the asyn port driver to be created.
@@ -117,11 +290,16 @@ NDPluginScatter::NDPluginScatter(const char *portName, int queueSize, int blocki
                    asynInt32ArrayMask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
                    asynInt32ArrayMask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
                    ASYN_MULTIDEVICE, 1, priority, stackSize, 1),
-    nextClient_(1)
+    nextClient_(0)
 {
     //static const char *functionName = "NDPluginScatter::NDPluginScatter";
 
     createParam(NDPluginScatterMethodString,         asynParamInt32,        &NDPluginScatterMethod);
+    createParam(NDPluginScatterAttributeString,      asynParamOctet,        &NDPluginScatterAttribute);
+
+    setIntegerParam(NDPluginScatterMethod, NDScatterRoundRobin);
+    setStringParam(NDPluginScatterAttribute, "");
+    attributeHandles_.add("");
 
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginScatter");
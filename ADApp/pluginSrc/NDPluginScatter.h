@@ -1,12 +1,25 @@
 #ifndef NDPluginScatter_H
 #define NDPluginScatter_H
 
+#include <vector>
+
 #include "NDPluginDriver.h"
+#include "NDAttributeHandles.h"
+
+/** Algorithms for choosing the client that receives each NDArray */
+typedef enum {
+    NDScatterRoundRobin,     /**< Clients in turn */
+    NDScatterLeastQueued,    /**< The client with the most free elements in its input queue */
+    NDScatterWeighted,       /**< Clients in turn, in proportion to how fast they process arrays */
+    NDScatterAttribute       /**< The client selected by the value of an attribute */
+} NDScatterMethod_t;
 
 /* General parameters */
 #define NDPluginScatterMethodString          "SCATTER_METHOD"            /* (asynInt32,        r/w) Algorithm for scatter */
+#define NDPluginScatterAttributeString       "SCATTER_ATTRIBUTE"         /* (asynOctet,        r/w) Attribute for NDScatterAttribute */
 
-/** A plugin that does callbacks in round-robin fashion rather than passing every NDArray to every callback client  */
+/** A plugin that passes each NDArray to only one of its callback clients, chosen in round-robin fashion
+  * or from the load of the downstream plugins, rather than passing every NDArray to every callback client  */
 class NDPLUGIN_API NDPluginScatter : public NDPluginDriver {
 public:
     NDPluginScatter(const char *portName, int queueSize, int blockingCallbacks,
@@ -15,14 +28,24 @@ public:
                       int priority, int stackSize);
     /* These methods override the virtual methods in the base class */
     void processCallbacks(NDArray *pArray);
+    asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t nChars, size_t *nActual);
 
 protected:
     int NDPluginScatterMethod;
     #define FIRST_NDPLUGIN_SCATTER_PARAM NDPluginScatterMethod
+    int NDPluginScatterAttribute;
 
 private:
     int nextClient_;
-    asynStatus doNDArrayCallbacks(NDArray *pArray, int reason, int addr);
+    NDAttributeHandles attributeHandles_;                 /**< Handle of NDPluginScatterAttribute */
+    std::vector<asynGenericPointerInterrupt *> clients_;  /**< Clients matching the reason and address of the current callback */
+    std::vector<asynGenericPointerInterrupt *> creditClients_;  /**< Clients that credits_ was computed for */
+    std::vector<double> credits_;                         /**< Credit of each client for NDScatterWeighted */
+    std::vector<double> weights_;                         /**< Weight of each client for NDScatterWeighted */
+    bool getAttributeKey(NDArray *pArray, epicsUInt32 *pKey);
+    int selectLeastQueued();
+    int selectWeighted();
+    asynStatus doNDArrayCallbacks(NDArray *pArray, int reason, int addr, int method, bool haveKey, epicsUInt32 key);
 };
 
 #endif
@@ -10,6 +10,7 @@
  */
 
 #include <string.h>
+#include <math.h>
 
 #include <iocsh.h>
 
@@ -19,6 +20,44 @@
 
 static const char *driverName="NDPluginStdArrays";
 
+/** Returns true if data of type dataType can be passed to an asyn interface for interfaceType without
+  * conversion.  This is the case for the same type, and for the signed and unsigned integer types of the
+  * same size, because convert() casts between them without changing the bits. */
+static bool sameRepresentation(NDDataType_t dataType, NDDataType_t interfaceType)
+{
+    if (dataType == interfaceType) return true;
+    if ((dataType >= NDFloat32) || (interfaceType >= NDFloat32)) return false;
+    return (dataType/2 == interfaceType/2);
+}
+
+/** Copies every decimation'th element in X and Y of pIn to pOut */
+template <typename epicsType>
+static void decimateData(NDArray *pIn, NDArray *pOut, const size_t *steps)
+{
+    const epicsType *pInData = (const epicsType *)pIn->pData;
+    epicsType *pOutData = (epicsType *)pOut->pData;
+    size_t inStrides[ND_ARRAY_MAX_DIMS];
+    size_t index[ND_ARRAY_MAX_DIMS];
+    size_t stride = 1, nOut = 1, offset = 0;
+    int dim;
+
+    for (dim=0; dim<pIn->ndims; dim++) {
+        inStrides[dim] = stride * steps[dim];
+        stride *= pIn->dims[dim].size;
+        nOut *= pOut->dims[dim].size;
+        index[dim] = 0;
+    }
+    for (size_t i=0; i<nOut; i++) {
+        pOutData[i] = pInData[offset];
+        for (dim=0; dim<pIn->ndims; dim++) {
+            offset += inStrides[dim];
+            if (++index[dim] < pOut->dims[dim].size) break;
+            offset -= index[dim] * inStrides[dim];
+            index[dim] = 0;
+        }
+    }
+}
+
 template <typename epicsType, typename interruptType>
 void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDArrayPool *pNDArrayPool,
                             void *interruptPvt, int *initialized, NDDataType_t signedType, bool *wasThrottled)
@@ -28,6 +67,7 @@ void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDArrayPool *pND
     int status;
     epicsType *pData=NULL;
     NDArray *pOutput=NULL;
+    NDArray *pSent=pArray;
     NDArrayInfo_t arrayInfo;
     size_t numElements = 0;
     static const char* functionName="arrayInterruptCallback";
@@ -37,18 +77,25 @@ void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDArrayPool *pND
     while (pnode) {
         interruptType *pInterrupt = (interruptType *)pnode->drvPvt;
         if (pInterrupt->pasynUser->reason == NDPluginStdArraysData) {
+            /* The data are only converted for interfaces that have clients, and only once for all of them */
             if (!*initialized) {
                 *initialized = 1;
                 pArray->getInfo(&arrayInfo);
                 if (pArray->codec.empty()) {
-                    status = pNDArrayPool->convert(pArray, &pOutput, signedType);
-                    if (status) {
-                        asynPrint(pInterrupt->pasynUser, ASYN_TRACE_ERROR,
-                                  "%s::arrayInterruptCallback: error allocating array in convert()\n",
-                                   driverName);
-                        break;
+                    if (sameRepresentation(pArray->dataType, signedType)) {
+                        // The clients copy the data during the callback, so they can be passed the NDArray buffer
+                        pData = (epicsType *)pArray->pData;
+                    } else {
+                        status = pNDArrayPool->convert(pArray, &pOutput, signedType);
+                        if (status) {
+                            asynPrint(pInterrupt->pasynUser, ASYN_TRACE_ERROR,
+                                      "%s::arrayInterruptCallback: error allocating array in convert()\n",
+                                       driverName);
+                            break;
+                        }
+                        pData = (epicsType *)pOutput->pData;
+                        pSent = pOutput;
                     }
-                    pData = (epicsType *)pOutput->pData;
                     numElements = arrayInfo.nElements;
                 } else {
                     // Need to handle compressed arrays differently
@@ -56,7 +103,7 @@ void NDPluginStdArrays::arrayInterruptCallback(NDArray *pArray, NDArrayPool *pND
                     numElements = (pArray->compressedSize / arrayInfo.bytesPerElement) + 1;
                 }
             }
-            if (throttled(pOutput)) {
+            if (throttled(pSent)) {
                 int droppedOutputArrays;
                 *wasThrottled = true;
                 getIntegerParam(NDPluginDriverDroppedOutputArrays, &droppedOutputArrays);
@@ -101,17 +148,22 @@ asynStatus NDPluginStdArrays::readArray(asynUser *pasynUser, epicsType *value, s
                  * Just pass the first nElements. */
                  arrayInfo.nElements = nElements;
             }
-            status = (asynStatus)this->pNDArrayPool->convert(myArray, &pOutput, outputType);
-            if (status) {
-                asynPrint(pasynUser, ASYN_TRACE_ERROR,
-                          "%s::readArray: error allocating array in convert()\n",
-                           driverName);
-               goto done;
-            }
-            /* Copy the data */
             *nIn = arrayInfo.nElements;
-            memcpy(value, pOutput->pData, *nIn*sizeof(epicsType));
-            pOutput->release();
+            if (sameRepresentation(myArray->dataType, outputType)) {
+                /* No conversion is needed, copy the data directly */
+                memcpy(value, myArray->pData, *nIn*sizeof(epicsType));
+            } else {
+                status = (asynStatus)this->pNDArrayPool->convert(myArray, &pOutput, outputType);
+                if (status) {
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                              "%s::readArray: error allocating array in convert()\n",
+                               driverName);
+                   goto done;
+                }
+                /* Copy the data */
+                memcpy(value, pOutput->pData, *nIn*sizeof(epicsType));
+                pOutput->release();
+            }
         } else {
             // This is compressed data
             size_t numCopy = sizeof(epicsType) * nElements;
@@ -133,6 +185,88 @@ asynStatus NDPluginStdArrays::readArray(asynUser *pasynUser, epicsType *value, s
 
 
 
+/** Decimates an array in X and Y so that it has no more than maxElements elements.
+  * The same decimation is used for X and Y so the aspect ratio of images is preserved; the color dimension
+  * and any dimensions after X and Y are not decimated.  The binning of the output dimensions is multiplied
+  * by the decimation so clients can compute the original coordinates.
+  * \param[in] pArray The input array.
+  * \param[in] maxElements The maximum number of elements in the output; 0 for no limit.
+  * \param[out] decimation The decimation used, 1 if the array was not decimated.
+  * \return A new array that the caller must release, or NULL if the array does not need to be decimated
+  *         or it could not be allocated.
+  */
+NDArray *NDPluginStdArrays::decimateArray(NDArray *pArray, int maxElements, int *decimation)
+{
+    NDArrayInfo_t arrayInfo;
+    NDArray *pOutput;
+    size_t steps[ND_ARRAY_MAX_DIMS];
+    size_t dims[ND_ARRAY_MAX_DIMS];
+    size_t xSize, ySize=1, nOther, nOut;
+    size_t step;
+    int dim;
+    static const char *functionName = "decimateArray";
+
+    *decimation = 1;
+    if ((maxElements <= 0) || (pArray->ndims <= 0) || !pArray->codec.empty()) return NULL;
+    pArray->getInfo(&arrayInfo);
+    if (arrayInfo.nElements <= (size_t)maxElements) return NULL;
+
+    xSize = arrayInfo.xSize;
+    if (pArray->ndims > 1) ySize = arrayInfo.ySize;
+    nOther = arrayInfo.nElements / (xSize * ySize);
+    /* Start from the decimation that would be exact for a continuous size, then round up */
+    if (ySize > 1) {
+        step = (size_t)sqrt((double)arrayInfo.nElements / maxElements);
+    } else {
+        step = arrayInfo.nElements / maxElements;
+    }
+    if (step < 2) step = 2;
+    for (;; step++) {
+        nOut = ((xSize + step - 1) / step) * ((ySize + step - 1) / step) * nOther;
+        if ((nOut <= (size_t)maxElements) || ((step >= xSize) && (step >= ySize))) break;
+    }
+
+    for (dim=0; dim<pArray->ndims; dim++) {
+        steps[dim] = 1;
+        if ((dim == arrayInfo.xDim) || ((pArray->ndims > 1) && (dim == arrayInfo.yDim))) steps[dim] = step;
+        dims[dim] = (pArray->dims[dim].size + steps[dim] - 1) / steps[dim];
+    }
+    pOutput = this->pNDArrayPool->alloc(pArray->ndims, dims, pArray->dataType, 0, NULL);
+    if (!pOutput) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s: error allocating decimated array\n",
+            driverName, functionName);
+        return NULL;
+    }
+    pOutput->uniqueId = pArray->uniqueId;
+    pOutput->timeStamp = pArray->timeStamp;
+    pOutput->epicsTS = pArray->epicsTS;
+    pArray->pAttributeList->copy(pOutput->pAttributeList);
+    for (dim=0; dim<pArray->ndims; dim++) {
+        pOutput->dims[dim].offset = pArray->dims[dim].offset;
+        pOutput->dims[dim].binning = pArray->dims[dim].binning * (int)steps[dim];
+        pOutput->dims[dim].reverse = pArray->dims[dim].reverse;
+    }
+    /* The data are only copied, so the element size is all that matters */
+    switch (arrayInfo.bytesPerElement) {
+        case 1:
+            decimateData<epicsUInt8>(pArray, pOutput, steps);
+            break;
+        case 2:
+            decimateData<epicsUInt16>(pArray, pOutput, steps);
+            break;
+        case 4:
+            decimateData<epicsUInt32>(pArray, pOutput, steps);
+            break;
+        default:
+            decimateData<epicsUInt64>(pArray, pOutput, steps);
+            break;
+    }
+    *decimation = (int)step;
+    return pOutput;
+}
+
+
 /** Callback function that is called by the NDArray driver with new NDArray data.
   * It does callbacks with the array data to any registered asyn clients on any
   * of the asynXXXArray interfaces.  It converts the array data to the type required for that
@@ -153,46 +287,54 @@ void NDPluginStdArrays::processCallbacks(NDArray *pArray)
     int float32Initialized=0;
     int float64Initialized=0;
     bool wasThrottled=false;
-    NDArrayInfo_t arrayInfo;
+    int maxElements;
+    int decimation;
+    NDArray *pDecimated;
+    NDArray *pClientArray;
     asynStandardInterfaces *pInterfaces = this->getAsynStdInterfaces();
     /* static const char* functionName = "processCallbacks"; */
 
-    /* Call the base class method */
-    NDPluginDriver::beginProcessCallbacks(pArray);
+    /* Decimate large arrays first, so the dimensions reported by the base class are those of the array
+     * that the clients receive.  Downstream plugins still receive the original array. */
+    getIntegerParam(NDPluginStdArraysMaxElements, &maxElements);
+    pDecimated = decimateArray(pArray, maxElements, &decimation);
+    setIntegerParam(NDPluginStdArraysDecimation, decimation);
+    pClientArray = pDecimated ? pDecimated : pArray;
 
-    pArray->getInfo(&arrayInfo);
+    /* Call the base class method */
+    NDPluginDriver::beginProcessCallbacks(pClientArray);
 
     /* This function is called with the lock taken, and it must be set when we exit.
      * The following code can be exected without the mutex because we are not accessing pPvt */
     this->unlock();
 
     /* Pass interrupts for int8Array data*/
-    arrayInterruptCallback<epicsInt8, asynInt8ArrayInterrupt>(pArray, this->pNDArrayPool,
+    arrayInterruptCallback<epicsInt8, asynInt8ArrayInterrupt>(pClientArray, this->pNDArrayPool,
                              pInterfaces->int8ArrayInterruptPvt,
                              &int8Initialized, NDInt8, &wasThrottled);
 
     /* Pass interrupts for int16Array data*/
-    arrayInterruptCallback<epicsInt16,  asynInt16ArrayInterrupt>(pArray, this->pNDArrayPool,
+    arrayInterruptCallback<epicsInt16,  asynInt16ArrayInterrupt>(pClientArray, this->pNDArrayPool,
                              pInterfaces->int16ArrayInterruptPvt,
                              &int16Initialized, NDInt16, &wasThrottled);
 
     /* Pass interrupts for int32Array data*/
-    arrayInterruptCallback<epicsInt32, asynInt32ArrayInterrupt>(pArray, this->pNDArrayPool,
+    arrayInterruptCallback<epicsInt32, asynInt32ArrayInterrupt>(pClientArray, this->pNDArrayPool,
                              pInterfaces->int32ArrayInterruptPvt,
                              &int32Initialized, NDInt32, &wasThrottled);
 
     /* Pass interrupts for int64Array data*/
-    arrayInterruptCallback<epicsInt64, asynInt64ArrayInterrupt>(pArray, this->pNDArrayPool,
+    arrayInterruptCallback<epicsInt64, asynInt64ArrayInterrupt>(pClientArray, this->pNDArrayPool,
                              pInterfaces->int64ArrayInterruptPvt,
                              &int64Initialized, NDInt64, &wasThrottled);
 
     /* Pass interrupts for float32Array data*/
-    arrayInterruptCallback<epicsFloat32, asynFloat32ArrayInterrupt>(pArray, this->pNDArrayPool,
+    arrayInterruptCallback<epicsFloat32, asynFloat32ArrayInterrupt>(pClientArray, this->pNDArrayPool,
                              pInterfaces->float32ArrayInterruptPvt,
                              &float32Initialized, NDFloat32, &wasThrottled);
 
     /* Pass interrupts for float64Array data*/
-    arrayInterruptCallback<epicsFloat64, asynFloat64ArrayInterrupt>(pArray, this->pNDArrayPool,
+    arrayInterruptCallback<epicsFloat64, asynFloat64ArrayInterrupt>(pClientArray, this->pNDArrayPool,
                              pInterfaces->float64ArrayInterruptPvt,
                              &float64Initialized, NDFloat64, &wasThrottled);
 
@@ -210,9 +352,16 @@ void NDPluginStdArrays::processCallbacks(NDArray *pArray)
         setIntegerParam(NDArrayCounter, arrayCounter);
     }
 
-    // Do NDArray callbacks (rarely needed for this plugin).  We need to copy the array and get the attributes
+    // Do NDArray callbacks (rarely needed for this plugin).  We need to copy the array and get the attributes.
     NDPluginDriver::endProcessCallbacks(pArray, true, true);
 
+    // The asyn array reads return the array the clients received, so a decimated array replaces the
+    // cached copy of the original
+    if (pDecimated) {
+        if (this->pArrays[0]) this->pArrays[0]->release();
+        this->pArrays[0] = pDecimated;
+    }
+
     callParamCallbacks();
 }
 
@@ -334,9 +483,13 @@ NDPluginStdArrays::NDPluginStdArrays(const char *portName, int queueSize, int bl
     //static const char *functionName = "NDPluginStdArrays";
 
     createParam(NDPluginStdArraysDataString, asynParamGenericPointer, &NDPluginStdArraysData);
+    createParam(NDPluginStdArraysMaxElementsString, asynParamInt32, &NDPluginStdArraysMaxElements);
+    createParam(NDPluginStdArraysDecimationString, asynParamInt32, &NDPluginStdArraysDecimation);
 
     /* Set the plugin type string */
     setStringParam(NDPluginDriverPluginType, "NDPluginStdArrays");
+    setIntegerParam(NDPluginStdArraysMaxElements, 0);
+    setIntegerParam(NDPluginStdArraysDecimation, 1);
 
     // Disable ArrayCallbacks.
     // This plugin currently does not do array callbacks, so make the setting reflect the behavior
@@ -4,10 +4,14 @@
 #include "NDPluginDriver.h"
 
 #define NDPluginStdArraysDataString "STD_ARRAY_DATA"           /* (asynXXXArray, r/w) Array data waveform */
+#define NDPluginStdArraysMaxElementsString "STD_ARRAY_MAX_ELEMENTS" /* (asynInt32, r/w) Maximum number of elements output, 0=no limit */
+#define NDPluginStdArraysDecimationString "STD_ARRAY_DECIMATION" /* (asynInt32, r/o) Decimation of X and Y used for the last array */
 
 /** Converts NDArray callback data into standard asyn arrays (asynInt8Array, asynInt16Array, asynInt32Array, asynInt64Array,
   * asynFloat32Array or asynFloat64Array); normally used for putting NDArray data in EPICS waveform records.
-  * It handles the data type conversion if the NDArray data type differs from the data type of the asyn interface.
+  * It handles the data type conversion if the NDArray data type differs from the data type of the asyn interface;
+  * arrays that already have the representation of the interface are passed to the clients without a copy.
+  * Large arrays can be decimated in X and Y to a maximum number of elements for display clients.
   * It flattens the NDArrays to a single dimension because asyn and EPICS do not support multi-dimensional arrays. */
 class NDPLUGIN_API NDPluginStdArrays : public NDPluginDriver {
 public:
@@ -32,8 +36,11 @@ public:
 protected:
     int NDPluginStdArraysData;
     #define FIRST_NDPLUGIN_STDARRAYS_PARAM NDPluginStdArraysData
+    int NDPluginStdArraysMaxElements;
+    int NDPluginStdArraysDecimation;
 private:
     /* These methods are just for this class */
+    NDArray *decimateArray(NDArray *pArray, int maxElements, int *decimation);
     template <typename epicsType> asynStatus readArray(asynUser *pasynUser, epicsType *value,
                                         size_t nElements, size_t *nIn, NDDataType_t outputType);
     template <typename epicsType, typename interruptType> void arrayInterruptCallback(NDArray *pArray,
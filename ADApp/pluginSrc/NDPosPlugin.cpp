@@ -6,12 +6,11 @@
  */
 
 #include <string.h>
+#include <math.h>
 #include <sstream>
 #include <iocsh.h>
 #include <sys/stat.h>
 #include <string>
-#include <list>
-#include <map>
 #include <vector>
 
 #include "NDPosPlugin.h"
@@ -21,6 +20,36 @@
 
 static const char *driverName = "NDPosPlugin";
 
+/** Returns the number of positions to skip to reach a frame ID: the number of steps of IDDifference
+  * from expectedID to at least IDValue, limited to the positions that are available.
+  */
+static int positionsToSkip(int expectedID, int IDValue, int IDDifference, int available)
+{
+  double skip;
+
+  // The expected ID never reaches the frame ID, so all the positions are skipped
+  if (IDDifference <= 0) return available;
+  skip = ceil(((double)IDValue - expectedID) / IDDifference);
+  return (skip < available) ? (int)skip : available;
+}
+
+/** Gives each axis of the position store an attribute handle; called once the store
+  * axes have changed, so the attributes of each frame are found without comparing names.
+  */
+void NDPosPlugin::resolvePositionAttributes()
+{
+  if (numHandleAxes == positionStore.numAxes()) return;
+  for (int axis = 0; axis < positionStore.numAxes(); axis++){
+    const char *name = positionStore.axisName(axis).c_str();
+    if (axis + 1 < attributeHandles.count()){
+      attributeHandles.setName(axis + 1, name);
+    } else {
+      attributeHandles.add(name);
+    }
+  }
+  numHandleAxes = positionStore.numAxes();
+}
+
 /** Callback function that is called by the NDArray driver with new NDArray data.
   * If the plugin is running then it attaches position data to the NDArray as NDAttributes
   * and then passes the array on.  If the plugin is not running then NDArrays are not
@@ -34,6 +63,7 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
   int skip = 0;
   int mode = 0;
   int size = 0;
+  int skipped = 0;
   int duplicates = 0;
   int dropped = 0;
   int expectedID = 0;
@@ -46,10 +76,7 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
   // Call the base class method
   NDPluginDriver::beginProcessCallbacks(pArray);
   getIntegerParam(NDPos_Running, &running);
-  // We must maintain the size of the list ourselves, as calling
-  // size() on the list has a complexity of O(n) which causes a problem
-  // once we get into tens of thousands of items.
-  getIntegerParam(NDPos_CurrentQty, &size);
+  size = (int)positionStore.size();
   // Only attach the position data to the array if we are running
   if (running == NDPOS_RUNNING){
     getIntegerParam(NDPos_CurrentIndex, &index);
@@ -64,9 +91,11 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
       if (strcmp(IDName, "") == 0){
         IDValue = pArray->uniqueId;
       } else {
-        NDAttribute *IDAtt = pArray->pAttributeList->find(IDName);
+        if (strcmp(attributeHandles.getName(0), IDName) != 0){
+          attributeHandles.setName(0, IDName);
+        }
+        NDAttribute *IDAtt = attributeHandles.get(pArray->pAttributeList, 0);
         if (IDAtt){
-          epicsInt32 IDValue;
           if (IDAtt->getValue(NDAttrInt32, &IDValue, sizeof(epicsInt32)) == ND_ERROR){
             // Error, unable to get the value from the ID attribute
             asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR,
@@ -96,13 +125,10 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
           getIntegerParam(NDPos_MissingFrames, &dropped);
           getIntegerParam(NDPos_Mode, &mode);
           if (mode == MODE_DISCARD){
-            while ((expectedID < IDValue) && (size > 0)){
-              // The index will stay the same, and we need to pop the value out of the position array
-              positionArray.erase(positionArray.begin());
-              size--;
-              expectedID += IDDifference;
-              dropped++;
-            }
+            // The index will stay the same, and we need to remove the positions from the front of the store
+            skipped = positionsToSkip(expectedID, IDValue, IDDifference, size);
+            positionStore.erase(skipped);
+            size -= skipped;
             // If the size has dropped to zero then we've run out of positions, abort
             if (size == 0){
               setIntegerParam(NDPos_Running, NDPOS_IDLE);
@@ -110,11 +136,8 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
             }
             setIntegerParam(NDPos_CurrentQty, size);
           } else if (mode == MODE_KEEP){
-            while (expectedID < IDValue && (index < size)){
-              index++;
-              expectedID += IDDifference;
-              dropped++;
-            }
+            skipped = positionsToSkip(expectedID, IDValue, IDDifference, size - index);
+            index += skipped;
             // If the index has reached the size of the array then we've run out of positions, abort
             if (index == size){
               setIntegerParam(NDPos_Running, NDPOS_IDLE);
@@ -122,6 +145,8 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
             }
             setIntegerParam(NDPos_CurrentIndex, index);
           }
+          expectedID += skipped * IDDifference;
+          dropped += skipped;
           setIntegerParam(NDPos_ExpectedID, expectedID);
           setIntegerParam(NDPos_MissingFrames, dropped);
         } else if (expectedID > IDValue){
@@ -140,27 +165,31 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
       if (skip == 0 && running == NDPOS_RUNNING){
         // We must make a copy of the array as we are going to alter it
         pArrayOut = this->pNDArrayPool->copy(pArray, NULL, 1);
-        this->getAttributes(pArrayOut->pAttributeList);
         if (pArrayOut){
-          std::list<std::map<std::string, double> >::iterator it = positionArray.begin();
-          std::advance(it, index);
-          //std::map<std::string, double> pos = positionArray[index];
-          std::map<std::string, double> pos = *it;
+          this->getAttributes(pArrayOut->pAttributeList);
+          resolvePositionAttributes();
           std::stringstream sspos;
           sspos << "[";
           bool firstTime = true;
-          std::map<std::string, double>::iterator iter;
-          for (iter = pos.begin(); iter != pos.end(); iter++){
+          for (int axis = 0; axis < positionStore.numAxes(); axis++){
+            double value = positionStore.value(axis, index);
+            // Positions loaded with a different set of axes have no value for this one
+            if (NDPosPluginStore::isMissing(value)) continue;
+            const std::string& name = positionStore.axisName(axis);
             if (firstTime){
               firstTime = false;
             } else {
               sspos << ",";
             }
-            sspos << iter->first << "=" << iter->second;
-            // Create the NDAttribute with the position data
-            NDAttribute *pAtt = new NDAttribute(iter->first.c_str(), "Position of NDArray", NDAttrSourceDriver, driverName, NDAttrFloat64, &(iter->second));
-            // Add the NDAttribute to the NDArray
-            pArrayOut->pAttributeList->add(pAtt);
+            sspos << name << "=" << value;
+            // Update the attribute if a recycled array already has it, otherwise create it
+            NDAttribute *pAtt = attributeHandles.get(pArrayOut->pAttributeList, axis + 1);
+            if (pAtt && (pAtt->getDataType() == NDAttrFloat64)){
+              pAtt->setValue(&value);
+            } else {
+              pAtt = new NDAttribute(name.c_str(), "Position of NDArray", NDAttrSourceDriver, driverName, NDAttrFloat64, &value);
+              pArrayOut->pAttributeList->add(pAtt);
+            }
           }
           sspos << "]";
           setStringParam(NDPos_CurrentPos, sspos.str().c_str());
@@ -181,8 +210,8 @@ void NDPosPlugin::processCallbacks(NDArray *pArray)
         // Check the mode
         getIntegerParam(NDPos_Mode, &mode);
         if (mode == MODE_DISCARD){
-          // The index will stay the same, and we need to pop the value out of the position array
-          positionArray.erase(positionArray.begin());
+          // The index will stay the same, and we need to remove the position from the front of the store
+          positionStore.erase(1);
           size--;
           setIntegerParam(NDPos_CurrentQty, size);
         } else if (mode == MODE_KEEP){
@@ -245,9 +274,10 @@ asynStatus NDPosPlugin::writeInt32(asynUser *pasynUser, epicsInt32 value)
       setIntegerParam(NDPos_CurrentIndex, 0);
       // Reset the last sent position
       setStringParam(NDPos_CurrentPos, "");
-      // Clear out the position array
-      positionArray.clear();
-      setIntegerParam(NDPos_CurrentQty, (int)positionArray.size());
+      // Clear out the position store
+      positionStore.clear();
+      numHandleAxes = -1;
+      setIntegerParam(NDPos_CurrentQty, (int)positionStore.size());
     } else {
       // If this parameter belongs to a base class call its method
       if (function < FIRST_NDPOS_PARAM){
@@ -296,18 +326,17 @@ asynStatus NDPosPlugin::writeOctet(asynUser *pasynUser, const char *value, size_
     // Read the filename parameter
     std::string xml;
     getStringParam(NDPos_Filename, xml);
-    // Now validate the XML
+    /* The positions are loaded in a single pass into a separate store, so that a file that
+     * fails to load does not leave some of its positions in the position set, and then
+     * appended to the position set.
+     */
     NDPosPluginFileReader fr;
-    if (fr.validateXML(xml) == asynSuccess){
+    NDPosPluginStore positions;
+    if (fr.load(xml, positions) == asynSuccess){
       setIntegerParam(NDPos_FileValid, 1);
-      NDPosPluginFileReader fr;
-       /* Read the filename and valid parameters
-       * then the positions are loaded and appended to the position set.
-       */
-      fr.loadXML(xml);
-      std::vector<std::map<std::string, double> > positions = fr.readPositions();
-      positionArray.insert(positionArray.end(), positions.begin(), positions.end());
-      setIntegerParam(NDPos_CurrentQty, (int)positionArray.size());
+      positionStore.append(positions);
+      numHandleAxes = -1;
+      setIntegerParam(NDPos_CurrentQty, (int)positionStore.size());
       callParamCallbacks();
     } else {
       setIntegerParam(NDPos_FileValid, 0);
@@ -425,6 +454,10 @@ NDPosPlugin::NDPosPlugin(const char *portName,
   // Set the missing frames to 0
   setIntegerParam(NDPos_DuplicateFrames,   0);
 
+  // Handle 0 is the ID attribute; its name is set from NDPos_IDName when it is used
+  attributeHandles.add("");
+  numHandleAxes = -1;
+
   // Try to connect to the array port
   connectToArrayPort();
 
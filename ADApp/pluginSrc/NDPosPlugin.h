@@ -31,10 +31,10 @@
 #define NDPosPluginAPP_SRC_NDPOSPLUGIN_H_
 
 #include <string>
-#include <list>
-#include <map>
 
 #include "NDPluginDriver.h"
+#include "NDAttributeHandles.h"
+#include "NDPosPluginStore.h"
 
 #define str_NDPos_Filename        "NDPos_Filename"
 #define str_NDPos_FileValid       "NDPos_FileValid"
@@ -101,8 +101,13 @@ protected:
   int NDPos_IDStart;
 
 private:
+  void resolvePositionAttributes();
+
   // Plugin member variables
-  std::list<std::map<std::string, double> > positionArray;
+  NDPosPluginStore positionStore;
+  // Handle 0 is the ID attribute, handle i+1 the attribute of axis i of the store
+  NDAttributeHandles attributeHandles;
+  int numHandleAxes;   // Number of store axes that have handles, -1 if the axes have changed
 };
 
 #endif /* NDPosPluginAPP_SRC_NDPOSPLUGIN_H_ */
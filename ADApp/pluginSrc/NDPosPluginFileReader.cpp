@@ -6,7 +6,11 @@
  */
 
 #include "NDPosPluginFileReader.h"
-#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsTypes.h>
 
 const std::string NDPosPluginFileReader::ELEMENT_NAME       = "name";
 const std::string NDPosPluginFileReader::ELEMENT_DIMENSIONS = "dimensions";
@@ -16,8 +20,10 @@ const std::string NDPosPluginFileReader::ELEMENT_POSITION   = "position";
 
 const std::string NDPosPluginFileReader::DIMENSION_NAME     = "name";
 
+const char NDPosPluginFileReader::BINARY_MAGIC[8] = {'N', 'D', 'P', 'O', 'S', 'B', 'I', 'N'};
+
 NDPosPluginFileReader::NDPosPluginFileReader()
-  : xmlreader(NULL)
+  : xmlreader(NULL), pStore(NULL)
 {
 }
 
@@ -25,11 +31,44 @@ NDPosPluginFileReader::~NDPosPluginFileReader()
 {
 }
 
-asynStatus NDPosPluginFileReader::validateXML(const std::string& filename)
+/** Loads the positions of an XML string, XML file or binary file and appends them to a store.
+  * If loading fails the store may hold some of the positions, so callers load into an empty store.
+  */
+asynStatus NDPosPluginFileReader::load(const std::string& filename, NDPosPluginStore& store)
+{
+  if (isBinary(filename)){
+    return loadBinary(filename, store);
+  }
+  return loadXML(filename, store);
+}
+
+/** Returns true if filename is a file that starts with BINARY_MAGIC.
+  */
+bool NDPosPluginFileReader::isBinary(const std::string& filename)
+{
+  char magic[sizeof(BINARY_MAGIC)];
+  bool binary = false;
+
+  if (filename.find("<pos_layout>") != std::string::npos){
+    return false;
+  }
+  FILE *fp = fopen(filename.c_str(), "rb");
+  if (fp){
+    binary = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) &&
+             (memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0);
+    fclose(fp);
+  }
+  return binary;
+}
+
+asynStatus NDPosPluginFileReader::loadXML(const std::string& filename, NDPosPluginStore& store)
 {
   asynStatus status = asynSuccess;
   int ret = 0;
-  // Check for either a valid XML file or a valid XML string
+
+  pStore = &store;
+  dimensions.clear();
+  axes.clear();
   // if the file name contains <pos_layout> then load it as an xml string from memory
   if (filename.find("<pos_layout>") != std::string::npos){
     xmlreader = xmlReaderForMemory(filename.c_str(), (int)filename.length(), NULL, NULL, 0);
@@ -44,47 +83,103 @@ asynStatus NDPosPluginFileReader::validateXML(const std::string& filename)
 
   if (status == asynSuccess){
     while ((ret = xmlTextReaderRead(xmlreader)) == 1){
-      // Do nothing, we're just trying to validate
+      // A position with an invalid value is skipped, but without dimensions no position can be read
+      if ((this->processNode() != asynSuccess) && dimensions.empty()){
+        setErrorMsg("Position before the dimensions or dimension without a name, check file");
+        status = asynError;
+        break;
+      }
     }
     xmlFreeTextReader(xmlreader);
     xmlreader = NULL;
-    if (ret != 0){
+    if ((status == asynSuccess) && (ret != 0)){
       setErrorMsg("XML parsing failed, check file format");
       status = asynError;
     }
   }
+  pStore = NULL;
 
   return status;
 }
 
-asynStatus NDPosPluginFileReader::loadXML(const std::string& filename)
+asynStatus NDPosPluginFileReader::loadBinary(const std::string& filename, NDPosPluginStore& store)
 {
+  static const size_t blockSize = 4096;
+  char magic[sizeof(BINARY_MAGIC)];
+  epicsUInt32 numAxes = 0, length;
+  std::vector<double> block;
+  size_t i, j, numRead;
   asynStatus status = asynSuccess;
-  int ret = 0;
-  // if the file name contains <pos_layout> then load it as an xml string from memory
-  if (filename.find("<pos_layout>") != std::string::npos){
-    xmlreader = xmlReaderForMemory(filename.c_str(), (int)filename.length(), NULL, NULL, 0);
-  } else {
-    xmlreader = xmlReaderForFile(filename.c_str(), NULL, 0);
-  }
 
-  if (xmlreader == NULL){
-    setErrorMsg("Error creating XML parser, check file");
+  dimensions.clear();
+  FILE *fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL){
+    setErrorMsg("Error opening binary position file");
+    return asynError;
+  }
+  if ((fread(magic, 1, sizeof(magic), fp) != sizeof(magic)) ||
+      (memcmp(magic, BINARY_MAGIC, sizeof(magic)) != 0) ||
+      (fread(&numAxes, sizeof(numAxes), 1, fp) != 1) ||
+      (numAxes == 0) || (numAxes > 1024)){
     status = asynError;
   }
-
+  for (i = 0; (status == asynSuccess) && (i < numAxes); i++){
+    std::string name;
+    if ((fread(&length, sizeof(length), 1, fp) != 1) || (length == 0) || (length > 1024)){
+      status = asynError;
+    } else {
+      name.resize(length);
+      if (fread(&name[0], 1, length, fp) != length){
+        status = asynError;
+      } else {
+        dimensions.push_back(name);
+        store.addAxis(name);
+      }
+    }
+  }
   if (status == asynSuccess){
-    while ((ret = xmlTextReaderRead(xmlreader)) == 1){
-      this->processNode();
+    mapDimensions();
+    for (i = 0; i < numAxes; i++){
+      axes[i] = store.findAxis(dimensions[i]);
     }
-    xmlFreeTextReader(xmlreader);
-    xmlreader = NULL;
-    if (ret != 0){
-      setErrorMsg("XML parsing failed, check file format");
+    values.assign(store.numAxes(), NDPosPluginStore::missingValue());
+    // Reserve the store for all the positions in the file
+    long start = ftell(fp);
+    if ((start >= 0) && (fseek(fp, 0, SEEK_END) == 0)){
+      long end = ftell(fp);
+      if (end > start){
+        store.reserve((size_t)(end - start) / (sizeof(double) * numAxes));
+      }
+      fseek(fp, start, SEEK_SET);
+    }
+    block.resize(blockSize * numAxes);
+    size_t rowBytes = sizeof(double) * numAxes;
+    while ((numRead = fread(&block[0], 1, block.size() * sizeof(double), fp)) > 0){
+      // fread only returns less than a whole block at the end of the file
+      if (numRead % rowBytes != 0){
+        status = asynError;
+        break;
+      }
+      for (i = 0; (status == asynSuccess) && (i < numRead / rowBytes); i++){
+        for (j = 0; j < numAxes; j++){
+          // NaN is the missing value of the store, so it is not a valid position
+          if (NDPosPluginStore::isMissing(block[i * numAxes + j])){
+            status = asynError;
+          }
+          values[axes[j]] = block[i * numAxes + j];
+        }
+        if (status == asynSuccess) store.append(&values[0]);
+      }
+      if (status != asynSuccess) break;
+    }
+    if (ferror(fp)){
       status = asynError;
     }
   }
-
+  fclose(fp);
+  if (status != asynSuccess){
+    setErrorMsg("Binary position file format error, check file");
+  }
   return status;
 }
 
@@ -93,18 +188,6 @@ std::vector<std::string> NDPosPluginFileReader::readDimensions()
   return dimensions;
 }
 
-std::vector<std::map<std::string, double> > NDPosPluginFileReader::readPositions()
-{
-  return positions;
-}
-
-asynStatus NDPosPluginFileReader::clearPositions()
-{
-  positions.clear();
-  dimensions.clear();
-  return asynSuccess;
-}
-
 asynStatus NDPosPluginFileReader::processNode()
 {
   asynStatus status = asynSuccess;
@@ -159,55 +242,67 @@ asynStatus NDPosPluginFileReader::addDimension()
     }
   }
 
-  // Add the dimension to the vector of dimensions
+  // Add the dimension to the vector of dimensions and to the store
   if (status == asynSuccess){
     std::string str_dim_name;
     str_dim_name = (char*)dim_name;
-    //printf("Adding dimension: %s\n", str_dim_name.c_str());
-    // Add the dimension to the vector of dimension names
+    xmlFree(dim_name);
     dimensions.push_back(str_dim_name);
+    pStore->addAxis(str_dim_name);
+    // The store axes of the dimensions are looked up again at the next position
+    axes.clear();
   }
   return status;
 }
 
+/** Looks up the store axis of each dimension; called once the dimensions are known, since adding
+  * an axis to the store can change the indices of the others.
+  */
+void NDPosPluginFileReader::mapDimensions()
+{
+  axes.resize(dimensions.size());
+  for (size_t i = 0; i < dimensions.size(); i++){
+    axes[i] = pStore ? pStore->findAxis(dimensions[i]) : -1;
+  }
+}
+
 asynStatus NDPosPluginFileReader::addPosition()
 {
   asynStatus status = asynSuccess;
   xmlChar *pos_val = NULL;
-  std::string pos_str;
-  std::map<std::string, double> pos;
+  char *end = NULL;
 
-  // First check the basics
-  if (!xmlTextReaderHasAttributes(this->xmlreader)){
+  // First check the basics, a position can only be read once the dimensions are known
+  if (!xmlTextReaderHasAttributes(this->xmlreader) || dimensions.empty()){
     status = asynError;
   }
 
-  double index;
+  if (axes.size() != dimensions.size()){
+    mapDimensions();
+  }
+  values.assign(pStore->numAxes(), NDPosPluginStore::missingValue());
 
   // Loop over the dimensions looking for each
-  for (std::vector<std::string>::iterator iter = dimensions.begin(); iter != dimensions.end(); iter++){
+  for (size_t i = 0; (status == asynSuccess) && (i < dimensions.size()); i++){
     // Check for the dimension name specified in the element
-    if (status == asynSuccess){
-      pos_val = xmlTextReaderGetAttribute(this->xmlreader, (const xmlChar *)(*iter).c_str());
-      if (pos_val == NULL){
+    pos_val = xmlTextReaderGetAttribute(this->xmlreader, (const xmlChar *)dimensions[i].c_str());
+    if (pos_val == NULL){
+      status = asynError;
+    } else {
+      // Convert the string value into the position for this axis.  NaN is the missing value of the
+      // store, so it is not a valid position.
+      double index = strtod((const char *)pos_val, &end);
+      if ((end == (char *)pos_val) || NDPosPluginStore::isMissing(index)){
         status = asynError;
       } else {
-        // Convert the string value into an integer index
-        std::stringstream sindex((char *)pos_val);
-        sindex >> index;
-        if (!sindex){
-          status = asynError;
-        } else {
-          // Insert the dimension index into the position map
-          pos[*iter] = index;
-        }
+        values[axes[i]] = index;
       }
+      xmlFree(pos_val);
     }
   }
 
-  if (status == asynSuccess){
-    //printf("Adding position: %s\n", pos_str.c_str());
-    positions.push_back(pos);
+  if ((status == asynSuccess) && !values.empty()){
+    pStore->append(&values[0]);
   }
   return status;
 }
@@ -12,8 +12,15 @@
 #include <libxml/xmlreader.h>
 #include <string>
 #include <vector>
-#include <map>
 
+#include "NDPosPluginStore.h"
+
+/** Reads position files into an NDPosPluginStore.
+  * XML files and strings are read with the libxml2 streaming reader, and each position is appended to the
+  * store as it is parsed.  Binary files start with BINARY_MAGIC, then the number of axes and the name of
+  * each axis (a 32-bit length followed by the characters), then the positions as one 64-bit float per axis,
+  * all in the byte order of the IOC.  They are read in blocks straight into the store.
+  */
 class NDPosPluginFileReader
 {
 public:
@@ -25,13 +32,15 @@ public:
 
   static const std::string DIMENSION_NAME;
 
+  static const char BINARY_MAGIC[8];
+
   NDPosPluginFileReader();
   virtual ~NDPosPluginFileReader();
-  asynStatus validateXML(const std::string& filename);
-  asynStatus loadXML(const std::string& filename);
+  asynStatus load(const std::string& filename, NDPosPluginStore& store);
+  asynStatus loadXML(const std::string& filename, NDPosPluginStore& store);
+  asynStatus loadBinary(const std::string& filename, NDPosPluginStore& store);
+  bool isBinary(const std::string& filename);
   std::vector<std::string> readDimensions();
-  std::vector<std::map<std::string, double> > readPositions();
-  asynStatus clearPositions();
   asynStatus processNode();
   asynStatus addDimension();
   asynStatus addPosition();
@@ -41,9 +50,13 @@ protected:
   void setErrorMsg(const std::string& msg);
 
 private:
+  void mapDimensions();
+
   xmlTextReaderPtr xmlreader;
   std::vector<std::string> dimensions;
-  std::vector<std::map<std::string, double> > positions;
+  std::vector<int> axes;        /**< Store axis of each dimension, empty until the first position */
+  std::vector<double> values;   /**< Values of the position being parsed, in store axis order */
+  NDPosPluginStore *pStore;
   std::string errorMessage;
 };
 
@@ -0,0 +1,170 @@
+/*
+ * NDPosPluginStore.cpp
+ *
+ * Columnar store of the positions attached to NDArrays by NDPosPlugin
+ *
+ */
+
+#include <algorithm>
+
+#include <epicsMath.h>
+
+#include "NDPosPluginStore.h"
+
+NDPosPluginStore::NDPosPluginStore()
+  : first_(0), count_(0)
+{
+}
+
+/** Removes all the positions and axes.
+  */
+void NDPosPluginStore::clear()
+{
+  axes_.clear();
+  columns_.clear();
+  first_ = 0;
+  count_ = 0;
+}
+
+/** Returns the number of positions in the store.
+  */
+size_t NDPosPluginStore::size() const
+{
+  return count_;
+}
+
+/** Returns the number of axes.
+  */
+int NDPosPluginStore::numAxes() const
+{
+  return (int)axes_.size();
+}
+
+/** Returns the name of an axis.
+  * \param[in] axis The axis index, 0 to numAxes()-1.
+  */
+const std::string& NDPosPluginStore::axisName(int axis) const
+{
+  return axes_[axis];
+}
+
+/** Returns the index of the axis with a name, or -1 if there is none.
+  * \param[in] name The axis name.
+  */
+int NDPosPluginStore::findAxis(const std::string& name) const
+{
+  std::vector<std::string>::const_iterator it = std::lower_bound(axes_.begin(), axes_.end(), name);
+  if (it == axes_.end() || *it != name) return -1;
+  return (int)(it - axes_.begin());
+}
+
+/** Adds an axis if there is none with this name, and returns its index.
+  * The positions already in the store have the missing value for a new axis.
+  * Adding an axis can change the indices of the axes after it, so callers look the indices
+  * up again once all the axes have been added.
+  * \param[in] name The axis name.
+  */
+int NDPosPluginStore::addAxis(const std::string& name)
+{
+  std::vector<std::string>::iterator it = std::lower_bound(axes_.begin(), axes_.end(), name);
+  int axis = (int)(it - axes_.begin());
+
+  if (it != axes_.end() && *it == name) return axis;
+  axes_.insert(it, name);
+  columns_.insert(columns_.begin() + axis, std::vector<double>(first_ + count_, missingValue()));
+  return axis;
+}
+
+/** Reserves space for positions that will be appended.
+  * \param[in] count The number of positions.
+  */
+void NDPosPluginStore::reserve(size_t count)
+{
+  compact();
+  for (size_t i=0; i<columns_.size(); i++) {
+    columns_[i].reserve(count_ + count);
+  }
+}
+
+/** Appends one position.
+  * \param[in] values The value for each axis, in axis order.
+  */
+void NDPosPluginStore::append(const double *values)
+{
+  if (first_ > count_) compact();
+  for (size_t i=0; i<columns_.size(); i++) {
+    columns_[i].push_back(values[i]);
+  }
+  count_++;
+}
+
+/** Appends all the positions of another store, adding any axes that it has and this store does not.
+  * \param[in] other The store to append.
+  */
+void NDPosPluginStore::append(const NDPosPluginStore& other)
+{
+  std::vector<int> map(other.axes_.size());
+  size_t i, j;
+
+  for (i=0; i<other.axes_.size(); i++) {
+    addAxis(other.axes_[i]);
+  }
+  for (i=0; i<other.axes_.size(); i++) {
+    map[i] = findAxis(other.axes_[i]);
+  }
+  compact();
+  for (j=0; j<columns_.size(); j++) {
+    columns_[j].resize(count_ + other.count_, missingValue());
+  }
+  for (i=0; i<other.axes_.size(); i++) {
+    std::copy(other.columns_[i].begin() + other.first_, other.columns_[i].end(),
+              columns_[map[i]].begin() + count_);
+  }
+  count_ += other.count_;
+}
+
+/** Returns the value of an axis at a position.
+  * \param[in] axis The axis index, 0 to numAxes()-1.
+  * \param[in] index The position index, 0 to size()-1.
+  */
+double NDPosPluginStore::value(int axis, size_t index) const
+{
+  return columns_[axis][first_ + index];
+}
+
+/** Removes positions from the start of the store.
+  * \param[in] count The number of positions to remove; limited to size().
+  */
+void NDPosPluginStore::erase(size_t count)
+{
+  if (count > count_) count = count_;
+  first_ += count;
+  count_ -= count;
+  if (count_ == 0) compact();
+}
+
+/** Returns the value stored for an axis that a position does not have.
+  */
+double NDPosPluginStore::missingValue()
+{
+  return epicsNAN;
+}
+
+/** Returns true if a value is the missing value.
+  * \param[in] value The value.
+  */
+bool NDPosPluginStore::isMissing(double value)
+{
+  return (value != value);
+}
+
+/** Frees the space of the erased positions.
+  */
+void NDPosPluginStore::compact()
+{
+  if (first_ == 0) return;
+  for (size_t i=0; i<columns_.size(); i++) {
+    columns_[i].erase(columns_[i].begin(), columns_[i].begin() + first_);
+  }
+  first_ = 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * NDPosPluginStore.h
+ *
+ * Columnar store of the positions attached to NDArrays by NDPosPlugin
+ *
+ */
+
+#ifndef NDPOSPLUGINSTORE_H_
+#define NDPOSPLUGINSTORE_H_
+
+#include <string>
+#include <vector>
+
+#include "NDPluginAPI.h"
+
+/** NDPosPluginStore class; the positions of a scan stored as one contiguous array of values per axis.
+  * The axes are kept sorted by name, which is the order their attributes are attached in.
+  * Positions are read by index in constant time, and removing positions from the front (Discard mode)
+  * only moves an offset; the removed values are reclaimed when positions are next appended.
+  * A position that has no value for an axis, because it was loaded with a different set of axes,
+  * holds the missing value (NaN) for that axis.
+  */
+class NDPLUGIN_API NDPosPluginStore
+{
+public:
+  NDPosPluginStore();
+  void clear();
+  size_t size() const;
+  int numAxes() const;
+  const std::string& axisName(int axis) const;
+  int findAxis(const std::string& name) const;
+  int addAxis(const std::string& name);
+  void reserve(size_t count);
+  void append(const double *values);
+  void append(const NDPosPluginStore& other);
+  double value(int axis, size_t index) const;
+  void erase(size_t count);
+
+  static double missingValue();
+  static bool isMissing(double value);
+
+private:
+  void compact();
+
+  std::vector<std::string> axes_;             /**< Axis names, sorted */
+  std::vector<std::vector<double> > columns_; /**< Values of each axis, including erased positions */
+  size_t first_;                              /**< Number of erased positions at the start of the columns */
+  size_t count_;                              /**< Number of positions after first_ */
+};
+
+#endif /* NDPOSPLUGINSTORE_H_ */
@@ -0,0 +1,18 @@
+/*
+ * BadPixelPluginWrapper.cpp
+ *
+ */
+
+#include "BadPixelPluginWrapper.h"
+
+BadPixelPluginWrapper::BadPixelPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginBadPixel(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0, 1),
+     AsynPortClientContainer(port)
+{
+}
+
+BadPixelPluginWrapper::~BadPixelPluginWrapper ()
+{
+  cleanup();
+}
+
@@ -0,0 +1,19 @@
+/*
+ * BadPixelPluginWrapper.h
+ *
+ */
+
+#ifndef ADAPP_PLUGINTESTS_BADPIXELPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_BADPIXELPLUGINWRAPPER_H_
+
+#include <NDPluginBadPixel.h>
+#include "AsynPortClientContainer.h"
+
+class BadPixelPluginWrapper : public NDPluginBadPixel, public AsynPortClientContainer
+{
+public:
+  BadPixelPluginWrapper(const std::string& port, const std::string& detectorPort);
+  virtual ~BadPixelPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_BADPIXELPLUGINWRAPPER_H_ */
@@ -0,0 +1,18 @@
+/*
+ * ScatterPluginWrapper.cpp
+ *
+ */
+
+#include "ScatterPluginWrapper.h"
+
+ScatterPluginWrapper::ScatterPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginScatter(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+ScatterPluginWrapper::~ScatterPluginWrapper ()
+{
+  cleanup();
+}
+
@@ -0,0 +1,18 @@
+/*
+ * StdArraysPluginWrapper.cpp
+ *
+ */
+
+#include "StdArraysPluginWrapper.h"
+
+StdArraysPluginWrapper::StdArraysPluginWrapper(const std::string& port, const std::string& detectorPort)
+  :  NDPluginStdArrays(port.c_str(), 50, 1, detectorPort.c_str(), 0, 0, 0, 0, 0),
+     AsynPortClientContainer(port)
+{
+}
+
+StdArraysPluginWrapper::~StdArraysPluginWrapper ()
+{
+  cleanup();
+}
+
@@ -0,0 +1,19 @@
+/*
+ * StdArraysPluginWrapper.h
+ *
+ */
+
+#ifndef ADAPP_PLUGINTESTS_STDARRAYSPLUGINWRAPPER_H_
+#define ADAPP_PLUGINTESTS_STDARRAYSPLUGINWRAPPER_H_
+
+#include <NDPluginStdArrays.h>
+#include "AsynPortClientContainer.h"
+
+class StdArraysPluginWrapper : public NDPluginStdArrays, public AsynPortClientContainer
+{
+public:
+  StdArraysPluginWrapper(const std::string& port, const std::string& detectorPort);
+  virtual ~StdArraysPluginWrapper ();
+};
+
+#endif /* ADAPP_PLUGINTESTS_STDARRAYSPLUGINWRAPPER_H_ */
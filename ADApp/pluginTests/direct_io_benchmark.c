@@ -0,0 +1,198 @@
+/*
+ * direct_io_benchmark.c
+ *
+ * Measures the sustained write throughput of the file paths used by NDFileHDF5 and
+ * NDFileRaw:
+ *   hdf5-sec2    HDF5 chunked dataset, default sec2 driver (page cache)
+ *   hdf5-direct  HDF5 chunked dataset, direct driver (only if HDF5 was built with it)
+ *   raw          write() through the page cache
+ *   raw-direct   write() with O_DIRECT from a block aligned buffer
+ *
+ * Each frame is written as one chunk, as NDFileHDF5 does with the default chunking.
+ * Times include closing the file and, for the page cache paths, an fsync so that the
+ * cost of writeback is counted.  Use a total size well above the memory available for
+ * the page cache to see sustained rates.
+ *
+ * Usage: direct_io_benchmark <directory> [frame MiB (default 8)] [frames (default 256)]
+ *                            [block size (default 4096)]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "hdf5.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double seconds, size_t frameBytes, int nFrames)
+{
+    double mbytes = (double)frameBytes * nFrames / (1024.0 * 1024.0);
+    printf("%-12s %8.1f MiB in %7.3f s  %9.1f MiB/s\n", name, mbytes, seconds, mbytes / seconds);
+}
+
+static void sync_file(const char *fileName)
+{
+    int fd = open(fileName, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static int bench_hdf5(const char *name, const char *fileName, hid_t fapl, hid_t fcpl,
+                      const char *frame, size_t frameBytes, int nFrames)
+{
+    hsize_t nPixels = frameBytes / 2;
+    hsize_t dims[2] = {0, nPixels};
+    hsize_t maxdims[2] = {H5S_UNLIMITED, nPixels};
+    hsize_t chunk[2] = {1, nPixels};
+    hsize_t start[2] = {0, 0};
+    hsize_t count[2] = {1, nPixels};
+    hid_t file, space, memspace, dcpl, dset, filespace;
+    double t0;
+    int i;
+
+    t0 = now();
+    file = H5Fcreate(fileName, H5F_ACC_TRUNC, fcpl, fapl);
+    if (file < 0) {
+        printf("%-12s could not create %s\n", name, fileName);
+        return -1;
+    }
+    space = H5Screate_simple(2, dims, maxdims);
+    dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl, 2, chunk);
+    dset = H5Dcreate2(file, "data", H5T_NATIVE_UINT16, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    memspace = H5Screate_simple(2, count, NULL);
+    for (i = 0; i < nFrames; i++) {
+        dims[0] = i + 1;
+        start[0] = i;
+        H5Dset_extent(dset, dims);
+        filespace = H5Dget_space(dset);
+        H5Sselect_hyperslab(filespace, H5S_SELECT_SET, start, NULL, count, NULL);
+        if (H5Dwrite(dset, H5T_NATIVE_UINT16, memspace, filespace, H5P_DEFAULT, frame) < 0) {
+            printf("%-12s write failed at frame %d\n", name, i);
+        }
+        H5Sclose(filespace);
+    }
+    H5Sclose(memspace);
+    H5Dclose(dset);
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    H5Fclose(file);
+    sync_file(fileName);
+    report(name, now() - t0, frameBytes, nFrames);
+    unlink(fileName);
+    return 0;
+}
+
+static int bench_raw(const char *name, const char *fileName, int direct,
+                     const char *frame, size_t frameBytes, int nFrames)
+{
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    double t0;
+    int fd, i;
+    size_t done;
+    ssize_t n;
+
+#ifdef O_DIRECT
+    if (direct) flags |= O_DIRECT;
+#else
+    if (direct) {
+        printf("%-12s O_DIRECT is not available on this platform\n", name);
+        return -1;
+    }
+#endif
+    t0 = now();
+    fd = open(fileName, flags, 0666);
+    if (fd < 0) {
+        printf("%-12s could not open %s, errno=%d\n", name, fileName, errno);
+        return -1;
+    }
+    for (i = 0; i < nFrames; i++) {
+        for (done = 0; done < frameBytes; done += n) {
+            n = write(fd, frame + done, frameBytes - done);
+            if (n < 0) {
+                printf("%-12s write failed at frame %d, errno=%d\n", name, i, errno);
+                close(fd);
+                unlink(fileName);
+                return -1;
+            }
+        }
+    }
+    if (!direct) fsync(fd);
+    close(fd);
+    report(name, now() - t0, frameBytes, nFrames);
+    unlink(fileName);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir;
+    size_t frameBytes, blockSize = 4096;
+    int nFrames = 256;
+    char fileName[4096];
+    char *frame;
+    hid_t fapl, fcpl;
+    size_t i;
+
+    if (argc < 2) {
+        printf("Usage: %s <directory> [frame MiB] [frames] [block size]\n", argv[0]);
+        return 1;
+    }
+    dir = argv[1];
+    frameBytes = (size_t)((argc > 2 ? atof(argv[2]) : 8.0) * 1024 * 1024);
+    if (argc > 3) nFrames = atoi(argv[3]);
+    if (argc > 4) blockSize = (size_t)atol(argv[4]);
+    /* Whole blocks per frame so that O_DIRECT can write each frame directly */
+    frameBytes = (frameBytes + blockSize - 1) / blockSize * blockSize;
+
+    if (posix_memalign((void **)&frame, blockSize, frameBytes) != 0) {
+        printf("Could not allocate %lu byte frame\n", (unsigned long)frameBytes);
+        return 1;
+    }
+    for (i = 0; i < frameBytes; i++) frame[i] = (char)(i * 7);
+
+    printf("%d frames of %lu bytes, block size %lu\n",
+           nFrames, (unsigned long)frameBytes, (unsigned long)blockSize);
+
+    fcpl = H5Pcreate(H5P_FILE_CREATE);
+
+    fapl = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_sec2(fapl);
+    snprintf(fileName, sizeof(fileName), "%s/bench_sec2.h5", dir);
+    bench_hdf5("hdf5-sec2", fileName, fapl, fcpl, frame, frameBytes, nFrames);
+    H5Pclose(fapl);
+
+#ifdef H5_HAVE_DIRECT
+    fapl = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_alignment(fapl, 0, blockSize);
+    H5Pset_fapl_direct(fapl, blockSize, blockSize, frameBytes);
+    snprintf(fileName, sizeof(fileName), "%s/bench_direct.h5", dir);
+    bench_hdf5("hdf5-direct", fileName, fapl, fcpl, frame, frameBytes, nFrames);
+    H5Pclose(fapl);
+#else
+    printf("%-12s not built into this HDF5 library\n", "hdf5-direct");
+#endif
+
+    H5Pclose(fcpl);
+
+    snprintf(fileName, sizeof(fileName), "%s/bench_raw.bin", dir);
+    bench_raw("raw", fileName, 0, frame, frameBytes, nFrames);
+    snprintf(fileName, sizeof(fileName), "%s/bench_raw_direct.bin", dir);
+    bench_raw("raw-direct", fileName, 1, frame, frameBytes, nFrames);
+
+    free(frame);
+    return 0;
+}
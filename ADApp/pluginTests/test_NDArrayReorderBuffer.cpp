@@ -0,0 +1,121 @@
+/*
+ * test_NDArrayReorderBuffer.cpp
+ *
+ */
+
+#include <limits.h>
+
+#include "boost/test/unit_test.hpp"
+
+#include "NDArrayReorderBuffer.h"
+
+struct ReorderBufferFixture
+{
+  NDArrayPool *pPool;
+  NDArrayReorderBuffer buffer;
+  epicsTimeStamp now;
+
+  ReorderBufferFixture()
+  {
+    pPool = new NDArrayPool(NULL, 0);
+    buffer.setSize(4);
+    epicsTimeGetCurrent(&now);
+  }
+  ~ReorderBufferFixture()
+  {
+    buffer.clear();
+    delete pPool;
+  }
+
+  // Pushes a new array and releases the reference of the caller, as plugins do after callbacks
+  int push(int uniqueId)
+  {
+    size_t dims[1] = {8};
+    NDArray *pArray = pPool->alloc(1, dims, NDUInt8, 0, NULL);
+    pArray->uniqueId = uniqueId;
+    int status = buffer.push(pArray, &now);
+    pArray->release();
+    return status;
+  }
+
+  // Pops an array and returns its uniqueId, or -1
+  int pop(int maxUniqueId)
+  {
+    NDArray *pArray = buffer.pop(maxUniqueId);
+    if (!pArray) return -1;
+    int uniqueId = pArray->uniqueId;
+    pArray->release();
+    return uniqueId;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(NDArrayReorderBufferTests, ReorderBufferFixture)
+
+BOOST_AUTO_TEST_CASE(test_Order)
+{
+  BOOST_CHECK_EQUAL(push(13), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(push(12), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(push(12), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(buffer.count(), 3);
+
+  // Nothing is returned while array 11 is missing
+  BOOST_CHECK_EQUAL(pop(11), -1);
+  BOOST_CHECK_EQUAL(pop(12), 12);
+  BOOST_CHECK_EQUAL(pop(12), 12);
+  BOOST_CHECK_EQUAL(pop(12), -1);
+  BOOST_CHECK_EQUAL(pop(13), 13);
+  BOOST_CHECK_EQUAL(buffer.count(), 0);
+  BOOST_CHECK_EQUAL(pop(INT_MAX), -1);
+}
+
+BOOST_AUTO_TEST_CASE(test_Window)
+{
+  BOOST_CHECK(buffer.fits(-2));
+  BOOST_CHECK_EQUAL(push(-2), ND_SUCCESS);
+  BOOST_CHECK(buffer.fits(1));
+  BOOST_CHECK(!buffer.fits(2));
+  BOOST_CHECK(!buffer.fits(-6));
+  BOOST_CHECK_EQUAL(push(2), ND_ERROR);
+  BOOST_CHECK_EQUAL(push(1), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(push(0), ND_SUCCESS);
+
+  // Popping the lowest array moves the window
+  BOOST_CHECK_EQUAL(pop(INT_MAX), -2);
+  BOOST_CHECK(buffer.fits(3));
+  BOOST_CHECK_EQUAL(push(3), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(push(0), ND_SUCCESS);
+  // The buffer is full even though the uniqueIds span less than its size
+  BOOST_CHECK(buffer.fits(2));
+  BOOST_CHECK_EQUAL(push(2), ND_ERROR);
+
+  BOOST_CHECK_EQUAL(pop(INT_MAX), 0);
+  BOOST_CHECK_EQUAL(pop(INT_MAX), 0);
+  BOOST_CHECK_EQUAL(pop(INT_MAX), 1);
+  BOOST_CHECK_EQUAL(pop(INT_MAX), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_Expired)
+{
+  epicsTimeStamp later = now;
+  BOOST_CHECK(!buffer.expired(&now, 0.1));
+  push(5);
+  BOOST_CHECK(!buffer.expired(&now, 0.1));
+  epicsTimeAddSeconds(&later, 0.2);
+  BOOST_CHECK(buffer.expired(&later, 0.1));
+  BOOST_CHECK(buffer.expired(&now, -1.));
+}
+
+BOOST_AUTO_TEST_CASE(test_Release)
+{
+  // The buffer holds a reference to each array until it is popped or the buffer is resized
+  push(1);
+  push(2);
+  BOOST_CHECK_EQUAL(pPool->getNumBuffers(), 2);
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), 0);
+  buffer.setSize(8);
+  BOOST_CHECK_EQUAL(buffer.count(), 0);
+  BOOST_CHECK_EQUAL(buffer.getSize(), 8);
+  BOOST_CHECK_EQUAL(pPool->getNumFree(), 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,85 @@
+/*
+ * test_NDAttributeEnvelope.cpp
+ *
+ */
+
+#include <vector>
+
+#include <epicsMath.h>
+
+#include "boost/test/unit_test.hpp"
+
+#include "NDAttributeEnvelope.h"
+
+BOOST_AUTO_TEST_SUITE(NDAttributeEnvelopeTests)
+
+BOOST_AUTO_TEST_CASE(test_Bins)
+{
+  NDAttributeEnvelope envelope;
+  std::vector<double> values(4);
+
+  envelope.configure(2, 3, 4);
+  BOOST_CHECK_EQUAL(envelope.numValid(), 0);
+
+  // Signal 0 is i, signal 1 is only present in the first bin
+  for (int i=0; i<8; i++) {
+    values[0] = i;
+    values[1] = (i < 4) ? 10. - i : epicsNAN;
+    BOOST_CHECK_EQUAL(envelope.add(&values[0]), (i % 4) == 3);
+  }
+  BOOST_REQUIRE_EQUAL(envelope.numValid(), 2);
+  BOOST_CHECK_EQUAL(envelope.numNew(), 2);
+
+  envelope.get(NDAttributeEnvelope::Min, 0, &values[0]);
+  BOOST_CHECK_EQUAL(values[0], 0.);
+  BOOST_CHECK_EQUAL(values[1], 4.);
+  envelope.get(NDAttributeEnvelope::Max, 1, &values[0]);
+  BOOST_CHECK_EQUAL(values[0], 10.);
+  BOOST_CHECK(values[1] != values[1]);
+  envelope.get(NDAttributeEnvelope::Mean, 0, &values[0]);
+  BOOST_CHECK_EQUAL(values[1], 5.5);
+  BOOST_CHECK_EQUAL(envelope.lastMean(0), 5.5);
+  BOOST_CHECK_EQUAL(envelope.newSum(0), 28.);
+  BOOST_CHECK_EQUAL(envelope.newSum(1), 34.);
+
+  // The new means are ordered by bin, with the signals of each bin contiguous
+  envelope.getNewMeans(&values[0]);
+  BOOST_CHECK_EQUAL(values[0], 1.5);
+  BOOST_CHECK_EQUAL(values[1], 8.5);
+  BOOST_CHECK_EQUAL(values[2], 5.5);
+
+  envelope.markPublished();
+  BOOST_CHECK_EQUAL(envelope.numNew(), 0);
+  BOOST_CHECK_EQUAL(envelope.newSum(0), 0.);
+}
+
+BOOST_AUTO_TEST_CASE(test_Ring)
+{
+  NDAttributeEnvelope envelope;
+  std::vector<double> values(3);
+
+  envelope.configure(1, 3, 1);
+  for (int i=0; i<5; i++) {
+    values[0] = i;
+    envelope.add(&values[0]);
+  }
+  // Only the last numBins bins are kept, oldest first
+  BOOST_REQUIRE_EQUAL(envelope.numValid(), 3);
+  BOOST_CHECK_EQUAL(envelope.numNew(), 3);
+  envelope.get(NDAttributeEnvelope::Mean, 0, &values[0]);
+  BOOST_CHECK_EQUAL(values[0], 2.);
+  BOOST_CHECK_EQUAL(values[1], 3.);
+  BOOST_CHECK_EQUAL(values[2], 4.);
+
+  envelope.markPublished();
+  values[0] = 5;
+  envelope.add(&values[0]);
+  BOOST_CHECK_EQUAL(envelope.numNew(), 1);
+  envelope.getNewMeans(&values[0]);
+  BOOST_CHECK_EQUAL(values[0], 5.);
+
+  envelope.clear();
+  BOOST_CHECK_EQUAL(envelope.numValid(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,320 @@
+/*
+ * test_NDAttributeList.cpp
+ *
+ */
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "boost/test/unit_test.hpp"
+
+#include "NDAttributeList.h"
+#include "NDAttributeHandles.h"
+
+struct AttributeListFixture
+{
+  NDAttributeSchema *pSchema;
+  NDAttributeList source;
+
+  AttributeListFixture()
+  {
+    pSchema = new NDAttributeSchema();
+    source.setSchema(pSchema);
+    pSchema->release();
+    epicsInt32 i32 = 42;
+    epicsFloat64 f64 = 3.5;
+    source.add("Int", "An integer", NDAttrInt32, &i32);
+    source.add("Double", "A double", NDAttrFloat64, &f64);
+    source.add("String", "A string", NDAttrString, (void *)"hello");
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(NDAttributeListTests, AttributeListFixture)
+
+BOOST_AUTO_TEST_CASE(test_SchemaFind)
+{
+  BOOST_CHECK_EQUAL(pSchema->count(), 3);
+  int id = pSchema->findId("Double");
+  BOOST_REQUIRE_GE(id, 0);
+  NDAttribute *pAttr = source.find("Double");
+  BOOST_REQUIRE(pAttr);
+  BOOST_CHECK_EQUAL(pAttr->getSchemaId(), id);
+  BOOST_CHECK_EQUAL(source.find(id), pAttr);
+  BOOST_CHECK_EQUAL(std::string(pSchema->getDescription(id)), "A double");
+  BOOST_CHECK(!source.find("double"));
+  BOOST_CHECK(!source.find("Missing"));
+  BOOST_CHECK_EQUAL(pSchema->findId("Missing"), -1);
+
+  // next() still walks the attributes in the order they were added
+  BOOST_CHECK_EQUAL(std::string(source.next(NULL)->getName()), "Int");
+  BOOST_CHECK_EQUAL(std::string(source.next(source.next(NULL))->getName()), "Double");
+}
+
+BOOST_AUTO_TEST_CASE(test_SchemaManyNames)
+{
+  // Enough names to grow the hash table several times
+  char name[32];
+  for (int i = 0; i < 1000; i++) {
+    epicsInt32 value = i;
+    sprintf(name, "Attr%d", i);
+    source.add(name, "", NDAttrInt32, &value);
+  }
+  BOOST_CHECK_EQUAL(source.count(), 1003);
+  for (int i = 0; i < 1000; i += 37) {
+    epicsInt32 value = -1;
+    sprintf(name, "Attr%d", i);
+    NDAttribute *pAttr = source.find(name);
+    BOOST_REQUIRE(pAttr);
+    pAttr->getValue(NDAttrInt32, &value);
+    BOOST_CHECK_EQUAL(value, i);
+  }
+  // The values of the first attributes survive the value block growing
+  epicsInt32 i32 = 0;
+  source.find("Int")->getValue(NDAttrInt32, &i32);
+  BOOST_CHECK_EQUAL(i32, 42);
+}
+
+BOOST_AUTO_TEST_CASE(test_SchemaCopy)
+{
+  NDAttributeList out;
+  source.copy(&out);
+  BOOST_CHECK_EQUAL(out.getSchema(), pSchema);
+  BOOST_CHECK_EQUAL(out.count(), 3);
+
+  NDAttribute *pInt = out.find("Int");
+  NDAttribute *pString = out.find("String");
+  BOOST_REQUIRE(pInt);
+  BOOST_REQUIRE(pString);
+  epicsInt32 i32 = 0;
+  pInt->getValue(NDAttrInt32, &i32);
+  BOOST_CHECK_EQUAL(i32, 42);
+
+  // Copying into the cleared list, as NDArrayPool::copy does, reuses the same attributes
+  i32 = 7;
+  source.find("Int")->setValue(&i32);
+  source.find("String")->setValue(std::string("world"));
+  out.clear();
+  BOOST_CHECK_EQUAL(out.count(), 0);
+  BOOST_CHECK(!out.find("Int"));
+  source.copy(&out);
+  BOOST_CHECK_EQUAL(out.count(), 3);
+  BOOST_CHECK_EQUAL(out.find("Int"), pInt);
+  BOOST_CHECK_EQUAL(out.find("String"), pString);
+  i32 = 0;
+  pInt->getValue(NDAttrInt32, &i32);
+  BOOST_CHECK_EQUAL(i32, 7);
+  std::string value;
+  pString->getValue(value);
+  BOOST_CHECK_EQUAL(value, "world");
+
+  // Copying into a list that still holds the attributes updates them in place
+  i32 = 8;
+  source.find("Int")->setValue(&i32);
+  source.copy(&out);
+  BOOST_CHECK_EQUAL(out.count(), 3);
+  pInt->getValue(NDAttrInt32, &i32);
+  BOOST_CHECK_EQUAL(i32, 8);
+}
+
+BOOST_AUTO_TEST_CASE(test_SchemaOutputAttributes)
+{
+  // Attributes added to the output list are interned in the shared schema
+  NDAttributeList out;
+  source.copy(&out);
+  epicsFloat64 f64 = 1.25;
+  out.add("Extra", "Added by a plugin", NDAttrFloat64, &f64);
+  BOOST_CHECK_EQUAL(pSchema->count(), 4);
+  BOOST_CHECK_EQUAL(out.count(), 4);
+  BOOST_CHECK(!source.find("Extra"));
+
+  // A second copy does not disturb the attribute only held by the output list
+  source.copy(&out);
+  f64 = 0;
+  out.find("Extra")->getValue(NDAttrFloat64, &f64);
+  BOOST_CHECK_EQUAL(f64, 1.25);
+
+  BOOST_CHECK_EQUAL(out.remove("Extra"), ND_SUCCESS);
+  BOOST_CHECK(!out.find("Extra"));
+  BOOST_CHECK_EQUAL(out.count(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_SchemaDataTypeChange)
+{
+  NDAttributeList out;
+  source.copy(&out);
+  out.clear();
+
+  // The source attribute is replaced by one with another data type
+  source.remove("Int");
+  epicsFloat64 f64 = 2.5;
+  source.add("Int", "Now a double", NDAttrFloat64, &f64);
+  source.copy(&out);
+  NDAttribute *pAttr = out.find("Int");
+  BOOST_REQUIRE(pAttr);
+  BOOST_CHECK_EQUAL(pAttr->getDataType(), NDAttrFloat64);
+  f64 = 0;
+  pAttr->getValue(NDAttrFloat64, &f64);
+  BOOST_CHECK_EQUAL(f64, 2.5);
+}
+
+BOOST_AUTO_TEST_CASE(test_SchemaCopyBetweenDrivers)
+{
+  // The attribute list of a plugin, which is a driver with a schema of its own
+  NDAttributeSchema *pPluginSchema = new NDAttributeSchema();
+  NDAttributeList plugin;
+  plugin.setSchema(pPluginSchema);
+  pPluginSchema->release();
+  char name[32];
+  for (int i = 0; i < 5; i++) {
+    epicsInt32 value = 100 + i;
+    sprintf(name, "Plugin%d", i);
+    plugin.add(name, "", NDAttrInt32, &value);
+  }
+  epicsFloat64 f64 = 7.5;
+  plugin.add("Double", "", NDAttrFloat64, &f64);
+
+  // Each frame the array gets the attributes of the upstream driver, then those of the plugin
+  NDAttributeList out;
+  NDAttributeHandles handles;
+  int hPlugin = handles.add("Plugin3");
+  int hInt = handles.add("Int");
+  for (int frame = 0; frame < 100; frame++) {
+    out.clear();
+    epicsInt32 i32 = frame;
+    source.find("Int")->setValue(&i32);
+    source.copy(&out);
+    plugin.copy(&out);
+    BOOST_REQUIRE_EQUAL(out.count(), 8);
+    BOOST_REQUIRE_EQUAL(out.getSchema(), pSchema);
+    epicsInt64 values[2];
+    BOOST_REQUIRE_EQUAL(handles.getValues(&out, values, (epicsInt64)-1), 2);
+    BOOST_CHECK_EQUAL(values[hPlugin], 103);
+    BOOST_CHECK_EQUAL(values[hInt], frame);
+  }
+  // Neither schema has learnt the names of the other driver
+  BOOST_CHECK_EQUAL(pSchema->count(), 3);
+  BOOST_CHECK_EQUAL(pPluginSchema->count(), 6);
+  BOOST_CHECK_EQUAL(pSchema->findId("Plugin0"), -1);
+  BOOST_CHECK_EQUAL(pPluginSchema->findId("Int"), -1);
+
+  // Names held by name are found and replaced like the others
+  f64 = 0;
+  out.find("Double")->getValue(NDAttrFloat64, &f64);
+  BOOST_CHECK_EQUAL(f64, 7.5);
+  BOOST_CHECK_EQUAL(out.remove("Plugin1"), ND_SUCCESS);
+  BOOST_CHECK(!out.find("Plugin1"));
+  BOOST_CHECK_EQUAL(out.count(), 7);
+
+  // An array recycled for the arrays of the plugin adopts its schema
+  out.clear();
+  plugin.copy(&out);
+  BOOST_CHECK_EQUAL(out.getSchema(), pPluginSchema);
+  BOOST_CHECK_EQUAL(out.count(), 6);
+  BOOST_CHECK_GE(out.find("Plugin0")->getSchemaId(), 0);
+  BOOST_CHECK_EQUAL(pSchema->count(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_PlainList)
+{
+  // Lists without a schema behave as before, and keep their values when one is removed
+  NDAttributeList plain;
+  epicsInt32 i32 = 5;
+  plain.add("Plain", "", NDAttrInt32, &i32);
+  plain.setSchema(pSchema);
+  BOOST_CHECK_GE(plain.find("Plain")->getSchemaId(), 0);
+  plain.setSchema(NULL);
+  BOOST_CHECK(!plain.getSchema());
+  NDAttribute *pAttr = plain.find("Plain");
+  BOOST_REQUIRE(pAttr);
+  BOOST_CHECK_EQUAL(pAttr->getSchemaId(), -1);
+  i32 = 0;
+  pAttr->getValue(NDAttrInt32, &i32);
+  BOOST_CHECK_EQUAL(i32, 5);
+
+  // A list with a schema can be copied into a plain list that already has attributes
+  source.copy(&plain);
+  BOOST_CHECK_EQUAL(plain.count(), 4);
+  BOOST_CHECK_EQUAL(plain.getSchema(), pSchema);
+  plain.find("Plain")->getValue(NDAttrInt32, &i32);
+  BOOST_CHECK_EQUAL(i32, 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_Handles)
+{
+  NDAttributeHandles handles;
+  int hDouble = handles.add("Double");
+  int hInt = handles.add("Int");
+  int hLater = handles.add("Later");
+  BOOST_CHECK_EQUAL(handles.count(), 3);
+
+  NDAttributeList out;
+  source.copy(&out);
+  BOOST_CHECK_EQUAL(handles.resolve(&out), 2);
+  BOOST_CHECK_EQUAL(handles.get(&out, hDouble), out.find("Double"));
+  BOOST_CHECK(!handles.get(&out, hLater));
+  BOOST_CHECK(!handles.get(&out, 3));
+
+  epicsFloat64 values[3];
+  BOOST_CHECK_EQUAL(handles.getValues(&out, values, -1.), 2);
+  BOOST_CHECK_EQUAL(values[0], 3.5);
+  BOOST_CHECK_EQUAL(values[1], 42.);
+  BOOST_CHECK_EQUAL(values[2], -1.);
+
+  // Integer values are read without converting them to double
+  epicsInt64 big = ((epicsInt64)1 << 60) + 1;
+  out.remove("Int");
+  out.add("Int", "", NDAttrInt64, &big);
+  epicsInt64 ints[3];
+  BOOST_CHECK_EQUAL(handles.getValues(&out, ints, (epicsInt64)-1), 2);
+  BOOST_CHECK_EQUAL(ints[0], 3);
+  BOOST_CHECK_EQUAL(ints[1], big);
+  BOOST_CHECK_EQUAL(ints[2], -1);
+
+  // Only string attributes are read as strings
+  int hString = handles.add("String");
+  std::string value;
+  BOOST_CHECK_EQUAL(handles.getValue(&out, hString, value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, "hello");
+  BOOST_CHECK_EQUAL(handles.getValue(&out, hDouble, value), ND_ERROR);
+  std::vector<std::string> strings;
+  BOOST_CHECK_EQUAL(handles.getValues(&out, strings, "none"), 1);
+  BOOST_REQUIRE_EQUAL(strings.size(), 4u);
+  BOOST_CHECK_EQUAL(strings[0], "none");
+  BOOST_CHECK_EQUAL(strings[1], "none");
+  BOOST_CHECK_EQUAL(strings[2], "none");
+  BOOST_CHECK_EQUAL(strings[hString], "hello");
+  source.copy(&out);
+
+  // A name added to the schema after the handles were resolved is found on the next read
+  epicsInt32 i32 = 9;
+  source.add("Later", "", NDAttrInt32, &i32);
+  source.copy(&out);
+  BOOST_CHECK_EQUAL(handles.resolve(&out), 4);
+  i32 = 0;
+  BOOST_CHECK_EQUAL(handles.getValue(&out, hLater, NDAttrInt32, &i32), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(i32, 9);
+
+  // Renaming a handle resolves it again
+  handles.setName(hInt, "String");
+  BOOST_CHECK_EQUAL(handles.get(&out, hInt), out.find("String"));
+
+  // Numeric values are read from the value block by ID, and strings are missing
+  epicsFloat64 allValues[4];
+  BOOST_CHECK_EQUAL(handles.getValues(&out, allValues, -1.), 2);
+  BOOST_CHECK_EQUAL(allValues[hDouble], 3.5);
+  BOOST_CHECK_EQUAL(allValues[hInt], -1.);
+  BOOST_CHECK_EQUAL(allValues[hLater], 9.);
+  BOOST_CHECK_EQUAL(allValues[hString], -1.);
+
+  // Lists without a schema are searched by name
+  NDAttributeList plain;
+  epicsFloat64 f64 = 6.5;
+  plain.add("Double", "", NDAttrFloat64, &f64);
+  BOOST_CHECK_EQUAL(handles.resolve(&plain), 0);
+  BOOST_CHECK_EQUAL(handles.get(&plain, hDouble), plain.find("Double"));
+  BOOST_CHECK_EQUAL(handles.getValues(&plain, allValues, -1.), 1);
+  BOOST_CHECK_EQUAL(allValues[hDouble], 6.5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+/*
+ * test_NDAttributeValueStore.cpp
+ *
+ */
+
+#include <string.h>
+#include <string>
+
+#include "boost/test/unit_test.hpp"
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+
+#include "NDAttributeValueStore.h"
+
+#define STORE_STRING_SIZE 64
+
+struct PublisherArgs
+{
+  NDAttributeValueStore *pStore;
+  int count;
+  epicsEventId done;
+};
+
+// Publishes strings made of a single repeated character, so that a torn read shows mixed characters
+static void publishStrings(void *arg)
+{
+  PublisherArgs *pArgs = (PublisherArgs *)arg;
+  char buffer[STORE_STRING_SIZE];
+  for (int i = 0; i < pArgs->count; i++) {
+    memset(buffer, 'a' + (i % 26), sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = 0;
+    pArgs->pStore->publish(buffer);
+  }
+  epicsEventSignal(pArgs->done);
+}
+
+BOOST_AUTO_TEST_CASE(test_StoreValues)
+{
+  NDAttributeValueStore store(NDAttrFloat64, 0);
+  NDAttrValue value;
+
+  // Nothing to read before the first value is published
+  BOOST_CHECK(!store.read(&value));
+  epicsFloat64 f64 = 1.5;
+  store.publish(&f64);
+  BOOST_REQUIRE(store.read(&value));
+  BOOST_CHECK_EQUAL(value.f64, 1.5);
+  f64 = 2.5;
+  store.publish(&f64);
+  f64 = 3.5;
+  store.publish(&f64);
+  BOOST_REQUIRE(store.read(&value));
+  BOOST_CHECK_EQUAL(value.f64, 3.5);
+  // A numeric store has no string value
+  std::string string;
+  BOOST_CHECK(!store.read(string));
+  BOOST_CHECK_EQUAL(store.getRetries(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_StoreStrings)
+{
+  NDAttributeValueStore store(NDAttrString, 8);
+  std::string string;
+
+  store.publish("short");
+  BOOST_REQUIRE(store.read(string));
+  BOOST_CHECK_EQUAL(string, "short");
+  // Strings longer than the buffer are truncated
+  store.publish("much too long");
+  BOOST_REQUIRE(store.read(string));
+  BOOST_CHECK_EQUAL(string, "much to");
+}
+
+BOOST_AUTO_TEST_CASE(test_StoreConcurrent)
+{
+  NDAttributeValueStore store(NDAttrString, STORE_STRING_SIZE);
+  std::string string;
+  PublisherArgs args;
+  args.pStore = &store;
+  args.count = 200000;
+  args.done = epicsEventCreate(epicsEventEmpty);
+
+  store.publish("start");
+  epicsThreadCreate("publishStrings", epicsThreadPriorityMedium,
+                    epicsThreadGetStackSize(epicsThreadStackMedium), publishStrings, &args);
+  int torn = 0;
+  int reads = 0;
+  while (epicsEventTryWait(args.done) != epicsEventOK) {
+    BOOST_REQUIRE(store.read(string));
+    reads++;
+    if (string == "start") continue;
+    if (string.size() != STORE_STRING_SIZE - 1 ||
+        string.find_first_not_of(string[0]) != std::string::npos) torn++;
+  }
+  // Every value read is one that was published whole
+  BOOST_CHECK_EQUAL(torn, 0);
+  BOOST_CHECK_GT(reads, 0);
+  BOOST_TEST_MESSAGE("reads " << reads << " retries " << store.getRetries());
+  epicsEventDestroy(args.done);
+}
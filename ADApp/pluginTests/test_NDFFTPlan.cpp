@@ -0,0 +1,129 @@
+/*
+ * test_NDFFTPlan.cpp
+ *
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+#include "boost/test/unit_test.hpp"
+
+#include "NDFFTPlan.h"
+
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
+typedef std::complex<double> Complex;
+
+// Direct computation of the 2-D DFT of real data, returning the nx/2+1 non-redundant columns
+static std::vector<Complex> directDFT(const std::vector<double>& in, int nx, int ny)
+{
+  int nOutX = nx/2 + 1;
+  std::vector<Complex> out(nOutX*ny);
+
+  for (int v=0; v<ny; v++) {
+    for (int u=0; u<nOutX; u++) {
+      Complex sum(0, 0);
+      for (int y=0; y<ny; y++) {
+        for (int x=0; x<nx; x++) {
+          double phase = -2. * M_PI * ((double)u*x/nx + (double)v*y/ny);
+          sum += in[y*nx + x] * Complex(cos(phase), sin(phase));
+        }
+      }
+      out[v*nOutX + u] = sum;
+    }
+  }
+  return out;
+}
+
+// Returns the largest difference between the plan and the direct DFT, relative to the largest value
+template <typename T>
+static double planError(int nx, int ny, NDFFTWorkers *pWorkers)
+{
+  NDFFTPlan<T> plan(nx, ny);
+  std::vector<double> data(nx*ny);
+  std::vector<T> in(nx*ny);
+  std::vector<std::complex<T> > out(plan.nOutX()*ny);
+  double maxValue = 0, maxError = 0;
+
+  for (int i=0; i<nx*ny; i++) {
+    data[i] = sin(0.37*i) + 0.5*cos(1.3*i) + (i % 7);
+    in[i] = (T)data[i];
+  }
+  plan.execute(&in[0], &out[0], pWorkers);
+  std::vector<Complex> expected = directDFT(data, nx, ny);
+  for (size_t i=0; i<expected.size(); i++) {
+    Complex value((double)out[i].real(), (double)out[i].imag());
+    maxValue = std::max(maxValue, std::abs(expected[i]));
+    maxError = std::max(maxError, std::abs(value - expected[i]));
+  }
+  return maxError / maxValue;
+}
+
+BOOST_AUTO_TEST_SUITE(NDFFTPlanTests)
+
+BOOST_AUTO_TEST_CASE(test_Sizes1D)
+{
+  // Powers of 2, each dedicated radix, other primes and sizes that were padded before
+  int sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 12, 15, 20, 30, 49, 64, 97, 100, 120, 210, 243, 1000};
+
+  for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+    BOOST_CHECK_MESSAGE(planError<double>(sizes[i], 1, NULL) < 1e-12, "double size " << sizes[i]);
+    BOOST_CHECK_MESSAGE(planError<float>(sizes[i], 1, NULL) < 1e-5, "float size " << sizes[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_Sizes2D)
+{
+  BOOST_CHECK_LT(planError<double>(20, 40, NULL), 1e-12);
+  BOOST_CHECK_LT(planError<double>(9, 10, NULL), 1e-12);
+  BOOST_CHECK_LT(planError<float>(16, 15, NULL), 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(test_Workers)
+{
+  NDFFTWorkers workers(3);
+
+  BOOST_CHECK_EQUAL(workers.numThreads(), 3);
+  // More threads than rows, and several transforms with the same pool
+  BOOST_CHECK_LT(planError<double>(24, 2, &workers), 1e-12);
+  BOOST_CHECK_LT(planError<double>(30, 25, &workers), 1e-12);
+  BOOST_CHECK_LT(planError<float>(32, 32, &workers), 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(test_Workspaces)
+{
+  // Rows and columns of other primes, which need scratch space in each thread
+  NDFFTWorkers workers(2);
+  NDFFTPlan<double> plan(14, 11);
+  std::vector<double> data(14*11);
+  for (size_t i=0; i<data.size(); i++) data[i] = cos(0.21*i) + (i % 5);
+  std::vector<Complex> expected = directDFT(data, 14, 11);
+
+  // The workspace is kept by the plan and given to the next execution
+  NDFFTWorkspace<double> *pWorkspace = plan.getWorkspace();
+  for (int pass=0; pass<2; pass++) {
+    std::copy(data.begin(), data.end(), pWorkspace->input());
+    plan.execute(pWorkspace->input(), pWorkspace->output(), &workers, pWorkspace);
+    double maxError = 0;
+    for (size_t i=0; i<expected.size(); i++) {
+      maxError = std::max(maxError, std::abs(pWorkspace->output()[i] - expected[i]));
+    }
+    BOOST_CHECK_LT(maxError, 1e-10);
+    plan.releaseWorkspace(pWorkspace);
+    NDFFTWorkspace<double> *pNext = plan.getWorkspace();
+    BOOST_CHECK_EQUAL(pNext, pWorkspace);
+    pWorkspace = pNext;
+  }
+
+  // Executions at the same time each get a workspace of their own
+  NDFFTWorkspace<double> *pOther = plan.getWorkspace();
+  BOOST_CHECK(pOther != pWorkspace);
+  plan.releaseWorkspace(pOther);
+  plan.releaseWorkspace(pWorkspace);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
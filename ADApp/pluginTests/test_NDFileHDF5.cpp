@@ -12,6 +12,8 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include <deque>
 #include <boost/shared_ptr.hpp>
@@ -19,15 +21,33 @@ using namespace std;
 
 #include "testingutilities.h"
 #include "asynPortDriver.h"
+#include <epicsThread.h>
+#include <epicsEvent.h>
 #include "HDF5PluginWrapper.h"
 #include "HDF5FileReader.h"
+#include "AsynException.h"
 
 static  NDArrayPool *arrayPool;
 
+struct CaptureStopArgs
+{
+  HDF5PluginWrapper *writer;
+  epicsEventId done;
+};
+
+// Stops the capture of a writer, which closes its file, from a thread of its own
+static void stopCapture(void *arg)
+{
+  CaptureStopArgs *pArgs = (CaptureStopArgs *)arg;
+  pArgs->writer->write(NDFileCaptureString, 0);
+  epicsEventSignal(pArgs->done);
+}
+
 struct NDFileHDF5TestFixture
 {
   asynNDArrayDriver* dummy_driver;
   boost::shared_ptr<HDF5PluginWrapper> hdf5;
+  std::string driverPort;
 
   static int testCase;
 
@@ -39,6 +59,7 @@ struct NDFileHDF5TestFixture
     std::string dummy_port("simHDF5test"), testport("HDF5");
     uniqueAsynPortName(dummy_port);
     uniqueAsynPortName(testport);
+    driverPort = dummy_port;
 
     // We need some upstream driver for our test plugin so that calls to connectToArrayPort don't fail, but we can then ignore it and send
     // arrays by calling processCallbacks directly.
@@ -177,6 +198,342 @@ BOOST_AUTO_TEST_CASE(test_Capture)
 
 }
 
+BOOST_AUTO_TEST_CASE(test_WriteBehind)
+{
+  size_t tmpdims[] = {4,6};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+
+  // Create some test arrays
+  std::vector<NDArray*>arrays(10);
+  fillNDArraysFromPool(dims, NDUInt32, arrays, arrayPool);
+
+  // Configure the HDF5 plugin to write through the write-behind thread
+  setup_hdf_stream();
+  hdf5->write(NDFileNameString, "testing_writebehind");
+  hdf5->write(str_NDFileHDF5_writeBehind, 1);
+  hdf5->write(str_NDFileHDF5_writeQueueSize, 4);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  // Start capture to disk
+  hdf5->write(NDFileNumCaptureString, 10);
+  hdf5->write(NDFileCaptureString, 1);
+
+  // The queue settings cannot change while the file is open
+  BOOST_CHECK_THROW(hdf5->write(str_NDFileHDF5_writeQueueSize, 8), AsynException);
+  BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_writeQueueSize), 4);
+
+  for (int i = 0; i < 10; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+  }
+
+  // The file is closed after the last frame, which waits for every queued write
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileCaptureString), 0);
+  BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_writeQueueUse), 0);
+  BOOST_CHECK_GE(hdf5->readDouble(str_NDFileHDF5_writeLatencyMax), 0.0);
+
+  HDF5FileReader fr("testing_writebehind_0.5");
+  std::vector<hsize_t> odims = fr.getDatasetDimensions("/entry/data/data");
+  BOOST_CHECK_EQUAL(odims.size(), 3);
+  BOOST_CHECK_EQUAL(odims[0], 10);
+  BOOST_CHECK_EQUAL(odims[1], 6);
+  BOOST_CHECK_EQUAL(odims[2], 4);
+  odims = fr.getDatasetDimensions("/entry/instrument/NDAttributes/NDArrayUniqueId");
+  BOOST_CHECK_EQUAL(odims.size(), 1);
+  BOOST_CHECK_EQUAL(odims[0], 10);
+}
+
+BOOST_AUTO_TEST_CASE(test_CaptureAllSpilled)
+{
+  // Arrays of 1.2 MB, so that with 1 MB of capture memory every one goes to the spill store
+  size_t tmpdims[] = {512,600};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  std::vector<NDArray*>arrays(3);
+  fillNDArraysFromPool(dims, NDUInt32, arrays, arrayPool);
+
+  char spillDir[] = "/tmp/test_NDFileHDF5XXXXXX";
+  BOOST_REQUIRE(mkdtemp(spillDir));
+  setup_hdf_stream();
+  hdf5->write(NDFileWriteModeString, NDFileModeCapture);
+  hdf5->write(NDFileNameString, "testing_spill");
+  hdf5->write(NDAutoSaveString, 1);
+  hdf5->write(NDFileCaptureMaxMemoryString, 1);
+  hdf5->write(NDFileSpillPathString, spillDir);
+  hdf5->write(NDFileSpillMaxSizeString, 8);
+
+  // Initialise the HDF5 plugin with a dummy frame
+  hdf5->processCallbacks(arrays[0]);
+
+  hdf5->write(NDFileNumCaptureString, 3);
+  hdf5->write(NDFileCaptureString, 1);
+  for (int i = 0; i < 3; i++)
+  {
+    hdf5->lock();
+    BOOST_CHECK_NO_THROW(hdf5->processCallbacks(arrays[i]));
+    hdf5->unlock();
+    if (i < 2) {
+      BOOST_CHECK_EQUAL(hdf5->readDouble(NDFileCaptureMemoryString), 0.0);
+      BOOST_CHECK_GT(hdf5->readDouble(NDFileSpillUsedString), 0.0);
+    }
+  }
+
+  // The file is written from the spill store alone, and the store is emptied
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileWriteStatusString), NDFileWriteOK);
+  BOOST_CHECK_EQUAL(hdf5->readInt(NDFileNumCapturedString), 0);
+  BOOST_CHECK_EQUAL(hdf5->readDouble(NDFileSpillUsedString), 0.0);
+  HDF5FileReader fr("testing_spill_0.5");
+  std::vector<hsize_t> odims = fr.getDatasetDimensions("/entry/data/data");
+  BOOST_CHECK_EQUAL(odims.size(), 3);
+  BOOST_CHECK_EQUAL(odims[0], 3);
+  BOOST_CHECK_EQUAL(odims[1], 600);
+  BOOST_CHECK_EQUAL(odims[2], 512);
+  // The spill file was unlinked when it was created, so the directory is already empty
+  BOOST_CHECK_EQUAL(rmdir(spillDir), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_DirectIO)
+{
+  // Direct I/O can only be selected when the HDF5 library has the direct driver
+  if (hdf5->readInt(str_NDFileHDF5_directIOSupported) == 0) {
+    BOOST_CHECK_THROW(hdf5->write(str_NDFileHDF5_directIO, 1), AsynException);
+    BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_directIO), 0);
+  } else {
+    BOOST_CHECK_NO_THROW(hdf5->write(str_NDFileHDF5_directIO, 1));
+    BOOST_CHECK_EQUAL(hdf5->readInt(str_NDFileHDF5_directIO), 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_Striping)
+{
+  size_t tmpdims[] = {4,6};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+
+  // Create some test arrays, every byte of array i is set to i+1 and its uniqueId is i
+  std::vector<NDArray*>arrays(10);
+  fillNDArraysFromPool(dims, NDUInt8, arrays, arrayPool);
+  for (int i = 0; i < 10; i++)
+  {
+    memset(arrays[i]->pData, i+1, arrays[i]->dataSize);
+    arrays[i]->uniqueId = i;
+  }
+
+  // Remove any master file left by an earlier run
+  remove("testing_stripe_0.5");
+
+  // A second writer receiving the same arrays
+  std::string stripeport("HDF5stripe");
+  uniqueAsynPortName(stripeport);
+  boost::shared_ptr<HDF5PluginWrapper> writers[2];
+  writers[0] = hdf5;
+  writers[1] = boost::shared_ptr<HDF5PluginWrapper>(new HDF5PluginWrapper(stripeport.c_str(),
+                                                                          50, 1, driverPort.c_str(),
+                                                                          0, 0, 2000000));
+  writers[1]->start();
+  writers[1]->write(NDPluginDriverEnableCallbacksString, 1);
+  writers[1]->write(NDPluginDriverBlockingCallbacksString, 1);
+
+  // Both writers share the file configuration and each owns one stripe and captures its own share
+  for (int w = 0; w < 2; w++)
+  {
+    writers[w]->write(NDFileWriteModeString, NDFileModeStream);
+    writers[w]->write(NDFilePathString, "");
+    writers[w]->write(NDFileNameString, "testing_stripe");
+    writers[w]->write(NDFileTemplateString, "%s%s_%d.5");
+    writers[w]->write(str_NDFileHDF5_stripeCount, 2);
+    writers[w]->write(str_NDFileHDF5_stripeIndex, w);
+    writers[w]->processCallbacks(arrays[0]);
+    writers[w]->write(NDFileNumCaptureString, 5);
+    writers[w]->write(NDFileCaptureString, 1);
+  }
+
+  // The stripe cannot change while the file is open
+  BOOST_CHECK_THROW(hdf5->write(str_NDFileHDF5_stripeIndex, 1), AsynException);
+  BOOST_CHECK_EQUAL(writers[1]->readString(str_NDFileHDF5_stripeFileName), "testing_stripe_0_stripe1.5");
+
+  // Array 6 is dropped before it reaches the first writer
+  for (int i = 0; i < 10; i++)
+  {
+    for (int w = 0; w < 2; w++)
+    {
+      if (w == 0 && i == 6) continue;
+      BOOST_CHECK_NO_THROW(writers[w]->driverCallback(writers[w]->pasynUserSelf, arrays[i]));
+    }
+  }
+
+  // Each writer only counted its own arrays, so the second writer has finished and the first
+  // is still waiting for its fifth array
+  BOOST_CHECK_EQUAL(writers[0]->readInt(NDFileNumCapturedString), 4);
+  BOOST_CHECK_EQUAL(writers[0]->readInt(NDFileCaptureString), 1);
+  BOOST_CHECK_EQUAL(writers[1]->readInt(NDFileNumCapturedString), 5);
+  BOOST_CHECK_EQUAL(writers[1]->readInt(NDFileCaptureString), 0);
+
+  // Only the first stripe creates the master file, when it closes its file
+  FILE *master = fopen("testing_stripe_0.5", "rb");
+  BOOST_CHECK(master == NULL);
+  if (master) fclose(master);
+  writers[0]->write(NDFileCaptureString, 0);
+
+  // Each stripe file records the uniqueIds of the frames it holds
+  for (int w = 0; w < 2; w++)
+  {
+    HDF5FileReader fr(w == 0 ? "testing_stripe_0_stripe0.5" : "testing_stripe_0_stripe1.5");
+    std::vector<hsize_t> odims = fr.getDatasetDimensions("/entry/data/data");
+    BOOST_CHECK_EQUAL(odims.size(), 3);
+    BOOST_CHECK_EQUAL(odims[0], w == 0 ? 4 : 5);
+    odims = fr.getDatasetDimensions("/stripe/uniqueId");
+    BOOST_REQUIRE_EQUAL(odims.size(), 1);
+    BOOST_CHECK_EQUAL(odims[0], w == 0 ? 4 : 5);
+  }
+  hid_t file = H5Fopen("testing_stripe_0_stripe0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE_GE(file, 0);
+  hid_t dataset = H5Dopen2(file, "/stripe/uniqueId", H5P_DEFAULT);
+  int ids[4];
+  const int expectedIds[4] = {0, 2, 4, 8};
+  BOOST_CHECK_GE(H5Dread(dataset, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, ids), 0);
+  for (int k = 0; k < 4; k++)
+  {
+    BOOST_CHECK_EQUAL(ids[k], expectedIds[k]);
+  }
+  H5Dclose(dataset);
+  H5Fclose(file);
+
+  // The master file presents all the frames in acquisition order, with the dropped frame
+  // holding the fill value
+  file = H5Fopen("testing_stripe_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE_GE(file, 0);
+  dataset = H5Dopen2(file, "/entry/data/data", H5P_DEFAULT);
+  BOOST_REQUIRE_GE(dataset, 0);
+  hid_t dataspace = H5Dget_space(dataset);
+  hsize_t vdims[3];
+  BOOST_CHECK_EQUAL(H5Sget_simple_extent_dims(dataspace, vdims, NULL), 3);
+  BOOST_CHECK_EQUAL(vdims[0], 10);
+  std::vector<epicsUInt8> data(10*6*4);
+  BOOST_CHECK_GE(H5Dread(dataset, H5T_NATIVE_UINT8, H5S_ALL, H5S_ALL, H5P_DEFAULT, &data[0]), 0);
+  for (int i = 0; i < 10; i++)
+  {
+    BOOST_CHECK_EQUAL((int)data[i*6*4], i == 6 ? 0 : i+1);
+  }
+  int missing = 0;
+  hid_t attr = H5Aopen(dataset, "missing_frames", H5P_DEFAULT);
+  BOOST_CHECK_GE(H5Aread(attr, H5T_NATIVE_INT32, &missing), 0);
+  BOOST_CHECK_EQUAL(missing, 1);
+  H5Aclose(attr);
+  H5Sclose(dataspace);
+  H5Dclose(dataset);
+  H5Fclose(file);
+
+  for (int i = 0; i < 10; i++)
+  {
+    arrays[i]->release();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_StripingOverlappingCloses)
+{
+  size_t tmpdims[] = {4,6};
+  std::vector<size_t>dims(tmpdims, tmpdims + sizeof(tmpdims)/sizeof(tmpdims[0]));
+  std::vector<NDArray*>arrays(4);
+  fillNDArraysFromPool(dims, NDUInt8, arrays, arrayPool);
+  for (int i = 0; i < 4; i++)
+  {
+    memset(arrays[i]->pData, i+1, arrays[i]->dataSize);
+    arrays[i]->uniqueId = i;
+  }
+  remove("testing_overlap_0.5");
+
+  std::string stripeport("HDF5overlap");
+  uniqueAsynPortName(stripeport);
+  boost::shared_ptr<HDF5PluginWrapper> writers[2];
+  writers[0] = hdf5;
+  writers[1] = boost::shared_ptr<HDF5PluginWrapper>(new HDF5PluginWrapper(stripeport.c_str(),
+                                                                          50, 1, driverPort.c_str(),
+                                                                          0, 0, 2000000));
+  writers[1]->start();
+  writers[1]->write(NDPluginDriverEnableCallbacksString, 1);
+  writers[1]->write(NDPluginDriverBlockingCallbacksString, 1);
+
+  // The writers stream until they are stopped
+  for (int w = 0; w < 2; w++)
+  {
+    writers[w]->write(NDFileWriteModeString, NDFileModeStream);
+    writers[w]->write(NDFilePathString, "");
+    writers[w]->write(NDFileNameString, "testing_overlap");
+    writers[w]->write(NDFileTemplateString, "%s%s_%d.5");
+    writers[w]->write(str_NDFileHDF5_stripeCount, 2);
+    writers[w]->write(str_NDFileHDF5_stripeIndex, w);
+    writers[w]->processCallbacks(arrays[0]);
+    writers[w]->write(NDFileNumCaptureString, 0);
+    writers[w]->write(NDFileCaptureString, 1);
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    for (int w = 0; w < 2; w++)
+    {
+      BOOST_CHECK_NO_THROW(writers[w]->driverCallback(writers[w]->pasynUserSelf, arrays[i]));
+    }
+  }
+
+  // The first stripe starts closing before the second and waits for it
+  CaptureStopArgs args[2];
+  for (int w = 0; w < 2; w++)
+  {
+    args[w].writer = writers[w].get();
+    args[w].done = epicsEventCreate(epicsEventEmpty);
+    epicsThreadCreate("stopCapture", epicsThreadPriorityMedium,
+                      epicsThreadGetStackSize(epicsThreadStackMedium), stopCapture, &args[w]);
+    if (w == 0) epicsThreadSleep(0.2);
+  }
+  for (int w = 0; w < 2; w++)
+  {
+    BOOST_REQUIRE_EQUAL(epicsEventWaitWithTimeout(args[w].done, 20.0), epicsEventOK);
+    epicsEventDestroy(args[w].done);
+  }
+
+  // One master file was created, by the first stripe, with all the frames
+  FILE *leftover = fopen("testing_overlap_0_stripe1.5.master", "rb");
+  BOOST_CHECK(leftover == NULL);
+  if (leftover) fclose(leftover);
+  hid_t file = H5Fopen("testing_overlap_0.5", H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE_GE(file, 0);
+  hid_t dataset = H5Dopen2(file, "/entry/data/data", H5P_DEFAULT);
+  BOOST_REQUIRE_GE(dataset, 0);
+  std::vector<epicsUInt8> data(4*6*4);
+  BOOST_CHECK_GE(H5Dread(dataset, H5T_NATIVE_UINT8, H5S_ALL, H5S_ALL, H5P_DEFAULT, &data[0]), 0);
+  for (int i = 0; i < 4; i++)
+  {
+    BOOST_CHECK_EQUAL((int)data[i*6*4], i+1);
+  }
+  H5Dclose(dataset);
+  H5Fclose(file);
+
+  // Without the second stripe file the first stripe gives up after the timeout
+  remove("testing_overlap_1.5");
+  for (int w = 0; w < 2; w++)
+  {
+    writers[w]->write(NDFileNumberString, 1);
+    writers[w]->write(NDFileCaptureString, 1);
+    for (int i = 0; i < 2; i++)
+    {
+      BOOST_CHECK_NO_THROW(writers[w]->driverCallback(writers[w]->pasynUserSelf, arrays[i]));
+    }
+  }
+  writers[0]->write(str_NDFileHDF5_stripeVDSTimeout, 0.5);
+  writers[0]->write(NDFileCaptureString, 0);
+  FILE *master = fopen("testing_overlap_1.5", "rb");
+  BOOST_CHECK(master == NULL);
+  if (master) fclose(master);
+  writers[1]->write(NDFileCaptureString, 0);
+
+  for (int i = 0; i < 4; i++)
+  {
+    arrays[i]->release();
+  }
+}
+
 BOOST_AUTO_TEST_CASE(test_DatasetLayout1)
 {
   size_t tmpdims[] = {10,10};
@@ -717,3 +717,86 @@ BOOST_AUTO_TEST_CASE(test_AttributeDimensionalDataset)
 
 }
 
+
+BOOST_AUTO_TEST_CASE(test_AttributeFlushInterval)
+{
+  // Open an HDF5 file for testing
+  std::string filename = "test_att_flush.h5";
+  hid_t file = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, 0, 0);
+  BOOST_REQUIRE_GT(file, -1);
+
+  // Add a test group.
+  std::string gname = "group";
+  hid_t group = H5Gcreate(file, gname.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  BOOST_REQUIRE_GT(group, -1);
+
+  boost::shared_ptr<NDFileHDF5AttributeDataset> adPtr;
+
+  // Buffer 8 values between writes, with a frame count that is not a multiple of 8
+  adPtr = boost::shared_ptr<NDFileHDF5AttributeDataset>(new NDFileHDF5AttributeDataset(file, "att1", NDAttrInt32));
+  adPtr->setDsetName("dset1");
+  adPtr->setParentGroupName(gname);
+  adPtr->setFlushInterval(8);
+  adPtr->createDataset(4);
+  epicsInt32 val1 = 0;
+  for (epicsInt32 index = 0; index < 29; index++){
+    val1 = index * 3;
+    NDAttribute ndAttr("att1", "Test attribute 1", NDAttrSourceFunct, "test", NDAttrInt32, &val1);
+    adPtr->writeAttributeDataset(hdf5::OnFrame, &ndAttr, 0);
+  }
+  // Closing the dataset must write the remaining buffered values
+  adPtr->closeAttributeDataset();
+
+  // Buffered values must land in the right place for multi-dimensional datasets too
+  int extradims = 2;
+  int dimsize[2] = {3, 3};
+  int chunking[2] = {1, 1};
+  adPtr = boost::shared_ptr<NDFileHDF5AttributeDataset>(new NDFileHDF5AttributeDataset(file, "att2", NDAttrFloat64));
+  adPtr->setDsetName("dset2");
+  adPtr->setParentGroupName(gname);
+  adPtr->setFlushInterval(4);
+  adPtr->createDataset(true, extradims, dimsize, chunking);
+  epicsFloat64 val2 = 0.0;
+  for (int index = 0; index < 7; index++){
+    val2 = index + 0.5;
+    NDAttribute ndAttr("att2", "Test attribute 2", NDAttrSourceFunct, "test", NDAttrFloat64, &val2);
+    adPtr->writeAttributeDataset(hdf5::OnFrame, &ndAttr, 0);
+  }
+  adPtr->closeAttributeDataset();
+
+  // Close the group
+  H5Gclose(group);
+  // Close the file
+  H5Fclose(file);
+
+  HDF5FileReader fr(filename);
+  std::vector<hsize_t> dims = fr.getDatasetDimensions("/group/dset1");
+  BOOST_CHECK_EQUAL(dims.size(), 1);
+  BOOST_CHECK_EQUAL(dims[0], 29);
+  dims = fr.getDatasetDimensions("/group/dset2");
+  BOOST_CHECK_EQUAL(dims.size(), 2);
+  BOOST_CHECK_EQUAL(dims[0], 3);
+  BOOST_CHECK_EQUAL(dims[1], 3);
+
+  // Read the values back and check every buffered value was written in order
+  file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  BOOST_REQUIRE_GT(file, -1);
+  hid_t dset = H5Dopen2(file, "/group/dset1", H5P_DEFAULT);
+  BOOST_REQUIRE_GT(dset, -1);
+  epicsInt32 ivalues[29];
+  BOOST_REQUIRE_GE(H5Dread(dset, H5T_NATIVE_INT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, ivalues), 0);
+  for (int index = 0; index < 29; index++){
+    BOOST_CHECK_EQUAL(ivalues[index], index * 3);
+  }
+  H5Dclose(dset);
+
+  dset = H5Dopen2(file, "/group/dset2", H5P_DEFAULT);
+  BOOST_REQUIRE_GT(dset, -1);
+  epicsFloat64 dvalues[9];
+  BOOST_REQUIRE_GE(H5Dread(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, dvalues), 0);
+  for (int index = 0; index < 7; index++){
+    BOOST_CHECK_EQUAL(dvalues[index], index + 0.5);
+  }
+  H5Dclose(dset);
+  H5Fclose(file);
+}
@@ -0,0 +1,162 @@
+/*
+ * test_NDFileHDF5ChunkTracker.cpp
+ *
+ */
+
+#include <stdio.h>
+
+#include "boost/test/unit_test.hpp"
+
+#include "hdf5.h"
+#include "NDFileHDF5ChunkTracker.h"
+
+// Append nFrames frames of 64x64 elements along the first dimension
+static void appendFrames(NDFileHDF5ChunkTracker& tracker, int nFrames)
+{
+  hsize_t count[3] = {1, 64, 64};
+  for (int frame = 0; frame < nFrames; frame++){
+    hsize_t offset[3] = {(hsize_t)frame, 0, 0};
+    tracker.write(offset, count);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_ChunkTrackerFrameChunks)
+{
+  // One frame per chunk never leaves a chunk incomplete, even without a cache
+  hsize_t chunkdims[3] = {1, 64, 64};
+  hsize_t maxdims[3] = {H5S_UNLIMITED, 64, 64};
+  NDFileHDF5ChunkTracker tracker;
+  tracker.configure(3, chunkdims, maxdims, 2, 0, 521);
+  appendFrames(tracker, 10);
+  BOOST_CHECK_EQUAL(tracker.getAccesses(), 10);
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 0);
+  BOOST_CHECK_EQUAL(tracker.getPartialFlushes(), 0);
+  BOOST_CHECK_CLOSE(tracker.getHitRate(), 1.0, 1e-9);
+  BOOST_CHECK_CLOSE(NDFileHDF5ChunkTracker::expectedHitRate(3, 2, chunkdims, maxdims, 2, 0), 1.0, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(test_ChunkTrackerMultiFrameChunks)
+{
+  // Four frames per chunk of 32 kB
+  hsize_t chunkdims[3] = {4, 64, 64};
+  hsize_t maxdims[3] = {H5S_UNLIMITED, 64, 64};
+  NDFileHDF5ChunkTracker tracker;
+
+  // The cache holds the chunk being filled
+  tracker.configure(3, chunkdims, maxdims, 2, 1048576, 521);
+  appendFrames(tracker, 16);
+  BOOST_CHECK_EQUAL(tracker.getAccesses(), 16);
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 0);
+  BOOST_CHECK_EQUAL(tracker.getPartialFlushes(), 0);
+  BOOST_CHECK_CLOSE(NDFileHDF5ChunkTracker::expectedHitRate(3, 2, chunkdims, maxdims, 2, 1048576), 1.0, 1e-9);
+
+  // A flush in the middle of a chunk writes it incomplete but keeps it cached
+  tracker.reset();
+  appendFrames(tracker, 2);
+  tracker.flush();
+  BOOST_CHECK_EQUAL(tracker.getPartialFlushes(), 1);
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 0);
+
+  // The chunk is larger than the cache, so every frame after the first reads it back
+  tracker.configure(3, chunkdims, maxdims, 2, 16384, 521);
+  appendFrames(tracker, 16);
+  BOOST_CHECK_EQUAL(tracker.getAccesses(), 16);
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 12);
+  BOOST_CHECK_EQUAL(tracker.getPartialFlushes(), 12);
+  BOOST_CHECK_CLOSE(tracker.getHitRate(), 0.25, 1e-9);
+  BOOST_CHECK_CLOSE(NDFileHDF5ChunkTracker::expectedHitRate(3, 2, chunkdims, maxdims, 2, 16384), 0.25, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(test_ChunkTrackerTiles)
+{
+  // Frames split into four tiles of 16 rows, with four frames per chunk
+  hsize_t chunkdims[3] = {4, 16, 64};
+  hsize_t maxdims[3] = {H5S_UNLIMITED, 64, 64};
+  NDFileHDF5ChunkTracker tracker;
+
+  // Room for only two of the four tiles being filled
+  tracker.configure(3, chunkdims, maxdims, 2, 16384, 521);
+  appendFrames(tracker, 8);
+  BOOST_CHECK_EQUAL(tracker.getAccesses(), 32);
+  // On the last frame of each chunk the completed tiles are evicted first, saving one read
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 22);
+  BOOST_CHECK_CLOSE(NDFileHDF5ChunkTracker::expectedHitRate(3, 2, chunkdims, maxdims, 2, 16384), 0.25, 1e-9);
+
+  // Room for all four tiles
+  tracker.configure(3, chunkdims, maxdims, 2, 32768, 521);
+  appendFrames(tracker, 8);
+  BOOST_CHECK_EQUAL(tracker.getAccesses(), 32);
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 0);
+  BOOST_CHECK_EQUAL(tracker.getPartialFlushes(), 0);
+  BOOST_CHECK_CLOSE(NDFileHDF5ChunkTracker::expectedHitRate(3, 2, chunkdims, maxdims, 2, 32768), 1.0, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(test_ChunkTrackerHashSlots)
+{
+  // Two tiles of two frames share the only hash slot, so each evicts the other
+  hsize_t chunkdims[3] = {2, 32, 64};
+  hsize_t maxdims[3] = {H5S_UNLIMITED, 64, 64};
+  NDFileHDF5ChunkTracker tracker;
+  tracker.configure(3, chunkdims, maxdims, 2, 1048576, 1);
+  appendFrames(tracker, 4);
+  BOOST_CHECK_EQUAL(tracker.getAccesses(), 8);
+  // The second frame of each tile reads it back, and the first frame of each tile is evicted incomplete
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 4);
+  BOOST_CHECK_EQUAL(tracker.getPartialFlushes(), 4);
+
+  // Nothing incomplete is left in the cache
+  tracker.flush();
+  BOOST_CHECK_EQUAL(tracker.getPartialFlushes(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_ChunkTrackerExtraDims)
+{
+  // 3 points in X with 4 frames each, chunked 2 frames by 2 points in X
+  hsize_t chunkdims[4] = {2, 2, 8, 8};
+  hsize_t maxdims[4] = {3, 4, 8, 8};
+  hsize_t count[4] = {1, 1, 8, 8};
+
+  // Chunks along N are open for two X positions, so two chunks of 512 bytes are needed
+  BOOST_CHECK_CLOSE(NDFileHDF5ChunkTracker::expectedHitRate(4, 2, chunkdims, maxdims, 2, 1024), 1.0, 1e-9);
+  BOOST_CHECK_CLOSE(NDFileHDF5ChunkTracker::expectedHitRate(4, 2, chunkdims, maxdims, 2, 512), 0.25, 1e-9);
+
+  NDFileHDF5ChunkTracker tracker;
+  tracker.configure(4, chunkdims, maxdims, 2, 1024, 521);
+  for (hsize_t x = 0; x < 3; x++){
+    for (hsize_t n = 0; n < 4; n++){
+      hsize_t offset[4] = {x, n, 0, 0};
+      tracker.write(offset, count);
+    }
+  }
+  BOOST_CHECK_EQUAL(tracker.getAccesses(), 12);
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 0);
+  BOOST_CHECK_EQUAL(tracker.getPartialFlushes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_ChunkTrackerDataset)
+{
+  // The geometry and cache settings are read from a dataset
+  hid_t file = H5Fcreate("test_chunktracker.h5", H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  BOOST_REQUIRE_GT(file, -1);
+  hsize_t dims[3] = {0, 64, 64};
+  hsize_t maxdims[3] = {H5S_UNLIMITED, 64, 64};
+  hsize_t chunkdims[3] = {4, 64, 64};
+  hid_t space = H5Screate_simple(3, dims, maxdims);
+  hid_t cparms = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(cparms, 3, chunkdims);
+  hid_t aparms = H5Pcreate(H5P_DATASET_ACCESS);
+  H5Pset_chunk_cache(aparms, 521, 16384, 1.0);
+  hid_t dataset = H5Dcreate2(file, "data", H5T_NATIVE_UINT16, space, H5P_DEFAULT, cparms, aparms);
+  BOOST_REQUIRE_GT(dataset, -1);
+
+  NDFileHDF5ChunkTracker tracker;
+  tracker.configure(dataset);
+  appendFrames(tracker, 4);
+  BOOST_CHECK_EQUAL(tracker.getMisses(), 3);
+
+  H5Dclose(dataset);
+  H5Pclose(aparms);
+  H5Pclose(cparms);
+  H5Sclose(space);
+  H5Fclose(file);
+}
@@ -232,6 +232,42 @@ BOOST_AUTO_TEST_CASE(attrplot_attribute_data)
     }
 }
 
+BOOST_AUTO_TEST_CASE(attrplot_publish_changed_blocks)
+{
+    const std::string attr_name = "attribute";
+    asynFloat64ArrayClient client = asynFloat64ArrayClient(port.c_str(), 0, NDAttrPlotDataString);
+    client.registerInterruptUser(addr0DataInterrupt);
+
+    // Enable plugin
+    BOOST_CHECK_NO_THROW(attrPlot->write(NDArrayCallbacksString, 1));
+
+    NDArrayWrapper wrap(arrPool);
+    wrap.set_uid(1).add_attr(attr_name, 5.);
+
+    attrPlot->lock();
+    BOOST_CHECK_NO_THROW(attrPlot->processCallbacks(wrap.get()));
+    attrPlot->unlock();
+
+    // Selecting the attribute publishes its block, padded with the last point
+    addr0Data.reset();
+    BOOST_CHECK_NO_THROW(attrPlot->write(NDAttrPlotDataSelectString, 0, 0));
+    try {
+        std::vector<double> data = addr0Data.get_data();
+        BOOST_REQUIRE_EQUAL(data.size(), static_cast<size_t>(cache_size));
+        for (int i = 0; i < cache_size; ++i) {
+            BOOST_CHECK_EQUAL(data[i], 5.);
+        }
+    } catch (const AsynException& e) {
+        BOOST_FAIL("Exception thrown while trying to get data");
+    }
+
+    // Selecting another block does not publish the unchanged one again
+    addr0Data.reset();
+    BOOST_CHECK_NO_THROW(attrPlot->write(NDAttrPlotDataSelectString,
+                ND_ATTRPLOT_UID_INDEX, 1));
+    BOOST_CHECK_THROW(addr0Data.get_data(), AsynException);
+}
+
 BOOST_AUTO_TEST_CASE(attrplot_attribute_select)
 {
     const std::string attr_name = "attribute";
@@ -0,0 +1,165 @@
+/*
+ * test_NDPluginBadPixel.cpp
+ *
+ */
+
+#include <stdio.h>
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+
+#include <boost/shared_ptr.hpp>
+#include <fstream>
+using namespace std;
+
+#include "testingutilities.h"
+#include "BadPixelPluginWrapper.h"
+
+static const char *badPixelFile = "test_NDPluginBadPixel.json";
+
+struct BadPixelPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<BadPixelPluginWrapper> badPixel;
+  TestingPlugin* downstream_plugin; // TODO: we don't put this in a shared_ptr and purposefully leak memory because asyn ports cannot be deleted
+  NDArrayPool *arrayPool;
+
+  BadPixelPluginTestFixture()
+  {
+    // Asyn manager doesn't like it if we try to reuse the same port name for multiple drivers
+    // (even if only one is ever instantiated at once), so we change it slightly for each test case.
+    std::string simport("simBP"), testport("BP");
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+    arrayPool = driver->pNDArrayPool;
+
+    // This is the plugin under test
+    badPixel = boost::shared_ptr<BadPixelPluginWrapper>(new BadPixelPluginWrapper(testport, simport));
+    // This is the mock downstream plugin
+    downstream_plugin = new TestingPlugin(testport.c_str(), 0);
+
+    badPixel->start();
+    badPixel->write(NDPluginDriverEnableCallbacksString, 1);
+    badPixel->write(NDPluginDriverBlockingCallbacksString, 1);
+
+    // Pixel coordinates are detector pixels; Replace and Median offsets are in binned pixels
+    std::ofstream file(badPixelFile);
+    file << "{\"Bad pixels\": ["
+            "{\"Pixel\": [1, 1], \"Set\": 500},"
+            "{\"Pixel\": [5, 5], \"Replace\": [1, 0]},"
+            "{\"Pixel\": [3, 7], \"Median\": [1, 1]},"
+            "{\"Pixel\": [8, 2], \"Median\": [1, 1]},"
+            "{\"Pixel\": [9, 2], \"Set\": 0},"
+            "{\"Pixel\": [0, 9], \"Median\": [1, 1]},"
+            "{\"Pixel\": [50, 50], \"Set\": 1}"
+            "]}";
+    file.close();
+    badPixel->write(NDPluginBadPixelFileNameString, std::string(badPixelFile));
+  }
+
+  ~BadPixelPluginTestFixture()
+  {
+    remove(badPixelFile);
+    badPixel.reset();
+    driver.reset();
+  }
+
+  // Returns a UInt16 image of nx by ny pixels, all set to 100, with the given binning
+  NDArray *newImage(size_t nx, size_t ny, int binning)
+  {
+    size_t dims[2] = {nx, ny};
+    NDArray *pArray = arrayPool->alloc(2, dims, NDUInt16, 0, NULL);
+    epicsUInt16 *pData = (epicsUInt16 *)pArray->pData;
+    for (size_t i=0; i<nx*ny; i++) pData[i] = 100;
+    pArray->dims[0].binning = binning;
+    pArray->dims[1].binning = binning;
+    return pArray;
+  }
+
+  // Processes an array and returns the data of the array received downstream
+  epicsUInt16 *process(NDArray *pArray)
+  {
+    badPixel->lock();
+    badPixel->processCallbacks(pArray);
+    badPixel->unlock();
+    BOOST_REQUIRE(!downstream_plugin->arrays.empty());
+    NDArray *pOut = downstream_plugin->arrays.back();
+    BOOST_REQUIRE(pOut != pArray);
+    return (epicsUInt16 *)pOut->pData;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(BadPixelPluginTests, BadPixelPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_Corrections)
+{
+  const int nx = 10;
+  NDArray *pArray = newImage(nx, 10, 1);
+  epicsUInt16 *pIn = (epicsUInt16 *)pArray->pData;
+
+  pIn[5*nx + 6] = 321;
+  // Neighbours of (3,7)
+  int values37[] = {1, 2, 3, 4, 50, 60, 70, 80};
+  int offsets37[] = {6*nx+2, 6*nx+3, 6*nx+4, 7*nx+2, 7*nx+4, 8*nx+2, 8*nx+3, 8*nx+4};
+  for (int i=0; i<8; i++) pIn[offsets37[i]] = values37[i];
+  // Neighbours of (8,2); (9,2) is also bad, so its value is not used
+  int values82[] = {10, 20, 30, 40, 50, 60, 70};
+  int offsets82[] = {1*nx+7, 1*nx+8, 1*nx+9, 2*nx+7, 3*nx+7, 3*nx+8, 3*nx+9};
+  for (int i=0; i<7; i++) pIn[offsets82[i]] = values82[i];
+  pIn[2*nx + 9] = 1000;
+  // Neighbours of (0,9) that are inside the array
+  pIn[9*nx + 1] = 5;
+  pIn[8*nx + 0] = 6;
+  pIn[8*nx + 1] = 7;
+
+  epicsUInt16 *pOut = process(pArray);
+  BOOST_CHECK_EQUAL(pOut[1*nx + 1], 500);
+  BOOST_CHECK_EQUAL(pOut[5*nx + 5], 321);
+  // Median of an even number of values is the mean of the middle two
+  BOOST_CHECK_EQUAL(pOut[7*nx + 3], 27);
+  BOOST_CHECK_EQUAL(pOut[2*nx + 8], 40);
+  BOOST_CHECK_EQUAL(pOut[2*nx + 9], 0);
+  BOOST_CHECK_EQUAL(pOut[9*nx + 0], 6);
+  // Good pixels and the input array are not modified
+  BOOST_CHECK_EQUAL(pOut[0], 100);
+  BOOST_CHECK_EQUAL(pOut[5*nx + 6], 321);
+  BOOST_CHECK_EQUAL(pIn[1*nx + 1], 100);
+  BOOST_CHECK_EQUAL(pIn[2*nx + 9], 1000);
+
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_Binning)
+{
+  // With 2x2 binning detector pixel (x,y) is array pixel (x/2,y/2), and Replace offsets are in array pixels
+  const int nx = 5;
+  NDArray *pArray = newImage(nx, 5, 2);
+  epicsUInt16 *pIn = (epicsUInt16 *)pArray->pData;
+  pIn[2*nx + 3] = 77;
+
+  epicsUInt16 *pOut = process(pArray);
+  BOOST_CHECK_EQUAL(pOut[0*nx + 0], 500);
+  BOOST_CHECK_EQUAL(pOut[2*nx + 2], 77);
+  pArray->release();
+
+  // The corrections follow the array geometry when the binning changes again
+  pArray = newImage(10, 10, 1);
+  pOut = process(pArray);
+  BOOST_CHECK_EQUAL(pOut[0], 100);
+  BOOST_CHECK_EQUAL(pOut[1*10 + 1], 500);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 
 // AD and asyn dependencies
 #include <NDPluginCircularBuff.h>
+#include <NDPluginCodec.h>
 #include <asynPortDriver.h>
 #include <NDArray.h>
 #include <asynDriver.h>
@@ -13,6 +14,8 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "testingutilities.h"
 
@@ -54,8 +57,8 @@ struct NDPluginCircularBuffFixture
         cb = new NDPluginCircularBuff(testport.c_str(), 50, 0, dummy_port.c_str(), 0, 1000, -1, 0, 2000000);
         cb->start(); // start the plugin thread although not required for this unittesting
 
-        // This is the mock downstream plugin
-        ds = new TestingPlugin(testport.c_str(), 0);
+        // This is the mock downstream plugin.  It reserves the arrays, because the plugin releases them after the callbacks.
+        ds = new TestingPlugin(testport.c_str(), 0, true);
 
         cbControl = new asynInt32Client(testport.c_str(), 0, NDCircBuffControlString);
         cbPreTrigger = new asynInt32Client(testport.c_str(), 0, NDCircBuffPreTriggerString);
@@ -79,7 +82,7 @@ struct NDPluginCircularBuffFixture
         delete cbPostTrigger;
         delete cbPreTrigger;
         delete cbControl;
-        //delete ds; // TODO: something is wrong here - if we delete ds we get a memory corruption error (in a loop!?!?)
+        delete ds;
         delete cb;
         delete dummy_driver;
     }
@@ -183,4 +186,375 @@ BOOST_AUTO_TEST_CASE(test_PreBufferOrder)
     BOOST_CHECK_EQUAL(3, ((uint8_t *)ds->arrays[3]->pData)[0]);
 }
 
+BOOST_AUTO_TEST_CASE(test_ArrayDataTrigger)
+{
+    size_t gotbytes;
+    // J is the maximum of the array data
+    cbCalc->write("J>5", 4, &gotbytes);
+
+    cbPreTrigger->write(2);
+    cbPostTrigger->write(1);
+    cbControl->write(1);
+
+    size_t dims = 3;
+    NDArray *testArrays[3];
+    for (int i = 0; i < 3; i++) {
+        testArrays[i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+        memset(testArrays[i]->pData, 0, 3);
+        ((uint8_t *)testArrays[i]->pData)[2] = (uint8_t)(3*i);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        cbProcess(testArrays[i]);
+    }
+    // Array 2 has a maximum of 6, so it triggers and is output after arrays 0 and 1
+    BOOST_REQUIRE_EQUAL((size_t)3, ds->arrays.size());
+    BOOST_CHECK_EQUAL(6, ((uint8_t *)ds->arrays[2]->pData)[2]);
+
+    for (int i = 0; i < 3; i++) {
+        testArrays[i]->release();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_AttributeInputsGH)
+{
+    size_t gotbytes;
+    asynOctetClient cbTrigG(cb->portName, 0, NDCircBuffTriggerGString);
+    asynOctetClient cbTrigH(cb->portName, 0, NDCircBuffTriggerHString);
+    asynFloat64Client cbTrigGVal(cb->portName, 0, NDCircBuffTriggerGValString);
+    asynFloat64Client cbTrigHVal(cb->portName, 0, NDCircBuffTriggerHValString);
+    asynFloat64Client cbCalcVal(cb->portName, 0, NDCircBuffTriggerCalcValString);
+    cbTrigG.write("Gain", 4, &gotbytes);
+    cbTrigH.write("Offset", 6, &gotbytes);
+    cbCalc->write("G*H>10", 7, &gotbytes);
+
+    cbPreTrigger->write(2);
+    cbPostTrigger->write(1);
+    cbControl->write(1);
+
+    size_t dims = 3;
+    NDArray *testArrays[3];
+    for (int i = 0; i < 3; i++) {
+        epicsFloat64 gain = 2. * i, offset = 3.;
+        testArrays[i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+        testArrays[i]->pAttributeList->add("Gain", "", NDAttrFloat64, &gain);
+        testArrays[i]->pAttributeList->add("Offset", "", NDAttrFloat64, &offset);
+    }
+
+    double gVal, hVal, calcVal;
+    cbProcess(testArrays[0]);
+    cbProcess(testArrays[1]);
+    cbTrigGVal.read(&gVal);
+    cbTrigHVal.read(&hVal);
+    cbCalcVal.read(&calcVal);
+    BOOST_CHECK_EQUAL(gVal, 2.);
+    BOOST_CHECK_EQUAL(hVal, 3.);
+    BOOST_CHECK_EQUAL(calcVal, 0.);
+    BOOST_CHECK_EQUAL((size_t)0, ds->arrays.size());
+
+    // 4*3 > 10, so array 2 triggers and the ring is flushed
+    cbProcess(testArrays[2]);
+    cbTrigGVal.read(&gVal);
+    cbCalcVal.read(&calcVal);
+    BOOST_CHECK_EQUAL(gVal, 4.);
+    BOOST_CHECK_EQUAL(calcVal, 1.);
+    BOOST_CHECK_EQUAL((size_t)3, ds->arrays.size());
+
+    for (int i = 0; i < 3; i++) {
+        testArrays[i]->release();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_EarlyTrigger)
+{
+    size_t gotbytes;
+    asynInt32Client cbBlocking(cb->portName, 0, NDPluginDriverBlockingCallbacksString);
+    asynInt32Client cbEarlyTrigger(cb->portName, 0, NDCircBuffEarlyTriggerString);
+    asynInt32Client cbEarlyDropped(cb->portName, 0, NDCircBuffEarlyDroppedString);
+    asynFloat64Client cbTrigAVal(cb->portName, 0, NDCircBuffTriggerAValString);
+    cbBlocking.write(1);
+    cbEarlyTrigger.write(1);
+    cbTrigA->write("Value", 5, &gotbytes);
+    cbCalc->write("A>5", 4, &gotbytes);
+
+    // Without pre-trigger arrays, the arrays that do not trigger are dropped in driverCallback()
+    cbPreTrigger->write(0);
+    cbPostTrigger->write(2);
+    cbControl->write(1);
+
+    size_t dims = 3;
+    NDArray *testArrays[4];
+    for (int i = 0; i < 4; i++) {
+        epicsFloat64 value = 2. * i;
+        testArrays[i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+        memset(testArrays[i]->pData, 0, 3);
+        testArrays[i]->pAttributeList->add("Value", "", NDAttrFloat64, &value);
+    }
+
+    int dropped;
+    double aVal;
+    for (int i = 0; i < 3; i++) {
+        cb->driverCallback(cb->pasynUserSelf, testArrays[i]);
+    }
+    cbEarlyDropped.read(&dropped);
+    cbTrigAVal.read(&aVal);
+    BOOST_CHECK_EQUAL(dropped, 3);
+    BOOST_CHECK_EQUAL(aVal, 4.);
+    BOOST_CHECK_EQUAL((size_t)0, ds->arrays.size());
+
+    // Array 3 triggers, and the result found in driverCallback() is used when it is processed
+    cb->driverCallback(cb->pasynUserSelf, testArrays[3]);
+    cbTrigAVal.read(&aVal);
+    BOOST_CHECK_EQUAL(aVal, 6.);
+    BOOST_CHECK_EQUAL((size_t)1, ds->arrays.size());
+
+    // Once triggered the arrays are not evaluated, so array 0 is output as the second post-trigger array
+    cb->driverCallback(cb->pasynUserSelf, testArrays[0]);
+    cbEarlyDropped.read(&dropped);
+    BOOST_CHECK_EQUAL(dropped, 3);
+    BOOST_CHECK_EQUAL((size_t)2, ds->arrays.size());
+
+    // Starting the capture again resets the count
+    cbControl->write(1);
+    cbEarlyDropped.read(&dropped);
+    BOOST_CHECK_EQUAL(dropped, 0);
+
+    // Expressions of the array data are not evaluated in driverCallback(), so no arrays are dropped
+    cbCalc->write("J>5", 4, &gotbytes);
+    for (int i = 0; i < 3; i++) {
+        cb->driverCallback(cb->pasynUserSelf, testArrays[i]);
+    }
+    cbEarlyDropped.read(&dropped);
+    BOOST_CHECK_EQUAL(dropped, 0);
+    BOOST_CHECK_EQUAL((size_t)2, ds->arrays.size());
+
+    for (int i = 0; i < 4; i++) {
+        testArrays[i]->release();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_MaxMemory)
+{
+    size_t gotbytes;
+    cbCalc->write("0", 2, &gotbytes);
+
+    asynInt32Client cbMaxMemory(cb->portName, 0, NDCircBuffMaxMemoryString);
+    asynFloat64Client cbMemoryUsed(cb->portName, 0, NDCircBuffMemoryUsedString);
+    cbMaxMemory.write(1);
+    cbPreTrigger->write(10);
+    cbControl->write(1);
+
+    // Arrays of 0.4 MB, so that only 2 of them fit in 1 MB
+    size_t dims = 400000;
+    NDArray *testArrays[5];
+    for (int i = 0; i < 5; i++) {
+        testArrays[i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+        memset(testArrays[i]->pData, i, dims);
+        cbProcess(testArrays[i]);
+    }
+
+    int storedImages;
+    double memoryUsed;
+    cbCount->read(&storedImages);
+    cbMemoryUsed.read(&memoryUsed);
+    BOOST_CHECK_EQUAL(storedImages, 2);
+    BOOST_CHECK_CLOSE(memoryUsed, 800000 / 1048576., 1e-6);
+
+    // The newest arrays are kept
+    cbSoftTrigger->write(1);
+    cbProcess(testArrays[0]);
+    BOOST_REQUIRE_EQUAL((size_t)3, ds->arrays.size());
+    BOOST_CHECK_EQUAL(3, ((uint8_t *)ds->arrays[0]->pData)[0]);
+    BOOST_CHECK_EQUAL(4, ((uint8_t *)ds->arrays[1]->pData)[0]);
+    cbMemoryUsed.read(&memoryUsed);
+    BOOST_CHECK_EQUAL(memoryUsed, 0.);
+}
+
+BOOST_AUTO_TEST_CASE(test_CompressedStream)
+{
+    size_t gotbytes;
+    cbCalc->write("0", 2, &gotbytes);
+
+    // Without decompression on flush, the post-trigger arrays are compressed like those in the ring
+    asynInt32Client cbCompressor(cb->portName, 0, NDCircBuffCompressorString);
+    asynInt32Client cbFlushDecompress(cb->portName, 0, NDCircBuffFlushDecompressString);
+    cbCompressor.write(NDCircBuffCompressorLZ4);
+    cbFlushDecompress.write(0);
+    cbPreTrigger->write(2);
+    cbPostTrigger->write(2);
+    cbControl->write(1);
+
+    size_t dims = 1000;
+    NDArray *testArrays[4];
+    for (int i = 0; i < 4; i++) {
+        testArrays[i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+        memset(testArrays[i]->pData, i, dims);
+    }
+    cbProcess(testArrays[0]);
+    cbProcess(testArrays[1]);
+    cbSoftTrigger->write(1);
+    cbProcess(testArrays[2]);
+    cbProcess(testArrays[3]);
+
+    // The arrays are all compressed if LZ4 is available, or all uncompressed otherwise
+    BOOST_REQUIRE_EQUAL((size_t)4, ds->arrays.size());
+    for (int i = 0; i < 4; i++) {
+        BOOST_CHECK_EQUAL(ds->arrays[i]->codec.name, ds->arrays[0]->codec.name);
+        if (!ds->arrays[i]->codec.empty()) {
+            BOOST_CHECK_LT(ds->arrays[i]->compressedSize, dims);
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        testArrays[i]->release();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_CompressBufferCount)
+{
+    size_t gotbytes;
+    int preCount, compressor;
+    cbCalc->write("0", 2, &gotbytes);
+    asynInt32Client cbCompressor(cb->portName, 0, NDCircBuffCompressorString);
+
+    // The plugin has 1000 buffers; one is left for the copy of each array, and one more for compressing it
+    cbPreTrigger->write(999);
+    cbPreTrigger->read(&preCount);
+    BOOST_CHECK_EQUAL(preCount, 999);
+    cbCompressor.write(NDCircBuffCompressorLZ4);
+    cbCompressor.read(&compressor);
+    BOOST_CHECK_EQUAL(compressor, NDCircBuffCompressorNone);
+    cbPreTrigger->write(998);
+    cbCompressor.write(NDCircBuffCompressorLZ4);
+    cbCompressor.read(&compressor);
+    BOOST_CHECK_EQUAL(compressor, NDCircBuffCompressorLZ4);
+    cbPreTrigger->write(999);
+    cbPreTrigger->read(&preCount);
+    BOOST_CHECK_EQUAL(preCount, 998);
+
+    // The compression buffer is returned to the pool when the capture stops
+    cbPreTrigger->write(2);
+    cbControl->write(1);
+    size_t dims = 1000;
+    NDArray *pArray = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+    memset(pArray->pData, 1, dims);
+    cbProcess(pArray);
+    NDArrayPool *pPool = cb->pNDArrayPool;
+    int inUse = pPool->getNumBuffers() - pPool->getNumFree();
+    cbControl->write(0);
+    int compressBuffers = (compressBoundLZ4(pArray) > 0) ? 1 : 0;
+    BOOST_CHECK_EQUAL(pPool->getNumBuffers() - pPool->getNumFree(), inUse - compressBuffers);
+    pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_SpillToDisk)
+{
+    size_t gotbytes;
+    cbCalc->write("0", 2, &gotbytes);
+
+    // The spill file is created in a directory of its own, which is removed at the end
+    char spillDir[] = "/tmp/test_NDPluginCircularBuffXXXXXX";
+    BOOST_REQUIRE(mkdtemp(spillDir));
+
+    asynInt32Client cbMaxMemory(cb->portName, 0, NDCircBuffMaxMemoryString);
+    asynOctetClient cbSpillPath(cb->portName, 0, NDCircBuffSpillPathString);
+    asynInt32Client cbSpillMaxSize(cb->portName, 0, NDCircBuffSpillMaxSizeString);
+    asynFloat64Client cbSpillUsed(cb->portName, 0, NDCircBuffSpillUsedString);
+    cbMaxMemory.write(1);
+    cbSpillPath.write(spillDir, strlen(spillDir), &gotbytes);
+    cbSpillMaxSize.write(2);
+    cbPreTrigger->write(10);
+    cbControl->write(1);
+
+    // Arrays of 0.4 MB, so that 2 fit in memory and 5 more on disk; array 0 is released when the disk is full
+    size_t dims = 400000;
+    NDArray *testArrays[8];
+    for (int i = 0; i < 8; i++) {
+        testArrays[i] = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+        memset(testArrays[i]->pData, i, dims);
+        testArrays[i]->uniqueId = i;
+        cbProcess(testArrays[i]);
+    }
+
+    int storedImages;
+    double spillUsed;
+    cbCount->read(&storedImages);
+    cbSpillUsed.read(&spillUsed);
+    BOOST_CHECK_EQUAL(storedImages, 7);
+    BOOST_CHECK_CLOSE(spillUsed, 5 * 400000 / 1048576., 1e-6);
+
+    // The arrays on disk, 1 to 5, are output first, then 6 and 7 from memory and 0 as the post-trigger array
+    cbSoftTrigger->write(1);
+    cbProcess(testArrays[0]);
+    BOOST_REQUIRE_EQUAL((size_t)8, ds->arrays.size());
+    for (int i = 0; i < 8; i++) {
+        int expected = (i + 1) % 8;
+        uint8_t *pData = (uint8_t *)ds->arrays[i]->pData;
+        BOOST_CHECK_EQUAL(expected, ds->arrays[i]->uniqueId);
+        BOOST_CHECK_EQUAL(expected, pData[0]);
+        BOOST_CHECK_EQUAL(expected, pData[dims/2]);
+        BOOST_CHECK_EQUAL(expected, pData[dims - 1]);
+    }
+    cbSpillUsed.read(&spillUsed);
+    BOOST_CHECK_EQUAL(spillUsed, 0.);
+
+    for (int i = 0; i < 8; i++) {
+        testArrays[i]->release();
+    }
+    // The spill file was unlinked when it was created, so the directory is already empty
+    BOOST_CHECK_EQUAL(rmdir(spillDir), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_SpillPreCount)
+{
+    size_t gotbytes;
+    asynOctetClient cbSpillPath(cb->portName, 0, NDCircBuffSpillPathString);
+    asynInt32Client cbSpillMaxSize(cb->portName, 0, NDCircBuffSpillMaxSizeString);
+    int preCount;
+
+    // The plugin has 1000 buffers, so a larger pre-count needs a spill store that can be opened
+    cbPreTrigger->write(10);
+    cbSpillPath.write("/nonexistent", 12, &gotbytes);
+    cbSpillMaxSize.write(2);
+    cbPreTrigger->write(5000);
+    cbPreTrigger->read(&preCount);
+    BOOST_CHECK_EQUAL(preCount, 10);
+
+    char spillDir[] = "/tmp/test_NDPluginCircularBuffXXXXXX";
+    BOOST_REQUIRE(mkdtemp(spillDir));
+    cbSpillPath.write(spillDir, strlen(spillDir), &gotbytes);
+    cbPreTrigger->write(5000);
+    cbPreTrigger->read(&preCount);
+    BOOST_CHECK_EQUAL(preCount, 5000);
+
+    // Without a memory limit the arrays go to disk when the ring holds all the buffers of the plugin
+    asynFloat64Client cbSpillUsed(cb->portName, 0, NDCircBuffSpillUsedString);
+    cbCalc->write("0", 2, &gotbytes);
+    cbPreTrigger->write(1200);
+    cbControl->write(1);
+    size_t dims = 100;
+    NDArray *pArray = arrayPool->alloc(1,&dims,NDUInt8,0,NULL);
+    for (int i = 0; i < 1200; i++) {
+        pArray->uniqueId = i;
+        cbProcess(pArray);
+    }
+    int storedImages;
+    double spillUsed;
+    cbCount->read(&storedImages);
+    cbSpillUsed.read(&spillUsed);
+    BOOST_CHECK_EQUAL(storedImages, 1200);
+    BOOST_CHECK_GT(spillUsed, 0.);
+    pArray->release();
+    cbControl->write(0);
+
+    // Closing the store limits the pre-count to the buffers of the plugin again
+    cbSpillMaxSize.write(0);
+    cbPreTrigger->read(&preCount);
+    BOOST_CHECK_EQUAL(preCount, 999);
+    cbPreTrigger->write(6000);
+    cbPreTrigger->read(&preCount);
+    BOOST_CHECK_EQUAL(preCount, 999);
+    BOOST_CHECK_EQUAL(rmdir(spillDir), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -18,6 +18,7 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <math.h>
 
 #include <deque>
 #include <boost/shared_ptr.hpp>
@@ -29,6 +30,9 @@ using namespace std;
 #include "FFTPluginWrapper.h"
 #include "AsynException.h"
 
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
 
 static int callbackCount = 0;
 static void *cbPtr = 0;
@@ -191,10 +195,78 @@ BOOST_AUTO_TEST_CASE(basic_1D_operation)
   BOOST_CHECK_EQUAL(downstream_plugin->arrays.size(), (size_t)200);
   BOOST_REQUIRE_GT(downstream_plugin->arrays.size(), (size_t)0);
   BOOST_REQUIRE_EQUAL(downstream_plugin->arrays[0]->ndims, 1);
+  // The 20 samples are not padded, so there are 10 frequencies
   for (int i=0; i<200; i++) {
-    BOOST_REQUIRE_EQUAL(downstream_plugin->arrays[i]->dims[0].size, (size_t)16);
+    BOOST_REQUIRE_EQUAL(downstream_plugin->arrays[i]->dims[0].size, (size_t)10);
   }
 }
 
 
+BOOST_AUTO_TEST_CASE(segmented_1D_PSD)
+{
+  BOOST_CHECK_NO_THROW(fft->write(FFTNumAverageString, 1));
+  BOOST_CHECK_NO_THROW(fft->write(NDArrayCallbacksString, 1));
+  BOOST_CHECK_NO_THROW(fft->write(FFTOutputString, FFTOutputPSD));
+  BOOST_CHECK_NO_THROW(fft->write(FFTWindowString, FFTWindowHann));
+  BOOST_CHECK_NO_THROW(fft->write(FFTSegmentSizeString, 8));
+  BOOST_CHECK_NO_THROW(fft->write(FFTSegmentOverlapString, 50.));
+  BOOST_CHECK_NO_THROW(fft->write(FFTDecimationString, 4));
+
+  for (int i = 0; i < 20; i++)
+  {
+    fft->lock();
+    BOOST_CHECK_NO_THROW(fft->processCallbacks(arrays_1d[i]));
+    fft->unlock();
+  }
+  // 20 points in segments of 8 every 4 points
+  BOOST_CHECK_EQUAL(fft->readInt(FFTNumSegmentsString), 4);
+
+  // Only every 4th array is output, with 4 frequencies
+  BOOST_REQUIRE_EQUAL(downstream_plugin->arrays.size(), (size_t)5);
+  for (size_t i=0; i<downstream_plugin->arrays.size(); i++) {
+    BOOST_REQUIRE_EQUAL(downstream_plugin->arrays[i]->dims[0].size, (size_t)4);
+  }
+
+  // A sine with a whole number of cycles in each segment.  Its PSD integrates to its variance,
+  // and the peak of its Hann windowed magnitude is half its amplitude.
+  const double amplitude = 2.;
+  const int segmentSize = 64;
+  const int cycles = 8;
+  const double timePerPoint = 0.001;
+  size_t dims[1] = {256};
+  NDArray *pSine = arrayPool->alloc(1, dims, NDFloat64, 0, NULL);
+  double *pTime = (double *)pSine->pData;
+  for (int i = 0; i < 256; i++) pTime[i] = amplitude * sin(2. * M_PI * cycles * i / segmentSize);
+  BOOST_CHECK_NO_THROW(fft->write(FFTDecimationString, 1));
+  BOOST_CHECK_NO_THROW(fft->write(FFTSegmentSizeString, segmentSize));
+  BOOST_CHECK_NO_THROW(fft->write(FFTTimePerPointString, timePerPoint));
+  fft->lock();
+  BOOST_CHECK_NO_THROW(fft->processCallbacks(pSine));
+  fft->unlock();
+  // 256 points in segments of 64 every 32 points
+  BOOST_CHECK_EQUAL(fft->readInt(FFTNumSegmentsString), 7);
+  NDArray *pOut = downstream_plugin->arrays.back();
+  BOOST_REQUIRE_EQUAL(pOut->dims[0].size, (size_t)(segmentSize/2));
+  double *pPSD = (double *)pOut->pData;
+  double power = 0.;
+  for (int i = 0; i < segmentSize/2; i++) power += pPSD[i];
+  // The frequency step is 1/(segmentSize*timePerPoint)
+  power /= segmentSize * timePerPoint;
+  BOOST_CHECK_CLOSE(power, amplitude * amplitude / 2., 1e-6);
+
+  BOOST_CHECK_NO_THROW(fft->write(FFTOutputString, FFTOutputMagnitude));
+  fft->lock();
+  BOOST_CHECK_NO_THROW(fft->processCallbacks(pSine));
+  fft->unlock();
+  pOut = downstream_plugin->arrays.back();
+  double *pMagnitude = (double *)pOut->pData;
+  BOOST_CHECK_CLOSE(pMagnitude[cycles], amplitude / 2., 1e-6);
+  // Hann leaks only into the neighbouring frequencies, by half as much
+  BOOST_CHECK_CLOSE(pMagnitude[cycles-1], amplitude / 4., 1e-6);
+  BOOST_CHECK_CLOSE(pMagnitude[cycles+1], amplitude / 4., 1e-6);
+  BOOST_CHECK_SMALL(pMagnitude[cycles+2], 1e-9);
+  pSine->release();
+}
+
+
 BOOST_AUTO_TEST_SUITE_END() // Done!
@@ -191,6 +191,40 @@ struct OverlayPluginTestFixture
     appendTestCase(&overlayTestCaseStrs, &test9);
   }
 
+  // Sets the geometry, draw mode and value of an overlay and enables it
+  void setOverlay(int overlayNum, NDOverlayShape_t shape, NDOverlayDrawMode_t drawMode,
+                  int positionX, int positionY, int sizeX, int sizeY, int width, int green)
+  {
+    Overlay->write(NDPluginOverlayUseString,       1,         overlayNum);
+    Overlay->write(NDPluginOverlayPositionXString, positionX, overlayNum);
+    Overlay->write(NDPluginOverlayPositionYString, positionY, overlayNum);
+    Overlay->write(NDPluginOverlaySizeXString,     sizeX,     overlayNum);
+    Overlay->write(NDPluginOverlaySizeYString,     sizeY,     overlayNum);
+    Overlay->write(NDPluginOverlayWidthXString,    width,     overlayNum);
+    Overlay->write(NDPluginOverlayWidthYString,    width,     overlayNum);
+    Overlay->write(NDPluginOverlayShapeString,     shape,     overlayNum);
+    Overlay->write(NDPluginOverlayDrawModeString,  drawMode,  overlayNum);
+    Overlay->write(NDPluginOverlayGreenString,     green,     overlayNum);
+  }
+
+  // Returns a mono UInt8 image of nx by ny pixels, all set to value
+  NDArray *newImage(size_t nx, size_t ny, int value)
+  {
+    size_t dims[2] = {nx, ny};
+    NDArray *pArray = arrayPool->alloc(2, dims, NDUInt8, 0, NULL);
+    memset(pArray->pData, value, nx*ny);
+    return pArray;
+  }
+
+  // Processes an array and returns the array received downstream
+  NDArray *process(NDArray *pArray)
+  {
+    Overlay->lock();
+    Overlay->processCallbacks(pArray);
+    Overlay->unlock();
+    return downstream_plugin->arrays.back();
+  }
+
   ~OverlayPluginTestFixture()
   {
     client.reset();
@@ -256,4 +290,102 @@ BOOST_AUTO_TEST_CASE(basic_overlay_operation)
 }
 
 
+BOOST_AUTO_TEST_CASE(rasterized_output)
+{
+  const int nx = 20, ny = 20;
+  NDArray *pArray = newImage(nx, ny, 0);
+
+  // A rectangle from (2,3) to (7,7) with a border 1 pixel wide
+  setOverlay(0, NDOverlayRectangle, NDOverlaySet, 2, 3, 5, 4, 1, 200);
+  NDArray *pOut = process(pArray);
+  BOOST_REQUIRE(pOut != pArray);
+  epicsUInt8 *pData = (epicsUInt8 *)pOut->pData;
+  int numSet = 0;
+  for (int iy=0; iy<ny; iy++) {
+    for (int ix=0; ix<nx; ix++) {
+      bool inside = (ix >= 2) && (ix <= 7) && (iy >= 3) && (iy <= 7);
+      bool border = inside && ((ix == 2) || (ix == 7) || (iy == 3) || (iy == 7));
+      BOOST_CHECK_EQUAL((int)pData[iy*nx + ix], border ? 200 : 0);
+      if (pData[iy*nx + ix]) numSet++;
+    }
+  }
+  BOOST_CHECK_EQUAL(numSet, 18);
+  // The input array is not modified
+  BOOST_CHECK_EQUAL(((epicsUInt8 *)pArray->pData)[3*nx + 2], 0);
+
+  // Changing only the value and draw mode reuses the raster; XOR flips the bits of each pixel once
+  memset(pArray->pData, 0x0f, nx*ny);
+  Overlay->write(NDPluginOverlayDrawModeString, NDOverlayXOR, 0);
+  Overlay->write(NDPluginOverlayGreenString, 0xff, 0);
+  pOut = process(pArray);
+  pData = (epicsUInt8 *)pOut->pData;
+  BOOST_CHECK_EQUAL((int)pData[3*nx + 2], 0xf0);
+  BOOST_CHECK_EQUAL((int)pData[7*nx + 7], 0xf0);
+  BOOST_CHECK_EQUAL((int)pData[5*nx + 7], 0xf0);
+  BOOST_CHECK_EQUAL((int)pData[5*nx + 5], 0x0f);
+  BOOST_CHECK_EQUAL((int)pData[5*nx + 8], 0x0f);
+
+  // A cross centred on (10,10) clipped by the edge of a smaller array
+  Overlay->write(NDPluginOverlayUseString, 0, 0);
+  setOverlay(1, NDOverlayCross, NDOverlaySet, 8, 8, 4, 4, 1, 9);
+  NDArray *pSmall = newImage(11, 11, 0);
+  pOut = process(pSmall);
+  pData = (epicsUInt8 *)pOut->pData;
+  numSet = 0;
+  for (int i=0; i<11*11; i++) if (pData[i]) numSet++;
+  // Rows 8 to 10 of column 10 and columns 8 to 10 of row 10, which share (10,10)
+  BOOST_CHECK_EQUAL(numSet, 5);
+  BOOST_CHECK_EQUAL((int)pData[10*11 + 8], 9);
+  BOOST_CHECK_EQUAL((int)pData[8*11 + 10], 9);
+  Overlay->write(NDPluginOverlayUseString, 0, 1);
+
+  pSmall->release();
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(in_place)
+{
+  setOverlay(0, NDOverlayRectangle, NDOverlaySet, 1, 1, 3, 3, 1, 7);
+  Overlay->write(NDPluginOverlayInPlaceString, 1);
+  Overlay->write(NDPluginDriverBlockingCallbacksString, 0);
+
+  // An array that no other plugin holds is drawn in place and passed on
+  NDArray *pArray = newImage(8, 8, 0);
+  NDArray *pOut = process(pArray);
+  BOOST_CHECK_EQUAL(pOut, pArray);
+  BOOST_CHECK_EQUAL((int)((epicsUInt8 *)pArray->pData)[1*8 + 1], 7);
+  pArray->release();
+
+  // An array that another plugin also holds is copied
+  pArray = newImage(8, 8, 0);
+  pArray->reserve();
+  pOut = process(pArray);
+  BOOST_CHECK(pOut != pArray);
+  BOOST_CHECK_EQUAL((int)((epicsUInt8 *)pOut->pData)[1*8 + 1], 7);
+  BOOST_CHECK_EQUAL((int)((epicsUInt8 *)pArray->pData)[1*8 + 1], 0);
+  pArray->release();
+  pArray->release();
+
+  // An array whose data is read-only, such as one received with pvAccess, is copied
+  pArray = newImage(8, 8, 0);
+  pArray->readOnly = true;
+  pOut = process(pArray);
+  BOOST_CHECK(pOut != pArray);
+  BOOST_CHECK(!pOut->readOnly);
+  BOOST_CHECK_EQUAL((int)((epicsUInt8 *)pArray->pData)[1*8 + 1], 0);
+  pArray->release();
+
+  // Arrays are copied when in place drawing is disabled, and with blocking callbacks
+  Overlay->write(NDPluginOverlayInPlaceString, 0);
+  pArray = newImage(8, 8, 0);
+  BOOST_CHECK(process(pArray) != pArray);
+  pArray->release();
+  Overlay->write(NDPluginOverlayInPlaceString, 1);
+  Overlay->write(NDPluginDriverBlockingCallbacksString, 1);
+  pArray = newImage(8, 8, 0);
+  BOOST_CHECK(process(pArray) != pArray);
+  pArray->release();
+}
+
+
 BOOST_AUTO_TEST_SUITE_END() // Done!
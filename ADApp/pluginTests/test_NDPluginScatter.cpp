@@ -0,0 +1,208 @@
+/*
+ * test_NDPluginScatter.cpp
+ *
+ */
+
+#include <stdio.h>
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+#include <epicsThread.h>
+
+#include <string.h>
+
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "ScatterPluginWrapper.h"
+
+// Downstream plugin that counts the arrays it processes, and takes delay seconds to process each one.
+// Its callback threads are not started, so with non-blocking callbacks the arrays stay in its queue.
+class ScatterClient : public NDPluginDriver {
+public:
+  ScatterClient(const char *portName, int queueSize, int blockingCallbacks, const char *scatterPort, double delay)
+    : NDPluginDriver(portName, queueSize, blockingCallbacks, scatterPort, 0, 1, 0, 0,
+                     asynGenericPointerMask, asynGenericPointerMask, 0, 1, 0, 0, 1),
+      numProcessed(0), delay_(delay)
+  {
+    setIntegerParam(NDPluginDriverEnableCallbacks, 1);
+    connectToArrayPort();
+  }
+  void processCallbacks(NDArray *pArray)
+  {
+    NDPluginDriver::beginProcessCallbacks(pArray);
+    numProcessed++;
+    if (delay_ > 0) epicsThreadSleep(delay_);
+  }
+  int droppedArrays()
+  {
+    int dropped;
+    getIntegerParam(NDPluginDriverDroppedArrays, &dropped);
+    return dropped;
+  }
+  int numProcessed;
+private:
+  double delay_;
+};
+
+struct ScatterPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<ScatterPluginWrapper> scatter;
+  NDArrayPool *arrayPool;
+  std::string testport;
+
+  ScatterPluginTestFixture()
+  {
+    // Asyn manager doesn't like it if we try to reuse the same port name for multiple drivers
+    // (even if only one is ever instantiated at once), so we change it slightly for each test case.
+    std::string simport("simSCATTER");
+    testport = "SCATTER";
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+    arrayPool = driver->pNDArrayPool;
+
+    // This is the plugin under test
+    scatter = boost::shared_ptr<ScatterPluginWrapper>(new ScatterPluginWrapper(testport, simport));
+    scatter->write(NDPluginDriverEnableCallbacksString, 1);
+    scatter->write(NDPluginDriverBlockingCallbacksString, 1);
+    scatter->write(NDArrayCallbacksString, 1);
+  }
+
+  ~ScatterPluginTestFixture()
+  {
+    scatter.reset();
+    driver.reset();
+  }
+
+  // Returns the name of a new client port
+  std::string clientPort()
+  {
+    std::string port("SCATTERCLIENT");
+    uniqueAsynPortName(port);
+    return port;
+  }
+
+  // Passes an array to the scatter plugin, optionally with an attribute named Channel
+  void process(int uniqueId, NDAttrDataType_t attrType=NDAttrUndefined, const void *pValue=NULL)
+  {
+    size_t dims[1] = {4};
+    NDArray *pArray = arrayPool->alloc(1, dims, NDUInt8, 0, NULL);
+    pArray->uniqueId = uniqueId;
+    if (pValue) pArray->pAttributeList->add("Channel", "", attrType, (void *)pValue);
+    scatter->lock();
+    scatter->processCallbacks(pArray);
+    scatter->unlock();
+    pArray->release();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ScatterPluginTests, ScatterPluginTestFixture)
+
+// The clients are not deleted; asyn ports cannot be deleted
+BOOST_AUTO_TEST_CASE(test_LeastQueued)
+{
+  ScatterClient *pClientA = new ScatterClient(clientPort().c_str(), 2, 0, testport.c_str(), 0);
+  ScatterClient *pClientB = new ScatterClient(clientPort().c_str(), 5, 0, testport.c_str(), 0);
+  scatter->write(NDPluginScatterMethodString, NDScatterLeastQueued);
+
+  // The client with the most free queue elements gets each array
+  for (int i=0; i<3; i++) process(i);
+  BOOST_CHECK_EQUAL(pClientA->getQueueFree(), 2);
+  BOOST_CHECK_EQUAL(pClientB->getQueueFree(), 2);
+
+  // Until both queues are full, without dropping arrays
+  for (int i=3; i<7; i++) process(i);
+  BOOST_CHECK_EQUAL(pClientA->getQueueFree(), 0);
+  BOOST_CHECK_EQUAL(pClientB->getQueueFree(), 0);
+  BOOST_CHECK_EQUAL(pClientA->droppedArrays(), 0);
+  BOOST_CHECK_EQUAL(pClientB->droppedArrays(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_Weighted)
+{
+  ScatterClient *pFast = new ScatterClient(clientPort().c_str(), 2, 1, testport.c_str(), 0.002);
+  ScatterClient *pSlow = new ScatterClient(clientPort().c_str(), 2, 1, testport.c_str(), 0.008);
+  scatter->write(NDPluginScatterMethodString, NDScatterWeighted);
+
+  // Clients receive arrays in proportion to the rate at which they process them, about 4 to 1
+  for (int i=0; i<40; i++) process(i);
+  BOOST_CHECK_EQUAL(pFast->numProcessed + pSlow->numProcessed, 40);
+  BOOST_CHECK_GT(pSlow->numProcessed, 0);
+  BOOST_CHECK_GT(pFast->numProcessed, 2*pSlow->numProcessed);
+}
+
+BOOST_AUTO_TEST_CASE(test_Attribute)
+{
+  std::vector<TestingPlugin *> clients;
+  for (int i=0; i<3; i++) clients.push_back(new TestingPlugin(testport.c_str(), 0));
+  scatter->write(NDPluginScatterMethodString, NDScatterAttribute);
+  scatter->write(NDPluginScatterAttributeString, std::string("Channel"));
+
+  // Returns the index of the client that received the last array
+  std::vector<size_t> counts(clients.size(), 0);
+  struct {
+    int operator()(std::vector<TestingPlugin *>& clients, std::vector<size_t>& counts) {
+      int received = -1;
+      for (size_t i=0; i<clients.size(); i++) {
+        if (clients[i]->arrays.size() != counts[i]) received = (int)i;
+        counts[i] = clients[i]->arrays.size();
+      }
+      return received;
+    }
+  } lastClient;
+
+  // The same value always selects the same client, and consecutive values different clients
+  int channelClient[6];
+  for (epicsInt32 channel=0; channel<6; channel++) {
+    process(channel, NDAttrInt32, &channel);
+    channelClient[channel] = lastClient(clients, counts);
+    BOOST_REQUIRE_GE(channelClient[channel], 0);
+  }
+  BOOST_CHECK(channelClient[0] != channelClient[1]);
+  BOOST_CHECK(channelClient[1] != channelClient[2]);
+  BOOST_CHECK(channelClient[0] != channelClient[2]);
+  for (int channel=3; channel<6; channel++) {
+    BOOST_CHECK_EQUAL(channelClient[channel], channelClient[channel-3]);
+  }
+
+  // Negative values select clients in the same way, starting from -1
+  epicsInt32 negative = -1;
+  process(6, NDAttrInt32, &negative);
+  BOOST_CHECK_EQUAL(lastClient(clients, counts), channelClient[0]);
+  negative = -2;
+  process(7, NDAttrInt32, &negative);
+  BOOST_CHECK_EQUAL(lastClient(clients, counts), channelClient[1]);
+
+  // Floating point values are converted to integers, strings are hashed
+  epicsFloat64 f64 = 4.;
+  process(10, NDAttrFloat64, &f64);
+  BOOST_CHECK_EQUAL(lastClient(clients, counts), channelClient[4]);
+  process(11, NDAttrString, "detector-2");
+  int stringClient = lastClient(clients, counts);
+  process(12, NDAttrString, "detector-2");
+  BOOST_CHECK_EQUAL(lastClient(clients, counts), stringClient);
+
+  // Arrays without the attribute are passed to the clients in turn
+  std::vector<int> received;
+  for (int i=0; i<3; i++) {
+    process(20+i);
+    received.push_back(lastClient(clients, counts));
+  }
+  BOOST_CHECK(received[0] != received[1]);
+  BOOST_CHECK(received[1] != received[2]);
+  BOOST_CHECK(received[0] != received[2]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,212 @@
+/*
+ * test_NDPluginStdArrays.cpp
+ *
+ */
+
+#include <stdio.h>
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <NDPluginDriver.h>
+#include <NDArray.h>
+#include <asynDriver.h>
+
+#include <string.h>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+using namespace std;
+
+#include "testingutilities.h"
+#include "StdArraysPluginWrapper.h"
+
+// Client of one of the asyn array interfaces, which keeps the data pointer and values of the last callback
+template <class clientType, typename epicsType>
+class StdArraysClient : public clientType {
+public:
+  StdArraysClient(const char *portName)
+    : clientType(portName, 0, NDPluginStdArraysDataString), pData(NULL)
+  {
+    this->registerInterruptUser(callback);
+  }
+  static void callback(void *userPvt, asynUser *pasynUser, epicsType *pData, size_t nElements)
+  {
+    StdArraysClient *self = (StdArraysClient *)userPvt;
+    self->pData = pData;
+    self->values.assign(pData, pData + nElements);
+  }
+  epicsType *pData;
+  std::vector<epicsType> values;
+};
+
+typedef StdArraysClient<asynInt8ArrayClient, epicsInt8> Int8Client;
+typedef StdArraysClient<asynInt16ArrayClient, epicsInt16> Int16Client;
+
+struct StdArraysPluginTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  boost::shared_ptr<StdArraysPluginWrapper> stdArrays;
+  NDArrayPool *arrayPool;
+  std::string testport;
+
+  StdArraysPluginTestFixture()
+  {
+    // Asyn manager doesn't like it if we try to reuse the same port name for multiple drivers
+    // (even if only one is ever instantiated at once), so we change it slightly for each test case.
+    std::string simport("simSTDARRAYS");
+    testport = "STDARRAYS";
+    uniqueAsynPortName(simport);
+    uniqueAsynPortName(testport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     1, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     0, 0, 0, 0));
+    arrayPool = driver->pNDArrayPool;
+
+    // This is the plugin under test
+    stdArrays = boost::shared_ptr<StdArraysPluginWrapper>(new StdArraysPluginWrapper(testport, simport));
+    stdArrays->write(NDPluginDriverEnableCallbacksString, 1);
+    stdArrays->write(NDPluginDriverBlockingCallbacksString, 1);
+  }
+
+  ~StdArraysPluginTestFixture()
+  {
+    stdArrays.reset();
+    driver.reset();
+  }
+
+  // Returns a new array with the value of each element equal to its index
+  NDArray *newArray(int ndims, size_t *dims, NDDataType_t dataType)
+  {
+    NDArray *pArray = arrayPool->alloc(ndims, dims, dataType, 0, NULL);
+    NDArrayInfo_t arrayInfo;
+    pArray->getInfo(&arrayInfo);
+    for (size_t i=0; i<arrayInfo.nElements; i++) {
+      if (dataType == NDUInt8) ((epicsUInt8 *)pArray->pData)[i] = (epicsUInt8)(i % 128);
+      else ((epicsUInt16 *)pArray->pData)[i] = (epicsUInt16)i;
+    }
+    return pArray;
+  }
+
+  void process(NDArray *pArray)
+  {
+    stdArrays->lock();
+    stdArrays->processCallbacks(pArray);
+    stdArrays->unlock();
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(StdArraysPluginTests, StdArraysPluginTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_ZeroCopy)
+{
+  Int8Client int8Client(testport.c_str());
+  size_t dims[2] = {4, 3};
+  NDArray *pArray = newArray(2, dims, NDUInt8);
+
+  // Unsigned data is passed to the signed interface of the same size without a copy
+  process(pArray);
+  BOOST_CHECK_EQUAL((void *)int8Client.pData, pArray->pData);
+  BOOST_REQUIRE_EQUAL(int8Client.values.size(), (size_t)12);
+  for (int i=0; i<12; i++) BOOST_CHECK_EQUAL(int8Client.values[i], i);
+  BOOST_CHECK_EQUAL(stdArrays->pNDArrayPool->getNumBuffers(), 0);
+
+  // Reading the array copies the data directly
+  epicsInt8 int8Values[20];
+  size_t nIn = 0;
+  BOOST_CHECK_EQUAL(int8Client.read(int8Values, 20, &nIn), asynSuccess);
+  BOOST_REQUIRE_EQUAL(nIn, (size_t)12);
+  for (int i=0; i<12; i++) BOOST_CHECK_EQUAL(int8Values[i], i);
+  BOOST_CHECK_EQUAL(stdArrays->pNDArrayPool->getNumBuffers(), 0);
+
+  // A client of another interface needs the data converted, once for all its clients
+  Int16Client int16Client(testport.c_str());
+  Int16Client int16Client2(testport.c_str());
+  process(pArray);
+  BOOST_CHECK_EQUAL((void *)int8Client.pData, pArray->pData);
+  BOOST_CHECK((void *)int16Client.pData != pArray->pData);
+  BOOST_CHECK_EQUAL(int16Client.pData, int16Client2.pData);
+  BOOST_REQUIRE_EQUAL(int16Client.values.size(), (size_t)12);
+  for (int i=0; i<12; i++) BOOST_CHECK_EQUAL(int16Client.values[i], i);
+  BOOST_CHECK_EQUAL(stdArrays->pNDArrayPool->getNumBuffers(), 1);
+
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_CASE(test_Decimation)
+{
+  Int16Client int16Client(testport.c_str());
+  // Downstream plugins receive the original arrays, only the asyn clients receive decimated arrays
+  TestingPlugin downstream(testport.c_str(), 0, true);
+  stdArrays->write(NDArrayCallbacksString, 1);
+  NDArray *pOut;
+
+  // An image is decimated by the same factor in X and Y, to no more than the maximum number of elements
+  size_t dims2D[2] = {10, 7};
+  NDArray *pArray = newArray(2, dims2D, NDUInt16);
+  stdArrays->write(NDPluginStdArraysMaxElementsString, 12);
+  process(pArray);
+  BOOST_CHECK_EQUAL(stdArrays->readInt(NDPluginStdArraysDecimationString), 3);
+  BOOST_REQUIRE_EQUAL(downstream.arrays.size(), (size_t)1);
+  pOut = downstream.arrays.back();
+  BOOST_REQUIRE_EQUAL(pOut->ndims, 2);
+  BOOST_CHECK_EQUAL(pOut->dims[0].size, (size_t)10);
+  BOOST_CHECK_EQUAL(pOut->dims[1].size, (size_t)7);
+  BOOST_CHECK_EQUAL(pOut->dims[0].binning, 1);
+  BOOST_CHECK_EQUAL(pOut->dims[1].binning, 1);
+  BOOST_REQUIRE_EQUAL(int16Client.values.size(), (size_t)12);
+  for (int y=0; y<3; y++) {
+    for (int x=0; x<4; x++) {
+      BOOST_CHECK_EQUAL(int16Client.values[y*4 + x], 3*y*10 + 3*x);
+    }
+  }
+  pArray->release();
+
+  // A 1-D array is decimated in X only
+  size_t dims1D[1] = {100};
+  pArray = newArray(1, dims1D, NDUInt16);
+  stdArrays->write(NDPluginStdArraysMaxElementsString, 30);
+  process(pArray);
+  BOOST_CHECK_EQUAL(stdArrays->readInt(NDPluginStdArraysDecimationString), 4);
+  pOut = downstream.arrays.back();
+  BOOST_CHECK_EQUAL(pOut->dims[0].size, (size_t)100);
+  BOOST_REQUIRE_EQUAL(int16Client.values.size(), (size_t)25);
+  for (int i=0; i<25; i++) BOOST_CHECK_EQUAL(int16Client.values[i], 4*i);
+  pArray->release();
+
+  // The color dimension of an RGB1 image is not decimated
+  size_t dimsRGB[3] = {3, 8, 6};
+  pArray = newArray(3, dimsRGB, NDUInt16);
+  int colorMode = NDColorModeRGB1;
+  pArray->pAttributeList->add("ColorMode", "Color mode", NDAttrInt32, &colorMode);
+  stdArrays->write(NDPluginStdArraysMaxElementsString, 40);
+  process(pArray);
+  BOOST_CHECK_EQUAL(stdArrays->readInt(NDPluginStdArraysDecimationString), 2);
+  pOut = downstream.arrays.back();
+  BOOST_REQUIRE_EQUAL(pOut->ndims, 3);
+  BOOST_CHECK_EQUAL(pOut->dims[1].size, (size_t)8);
+  BOOST_CHECK_EQUAL(pOut->dims[2].size, (size_t)6);
+  BOOST_REQUIRE_EQUAL(int16Client.values.size(), (size_t)36);
+  for (int y=0; y<3; y++) {
+    for (int x=0; x<4; x++) {
+      for (int c=0; c<3; c++) {
+        BOOST_CHECK_EQUAL(int16Client.values[(y*4 + x)*3 + c], c + 3*2*x + 24*2*y);
+      }
+    }
+  }
+
+  // Arrays within the limit are passed unchanged
+  stdArrays->write(NDPluginStdArraysMaxElementsString, 0);
+  process(pArray);
+  BOOST_CHECK_EQUAL(stdArrays->readInt(NDPluginStdArraysDecimationString), 1);
+  pOut = downstream.arrays.back();
+  BOOST_CHECK_EQUAL(pOut->dims[1].size, (size_t)8);
+  BOOST_CHECK_EQUAL((void *)int16Client.pData, pArray->pData);
+  BOOST_CHECK_EQUAL(int16Client.values.size(), (size_t)144);
+  pArray->release();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,151 @@
+/*
+ * test_NDPosPluginStore.cpp
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <fstream>
+
+#include "boost/test/unit_test.hpp"
+
+#include "NDPosPluginStore.h"
+#include "NDPosPluginFileReader.h"
+
+static const char *xmlLayout = "<pos_layout>\
+  <dimensions>\
+    <dimension name=\"y\"></dimension>\
+    <dimension name=\"x\"></dimension>\
+  </dimensions>\
+  <positions>\
+    <position x=\"0\" y=\"10\"></position>\
+    <position x=\"1.5\" y=\"11\"></position>\
+    <position x=\"bad\" y=\"12\"></position>\
+    <position x=\"nan\" y=\"12\"></position>\
+    <position x=\"2\" y=\"13\"></position>\
+  </positions>\
+  </pos_layout>";
+
+static const char *xmlPositionFirst = "<pos_layout>\
+  <positions>\
+    <position x=\"0\"></position>\
+  </positions>\
+  <dimensions>\
+    <dimension name=\"x\"></dimension>\
+  </dimensions>\
+  </pos_layout>";
+
+// Writes a binary position file with the axes a and x, with NaN as the last value if nanLast is set
+static void writeBinary(const char *filename, int numPositions, bool truncate, bool nanLast=false)
+{
+  std::ofstream out(filename, std::ios::binary);
+  const char *names[] = {"x", "a"};
+  epicsUInt32 numAxes = 2;
+
+  out.write(NDPosPluginFileReader::BINARY_MAGIC, sizeof(NDPosPluginFileReader::BINARY_MAGIC));
+  out.write((const char *)&numAxes, sizeof(numAxes));
+  for (int i = 0; i < 2; i++) {
+    epicsUInt32 length = (epicsUInt32)strlen(names[i]);
+    out.write((const char *)&length, sizeof(length));
+    out.write(names[i], length);
+  }
+  for (int i = 0; i < numPositions; i++) {
+    double values[2] = {(double)i, 100. + i};
+    if (nanLast && (i == numPositions-1)) values[1] = NDPosPluginStore::missingValue();
+    out.write((const char *)values, truncate && (i == numPositions-1) ? sizeof(double) : sizeof(values));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(NDPosPluginStoreTests)
+
+BOOST_AUTO_TEST_CASE(test_Store)
+{
+  NDPosPluginStore store;
+  double values[2];
+
+  // Axes are sorted by name
+  BOOST_CHECK_EQUAL(store.addAxis("y"), 0);
+  BOOST_CHECK_EQUAL(store.addAxis("x"), 0);
+  BOOST_CHECK_EQUAL(store.addAxis("y"), 1);
+  BOOST_CHECK_EQUAL(store.findAxis("z"), -1);
+  for (int i = 0; i < 10; i++) {
+    values[0] = i;
+    values[1] = 10 * i;
+    store.append(values);
+  }
+  BOOST_CHECK_EQUAL(store.size(), 10u);
+  BOOST_CHECK_EQUAL(store.value(1, 3), 30.);
+
+  // Erasing from the front keeps the indices relative to the first position
+  store.erase(4);
+  BOOST_CHECK_EQUAL(store.size(), 6u);
+  BOOST_CHECK_EQUAL(store.value(0, 0), 4.);
+  values[0] = 10;
+  values[1] = 100;
+  store.append(values);
+  BOOST_CHECK_EQUAL(store.value(1, 6), 100.);
+
+  // A new axis has no value for the positions already in the store
+  NDPosPluginStore other;
+  other.addAxis("a");
+  values[0] = -1;
+  other.append(values);
+  store.append(other);
+  BOOST_CHECK_EQUAL(store.numAxes(), 3);
+  BOOST_CHECK_EQUAL(store.size(), 8u);
+  BOOST_CHECK(NDPosPluginStore::isMissing(store.value(0, 0)));
+  BOOST_CHECK_EQUAL(store.value(0, 7), -1.);
+  BOOST_CHECK(NDPosPluginStore::isMissing(store.value(1, 7)));
+
+  store.erase(100);
+  BOOST_CHECK_EQUAL(store.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_LoadXML)
+{
+  NDPosPluginFileReader reader;
+  NDPosPluginStore store;
+
+  BOOST_CHECK_EQUAL(reader.load(xmlLayout, store), asynSuccess);
+  // The positions with an invalid value or NaN, the missing value of the store, are skipped
+  BOOST_REQUIRE_EQUAL(store.size(), 3u);
+  BOOST_CHECK_EQUAL(store.axisName(0), "x");
+  BOOST_CHECK_EQUAL(store.value(0, 1), 1.5);
+  BOOST_CHECK_EQUAL(store.value(1, 2), 13.);
+
+  NDPosPluginStore bad;
+  BOOST_CHECK_EQUAL(reader.load("<pos_layout><bad xml string</position>", bad), asynError);
+
+  // A position before the dimensions is an error rather than being dropped
+  NDPosPluginStore early;
+  BOOST_CHECK_EQUAL(reader.load(xmlPositionFirst, early), asynError);
+  BOOST_CHECK_EQUAL(early.size(), 0u);
+  BOOST_CHECK_EQUAL(reader.getErrorMsg(), "Position before the dimensions or dimension without a name, check file");
+}
+
+BOOST_AUTO_TEST_CASE(test_LoadBinary)
+{
+  NDPosPluginFileReader reader;
+  NDPosPluginStore store;
+
+  // More positions than one block of the reader
+  writeBinary("positions.bin", 10000, false);
+  BOOST_CHECK(reader.isBinary("positions.bin"));
+  BOOST_CHECK_EQUAL(reader.load("positions.bin", store), asynSuccess);
+  BOOST_REQUIRE_EQUAL(store.size(), 10000u);
+  BOOST_CHECK_EQUAL(store.axisName(0), "a");
+  BOOST_CHECK_EQUAL(store.value(0, 9999), 10099.);
+  BOOST_CHECK_EQUAL(store.value(1, 5000), 5000.);
+
+  NDPosPluginStore truncated;
+  writeBinary("positions.bin", 10, true);
+  BOOST_CHECK_EQUAL(reader.load("positions.bin", truncated), asynError);
+
+  NDPosPluginStore withNaN;
+  writeBinary("positions.bin", 10, false, true);
+  BOOST_CHECK_EQUAL(reader.load("positions.bin", withNaN), asynError);
+  remove("positions.bin");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,111 @@
+/*
+ * test_NTNDArrayPool.cpp
+ *
+ */
+
+#include <stdio.h>
+
+#include "boost/test/unit_test.hpp"
+
+// AD and asyn dependencies
+#include <NDArray.h>
+#include <asynNDArrayDriver.h>
+#include <ntndArrayConverter.h>
+
+#include "testingutilities.h"
+
+using namespace std;
+using epics::pvData::shared_vector;
+
+
+struct NTNDArrayPoolFixture
+{
+    NTNDArrayPool *pPool;
+    asynNDArrayDriver *dummy_driver;
+
+    NTNDArrayPoolFixture()
+    {
+        std::string dummy_port("simPort");
+
+        // Asyn manager doesn't like it if we try to reuse the same port name for multiple drivers (even if only one is ever instantiated at once), so
+        // change it slightly for each test case.
+        uniqueAsynPortName(dummy_port);
+
+        dummy_driver = new asynNDArrayDriver(dummy_port.c_str(), 1, 0, 0, asynGenericPointerMask, asynGenericPointerMask, 0, 0, 0, 0);
+        pPool = new NTNDArrayPool(dummy_driver, 0);
+    }
+    ~NTNDArrayPoolFixture()
+    {
+        delete pPool;
+        delete dummy_driver;
+    }
+
+    // Returns a frozen value of numBytes bytes, as pvAccess delivers them
+    shared_vector<const void> makeValue(size_t numBytes)
+    {
+        shared_vector<epicsUInt8> value(numBytes, 1);
+        return static_shared_vector_cast<const void>(freeze(value));
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(NTNDArrayPoolTests, NTNDArrayPoolFixture)
+
+BOOST_AUTO_TEST_CASE(test_WrapReleaseReuse)
+{
+  size_t dims = 100;
+  shared_vector<const void> value = makeValue(100);
+
+  // The array uses the value without copying it, holds a reference to it, and is read-only
+  NDArray *pArray = pPool->wrap(1, &dims, NDUInt8, value);
+  BOOST_REQUIRE(pArray);
+  BOOST_CHECK_EQUAL(pArray->pData, value.data());
+  BOOST_CHECK_EQUAL(pArray->dataSize, (size_t)100);
+  BOOST_CHECK(pArray->readOnly);
+  BOOST_CHECK(!value.unique());
+  BOOST_CHECK_EQUAL(pPool->getNumBuffers(), 1);
+  BOOST_CHECK_EQUAL(pPool->getMemorySize(), (size_t)100);
+
+  // Releasing a reference that is not the last keeps the value
+  pArray->reserve();
+  pArray->release();
+  BOOST_CHECK_EQUAL(pArray->pData, value.data());
+  BOOST_CHECK(!value.unique());
+
+  // The last release drops the reference and detaches the data, so the pool does not free it
+  pArray->release();
+  BOOST_CHECK(value.unique());
+  BOOST_CHECK(!pArray->pData);
+
+  // The next value reuses the array, and the memory size only counts the new value
+  shared_vector<const void> value2 = makeValue(250);
+  dims = 250;
+  NDArray *pArray2 = pPool->wrap(1, &dims, NDUInt8, value2);
+  BOOST_REQUIRE(pArray2);
+  BOOST_CHECK_EQUAL(pArray2, pArray);
+  BOOST_CHECK_EQUAL(pArray2->pData, value2.data());
+  BOOST_CHECK(pArray2->readOnly);
+  BOOST_CHECK_EQUAL(pPool->getNumBuffers(), 1);
+  BOOST_CHECK_EQUAL(pPool->getMemorySize(), (size_t)250);
+  BOOST_CHECK(value.unique());
+
+  // A copy into an ordinary pool has data of its own, which can be modified
+  NDArrayPool plainPool(dummy_driver, 0);
+  NDArray *pCopy = plainPool.copy(pArray2, NULL, true);
+  BOOST_REQUIRE(pCopy);
+  BOOST_CHECK(pCopy->pData != value2.data());
+  BOOST_CHECK(!pCopy->readOnly);
+  pCopy->release();
+
+  pArray2->release();
+  BOOST_CHECK(value2.unique());
+}
+
+BOOST_AUTO_TEST_CASE(test_WrapEmpty)
+{
+  size_t dims = 0;
+  shared_vector<const void> value;
+  BOOST_CHECK(!pPool->wrap(1, &dims, NDUInt8, value));
+  BOOST_CHECK_EQUAL(pPool->getNumBuffers(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+/*
+ * test_functAttribute.cpp
+ *
+ */
+
+#include <string.h>
+#include <string>
+
+#include "boost/test/unit_test.hpp"
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <registryFunction.h>
+
+#include "NDAttributeList.h"
+#include "functAttribute.h"
+
+static int countCalls = 0;
+
+// Sets the attribute to the number of times it has been called
+static int countFunction(const char *paramString, void **functionPvt, functAttribute *pAttribute)
+{
+  countCalls++;
+  pAttribute->setDataType(NDAttrInt32);
+  pAttribute->setValue(&countCalls);
+  return ND_SUCCESS;
+}
+
+static epicsEventId blockStarted = 0;
+static epicsEventId blockRelease = 0;
+
+// Blocks until released, as a slow source would
+static int blockFunction(const char *paramString, void **functionPvt, functAttribute *pAttribute)
+{
+  pAttribute->setDataType(NDAttrString);
+  epicsEventSignal(blockStarted);
+  epicsEventWait(blockRelease);
+  pAttribute->setValue(std::string(paramString));
+  return ND_SUCCESS;
+}
+
+struct FunctionRegistration
+{
+  FunctionRegistration()
+  {
+    registryFunctionAdd("testCountFunction", (REGISTRYFUNCTION)countFunction);
+    registryFunctionAdd("testBlockFunction", (REGISTRYFUNCTION)blockFunction);
+  }
+};
+
+static FunctionRegistration functionRegistration;
+
+struct UpdaterArgs
+{
+  NDAttributeList *pList;
+  epicsEventId done;
+};
+
+static void updateValues(void *arg)
+{
+  UpdaterArgs *pArgs = (UpdaterArgs *)arg;
+  pArgs->pList->updateValues();
+  epicsEventSignal(pArgs->done);
+}
+
+BOOST_AUTO_TEST_CASE(test_FunctPublishesValues)
+{
+  NDAttributeList list;
+  functAttribute *pAttr = new functAttribute("Count", "", "testCountFunction", "");
+  list.add(pAttr);
+  countCalls = 0;
+
+  // The value set by the function is only seen by the attribute after updateValue()
+  epicsInt32 value = -1;
+  pAttr->setDataType(NDAttrInt32);
+  pAttr->setValue(&value);
+  BOOST_REQUIRE_EQUAL(pAttr->publishValue(), ND_SUCCESS);
+  BOOST_REQUIRE_EQUAL(pAttr->getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, -1);
+  BOOST_REQUIRE_EQUAL(pAttr->updateValue(), ND_SUCCESS);
+  BOOST_REQUIRE_EQUAL(pAttr->getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, 1);
+
+  list.updateValues();
+  NDAttributeList copy;
+  list.copy(&copy);
+  NDAttribute *pCopy = copy.find("Count");
+  BOOST_REQUIRE(pCopy);
+  BOOST_REQUIRE_EQUAL(pCopy->getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, 2);
+  BOOST_CHECK_EQUAL(list.getSnapshotRetries(), 0u);
+
+  // Outside publishValue() setValue() sets the value directly
+  epicsInt32 direct = 42;
+  pCopy->setValue(&direct);
+  BOOST_REQUIRE_EQUAL(pCopy->getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, 42);
+}
+
+BOOST_AUTO_TEST_CASE(test_SlowFunctionDoesNotBlockCopy)
+{
+  NDAttributeList list;
+  list.add(new functAttribute("Slow", "", "testBlockFunction", "done"));
+  blockStarted = epicsEventCreate(epicsEventEmpty);
+  blockRelease = epicsEventCreate(epicsEventEmpty);
+  UpdaterArgs args;
+  args.pList = &list;
+  args.done = epicsEventCreate(epicsEventEmpty);
+
+  epicsThreadCreate("updateValues", epicsThreadPriorityMedium,
+                    epicsThreadGetStackSize(epicsThreadStackMedium), updateValues, &args);
+  BOOST_REQUIRE_EQUAL(epicsEventWaitWithTimeout(blockStarted, 5.0), epicsEventOK);
+
+  // The function is still running, but the list can be copied and searched
+  NDAttributeList copy;
+  BOOST_CHECK_EQUAL(list.copy(&copy), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(copy.count(), 1);
+  BOOST_CHECK(list.find("Slow"));
+
+  epicsEventSignal(blockRelease);
+  BOOST_REQUIRE_EQUAL(epicsEventWaitWithTimeout(args.done, 5.0), epicsEventOK);
+  std::string value;
+  BOOST_REQUIRE_EQUAL(list.find("Slow")->getValue(value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, "done");
+
+  epicsEventDestroy(args.done);
+  epicsEventDestroy(blockStarted);
+  epicsEventDestroy(blockRelease);
+}
+
+BOOST_AUTO_TEST_CASE(test_UpdatePolicies)
+{
+  functAttribute frame("Frame", "", "testCountFunction", "");
+  functAttribute periodic("Periodic", "", "testCountFunction", "", functUpdatePeriodic, 0.5);
+  functAttribute change("Change", "", "testCountFunction", "", functUpdateChange);
+  epicsInt32 value;
+
+  // functUpdateFrame calls the function every time
+  countCalls = 0;
+  for (int i = 0; i < 5; i++) frame.publishValue();
+  BOOST_CHECK_EQUAL(countCalls, 5);
+
+  // functUpdatePeriodic calls it the first time, then not again until the period has elapsed
+  countCalls = 0;
+  for (int i = 0; i < 10; i++) {
+    BOOST_REQUIRE_EQUAL(periodic.publishValue(), ND_SUCCESS);
+    periodic.updateValue();
+  }
+  BOOST_CHECK_EQUAL(countCalls, 1);
+  BOOST_REQUIRE_EQUAL(periodic.getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, 1);
+  epicsThreadSleep(0.6);
+  periodic.publishValue();
+  periodic.publishValue();
+  BOOST_CHECK_EQUAL(countCalls, 2);
+  periodic.updateValue();
+  BOOST_REQUIRE_EQUAL(periodic.getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, 2);
+
+  // functUpdateChange calls it the first time, then once after each requestUpdate()
+  countCalls = 0;
+  for (int i = 0; i < 3; i++) change.publishValue();
+  BOOST_CHECK_EQUAL(countCalls, 1);
+  change.requestUpdate();
+  change.requestUpdate();
+  for (int i = 0; i < 3; i++) change.publishValue();
+  BOOST_CHECK_EQUAL(countCalls, 2);
+  BOOST_CHECK_EQUAL(change.getUpdatePolicy(), functUpdateChange);
+}
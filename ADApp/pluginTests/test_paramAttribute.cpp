@@ -0,0 +1,91 @@
+/*
+ * test_paramAttribute.cpp
+ *
+ */
+
+#include <string>
+
+#include "boost/test/unit_test.hpp"
+
+// AD dependencies
+#include <asynNDArrayDriver.h>
+#include <NDAttributeList.h>
+#include <paramAttribute.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "testingutilities.h"
+
+struct ParamAttributeTestFixture
+{
+  boost::shared_ptr<asynNDArrayDriver> driver;
+  int arrayCounter;
+  int fileName;
+
+  ParamAttributeTestFixture()
+  {
+    std::string simport("simPARAMATTR");
+    uniqueAsynPortName(simport);
+
+    driver = boost::shared_ptr<asynNDArrayDriver>(new asynNDArrayDriver(simport.c_str(),
+                                                                     2, 0, 0,
+                                                                     asynGenericPointerMask,
+                                                                     asynGenericPointerMask,
+                                                                     ASYN_MULTIDEVICE, 0, 0, 0));
+    driver->findParam(NDArrayCounterString, &arrayCounter);
+    driver->findParam(NDFileNameString, &fileName);
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(ParamAttributeTests, ParamAttributeTestFixture)
+
+BOOST_AUTO_TEST_CASE(test_BatchGroupsByAddr)
+{
+  NDAttributeList list;
+  paramAttributeBatch batch;
+  paramAttribute *pCounter0 = new paramAttribute("Counter0", "", NDArrayCounterString, 0, driver.get(), "INT");
+  paramAttribute *pCounter1 = new paramAttribute("Counter1", "", NDArrayCounterString, 1, driver.get(), "INT");
+  paramAttribute *pName0 = new paramAttribute("Name0", "", NDFileNameString, 0, driver.get(), "STRING");
+  list.add(pCounter0);
+  list.add(pCounter1);
+  list.add(pName0);
+
+  BOOST_REQUIRE_EQUAL(batch.add(pName0), ND_SUCCESS);
+  BOOST_REQUIRE_EQUAL(batch.add(pCounter1), ND_SUCCESS);
+  BOOST_REQUIRE_EQUAL(batch.add(pCounter0), ND_SUCCESS);
+  // One group for each asyn address
+  BOOST_CHECK_EQUAL(batch.count(), 3);
+  BOOST_CHECK_EQUAL(batch.numGroups(), 2);
+
+  driver->setIntegerParam(0, arrayCounter, 7);
+  driver->setIntegerParam(1, arrayCounter, 8);
+  driver->setStringParam(0, fileName, "test");
+  BOOST_CHECK_EQUAL(batch.update(), asynSuccess);
+  // publishValue() does nothing for batched attributes, so a change after update() is not seen
+  driver->setIntegerParam(0, arrayCounter, 9);
+  list.updateValues();
+
+  epicsInt32 value;
+  std::string name;
+  BOOST_REQUIRE_EQUAL(pCounter0->getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, 7);
+  BOOST_REQUIRE_EQUAL(pCounter1->getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, 8);
+  BOOST_REQUIRE_EQUAL(pName0->getValue(name), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(name, "test");
+
+  // A deleted attribute removes itself from the batch, and its group when it was the last one
+  list.remove("Counter1");
+  BOOST_CHECK_EQUAL(batch.count(), 2);
+  BOOST_CHECK_EQUAL(batch.numGroups(), 1);
+
+  // An attribute removed from the batch reads its parameter in publishValue() again
+  BOOST_REQUIRE_EQUAL(batch.remove(pCounter0), ND_SUCCESS);
+  list.updateValues();
+  BOOST_REQUIRE_EQUAL(pCounter0->getValue(NDAttrInt32, &value), ND_SUCCESS);
+  BOOST_CHECK_EQUAL(value, 9);
+  batch.clear();
+  BOOST_CHECK_EQUAL(batch.count(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -84,23 +84,24 @@ void TestingPluginCallback(void *drvPvt, asynUser *pasynUser, void *ptr)
   self->callback((NDArray*)ptr);
 }
 
-TestingPlugin::TestingPlugin (const char *portName, int addr)
+TestingPlugin::TestingPlugin (const char *portName, int addr, bool reserveArrays)
 /* Invoke the base class constructor */
-: asynGenericPointerClient(portName, addr, NDArrayDataString)
+: asynGenericPointerClient(portName, addr, NDArrayDataString), reserveArrays_(reserveArrays)
 {
   this->registerInterruptUser(TestingPluginCallback);
 }
 
 TestingPlugin::~TestingPlugin()
 {
-  while(arrays.front()) {
-    arrays.front()->release();
+  while(!arrays.empty()) {
+    if (reserveArrays_) arrays.front()->release();
     arrays.pop_front();
   }
 }
 
 void TestingPlugin::callback(NDArray *pArray)
 {
+  if (reserveArrays_) pArray->reserve();
   arrays.push_back(pArray);
 }
 
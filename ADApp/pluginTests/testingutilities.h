@@ -25,12 +25,16 @@ void fillNDArraysFromPool(const std::vector<size_t>& dimensions, NDDataType_t da
 void uniqueAsynPortName(std::string& name);
 
 // Mock simply stores all received NDArrays and provides them to a client on request.
+// If reserveArrays is set it reserves each array, so that its data can be checked after the plugin under test
+// has released it, and releases them when it is deleted; it must then be deleted before their pool.
 class TestingPlugin : public asynGenericPointerClient {
 public:
-  TestingPlugin (const char *portName, int addr);
+  TestingPlugin (const char *portName, int addr, bool reserveArrays=false);
   ~TestingPlugin();
   void callback(NDArray *pArray);
   std::deque<NDArray *> arrays;
+private:
+  bool reserveArrays_;
 };
 
 